@@ -44,6 +44,7 @@
 #include <limits.h>
 #include <ctype.h>
 #include <float.h>
+#include <stddef.h>
 
 #ifdef ENABLE_LOCALES
 #include <locale.h>
@@ -237,6 +238,97 @@ CJSON_PUBLIC(void) cJSON_InitHooks(cJSON_Hooks* hooks)
     }
 }
 
+/* internal type flags of items that live in the arena of a document parsed with cJSON_ParseWithLengthArena */
+#define cJSON_InArena (1 << 10)
+#define cJSON_ArenaRoot (1 << 11)
+
+/* A bump allocator: items and strings are carved out of a few large blocks,
+ * all of which are released together when the root of the document is deleted. */
+typedef struct arena_block
+{
+    struct arena_block *previous;
+    size_t size; /* usable bytes after the header */
+    size_t used;
+} arena_block;
+
+typedef struct
+{
+    arena_block *current;
+    internal_hooks hooks;
+} parse_arena;
+
+/* the root item is stored right behind the arena, so cJSON_Delete can find it */
+typedef struct
+{
+    parse_arena arena;
+    cJSON root;
+} arena_document;
+
+typedef union
+{
+    double number;
+    void *pointer;
+    size_t size;
+} arena_alignment;
+
+#define ARENA_ALIGNMENT sizeof(arena_alignment)
+#define arena_align(size) (((size) + (ARENA_ALIGNMENT - 1)) & ~(ARENA_ALIGNMENT - 1))
+#define arena_block_data(block) (((unsigned char*)(block)) + arena_align(sizeof(arena_block)))
+
+static arena_block *arena_new_block(const internal_hooks * const hooks, arena_block *previous, size_t size)
+{
+    arena_block *block = (arena_block*)hooks->allocate(arena_align(sizeof(arena_block)) + size);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    block->previous = previous;
+    block->size = size;
+    block->used = 0;
+
+    return block;
+}
+
+static void *arena_allocate(parse_arena * const arena, size_t size, const cJSON_bool aligned)
+{
+    arena_block *block = arena->current;
+    size_t offset = aligned ? arena_align(block->used) : block->used;
+
+    if ((offset > block->size) || (size > (block->size - offset)))
+    {
+        /* grow geometrically so that the number of blocks stays logarithmic */
+        size_t block_size = block->size * 2;
+        if (block_size < size)
+        {
+            block_size = size;
+        }
+        block = arena_new_block(&arena->hooks, block, block_size);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        arena->current = block;
+        offset = 0;
+    }
+    block->used = offset + size;
+
+    return arena_block_data(block) + offset;
+}
+
+static void arena_release(parse_arena * const arena)
+{
+    /* the first block holds the arena itself, so read everything before freeing it */
+    arena_block *block = arena->current;
+    void (CJSON_CDECL *deallocate)(void *pointer) = arena->hooks.deallocate;
+
+    while (block != NULL)
+    {
+        arena_block *previous = block->previous;
+        deallocate(block);
+        block = previous;
+    }
+}
+
 /* Internal constructor. */
 static cJSON *cJSON_New_Item(const internal_hooks * const hooks)
 {
@@ -256,6 +348,26 @@ CJSON_PUBLIC(void) cJSON_Delete(cJSON *item)
     while (item != NULL)
     {
         next = item->next;
+        if (item->type & cJSON_InArena)
+        {
+            /* arena memory is only released together with the document root, but keys
+             * that were replaced after parsing are heap allocated and have to be found first */
+            if (!(item->type & cJSON_IsReference) && (item->child != NULL))
+            {
+                cJSON_Delete(item->child);
+            }
+            if (!(item->type & cJSON_StringIsConst) && (item->string != NULL))
+            {
+                global_hooks.deallocate(item->string);
+                item->string = NULL;
+            }
+            if (item->type & cJSON_ArenaRoot)
+            {
+                arena_release(&((arena_document*)(void*)((unsigned char*)item - offsetof(arena_document, root)))->arena);
+            }
+            item = next;
+            continue;
+        }
         if (!(item->type & cJSON_IsReference) && (item->child != NULL))
         {
             cJSON_Delete(item->child);
@@ -293,8 +405,31 @@ typedef struct
     size_t offset;
     size_t depth; /* How deeply nested (in arrays/objects) is the input at the current offset. */
     internal_hooks hooks;
+    unsigned char decimal_point; /* locale decimal point, looked up once per parse */
+    parse_arena *arena; /* items and strings come from here if not NULL */
+    int item_flags; /* type flags every parsed item gets */
 } parse_buffer;
 
+/* allocate a new item for the document being parsed */
+static cJSON *parse_new_item(parse_buffer * const input_buffer)
+{
+    cJSON *node = NULL;
+
+    if (input_buffer->arena == NULL)
+    {
+        return cJSON_New_Item(&(input_buffer->hooks));
+    }
+
+    node = (cJSON*)arena_allocate(input_buffer->arena, sizeof(cJSON), true);
+    if (node)
+    {
+        memset(node, '\0', sizeof(cJSON));
+        node->type = input_buffer->item_flags;
+    }
+
+    return node;
+}
+
 /* check if the given size is left to read in a given parse buffer (starting with 1) */
 #define can_read(buffer, size) ((buffer != NULL) && (((buffer)->offset + size) <= (buffer)->length))
 /* check if the buffer can be accessed at the given index (starting with 0) */
@@ -308,23 +443,27 @@ static cJSON_bool parse_number(cJSON * const item, parse_buffer * const input_bu
 {
     double number = 0;
     unsigned char *after_end = NULL;
-    unsigned char *number_c_string;
-    unsigned char decimal_point = get_decimal_point();
+    size_t consumed = 0; /* length of the number in the input */
+    unsigned char *number_c_string = NULL;
+    unsigned char stack_buffer[64]; /* large enough for any number that is not absurdly long */
+    const unsigned char *number_start = NULL;
     size_t i = 0;
     size_t number_string_length = 0;
     cJSON_bool has_decimal_point = false;
+    cJSON_bool is_plain_integer = true; /* only an optional '-' followed by digits */
 
     if ((input_buffer == NULL) || (input_buffer->content == NULL))
     {
         return false;
     }
 
-    /* copy the number into a temporary buffer and replace '.' with the decimal point
-     * of the current locale (for strtod)
+    number_start = buffer_at_offset(input_buffer);
+
+    /* find the extent of the number.
      * This also takes care of '\0' not necessarily being available for marking the end of the input */
     for (i = 0; can_access_at_index(input_buffer, i); i++)
     {
-        switch (buffer_at_offset(input_buffer)[i])
+        switch (number_start[i])
         {
             case '0':
             case '1':
@@ -336,16 +475,28 @@ static cJSON_bool parse_number(cJSON * const item, parse_buffer * const input_bu
             case '7':
             case '8':
             case '9':
-            case '+':
+                number_string_length++;
+                break;
+
             case '-':
+                if (i != 0)
+                {
+                    is_plain_integer = false;
+                }
+                number_string_length++;
+                break;
+
+            case '+':
             case 'e':
             case 'E':
+                is_plain_integer = false;
                 number_string_length++;
                 break;
 
             case '.':
                 number_string_length++;
                 has_decimal_point = true;
+                is_plain_integer = false;
                 break;
 
             default:
@@ -353,36 +504,72 @@ static cJSON_bool parse_number(cJSON * const item, parse_buffer * const input_bu
         }
     }
 loop_end:
-    /* malloc for temporary buffer, add 1 for '\0' */
-    number_c_string = (unsigned char *) input_buffer->hooks.allocate(number_string_length + 1);
-    if (number_c_string == NULL)
+    /* fast path: integers of up to 15 digits are exactly representable as double,
+     * so they can be accumulated directly without copying and without strtod */
+    if (is_plain_integer)
     {
-        return false; /* allocation failure */
+        size_t digits_start = (number_start[0] == '-') ? 1 : 0;
+        size_t digit_count = number_string_length - digits_start;
+
+        if ((digit_count > 0) && (digit_count <= 15))
+        {
+            for (i = digits_start; i < number_string_length; i++)
+            {
+                number = (number * 10.0) + (double)(number_start[i] - '0');
+            }
+            if (digits_start == 1)
+            {
+                number = -number;
+            }
+            consumed = number_string_length;
+            goto store_number;
+        }
     }
 
-    memcpy(number_c_string, buffer_at_offset(input_buffer), number_string_length);
+    /* copy the number into a temporary buffer and replace '.' with the decimal point
+     * of the current locale (for strtod). Only absurdly long numbers need the heap. */
+    if (number_string_length < sizeof(stack_buffer))
+    {
+        number_c_string = stack_buffer;
+    }
+    else
+    {
+        /* malloc for temporary buffer, add 1 for '\0' */
+        number_c_string = (unsigned char *) input_buffer->hooks.allocate(number_string_length + 1);
+        if (number_c_string == NULL)
+        {
+            return false; /* allocation failure */
+        }
+    }
+
+    memcpy(number_c_string, number_start, number_string_length);
     number_c_string[number_string_length] = '\0';
 
-    if (has_decimal_point)
+    if (has_decimal_point && (input_buffer->decimal_point != '.'))
     {
         for (i = 0; i < number_string_length; i++)
         {
             if (number_c_string[i] == '.')
             {
                 /* replace '.' with the decimal point of the current locale (for strtod) */
-                number_c_string[i] = decimal_point;
+                number_c_string[i] = input_buffer->decimal_point;
             }
         }
     }
 
     number = strtod((const char*)number_c_string, (char**)&after_end);
-    if (number_c_string == after_end)
+    consumed = (size_t)(after_end - number_c_string);
+    if (number_c_string != stack_buffer)
     {
         /* free the temporary buffer */
         input_buffer->hooks.deallocate(number_c_string);
+    }
+    if (consumed == 0)
+    {
         return false; /* parse_error */
     }
 
+store_number:
     item->valuedouble = number;
 
     /* use saturation in case of overflow */
@@ -399,11 +586,9 @@ loop_end:
         item->valueint = (int)number;
     }
 
-    item->type = cJSON_Number;
+    item->type = cJSON_Number | input_buffer->item_flags;
 
-    input_buffer->offset += (size_t)(after_end - number_c_string);
-    /* free the temporary buffer */
-    input_buffer->hooks.deallocate(number_c_string);
+    input_buffer->offset += consumed;
     return true;
 }
 
@@ -456,6 +641,11 @@ CJSON_PUBLIC(char*) cJSON_SetValuestring(cJSON *object, const char *valuestring)
         strcpy(object->valuestring, valuestring);
         return object->valuestring;
     }
+    if (object->type & cJSON_InArena)
+    {
+        /* the old string belongs to the arena and cannot be replaced by a longer one */
+        return NULL;
+    }
     copy = (char*) cJSON_strdup((const unsigned char*)valuestring, &global_hooks);
     if (copy == NULL)
     {
@@ -587,74 +777,539 @@ static cJSON_bool compare_double(double a, double b)
     return (fabs(a - b) <= maxVal * DBL_EPSILON);
 }
 
+/* "00" "01" ... "99": two decimal digits per lookup when printing integers */
+static const char decimal_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* number of decimal digits in value */
+static size_t decimal_length(unsigned int value)
+{
+    size_t length = 1;
+    for (;;)
+    {
+        if (value < 10) return length;
+        if (value < 100) return length + 1;
+        if (value < 1000) return length + 2;
+        if (value < 10000) return length + 3;
+        value /= 10000;
+        length += 4;
+    }
+}
+
+/* print an int without sprintf, returns the number of characters written (not zero terminated) */
+static size_t print_integer(int value, unsigned char * const output)
+{
+    unsigned int magnitude = (value < 0) ? (0U - (unsigned int)value) : (unsigned int)value;
+    size_t sign_length = (size_t)(value < 0);
+    size_t length = sign_length + decimal_length(magnitude);
+    unsigned char *output_pointer = output + length;
+
+    output[0] = '-'; /* overwritten by the last digit if value is positive */
+    while (magnitude >= 100)
+    {
+        const char *pair = decimal_digit_pairs + ((magnitude % 100) * 2);
+        magnitude /= 100;
+        *--output_pointer = (unsigned char)pair[1];
+        *--output_pointer = (unsigned char)pair[0];
+    }
+    if (magnitude >= 10)
+    {
+        const char *pair = decimal_digit_pairs + (magnitude * 2);
+        *--output_pointer = (unsigned char)pair[1];
+        *--output_pointer = (unsigned char)pair[0];
+    }
+    else
+    {
+        *--output_pointer = (unsigned char)('0' + magnitude);
+    }
+
+    return length;
+}
+
+#if (defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 199901L)) || defined(_MSC_VER)
+/* Shortest round-trip double printing (Grisu2 with the usual 87 cached powers of ten).
+ * The output always reads back to the exact same double and is the shortest such
+ * representation for all but a tiny fraction of inputs. Needs a 64 bit integer type,
+ * otherwise the sprintf based fallback below is used. */
+#define CJSON_SHORTEST_DOUBLE
+
+typedef unsigned long long cjson_uint64;
+#define CJSON_UINT64(high, low) ((((cjson_uint64)(high)) << 32) | (cjson_uint64)(low))
+
+typedef struct
+{
+    cjson_uint64 f; /* significand */
+    int e; /* binary exponent */
+} diy_fp;
+
+#define DOUBLE_SIGNIFICAND_SIZE 52
+#define DOUBLE_EXPONENT_BIAS (0x3FF + DOUBLE_SIGNIFICAND_SIZE)
+#define DOUBLE_HIDDEN_BIT CJSON_UINT64(0x00100000, 0x00000000)
+
+static const cjson_uint64 cached_powers_significand[87] =
+{
+    CJSON_UINT64(0xfa8fd5a0, 0x081c0288), CJSON_UINT64(0xbaaee17f, 0xa23ebf76),
+    CJSON_UINT64(0x8b16fb20, 0x3055ac76), CJSON_UINT64(0xcf42894a, 0x5dce35ea),
+    CJSON_UINT64(0x9a6bb0aa, 0x55653b2d), CJSON_UINT64(0xe61acf03, 0x3d1a45df),
+    CJSON_UINT64(0xab70fe17, 0xc79ac6ca), CJSON_UINT64(0xff77b1fc, 0xbebcdc4f),
+    CJSON_UINT64(0xbe5691ef, 0x416bd60c), CJSON_UINT64(0x8dd01fad, 0x907ffc3c),
+    CJSON_UINT64(0xd3515c28, 0x31559a83), CJSON_UINT64(0x9d71ac8f, 0xada6c9b5),
+    CJSON_UINT64(0xea9c2277, 0x23ee8bcb), CJSON_UINT64(0xaecc4991, 0x4078536d),
+    CJSON_UINT64(0x823c1279, 0x5db6ce57), CJSON_UINT64(0xc2109436, 0x4dfb5637),
+    CJSON_UINT64(0x9096ea6f, 0x3848984f), CJSON_UINT64(0xd77485cb, 0x25823ac7),
+    CJSON_UINT64(0xa086cfcd, 0x97bf97f4), CJSON_UINT64(0xef340a98, 0x172aace5),
+    CJSON_UINT64(0xb23867fb, 0x2a35b28e), CJSON_UINT64(0x84c8d4df, 0xd2c63f3b),
+    CJSON_UINT64(0xc5dd4427, 0x1ad3cdba), CJSON_UINT64(0x936b9fce, 0xbb25c996),
+    CJSON_UINT64(0xdbac6c24, 0x7d62a584), CJSON_UINT64(0xa3ab6658, 0x0d5fdaf6),
+    CJSON_UINT64(0xf3e2f893, 0xdec3f126), CJSON_UINT64(0xb5b5ada8, 0xaaff80b8),
+    CJSON_UINT64(0x87625f05, 0x6c7c4a8b), CJSON_UINT64(0xc9bcff60, 0x34c13053),
+    CJSON_UINT64(0x964e858c, 0x91ba2655), CJSON_UINT64(0xdff97724, 0x70297ebd),
+    CJSON_UINT64(0xa6dfbd9f, 0xb8e5b88f), CJSON_UINT64(0xf8a95fcf, 0x88747d94),
+    CJSON_UINT64(0xb9447093, 0x8fa89bcf), CJSON_UINT64(0x8a08f0f8, 0xbf0f156b),
+    CJSON_UINT64(0xcdb02555, 0x653131b6), CJSON_UINT64(0x993fe2c6, 0xd07b7fac),
+    CJSON_UINT64(0xe45c10c4, 0x2a2b3b06), CJSON_UINT64(0xaa242499, 0x697392d3),
+    CJSON_UINT64(0xfd87b5f2, 0x8300ca0e), CJSON_UINT64(0xbce50864, 0x92111aeb),
+    CJSON_UINT64(0x8cbccc09, 0x6f5088cc), CJSON_UINT64(0xd1b71758, 0xe219652c),
+    CJSON_UINT64(0x9c400000, 0x00000000), CJSON_UINT64(0xe8d4a510, 0x00000000),
+    CJSON_UINT64(0xad78ebc5, 0xac620000), CJSON_UINT64(0x813f3978, 0xf8940984),
+    CJSON_UINT64(0xc097ce7b, 0xc90715b3), CJSON_UINT64(0x8f7e32ce, 0x7bea5c70),
+    CJSON_UINT64(0xd5d238a4, 0xabe98068), CJSON_UINT64(0x9f4f2726, 0x179a2245),
+    CJSON_UINT64(0xed63a231, 0xd4c4fb27), CJSON_UINT64(0xb0de6538, 0x8cc8ada8),
+    CJSON_UINT64(0x83c7088e, 0x1aab65db), CJSON_UINT64(0xc45d1df9, 0x42711d9a),
+    CJSON_UINT64(0x924d692c, 0xa61be758), CJSON_UINT64(0xda01ee64, 0x1a708dea),
+    CJSON_UINT64(0xa26da399, 0x9aef774a), CJSON_UINT64(0xf209787b, 0xb47d6b85),
+    CJSON_UINT64(0xb454e4a1, 0x79dd1877), CJSON_UINT64(0x865b8692, 0x5b9bc5c2),
+    CJSON_UINT64(0xc83553c5, 0xc8965d3d), CJSON_UINT64(0x952ab45c, 0xfa97a0b3),
+    CJSON_UINT64(0xde469fbd, 0x99a05fe3), CJSON_UINT64(0xa59bc234, 0xdb398c25),
+    CJSON_UINT64(0xf6c69a72, 0xa3989f5c), CJSON_UINT64(0xb7dcbf53, 0x54e9bece),
+    CJSON_UINT64(0x88fcf317, 0xf22241e2), CJSON_UINT64(0xcc20ce9b, 0xd35c78a5),
+    CJSON_UINT64(0x98165af3, 0x7b2153df), CJSON_UINT64(0xe2a0b5dc, 0x971f303a),
+    CJSON_UINT64(0xa8d9d153, 0x5ce3b396), CJSON_UINT64(0xfb9b7cd9, 0xa4a7443c),
+    CJSON_UINT64(0xbb764c4c, 0xa7a44410), CJSON_UINT64(0x8bab8eef, 0xb6409c1a),
+    CJSON_UINT64(0xd01fef10, 0xa657842c), CJSON_UINT64(0x9b10a4e5, 0xe9913129),
+    CJSON_UINT64(0xe7109bfb, 0xa19c0c9d), CJSON_UINT64(0xac2820d9, 0x623bf429),
+    CJSON_UINT64(0x80444b5e, 0x7aa7cf85), CJSON_UINT64(0xbf21e440, 0x03acdd2d),
+    CJSON_UINT64(0x8e679c2f, 0x5e44ff8f), CJSON_UINT64(0xd433179d, 0x9c8cb841),
+    CJSON_UINT64(0x9e19db92, 0xb4e31ba9), CJSON_UINT64(0xeb96bf6e, 0xbadf77d9),
+    CJSON_UINT64(0xaf87023b, 0x9bf0ee6b)
+};
+
+static const short cached_powers_exponent[87] =
+{
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static diy_fp diy_fp_from_double(double d)
+{
+    diy_fp fp;
+    cjson_uint64 bits = 0;
+    int biased_exponent = 0;
+    cjson_uint64 significand = 0;
+
+    memcpy(&bits, &d, sizeof(bits));
+    biased_exponent = (int)((bits >> DOUBLE_SIGNIFICAND_SIZE) & 0x7FF);
+    significand = bits & (DOUBLE_HIDDEN_BIT - 1);
+    if (biased_exponent != 0)
+    {
+        fp.f = significand + DOUBLE_HIDDEN_BIT;
+        fp.e = biased_exponent - DOUBLE_EXPONENT_BIAS;
+    }
+    else
+    {
+        /* subnormal */
+        fp.f = significand;
+        fp.e = 1 - DOUBLE_EXPONENT_BIAS;
+    }
+
+    return fp;
+}
+
+/* 64x64 bit multiplication keeping the rounded upper 64 bits */
+static diy_fp diy_fp_multiply(diy_fp x, diy_fp y)
+{
+    const cjson_uint64 mask = 0xFFFFFFFFU;
+    const cjson_uint64 a = x.f >> 32;
+    const cjson_uint64 b = x.f & mask;
+    const cjson_uint64 c = y.f >> 32;
+    const cjson_uint64 d = y.f & mask;
+    const cjson_uint64 ac = a * c;
+    const cjson_uint64 bc = b * c;
+    const cjson_uint64 ad = a * d;
+    const cjson_uint64 bd = b * d;
+    cjson_uint64 middle = (bd >> 32) + (ad & mask) + (bc & mask);
+    diy_fp product;
+
+    middle += (cjson_uint64)1 << 31; /* round */
+    product.f = ac + (ad >> 32) + (bc >> 32) + (middle >> 32);
+    product.e = x.e + y.e + 64;
+
+    return product;
+}
+
+static diy_fp diy_fp_normalize(diy_fp fp)
+{
+    while (!(fp.f & CJSON_UINT64(0x80000000, 0x00000000)))
+    {
+        fp.f <<= 1;
+        fp.e--;
+    }
+
+    return fp;
+}
+
+/* the normalized upper and lower rounding boundaries of v, sharing one exponent */
+static void diy_fp_boundaries(diy_fp v, diy_fp * const minus, diy_fp * const plus)
+{
+    diy_fp upper;
+    diy_fp lower;
+
+    upper.f = (v.f << 1) + 1;
+    upper.e = v.e - 1;
+    while (!(upper.f & (DOUBLE_HIDDEN_BIT << 1)))
+    {
+        upper.f <<= 1;
+        upper.e--;
+    }
+    upper.f <<= 64 - DOUBLE_SIGNIFICAND_SIZE - 2;
+    upper.e -= 64 - DOUBLE_SIGNIFICAND_SIZE - 2;
+
+    if (v.f == DOUBLE_HIDDEN_BIT)
+    {
+        /* the lower neighbour is closer when v is a power of two */
+        lower.f = (v.f << 2) - 1;
+        lower.e = v.e - 2;
+    }
+    else
+    {
+        lower.f = (v.f << 1) - 1;
+        lower.e = v.e - 1;
+    }
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+
+    *plus = upper;
+    *minus = lower;
+}
+
+/* cached power 10^-k such that multiplying by it brings binary exponent e into [-60, -32] */
+static diy_fp cached_power(int e, int * const k)
+{
+    diy_fp power;
+    double dk = ((-61 - e) * 0.30102999566398114) + 347;
+    int ik = (int)dk;
+    unsigned int index = 0;
+
+    if ((dk - ik) > 0.0)
+    {
+        ik++;
+    }
+    index = (unsigned int)((ik >> 3) + 1);
+    *k = -(-348 + (int)(index << 3));
+
+    power.f = cached_powers_significand[index];
+    power.e = cached_powers_exponent[index];
+
+    return power;
+}
+
+/* move the last digit towards the exact value while staying inside the rounding interval */
+static void grisu_round(unsigned char * const digits, size_t length, cjson_uint64 delta, cjson_uint64 rest, cjson_uint64 ten_kappa, cjson_uint64 distance)
+{
+    while ((rest < distance) && ((delta - rest) >= ten_kappa)
+            && (((rest + ten_kappa) < distance) || ((distance - rest) > (rest + ten_kappa - distance))))
+    {
+        digits[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+/* generate the shortest digits in (Wm, Wp), returns the digit count and adjusts the decimal exponent k */
+static size_t grisu_digits(diy_fp w, diy_fp upper, cjson_uint64 delta, unsigned char * const digits, int * const k)
+{
+    static const unsigned int powers_of_ten32[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+    const int shift = -upper.e;
+    const cjson_uint64 one = (cjson_uint64)1 << shift;
+    const cjson_uint64 distance = upper.f - w.f;
+    unsigned int integral = (unsigned int)(upper.f >> shift);
+    cjson_uint64 fractional = upper.f & (one - 1);
+    int kappa = (int)decimal_length(integral);
+    size_t length = 0;
+
+    while (kappa > 0)
+    {
+        const unsigned int divisor = powers_of_ten32[kappa - 1];
+        const unsigned int digit = integral / divisor;
+        cjson_uint64 rest = 0;
+
+        integral %= divisor;
+        if ((digit != 0) || (length != 0))
+        {
+            digits[length++] = (unsigned char)('0' + digit);
+        }
+        kappa--;
+        rest = (((cjson_uint64)integral) << shift) + fractional;
+        if (rest <= delta)
+        {
+            *k += kappa;
+            grisu_round(digits, length, delta, rest, ((cjson_uint64)powers_of_ten32[kappa]) << shift, distance);
+            return length;
+        }
+    }
+
+    for (;;)
+    {
+        unsigned int digit = 0;
+        cjson_uint64 scaled_distance = distance;
+        int i = 0;
+
+        fractional *= 10;
+        delta *= 10;
+        digit = (unsigned int)(fractional >> shift);
+        if ((digit != 0) || (length != 0))
+        {
+            digits[length++] = (unsigned char)('0' + digit);
+        }
+        fractional &= one - 1;
+        kappa--;
+        if (fractional < delta)
+        {
+            *k += kappa;
+            for (i = 0; i < -kappa; i++)
+            {
+                scaled_distance *= 10;
+            }
+            grisu_round(digits, length, delta, fractional, one, (-kappa < 20) ? scaled_distance : 0);
+            return length;
+        }
+    }
+}
+
+static unsigned char *print_exponent(int exponent, unsigned char *output_pointer)
+{
+    *output_pointer++ = 'e';
+    if (exponent < 0)
+    {
+        *output_pointer++ = '-';
+        exponent = -exponent;
+    }
+    else
+    {
+        *output_pointer++ = '+';
+    }
+    /* at least two digits, like printf */
+    if (exponent >= 100)
+    {
+        *output_pointer++ = (unsigned char)('0' + (exponent / 100));
+        exponent %= 100;
+    }
+    *output_pointer++ = (unsigned char)decimal_digit_pairs[exponent * 2];
+    *output_pointer++ = (unsigned char)decimal_digit_pairs[(exponent * 2) + 1];
+
+    return output_pointer;
+}
+
+/* print a finite, non zero double with the fewest digits that read back exactly.
+ * returns the number of characters written (not zero terminated), at most 25 */
+static size_t print_double_shortest(double d, unsigned char * const output)
+{
+    unsigned char *output_pointer = output;
+    unsigned char digits[20];
+    size_t length = 0;
+    int k = 0;
+    int point = 0; /* position of the decimal point relative to the first digit */
+    int i = 0;
+    diy_fp v;
+    diy_fp w;
+    diy_fp minus;
+    diy_fp plus;
+    diy_fp power;
+
+    if (d < 0)
+    {
+        *output_pointer++ = '-';
+        d = -d;
+    }
+
+    v = diy_fp_from_double(d);
+    diy_fp_boundaries(v, &minus, &plus);
+    power = cached_power(plus.e, &k);
+    w = diy_fp_multiply(diy_fp_normalize(v), power);
+    plus = diy_fp_multiply(plus, power);
+    minus = diy_fp_multiply(minus, power);
+    minus.f++;
+    plus.f--;
+    length = grisu_digits(w, plus, plus.f - minus.f, digits, &k);
+
+    /* the value is digits * 10^k, choose between plain and exponential notation */
+    point = (int)length + k;
+    if ((k >= 0) && (point <= 21))
+    {
+        /* 1234e7 -> 12340000000 */
+        memcpy(output_pointer, digits, length);
+        output_pointer += length;
+        for (i = 0; i < k; i++)
+        {
+            *output_pointer++ = '0';
+        }
+    }
+    else if ((point > 0) && (point <= 21))
+    {
+        /* 1234e-2 -> 12.34 */
+        memcpy(output_pointer, digits, (size_t)point);
+        output_pointer += point;
+        *output_pointer++ = '.';
+        memcpy(output_pointer, digits + point, length - (size_t)point);
+        output_pointer += length - (size_t)point;
+    }
+    else if ((point > -6) && (point <= 0))
+    {
+        /* 1234e-6 -> 0.001234 */
+        *output_pointer++ = '0';
+        *output_pointer++ = '.';
+        for (i = point; i < 0; i++)
+        {
+            *output_pointer++ = '0';
+        }
+        memcpy(output_pointer, digits, length);
+        output_pointer += length;
+    }
+    else
+    {
+        /* 1234e30 -> 1.234e+33 */
+        *output_pointer++ = digits[0];
+        if (length > 1)
+        {
+            *output_pointer++ = '.';
+            memcpy(output_pointer, digits + 1, length - 1);
+            output_pointer += length - 1;
+        }
+        output_pointer = print_exponent(point - 1, output_pointer);
+    }
+
+    return (size_t)(output_pointer - output);
+}
+#endif
+
 /* Render the number nicely from the given item into a string. */
 static cJSON_bool print_number(const cJSON * const item, printbuffer * const output_buffer)
 {
     unsigned char *output_pointer = NULL;
     double d = item->valuedouble;
-    int length = 0;
-    size_t i = 0;
-    unsigned char number_buffer[26] = {0}; /* temporary buffer to print the number into */
-    unsigned char decimal_point = get_decimal_point();
-    double test = 0.0;
+    size_t length = 0;
 
     if (output_buffer == NULL)
     {
         return false;
     }
 
+    /* the common case: integers are printed straight into the output */
+    if (d == (double)item->valueint)
+    {
+        output_pointer = ensure(output_buffer, sizeof("-2147483648"));
+        if (output_pointer == NULL)
+        {
+            return false;
+        }
+        length = print_integer(item->valueint, output_pointer);
+        output_pointer[length] = '\0';
+        output_buffer->offset += length;
+
+        return true;
+    }
+
     /* This checks for NaN and Infinity */
     if (isnan(d) || isinf(d))
     {
-        length = sprintf((char*)number_buffer, "null");
+        output_pointer = ensure(output_buffer, sizeof("null"));
+        if (output_pointer == NULL)
+        {
+            return false;
+        }
+        strcpy((char*)output_pointer, "null");
+        output_buffer->offset += static_strlen("null");
+
+        return true;
     }
-    else if(d == (double)item->valueint)
+
+#ifdef CJSON_SHORTEST_DOUBLE
+    output_pointer = ensure(output_buffer, 26);
+    if (output_pointer == NULL)
     {
-        length = sprintf((char*)number_buffer, "%d", item->valueint);
+        return false;
     }
-    else
+    length = print_double_shortest(d, output_pointer);
+    output_pointer[length] = '\0';
+    output_buffer->offset += length;
+
+    return true;
+#else
     {
+        unsigned char number_buffer[26] = {0}; /* temporary buffer to print the number into */
+        unsigned char decimal_point = get_decimal_point();
+        double test = 0.0;
+        int printed_length = 0;
+        size_t i = 0;
+
         /* Try 15 decimal places of precision to avoid nonsignificant nonzero digits */
-        length = sprintf((char*)number_buffer, "%1.15g", d);
+        printed_length = sprintf((char*)number_buffer, "%1.15g", d);
 
         /* Check whether the original double can be recovered */
         if ((sscanf((char*)number_buffer, "%lg", &test) != 1) || !compare_double((double)test, d))
         {
             /* If not, print with 17 decimal places of precision */
-            length = sprintf((char*)number_buffer, "%1.17g", d);
+            printed_length = sprintf((char*)number_buffer, "%1.17g", d);
         }
-    }
-
-    /* sprintf failed or buffer overrun occurred */
-    if ((length < 0) || (length > (int)(sizeof(number_buffer) - 1)))
-    {
-        return false;
-    }
 
-    /* reserve appropriate space in the output */
-    output_pointer = ensure(output_buffer, (size_t)length + sizeof(""));
-    if (output_pointer == NULL)
-    {
-        return false;
-    }
+        /* sprintf failed or buffer overrun occurred */
+        if ((printed_length < 0) || (printed_length > (int)(sizeof(number_buffer) - 1)))
+        {
+            return false;
+        }
+        length = (size_t)printed_length;
 
-    /* copy the printed number to the output and replace locale
-     * dependent decimal point with '.' */
-    for (i = 0; i < ((size_t)length); i++)
-    {
-        if (number_buffer[i] == decimal_point)
+        /* reserve appropriate space in the output */
+        output_pointer = ensure(output_buffer, length + sizeof(""));
+        if (output_pointer == NULL)
         {
-            output_pointer[i] = '.';
-            continue;
+            return false;
         }
 
-        output_pointer[i] = number_buffer[i];
-    }
-    output_pointer[i] = '\0';
+        /* copy the printed number to the output and replace locale
+         * dependent decimal point with '.' */
+        for (i = 0; i < length; i++)
+        {
+            if (number_buffer[i] == decimal_point)
+            {
+                output_pointer[i] = '.';
+                continue;
+            }
 
-    output_buffer->offset += (size_t)length;
+            output_pointer[i] = number_buffer[i];
+        }
+        output_pointer[i] = '\0';
 
-    return true;
+        output_buffer->offset += length;
+
+        return true;
+    }
+#endif
 }
 
 /* parse 4 digit hexadecimal number */
@@ -815,11 +1470,45 @@ fail:
     return 0;
 }
 
+/* find the first '\"' or '\\' in [pointer, end), testing a machine word at a time */
+static const unsigned char *scan_to_quote_or_escape(const unsigned char *pointer, const unsigned char * const end)
+{
+    const size_t ones = ((size_t)-1) / 0xFF; /* 0x0101...01 */
+    const size_t high_bits = ones * 0x80;
+    const size_t quotes = ones * (unsigned char)'\"';
+    const size_t backslashes = ones * (unsigned char)'\\';
+
+    while ((size_t)(end - pointer) >= sizeof(size_t))
+    {
+        size_t word = 0;
+        size_t quote_bytes = 0;
+        size_t backslash_bytes = 0;
+
+        memcpy(&word, pointer, sizeof(word));
+        /* a byte of these becomes zero where the input matches */
+        quote_bytes = word ^ quotes;
+        backslash_bytes = word ^ backslashes;
+        if ((((quote_bytes - ones) & ~quote_bytes) | ((backslash_bytes - ones) & ~backslash_bytes)) & high_bits)
+        {
+            break;
+        }
+        pointer += sizeof(size_t);
+    }
+
+    while ((pointer < end) && (*pointer != '\"') && (*pointer != '\\'))
+    {
+        pointer++;
+    }
+
+    return pointer;
+}
+
 /* Parse the input text into an unescaped cinput, and populate item. */
 static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_buffer)
 {
     const unsigned char *input_pointer = buffer_at_offset(input_buffer) + 1;
     const unsigned char *input_end = buffer_at_offset(input_buffer) + 1;
+    const unsigned char *content_end = input_buffer->content + input_buffer->length;
     unsigned char *output_pointer = NULL;
     unsigned char *output = NULL;
 
@@ -833,29 +1522,38 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
         /* calculate approximate size of the output (overestimate) */
         size_t allocation_length = 0;
         size_t skipped_bytes = 0;
-        while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"'))
+        for (;;)
         {
+            input_end = scan_to_quote_or_escape(input_end, content_end);
+            if ((input_end >= content_end) || (*input_end == '\"'))
+            {
+                break;
+            }
+
             /* is escape sequence */
-            if (input_end[0] == '\\')
+            if ((input_end + 1) >= content_end)
             {
-                if ((size_t)(input_end + 1 - input_buffer->content) >= input_buffer->length)
-                {
-                    /* prevent buffer overflow when last input character is a backslash */
-                    goto fail;
-                }
-                skipped_bytes++;
-                input_end++;
+                /* prevent buffer overflow when last input character is a backslash */
+                goto fail;
             }
-            input_end++;
+            skipped_bytes++;
+            input_end += 2;
         }
-        if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end != '\"'))
+        if ((input_end >= content_end) || (*input_end != '\"'))
         {
             goto fail; /* string ended unexpectedly */
         }
 
         /* This is at most how much we need for the output */
         allocation_length = (size_t) (input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
-        output = (unsigned char*)input_buffer->hooks.allocate(allocation_length + sizeof(""));
+        if (input_buffer->arena != NULL)
+        {
+            output = (unsigned char*)arena_allocate(input_buffer->arena, allocation_length + sizeof(""), false);
+        }
+        else
+        {
+            output = (unsigned char*)input_buffer->hooks.allocate(allocation_length + sizeof(""));
+        }
         if (output == NULL)
         {
             goto fail; /* allocation failure */
@@ -868,7 +1566,11 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
     {
         if (*input_pointer != '\\')
         {
-            *output_pointer++ = *input_pointer++;
+            /* copy the whole run up to the next escape sequence at once */
+            const unsigned char *run_end = scan_to_quote_or_escape(input_pointer, input_end);
+            memcpy(output_pointer, input_pointer, (size_t)(run_end - input_pointer));
+            output_pointer += run_end - input_pointer;
+            input_pointer = run_end;
         }
         /* escape sequence */
         else
@@ -922,7 +1624,7 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
     /* zero terminate the output */
     *output_pointer = '\0';
 
-    item->type = cJSON_String;
+    item->type = cJSON_String | input_buffer->item_flags;
     item->valuestring = (char*)output;
 
     input_buffer->offset = (size_t) (input_end - input_buffer->content);
@@ -931,7 +1633,7 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
     return true;
 
 fail:
-    if (output != NULL)
+    if ((output != NULL) && (input_buffer->arena == NULL))
     {
         input_buffer->hooks.deallocate(output);
         output = NULL;
@@ -1139,10 +1841,12 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return
 }
 
 /* Parse an object - create a new root, and populate. */
-CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
+static cJSON *parse_document(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated, cJSON_bool use_arena)
 {
-    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 }, 0, NULL, 0 };
     cJSON *item = NULL;
+    arena_block *first_block = NULL;
+    arena_document *document = NULL;
 
     /* reset error position */
     global_error.json = NULL;
@@ -1157,11 +1861,41 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer
     buffer.length = buffer_length;
     buffer.offset = 0;
     buffer.hooks = global_hooks;
+    buffer.decimal_point = get_decimal_point();
 
-    item = cJSON_New_Item(&global_hooks);
-    if (item == NULL) /* memory fail */
+    if (use_arena)
     {
-        goto fail;
+        /* parsed items and strings together take about twice the size of the text,
+         * so one block usually holds the whole document */
+        size_t block_size = buffer_length * 2;
+        if (block_size < buffer_length)
+        {
+            block_size = buffer_length;
+        }
+        block_size += sizeof(arena_document);
+        first_block = arena_new_block(&global_hooks, NULL, block_size);
+        if (first_block == NULL)
+        {
+            goto fail;
+        }
+        document = (arena_document*)(void*)arena_block_data(first_block);
+        first_block->used = sizeof(arena_document);
+        document->arena.current = first_block;
+        document->arena.hooks = global_hooks;
+        memset(&document->root, '\0', sizeof(cJSON));
+
+        buffer.arena = &document->arena;
+        /* keys point into the arena as well, so they must never be freed one by one */
+        buffer.item_flags = cJSON_InArena | cJSON_StringIsConst;
+        item = &document->root;
+    }
+    else
+    {
+        item = cJSON_New_Item(&global_hooks);
+        if (item == NULL) /* memory fail */
+        {
+            goto fail;
+        }
     }
 
     if (!parse_value(item, buffer_skip_whitespace(skip_utf8_bom(&buffer))))
@@ -1184,10 +1918,20 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer
         *return_parse_end = (const char*)buffer_at_offset(&buffer);
     }
 
+    if (document != NULL)
+    {
+        item->type |= cJSON_ArenaRoot;
+    }
+
     return item;
 
 fail:
-    if (item != NULL)
+    if (document != NULL)
+    {
+        /* nothing in the arena owns memory of its own yet */
+        arena_release(&document->arena);
+    }
+    else if (item != NULL)
     {
         cJSON_Delete(item);
     }
@@ -1218,6 +1962,11 @@ fail:
     return NULL;
 }
 
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
+{
+    return parse_document(value, buffer_length, return_parse_end, require_null_terminated, false);
+}
+
 /* Default options for cJSON_Parse */
 CJSON_PUBLIC(cJSON *) cJSON_Parse(const char *value)
 {
@@ -1229,19 +1978,102 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLength(const char *value, size_t buffer_len
     return cJSON_ParseWithLengthOpts(value, buffer_length, 0, 0);
 }
 
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthArena(const char *value, size_t buffer_length)
+{
+    return parse_document(value, buffer_length, NULL, false, true);
+}
+
 #define cjson_min(a, b) (((a) < (b)) ? (a) : (b))
 
+/* Estimate the printed length of an item so that print() can allocate its buffer once.
+ * Exact for everything except escape sequences in strings (not counted) and
+ * non-integer numbers (counted with their maximum length). */
+static size_t estimate_print_length(const cJSON * const item, const cJSON_bool format, const size_t depth)
+{
+    const cJSON *child = NULL;
+    size_t length = 0;
+
+    switch ((item->type) & 0xFF)
+    {
+        case cJSON_NULL:
+        case cJSON_True:
+            return 4;
+
+        case cJSON_False:
+            return 5;
+
+        case cJSON_Number:
+            if (item->valuedouble == (double)item->valueint)
+            {
+                unsigned int magnitude = (item->valueint < 0) ? (0U - (unsigned int)item->valueint) : (unsigned int)item->valueint;
+                return ((item->valueint < 0) ? 1 : 0) + decimal_length(magnitude);
+            }
+            return 25;
+
+        case cJSON_Raw:
+            return (item->valuestring != NULL) ? strlen(item->valuestring) : 0;
+
+        case cJSON_String:
+            return ((item->valuestring != NULL) ? strlen(item->valuestring) : 0) + sizeof("\"\"") - sizeof("");
+
+        case cJSON_Array:
+            length = 2; /* [] */
+            for (child = item->child; child != NULL; child = child->next)
+            {
+                length += estimate_print_length(child, format, depth + 1);
+                if (child->next != NULL)
+                {
+                    length += format ? 2 : 1; /* ", " */
+                }
+            }
+            return length;
+
+        case cJSON_Object:
+            length = format ? (3 + depth) : 2; /* {\n ... tabs} */
+            for (child = item->child; child != NULL; child = child->next)
+            {
+                /* "key": value */
+                length += ((child->string != NULL) ? strlen(child->string) : 0) + 2 + (format ? 2 : 1);
+                length += estimate_print_length(child, format, depth + 1);
+                if (child->next != NULL)
+                {
+                    length++; /* , */
+                }
+                if (format)
+                {
+                    length += depth + 2; /* indentation and \n */
+                }
+            }
+            return length;
+
+        default:
+            return 0;
+    }
+}
+
 static unsigned char *print(const cJSON * const item, cJSON_bool format, const internal_hooks * const hooks)
 {
     static const size_t default_buffer_size = 256;
+    /* headroom for ensure() reserving a little more than it ends up using */
+    static const size_t estimate_slack = 64;
+    size_t buffer_size = default_buffer_size;
     printbuffer buffer[1];
     unsigned char *printed = NULL;
 
     memset(buffer, 0, sizeof(buffer));
 
-    /* create buffer */
-    buffer->buffer = (unsigned char*) hooks->allocate(default_buffer_size);
-    buffer->length = default_buffer_size;
+    if (item != NULL)
+    {
+        buffer_size = estimate_print_length(item, format, 0) + estimate_slack;
+        if (buffer_size < default_buffer_size)
+        {
+            buffer_size = default_buffer_size;
+        }
+    }
+
+    /* create buffer, large enough for the whole output unless strings need escaping */
+    buffer->buffer = (unsigned char*) hooks->allocate(buffer_size);
+    buffer->length = buffer_size;
     buffer->format = format;
     buffer->hooks = *hooks;
     if (buffer->buffer == NULL)
@@ -1371,21 +2203,21 @@ static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buf
     /* null */
     if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "null", 4) == 0))
     {
-        item->type = cJSON_NULL;
+        item->type = cJSON_NULL | input_buffer->item_flags;
         input_buffer->offset += 4;
         return true;
     }
     /* false */
     if (can_read(input_buffer, 5) && (strncmp((const char*)buffer_at_offset(input_buffer), "false", 5) == 0))
     {
-        item->type = cJSON_False;
+        item->type = cJSON_False | input_buffer->item_flags;
         input_buffer->offset += 5;
         return true;
     }
     /* true */
     if (can_read(input_buffer, 4) && (strncmp((const char*)buffer_at_offset(input_buffer), "true", 4) == 0))
     {
-        item->type = cJSON_True;
+        item->type = cJSON_True | input_buffer->item_flags;
         item->valueint = 1;
         input_buffer->offset += 4;
         return true;
@@ -1527,7 +2359,7 @@ static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buf
     do
     {
         /* allocate next item */
-        cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
+        cJSON *new_item = parse_new_item(input_buffer);
         if (new_item == NULL)
         {
             goto fail; /* allocation failure */
@@ -1570,7 +2402,7 @@ success:
         head->prev = current_item;
     }
 
-    item->type = cJSON_Array;
+    item->type = cJSON_Array | input_buffer->item_flags;
     item->child = head;
 
     input_buffer->offset++;
@@ -1685,7 +2517,7 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
     do
     {
         /* allocate next item */
-        cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
+        cJSON *new_item = parse_new_item(input_buffer);
         if (new_item == NULL)
         {
             goto fail; /* allocation failure */
@@ -1751,7 +2583,7 @@ success:
         head->prev = current_item;
     }
 
-    item->type = cJSON_Object;
+    item->type = cJSON_Object | input_buffer->item_flags;
     item->child = head;
 
     input_buffer->offset++;
@@ -1975,6 +2807,291 @@ CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const objec
     return get_object_item(object, string, true);
 }
 
+struct cJSON_MemberCache
+{
+    const char * const *names;
+    unsigned long *name_hashes;
+    size_t *name_positions; /* where each name was found in the current object */
+    int count;
+    /* expected_names[position] = index of the name found at that position in the previous object, or -1 */
+    int *expected_names;
+    size_t expected_length;
+    /* open addressing table of an object's members, only used when the key order changes */
+    cJSON **slots;
+    unsigned long *slot_hashes;
+    size_t *slot_positions;
+    size_t slot_count;
+};
+
+#define MEMBER_POSITION_UNKNOWN ((size_t)-1)
+
+/* FNV-1a */
+static unsigned long hash_member_name(const char *name)
+{
+    unsigned long hash = 2166136261UL;
+    const unsigned char *pointer = (const unsigned char*)name;
+
+    for (; *pointer != '\0'; pointer++)
+    {
+        hash ^= *pointer;
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+
+    return hash;
+}
+
+CJSON_PUBLIC(cJSON_MemberCache *) cJSON_CreateMemberCache(const char * const *names, int count)
+{
+    cJSON_MemberCache *cache = NULL;
+    int i = 0;
+
+    if ((names == NULL) || (count <= 0))
+    {
+        return NULL;
+    }
+
+    cache = (cJSON_MemberCache*)global_hooks.allocate(sizeof(cJSON_MemberCache));
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(cJSON_MemberCache));
+    cache->names = names;
+    cache->count = count;
+
+    cache->name_hashes = (unsigned long*)global_hooks.allocate((size_t)count * sizeof(unsigned long));
+    cache->name_positions = (size_t*)global_hooks.allocate((size_t)count * sizeof(size_t));
+    if ((cache->name_hashes == NULL) || (cache->name_positions == NULL))
+    {
+        cJSON_DeleteMemberCache(cache);
+        return NULL;
+    }
+    for (i = 0; i < count; i++)
+    {
+        cache->name_hashes[i] = hash_member_name(names[i]);
+    }
+
+    return cache;
+}
+
+static void free_member_slots(cJSON_MemberCache * const cache)
+{
+    if (cache->slots != NULL)
+    {
+        global_hooks.deallocate(cache->slots);
+        cache->slots = NULL;
+    }
+    if (cache->slot_hashes != NULL)
+    {
+        global_hooks.deallocate(cache->slot_hashes);
+        cache->slot_hashes = NULL;
+    }
+    if (cache->slot_positions != NULL)
+    {
+        global_hooks.deallocate(cache->slot_positions);
+        cache->slot_positions = NULL;
+    }
+    cache->slot_count = 0;
+}
+
+CJSON_PUBLIC(void) cJSON_DeleteMemberCache(cJSON_MemberCache *cache)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    if (cache->name_hashes != NULL)
+    {
+        global_hooks.deallocate(cache->name_hashes);
+    }
+    if (cache->name_positions != NULL)
+    {
+        global_hooks.deallocate(cache->name_positions);
+    }
+    if (cache->expected_names != NULL)
+    {
+        global_hooks.deallocate(cache->expected_names);
+    }
+    free_member_slots(cache);
+    global_hooks.deallocate(cache);
+}
+
+/* slow path: hash all members of the object, then look up the names that are still missing */
+static cJSON_bool resolve_members_by_hash(cJSON_MemberCache * const cache, const cJSON * const object, size_t member_count, cJSON **items)
+{
+    size_t slot_count = 16;
+    size_t mask = 0;
+    size_t position = 0;
+    cJSON *member = NULL;
+    int i = 0;
+
+    while (slot_count < (member_count * 2))
+    {
+        slot_count *= 2;
+    }
+    if (slot_count > cache->slot_count)
+    {
+        free_member_slots(cache);
+        cache->slots = (cJSON**)global_hooks.allocate(slot_count * sizeof(cJSON*));
+        cache->slot_hashes = (unsigned long*)global_hooks.allocate(slot_count * sizeof(unsigned long));
+        cache->slot_positions = (size_t*)global_hooks.allocate(slot_count * sizeof(size_t));
+        if ((cache->slots == NULL) || (cache->slot_hashes == NULL) || (cache->slot_positions == NULL))
+        {
+            free_member_slots(cache);
+            return false;
+        }
+        cache->slot_count = slot_count;
+    }
+    mask = cache->slot_count - 1;
+    memset(cache->slots, 0, cache->slot_count * sizeof(cJSON*));
+
+    for (member = object->child; member != NULL; member = member->next, position++)
+    {
+        unsigned long hash = 0;
+        size_t slot = 0;
+
+        if (member->string == NULL)
+        {
+            continue;
+        }
+        hash = hash_member_name(member->string);
+        slot = (size_t)hash & mask;
+        while (cache->slots[slot] != NULL)
+        {
+            if ((cache->slot_hashes[slot] == hash) && (strcmp(cache->slots[slot]->string, member->string) == 0))
+            {
+                break; /* keep the first of duplicate keys */
+            }
+            slot = (slot + 1) & mask;
+        }
+        if (cache->slots[slot] == NULL)
+        {
+            cache->slots[slot] = member;
+            cache->slot_hashes[slot] = hash;
+            cache->slot_positions[slot] = position;
+        }
+    }
+
+    for (i = 0; i < cache->count; i++)
+    {
+        size_t slot = (size_t)cache->name_hashes[i] & mask;
+
+        if (items[i] != NULL)
+        {
+            continue;
+        }
+        while (cache->slots[slot] != NULL)
+        {
+            if ((cache->slot_hashes[slot] == cache->name_hashes[i]) && (strcmp(cache->slots[slot]->string, cache->names[i]) == 0))
+            {
+                items[i] = cache->slots[slot];
+                cache->name_positions[i] = cache->slot_positions[slot];
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    return true;
+}
+
+CJSON_PUBLIC(int) cJSON_GetMembersCaseSensitive(cJSON_MemberCache *cache, const cJSON * const object, cJSON **items)
+{
+    cJSON *member = NULL;
+    size_t position = 0;
+    int found = 0;
+    int i = 0;
+    cJSON_bool layout_changed = false;
+
+    if ((cache == NULL) || (items == NULL))
+    {
+        return 0;
+    }
+    for (i = 0; i < cache->count; i++)
+    {
+        items[i] = NULL;
+    }
+    if (!cJSON_IsObject(object))
+    {
+        return 0;
+    }
+
+    /* fast path: expect every name at the position it had in the previous object */
+    for (member = object->child; member != NULL; member = member->next, position++)
+    {
+        int expected = (position < cache->expected_length) ? cache->expected_names[position] : -1;
+
+        if (expected < 0)
+        {
+            continue;
+        }
+        if ((items[expected] == NULL) && (member->string != NULL) && (strcmp(member->string, cache->names[expected]) == 0))
+        {
+            items[expected] = member;
+            cache->name_positions[expected] = position;
+            found++;
+        }
+        else
+        {
+            layout_changed = true;
+        }
+    }
+
+    if ((found == cache->count) && !layout_changed)
+    {
+        return found;
+    }
+
+    /* the key order differs from the previous object: hash this one and remember its layout */
+    if (!resolve_members_by_hash(cache, object, position, items))
+    {
+        /* out of memory, fall back to linear searches */
+        for (i = 0; i < cache->count; i++)
+        {
+            if (items[i] == NULL)
+            {
+                items[i] = get_object_item(object, cache->names[i], true);
+                cache->name_positions[i] = MEMBER_POSITION_UNKNOWN;
+            }
+        }
+    }
+
+    if (position > cache->expected_length)
+    {
+        int *expected_names = (int*)global_hooks.allocate(position * sizeof(int));
+        if (expected_names != NULL)
+        {
+            if (cache->expected_names != NULL)
+            {
+                global_hooks.deallocate(cache->expected_names);
+            }
+            cache->expected_names = expected_names;
+            cache->expected_length = position;
+        }
+    }
+    for (position = 0; position < cache->expected_length; position++)
+    {
+        cache->expected_names[position] = -1;
+    }
+
+    found = 0;
+    for (i = 0; i < cache->count; i++)
+    {
+        if (items[i] == NULL)
+        {
+            continue;
+        }
+        found++;
+        if (cache->name_positions[i] < cache->expected_length)
+        {
+            cache->expected_names[cache->name_positions[i]] = i;
+        }
+    }
+
+    return found;
+}
+
 CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string)
 {
     return cJSON_GetObjectItem(object, string) ? 1 : 0;
@@ -1987,6 +3104,10 @@ static void suffix_object(cJSON *prev, cJSON *item)
     item->prev = prev;
 }
 
+/* Items of an arena document are never freed one by one, so a heap allocated
+ * item attached to one of them would leak when the document is deleted. */
+#define arena_rejects_item(parent, item) ((((parent)->type & cJSON_InArena) != 0) && (((item)->type & cJSON_InArena) == 0))
+
 /* Utility for handling references. */
 static cJSON *create_reference(const cJSON *item, const internal_hooks * const hooks)
 {
@@ -2004,6 +3125,7 @@ static cJSON *create_reference(const cJSON *item, const internal_hooks * const h
 
     memcpy(reference, item, sizeof(cJSON));
     reference->string = NULL;
+    reference->type &= ~(cJSON_InArena | cJSON_ArenaRoot);
     reference->type |= cJSON_IsReference;
     reference->next = reference->prev = NULL;
     return reference;
@@ -2013,7 +3135,7 @@ static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
 {
     cJSON *child = NULL;
 
-    if ((item == NULL) || (array == NULL) || (array == item))
+    if ((item == NULL) || (array == NULL) || (array == item) || arena_rejects_item(array, item))
     {
         return false;
     }
@@ -2069,7 +3191,7 @@ static cJSON_bool add_item_to_object(cJSON * const object, const char * const st
     char *new_key = NULL;
     int new_type = cJSON_Invalid;
 
-    if ((object == NULL) || (string == NULL) || (item == NULL) || (object == item))
+    if ((object == NULL) || (string == NULL) || (item == NULL) || (object == item) || arena_rejects_item(object, item))
     {
         return false;
     }
@@ -2331,6 +3453,11 @@ CJSON_PUBLIC(cJSON_bool) cJSON_InsertItemInArray(cJSON *array, int which, cJSON
         return add_item_to_array(array, newitem);
     }
 
+    if (arena_rejects_item(array, newitem))
+    {
+        return false;
+    }
+
     if (after_inserted != array->child && after_inserted->prev == NULL) {
         /* return false if after_inserted is a corrupted array item */
         return false;
@@ -2352,7 +3479,7 @@ CJSON_PUBLIC(cJSON_bool) cJSON_InsertItemInArray(cJSON *array, int which, cJSON
 
 CJSON_PUBLIC(cJSON_bool) cJSON_ReplaceItemViaPointer(cJSON * const parent, cJSON * const item, cJSON * replacement)
 {
-    if ((parent == NULL) || (parent->child == NULL) || (replacement == NULL) || (item == NULL))
+    if ((parent == NULL) || (parent->child == NULL) || (replacement == NULL) || (item == NULL) || arena_rejects_item(parent, replacement))
     {
         return false;
     }
@@ -2790,7 +3917,7 @@ cJSON * cJSON_Duplicate_rec(const cJSON *item, size_t depth, cJSON_bool recurse)
         goto fail;
     }
     /* Copy over all vars */
-    newitem->type = item->type & (~cJSON_IsReference);
+    newitem->type = item->type & ~(cJSON_IsReference | cJSON_InArena | cJSON_ArenaRoot);
     newitem->valueint = item->valueint;
     newitem->valuedouble = item->valuedouble;
     if (item->valuestring)
@@ -2803,7 +3930,16 @@ cJSON * cJSON_Duplicate_rec(const cJSON *item, size_t depth, cJSON_bool recurse)
     }
     if (item->string)
     {
-        newitem->string = (item->type&cJSON_StringIsConst) ? item->string : (char*)cJSON_strdup((unsigned char*)item->string, &global_hooks);
+        if ((item->type & cJSON_StringIsConst) && !(item->type & cJSON_InArena))
+        {
+            newitem->string = item->string;
+        }
+        else
+        {
+            /* keys of arena items only live as long as their document */
+            newitem->string = (char*)cJSON_strdup((unsigned char*)item->string, &global_hooks);
+            newitem->type &= ~cJSON_StringIsConst;
+        }
         if (!newitem->string)
         {
             goto fail;
@@ -157,6 +157,10 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLength(const char *value, size_t buffer_len
 /* If you supply a ptr in return_parse_end and parsing fails, then return_parse_end will contain a pointer to the error so will match cJSON_GetErrorPtr(). */
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated);
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated);
+/* ParseWithLengthArena builds the whole tree inside a few large blocks instead of one allocation per item and string.
+ * The document is released all at once by calling cJSON_Delete on the returned root; deleting any other item of it is a no-op
+ * and no item of it may be used after the root is gone. Items that were not parsed into the same document cannot be added to it. */
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthArena(const char *value, size_t buffer_length);
 
 /* Render a cJSON entity to text for transfer/storage. */
 CJSON_PUBLIC(char *) cJSON_Print(const cJSON *item);
@@ -178,6 +182,17 @@ CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index);
 CJSON_PUBLIC(cJSON *) cJSON_GetObjectItem(const cJSON * const object, const char * const string);
 CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const object, const char * const string);
 CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string);
+/* Look up a fixed list of member names in many objects of the same shape (e.g. the records of a table).
+ * The cache remembers where each name was found in the previous object, so objects with the same
+ * key order cost one strcmp per member; otherwise it falls back to hashing the object's members.
+ * Either way a lookup is linear in the size of the object. Case sensitive.
+ * names are not copied and must stay valid while the cache is in use. */
+typedef struct cJSON_MemberCache cJSON_MemberCache;
+CJSON_PUBLIC(cJSON_MemberCache *) cJSON_CreateMemberCache(const char * const *names, int count);
+/* Fills items[0..count-1] with the members of object named names[0..count-1] (NULL if absent) and returns how many were found.
+ * If object has duplicate keys, which one is returned is unspecified. */
+CJSON_PUBLIC(int) cJSON_GetMembersCaseSensitive(cJSON_MemberCache *cache, const cJSON * const object, cJSON **items);
+CJSON_PUBLIC(void) cJSON_DeleteMemberCache(cJSON_MemberCache *cache);
 /* For analysing failed parses. This returns a pointer to the parse error. You'll probably need to look a few chars back to make sense of it. Defined when cJSON_Parse() returns 0. 0 when cJSON_Parse() succeeds. */
 CJSON_PUBLIC(const char *) cJSON_GetErrorPtr(void);
 
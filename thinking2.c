@@ -2,7 +2,7 @@
  * 数据库内核课设 - 重构版
  * 核心数据结构：链表（主存储） + AVL树（索引）
  * 功能：新建表、增删改查、保存/加载JSON
- * 检索：支持最大最小值、包含字符串、比较运算（AVL树 + 线性遍历对比）
+ * 检索：支持最大最小值、包含字符串、比较运算（AVL树 / 自适应裂解 + 线性遍历对比）
  */
 
 #include <stdio.h>
@@ -11,6 +11,7 @@
 #include <windows.h> 
 #include "cJSON.h" 
 #include <time.h>
+#include <limits.h>
 
 /*==================== 高精度计时器 ====================*/
 
@@ -58,19 +59,25 @@ typedef struct {
  * 描述：表中单个单元格的数据存储，使用联合体节省空间
  * 
  * 成员：
- *   - type: 数据类型 (与Column的type对应)
- *   - data: 联合体，根据type只使用其中一个字段
+ *   - data: 联合体，根据所在列的type只使用其中一个字段
  *       - int_val: 整数值
- *       - str_val: 字符串指针（动态分配）
+ *       - inline_str: 短字符串（不超过CELL_INLINE_MAX字节）直接存在单元格里
+ *       - str_val: 长字符串指针（动态分配），此时最后一个字节为CELL_HEAP_TAG
  * 
- * 设计思路：使用union联合体，同一内存空间存储不同类型，同时在输入是作为验证
- * 内存效率：比两个独立字段节省空间（只占用较大字段的大小）
+ * 设计思路：使用union联合体，同一内存空间存储不同类型
+ * 内存效率：类型只记在Column里，单元格不重复保存类型标记；
+ *   姓名、专业这类短字符串不再单独分配内存，读取时也不用再跟一次指针
+ * 
+ * 字符串一律通过 cellStr / cellSetStr / cellFreeStr 访问
  */
+#define CELL_INLINE_MAX 15        // 内联字符串最大字节数（不含'\0'）
+#define CELL_HEAP_TAG ((char)0xFF) // inline_str最后一个字节为此值表示字符串在堆上
+
 typedef struct {
-    int type;          // 标识当前单元格存储的数据类型
     union {            // 联合体：整数和字符串共享同一内存空间
-        int int_val;   // 如果type=1，使用此字段
-        char* str_val; // 如果type=2，使用此字段（需动态分配）
+        int int_val;   // 如果列type=1，使用此字段
+        char* str_val; // 如果列type=2且字符串较长，使用此字段（需动态分配）
+        char inline_str[CELL_INLINE_MAX + 1]; // 如果列type=2且字符串较短，直接存放
     } data;
 } Cell;
 
@@ -78,8 +85,8 @@ typedef struct {
  * 描述：单链表节点，存储一行数据
  * 
  * 成员：
- *   - cells: 指向单元格数组的指针（数组大小 = 列数）
  *   - next: 指向下一个记录节点的指针
+ *   - cells: 单元格数组（数组大小 = 列数），与节点在同一块内存里，每行只需一次分配
  * 
  * 数据结构：单链表
  * 时间复杂度：
@@ -88,8 +95,8 @@ typedef struct {
  *   - 删除中间节点：O(n)
  */
 typedef struct RecordNode {
-    Cell* cells;               // 指向Cell数组，存储该行所有列的数据
     struct RecordNode* next;   // 指向下一行记录的指针（链表）
+    Cell cells[];              // 柔性数组，存储该行所有列的数据
 } RecordNode;
 
 /*4. Table - 表结构体
@@ -98,24 +105,59 @@ typedef struct RecordNode {
  * 成员：
  *   - numColumns: 列数
  *   - columns: 列定义数组指针
+ *   - columnSlots/columnSlotCount: 列名哈希表（开放寻址，存列下标+1，0表示空槽）
  *   - head: 链表头指针（指向第一条记录）
  *   - tail: 链表尾指针（指向最后一条记录，用于O(1)尾插入）
  *   - rowCount: 当前记录总数
+ *   - version: 修改计数，每次增删改加1，依赖行号的缓存结构（如裂解列）据此判断是否失效
+ *   - crackers: 每个整数列的裂解列（按需创建，见"自适应索引"一节）
+ *   - blooms: 每个字符串列的计数布隆过滤器（随增删改维护，见"布隆过滤器"一节）
+ *   - indexes: 各列的持久化有序索引（按需建立，保存表时写入索引文件，见"持久化索引"一节）
+ *   - checksum/checksumVersion: 表内容对应JSON文本的校验和，以及算校验和时的version
+ *   - builds: 各列的后台建索引任务（加载后启动，见"后台建索引"一节）
+ *   - primaryKey/pk: 主键列（-1表示没有）及其唯一哈希索引（见"主键索引"一节）
+ *   - rowTree: 行号 -> 记录 的计数AVL树（第一次按行号访问时建立，见"行号索引"一节）
+ *   - clusterColumn/clusteredRows/autoCluster: 聚簇列、按该列有序的前缀行数、是否自动增量聚簇（见"聚簇表"一节）
+ *   - kd: 最近一次多列查询用的k-d树（按需建立，表被修改后重建，见"多维索引"一节）
+ *   - store: 列存副本，压缩的只读主存 + 记录改动的增量区（开启后随增删改维护，见"列存主表"一节）
+ *   - lsm: 按主键持久化的LSM存储，增删改同步写入其WAL和内存表（见"LSM存储引擎"一节）
  * 
  * 核心数据结构：单链表（带尾指针优化）
  * 设计优势：
  *   - 动态增长，不需要预分配空间
  *   - 尾指针使插入操作达到O(1)
  * 设计权衡：
- *   - 不支持随机访问（必须从头遍历）
- *   - 删除中间元素需要O(n)时间
+ *   - 链表本身不支持随机访问，按行号定位、删除中间元素需要O(n)时间
+ *     （由行号树补上：按行号取、插入、删除都是O(log n)）
  */
 typedef struct {
     int numColumns;      // 表的列数
     Column* columns;     // 列定义数组（大小为numColumns）
+    int* columnSlots;    // 列名 -> 列下标 的哈希表，按名字找列为O(1)，与列数无关
+    int columnSlotCount; // 哈希槽数（2的幂，至少为列数的2倍）
     RecordNode* head;    // 链表头指针，指向第一条记录（NULL表示空表）
     RecordNode* tail;    // 链表尾指针，指向最后一条记录（用于快速尾插）
     int rowCount;        // 当前表中的记录总数
+    unsigned int version;             // 修改计数（增删改时递增）
+    struct CrackerColumn** crackers;  // 各列的裂解列（未查询过的列为NULL）
+    struct StringBloom** blooms;      // 各字符串列的布隆过滤器（整数列为NULL）
+    struct ColumnIndex** indexes;     // 各列的有序索引（未建立的为NULL）
+    unsigned long long checksum;      // 最近一次保存/加载的JSON文本校验和
+    unsigned int checksumVersion;     // 该校验和对应的version（version变了校验和就不代表当前内容）
+    struct IndexBuild** builds;       // 各列的后台建索引任务（没有的为NULL）
+    int primaryKey;                   // 主键列下标，-1表示没有主键
+    struct PrimaryKeyIndex* pk;       // 主键值 -> 记录节点 的哈希索引
+    struct RowTreeNode* rowTree;      // 按行号定位记录的计数平衡树（未建立为NULL）
+    int clusterColumn;                // 聚簇列下标，-1表示没有
+    int clusteredRows;                // 前多少行按聚簇列有序（之后的行尚未归位）
+    int autoCluster;                  // 1 = 在请求之间把新行增量合并进有序前缀
+    struct KdIndex* kd;               // 多个整数列上的k-d树（未建立为NULL）
+    struct ColumnStore* store;        // 列存主存 + 增量区（未开启为NULL）
+    struct LsmStore* lsm;             // LSM持久化存储（未挂上为NULL）
+    struct SharedSegment* shared;     // 发布到共享内存的段（未发布为NULL）
+    struct MapFile* map;              // 映射表文件（未开启为NULL）
+    struct ConcurrentHash* chash;     // 多线程可并发访问的哈希索引（未建立为NULL）
+    struct SkipList* skip;            // 多线程可并发访问的有序索引（未建立为NULL）
 } Table;
 
 /*5. AVLNode - AVL平衡二叉搜索树节点
@@ -125,6 +167,7 @@ typedef struct {
  *   - intKey/strKey: 索引键（根据keyType选择使用）
  *   - keyType: 键的类型 (1=整数, 2=字符串)
  *   - record: 指向对应的RecordNode（不拥有所有权）
+ *   - rowNum: 建索引时该记录的行号（索引每次查询前重建，行号有效）
  *   - left/right: 左右子树指针
  *   - height: 当前节点的高度（用于平衡计算）
  * 
@@ -146,6 +189,7 @@ typedef struct AVLNode {
     int keyType;             // 1=使用intKey, 2=使用strKey
     //只存指针，不拷贝数据
     RecordNode* record;      // 指向实际数据记录（不拥有所有权）
+    int rowNum;              // 记录的行号（从1开始）
     struct AVLNode* left;    // 左子树指针（键值 < 当前节点）
     struct AVLNode* right;   // 右子树指针（键值 > 当前节点）
     int height;              // 节点高度（用于计算平衡因子）
@@ -155,31 +199,785 @@ typedef struct AVLNode {
  * 描述：动态数组，存储查询结果（支持多条记录）
  * 
  * 成员：
- *   - records: 指向RecordNode指针数组
- *   - rowNums: 对应的行号数组（从1开始编号）
+ *   - rowNums: 命中记录的行号数组（从1开始编号），每条结果只占32位
  *   - count: 当前结果数量
  *   - capacity: 数组容量（自动扩容）
  * 
  * 数据结构：动态数组
+ * 初始容量：按查询的选择率预估（见createSearchResult）
  * 扩容策略：容量不足时 capacity *= 2
- * 初始容量：16
  * 
  * 内存管理：
- *   - records数组需要释放
- *   - rowNums数组需要释放
- *   - 但records指向的RecordNode由Table管理，不应释放
+ *   - 用完交给 freeSearchResult，结构体和数组会放回线程内的结果池，
+ *     下一次查询直接复用，交互查询时不再反复 malloc/realloc
+ *   - 需要记录内容时用 resolveResultRows 按行号一次遍历取出RecordNode
  */
 typedef struct {
-    RecordNode** records;  // 记录指针数组（动态分配）
-    int* rowNums;          // 行号数组（与records一一对应）
+    unsigned int* rowNums; // 行号数组（动态分配）
     int count;             // 当前存储的结果数量
     int capacity;          // 数组容量（大于等于count）
 } SearchResult;
 
 /*==================== 前向声明 ====================*/
-static void deepCopyCells(Cell* dest, Cell* src, int numColumns);
-static void freeCells(Cell* cells, int numColumns);
+static void deepCopyCells(Cell* dest, Cell* src, const Column* columns, int numColumns);
+static void freeCells(Cell* cells, const Column* columns, int numColumns);
 RecordNode* addRecord(Table* table, Cell* cells);
+static void freeCrackers(Table* table);
+static void freeColumnIndexes(Table* table);
+static void freeKdIndex(Table* table);
+static void waitIndexBuilds(Table* table);
+static void freeIndexBuilds(Table* table);
+static void startIndexBuilds(Table* table, const unsigned char* registered);
+static int replaceRecordCells(Table* table, RecordNode* node, Cell* newCells);
+static unsigned long long checksumText(const char* text, size_t length);
+static void saveIndexFile(Table* table, const char* tableFilename);
+static int loadIndexFile(Table* table, const char* tableFilename, unsigned char* registered);
+static void clusterNoteAppend(Table* table, RecordNode* prevTail);
+static void clusterNoteInsert(Table* table, int rowNum);
+static int clusterRowOf(Table* table, RecordNode* node);
+static void clusterReposition(Table* table, int rowNum);
+static void storeNoteAppend(Table* table, RecordNode* node);
+static void storeNoteUpdate(Table* table, RecordNode* node);
+static void storeNoteDelete(Table* table, RecordNode* node);
+static void storeInvalidate(Table* table);
+static void freeColumnStore(Table* table);
+static void lsmNotePut(Table* table, RecordNode* node);
+static void lsmNoteDelete(Table* table, RecordNode* node);
+static void lsmCheckKeyColumn(Table* table, int colIndex);
+static void closeLsm(Table* table);
+static void stopSharing(Table* table);
+static void mapNoteLink(Table* table, RecordNode* prev, RecordNode* node);
+static void mapNoteUnlink(Table* table, RecordNode* prev, RecordNode* node);
+static void mapNoteUpdate(Table* table, RecordNode* node);
+static void mapRelink(Table* table, RecordNode* from);
+static void mapInvalidate(Table* table);
+static void chashNoteInsert(Table* table, RecordNode* node);
+static void chashNoteRemove(Table* table, RecordNode* node);
+static void dropConcurrentHash(Table* table);
+static void rebuildConcurrentHash(Table* table);
+static void skipNoteInsert(Table* table, RecordNode* node);
+static void skipNoteRemove(Table* table, RecordNode* node);
+static void dropSkipList(Table* table);
+static void rebuildSkipList(Table* table);
+static void closeMappedFile(Table* table);
+
+/*==================== 单元格字符串 ====================*/
+
+// 读取字符串单元格：短字符串直接返回单元格内的地址，不需要解引用
+static const char* cellStr(const Cell* cell) {
+    if (cell->data.inline_str[CELL_INLINE_MAX] != CELL_HEAP_TAG) return cell->data.inline_str;
+    return cell->data.str_val ? cell->data.str_val : "";
+}
+
+// 写入字符串单元格（不释放旧值）：短字符串内联，长字符串 _strdup 到堆上
+static void cellSetStr(Cell* cell, const char* s) {
+    if (!s) s = "";
+    size_t len = strlen(s);
+    if (len <= CELL_INLINE_MAX) {
+        memset(cell->data.inline_str, 0, sizeof(cell->data.inline_str));//末字节为0即内联标记
+        memcpy(cell->data.inline_str, s, len);
+    } else {
+        cell->data.str_val = _strdup(s);
+        cell->data.inline_str[CELL_INLINE_MAX] = CELL_HEAP_TAG;
+    }
+}
+
+// 释放字符串单元格的堆内存，之后单元格为空字符串
+static void cellFreeStr(Cell* cell) {
+    if (cell->data.inline_str[CELL_INLINE_MAX] == CELL_HEAP_TAG) {
+        free(cell->data.str_val);
+    }
+    memset(cell->data.inline_str, 0, sizeof(cell->data.inline_str));
+}
+
+/*==================== 布隆过滤器（字符串列等值查询） ====================*/
+/* 计数型分块布隆过滤器（Counting Blocked Bloom Filter）
+ * 
+ * 用途：字符串等值查询前先问过滤器，"一定不存在"时直接返回，不必扫描整张表
+ * 
+ * 结构：
+ *   - 若干个64字节的块（正好一条缓存行），每块64个8位计数器
+ *   - 一个字符串只落在一个块里，在块内置BLOOM_PROBES个计数器，一次查询只碰一条缓存行
+ *   - 用计数器代替位，删除/修改时可以减回去；计数器到255后不再变化，保证不会误判为不存在
+ * 
+ * 误判率：每个字符串约BLOOM_COUNTERS_PER_ITEM个计数器，约1%；字符串数超过容量时按2倍重建
+ * 
+ * 接口按"哈希值"分开（bloomHash / bloomMayContainHash），
+ * 以后按块组织存储时，每块自带一个过滤器，同一个哈希值可以逐块判断、跳过整块
+ */
+
+#define BLOOM_BLOCK_SIZE 64          // 每块计数器数（= 64字节缓存行）
+#define BLOOM_PROBES 6               // 每个字符串在块内置的计数器数
+#define BLOOM_COUNTERS_PER_ITEM 12   // 每个字符串平均占的计数器数
+#define BLOOM_MIN_CAPACITY 1024      // 初始容量（字符串数）
+
+typedef struct StringBloom {
+    unsigned char* counters; // numBlocks * BLOOM_BLOCK_SIZE 个计数器
+    unsigned int numBlocks;  // 块数（2的幂）
+    int capacity;            // 按此字符串数分配的空间
+    int items;               // 当前字符串数
+} StringBloom;
+
+// 64位字符串哈希（FNV-1a + 末尾混合，使高位也足够随机）
+unsigned long long bloomHash(const char* s) {
+    unsigned long long h = 14695981039346656037ULL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// 低32位选块；高32位里每隔5位取6位选块内一个计数器（6次要36位，相邻两次重叠1位）
+static unsigned char* bloomBlock(const StringBloom* bf, unsigned long long h) {
+    return bf->counters + (size_t)((unsigned int)h & (bf->numBlocks - 1)) * BLOOM_BLOCK_SIZE;
+}
+#define BLOOM_PROBE(h, i) ((unsigned int)((h) >> (32 + 5 * (i))) & (BLOOM_BLOCK_SIZE - 1))
+
+static StringBloom* createBloom(int capacity) {
+    StringBloom* bf = (StringBloom*)malloc(sizeof(StringBloom));
+    if (capacity < BLOOM_MIN_CAPACITY) capacity = BLOOM_MIN_CAPACITY;
+    bf->numBlocks = 1;
+    while ((long long)bf->numBlocks * BLOOM_BLOCK_SIZE < (long long)capacity * BLOOM_COUNTERS_PER_ITEM) bf->numBlocks *= 2;
+    bf->counters = (unsigned char*)calloc((size_t)bf->numBlocks * BLOOM_BLOCK_SIZE, 1);
+    bf->capacity = capacity;
+    bf->items = 0;
+    return bf;
+}
+
+static void freeBloom(StringBloom* bf) {
+    if (!bf) return;
+    free(bf->counters);
+    free(bf);
+}
+
+static void bloomAddHash(StringBloom* bf, unsigned long long h) {
+    unsigned char* block = bloomBlock(bf, h);
+    for (int i = 0; i < BLOOM_PROBES; i++) {
+        unsigned char* c = &block[BLOOM_PROBE(h, i)];
+        if (*c < 255) (*c)++;
+    }
+    bf->items++;
+}
+
+static void bloomAdd(StringBloom* bf, const char* s) {
+    bloomAddHash(bf, bloomHash(s));
+}
+
+static void bloomRemove(StringBloom* bf, const char* s) {
+    unsigned long long h = bloomHash(s);
+    unsigned char* block = bloomBlock(bf, h);
+    for (int i = 0; i < BLOOM_PROBES; i++) {
+        unsigned char* c = &block[BLOOM_PROBE(h, i)];
+        if (*c > 0 && *c < 255) (*c)--;//饱和的计数器不再减，宁可多报也不能漏报
+    }
+    bf->items--;
+}
+
+// 返回0表示一定不存在，1表示可能存在
+int bloomMayContainHash(const StringBloom* bf, unsigned long long h) {
+    const unsigned char* block = bloomBlock(bf, h);
+    for (int i = 0; i < BLOOM_PROBES; i++) {
+        if (block[BLOOM_PROBE(h, i)] == 0) return 0;
+    }
+    return 1;
+}
+
+// 按当前表内容重建某列的过滤器（容量不够时调用）
+static void rebuildBloom(Table* table, int colIndex, int capacity) {
+    freeBloom(table->blooms[colIndex]);
+    StringBloom* bf = createBloom(capacity);
+    for (RecordNode* cur = table->head; cur; cur = cur->next) {
+        bloomAdd(bf, cellStr(&cur->cells[colIndex]));
+    }
+    table->blooms[colIndex] = bf;
+}
+
+// 新行加入表后调用：把各字符串列的值加入过滤器
+static void bloomAddRow(Table* table, RecordNode* node) {
+    for (int i = 0; i < table->numColumns; i++) {
+        StringBloom* bf = table->blooms[i];
+        if (!bf) continue;
+        if (bf->items >= bf->capacity) {
+            rebuildBloom(table, i, bf->capacity * 2);//已包含新行
+            continue;
+        }
+        bloomAdd(bf, cellStr(&node->cells[i]));
+    }
+}
+
+// 行被删除或覆盖前调用：把旧值从过滤器中减掉
+static void bloomRemoveRow(Table* table, RecordNode* node) {
+    for (int i = 0; i < table->numColumns; i++) {
+        if (table->blooms[i]) bloomRemove(table->blooms[i], cellStr(&node->cells[i]));
+    }
+}
+
+// 预计要装入rows行时提前把过滤器扩到位，避免逐步加行时反复重建（如从JSON加载）
+void bloomReserve(Table* table, int rows) {
+    for (int i = 0; i < table->numColumns; i++) {
+        if (table->blooms[i] && table->blooms[i]->capacity < rows) rebuildBloom(table, i, rows);
+    }
+}
+
+/* bloomMayContain - 字符串列中是否可能有值为value的记录
+ * 返回值：0 = 一定没有（可以直接跳过扫描），1 = 可能有
+ */
+int bloomMayContain(Table* table, int colIndex, const char* value) {
+    if (!table->blooms[colIndex]) return 1;
+    return bloomMayContainHash(table->blooms[colIndex], bloomHash(value));
+}
+
+/*==================== 主键索引 ====================*/
+/* 可选的主键列：值在表内唯一，用哈希表从主键值直接找到记录节点
+ * 
+ * 结构：开放定址、线性探测，槽里存 RecordNode*，键从节点的主键单元格里取，不另外保存
+ *   - 容量为2的幂，元素数超过容量的 70% 时扩容为2倍
+ *   - 删除用"后移"法：把后面探测链上的元素往前挪，不留墓碑，查找不会越来越慢
+ * 
+ * 整数主键（如学号）通常是连续的，另有一个直接寻址数组 direct[key - directBase]：
+ *   - 落在数组范围内的键只存数组，按主键查找就是一次数组访问，不用算哈希、不用探测
+ *   - 新键超出范围时，只要扩展后至少 1/PK_DIRECT_MAX_SPARSE 的格子有记录就按2倍扩展
+ *     （顺序追加的学号摊还O(1)），否则放进哈希表；扩展时把哈希表里落进新范围的键搬进数组
+ *   - 稀疏的离群值（如 999999）留在哈希表里，不会把数组撑大
+ *   - 哈希表要扩容时先重新规划：找出最稠密的一段键，若比现在数组里的记录多，就把数组换到那一段
+ *     （例如先插入了离群值、数组建在了它附近，之后大量连续学号进来，也能回到数组里）
+ * 
+ * 维护：addRecord 拒绝重复主键；删除、修改记录时同步更新；按主键查找/修改/删除都是 O(1)
+ */
+
+#define PK_MIN_CAPACITY 1024
+#define PK_MAX_LOAD_PERCENT 70
+#define PK_DIRECT_MIN_SIZE 1024      // 直接寻址数组的最小长度
+#define PK_DIRECT_MAX_SPARSE 4       // 数组长度不超过记录数的这么多倍
+
+typedef struct PrimaryKeyIndex {
+    RecordNode** slots;      // 哈希槽（NULL为空）
+    unsigned int capacity;   // 槽数（2的幂）
+    int count;               // 哈希表中的记录数
+    RecordNode** direct;     // 直接寻址数组（仅整数主键）：direct[key - directBase]
+    long long directBase;    // 数组第一格对应的主键值
+    unsigned int directSize; // 数组长度（0表示还没有）
+    int directCount;         // 数组中的记录数
+} PrimaryKeyIndex;
+
+static unsigned int pkHashCell(Table* table, const Cell* key) {
+    if (table->columns[table->primaryKey].type == 1) {
+        unsigned int x = (unsigned int)key->data.int_val;  // 整数打散，连续的学号不会挤在一起
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+    return (unsigned int)bloomHash(cellStr(key));
+}
+
+static int pkKeyEqual(Table* table, const Cell* a, const Cell* b) {
+    if (table->columns[table->primaryKey].type == 1) return a->data.int_val == b->data.int_val;
+    return strcmp(cellStr(a), cellStr(b)) == 0;
+}
+
+// 返回键所在的槽；不存在时返回探测到的第一个空槽
+static unsigned int pkFindSlot(Table* table, const Cell* key) {
+    PrimaryKeyIndex* pk = table->pk;
+    unsigned int mask = pk->capacity - 1;
+    unsigned int slot = pkHashCell(table, key) & mask;
+    while (pk->slots[slot] && !pkKeyEqual(table, &pk->slots[slot]->cells[table->primaryKey], key)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void pkResize(Table* table, unsigned int capacity) {
+    PrimaryKeyIndex* pk = table->pk;
+    RecordNode** old = pk->slots;
+    unsigned int oldCapacity = pk->capacity;
+    pk->slots = (RecordNode**)calloc(capacity, sizeof(RecordNode*));
+    pk->capacity = capacity;
+    for (unsigned int i = 0; i < oldCapacity; i++) {
+        if (old[i]) pk->slots[pkFindSlot(table, &old[i]->cells[table->primaryKey])] = old[i];
+    }
+    free(old);
+}
+
+// 按预计行数一次分配好槽，加载大表时不必反复扩容
+// 整数主键大多进直接寻址数组，哈希表只在需要时扩容
+static void pkReserve(Table* table, int rows) {
+    if (!table->pk || table->columns[table->primaryKey].type == 1) return;
+    unsigned int capacity = table->pk->capacity;
+    while ((unsigned long long)rows * 100 > (unsigned long long)capacity * PK_MAX_LOAD_PERCENT) capacity *= 2;
+    if (capacity != table->pk->capacity) pkResize(table, capacity);
+}
+
+// 整数键在直接寻址数组中的位置；不在数组范围内返回0
+static int pkDirectPos(Table* table, const Cell* key, unsigned int* pos) {
+    PrimaryKeyIndex* pk = table->pk;
+    if (table->columns[table->primaryKey].type != 1) return 0;
+    long long offset = (long long)key->data.int_val - pk->directBase;
+    if (offset < 0 || offset >= (long long)pk->directSize) return 0;
+    *pos = (unsigned int)offset;
+    return 1;
+}
+
+/* pkDirectCover - 尝试扩展直接寻址数组，使其覆盖key
+ * 返回值：1 已覆盖；0 扩展后太稀疏（该键应放进哈希表）
+ */
+static int pkDirectCover(Table* table, int key) {
+    PrimaryKeyIndex* pk = table->pk;
+    long long lo = pk->directSize ? pk->directBase : key;
+    long long hi = pk->directSize ? pk->directBase + pk->directSize - 1 : key;
+    if (key < lo) lo = key;
+    if (key > hi) hi = key;
+    long long need = hi - lo + 1;
+    long long limit = (long long)(pk->directCount + pk->count + 1) * PK_DIRECT_MAX_SPARSE;
+    if (limit < PK_DIRECT_MIN_SIZE) limit = PK_DIRECT_MIN_SIZE;
+    if (need > limit || need > INT_MAX) return 0;
+    long long size = pk->directSize ? (long long)pk->directSize * 2 : PK_DIRECT_MIN_SIZE;
+    if (size < need) size = need;
+    if (size > limit) size = limit;
+    
+    // 键在前面就把新空间留在前面，否则留在后面
+    long long base = (pk->directSize && key < pk->directBase) ? hi - size + 1 : lo;
+    RecordNode** direct = (RecordNode**)calloc((size_t)size, sizeof(RecordNode*));
+    if (!direct) return 0;
+    if (pk->directSize) {
+        memcpy(direct + (pk->directBase - base), pk->direct, pk->directSize * sizeof(RecordNode*));
+    }
+    free(pk->direct);
+    pk->direct = direct;
+    pk->directBase = base;
+    pk->directSize = (unsigned int)size;
+    
+    // 哈希表里落进新范围的键搬到数组，保证范围内的键只查数组
+    if (pk->count > 0) {
+        RecordNode** old = pk->slots;
+        pk->slots = (RecordNode**)calloc(pk->capacity, sizeof(RecordNode*));
+        pk->count = 0;
+        for (unsigned int i = 0; i < pk->capacity; i++) {
+            if (!old[i]) continue;
+            unsigned int pos;
+            if (pkDirectPos(table, &old[i]->cells[table->primaryKey], &pos)) {
+                pk->direct[pos] = old[i];
+                pk->directCount++;
+            } else {
+                pk->slots[pkFindSlot(table, &old[i]->cells[table->primaryKey])] = old[i];
+                pk->count++;
+            }
+        }
+        free(old);
+    }
+    return 1;
+}
+
+typedef struct {
+    int key;
+    RecordNode* node;
+} PkEntry;
+
+static int cmpPkEntry(const void* a, const void* b) {
+    int x = ((const PkEntry*)a)->key, y = ((const PkEntry*)b)->key;
+    return (x > y) - (x < y);
+}
+
+/* pkDirectReplan - 把直接寻址数组移到键最稠密的一段
+ * 在哈希表扩容前调用（次数为对数级），O(n log n)
+ * 返回值：1 已移动（哈希表变小了），0 现在的数组已经是最好的
+ */
+static int pkDirectReplan(Table* table) {
+    PrimaryKeyIndex* pk = table->pk;
+    int total = pk->count + pk->directCount;
+    PkEntry* entries = (PkEntry*)malloc((total > 0 ? total : 1) * sizeof(PkEntry));
+    int n = 0;
+    for (unsigned int i = 0; i < pk->directSize; i++) {
+        if (pk->direct[i]) entries[n].node = pk->direct[i], entries[n++].key = pk->direct[i]->cells[table->primaryKey].data.int_val;
+    }
+    for (unsigned int i = 0; i < pk->capacity; i++) {
+        if (pk->slots[i]) entries[n].node = pk->slots[i], entries[n++].key = pk->slots[i]->cells[table->primaryKey].data.int_val;
+    }
+    qsort(entries, n, sizeof(PkEntry), cmpPkEntry);
+    
+    // 双指针：以每个键为右端，找满足稠密条件的最长窗口
+    int bestFrom = 0, bestCount = 0;
+    for (int from = 0, to = 0; to < n; to++) {
+        while ((long long)entries[to].key - entries[from].key + 1 > PK_DIRECT_MIN_SIZE
+               && (long long)entries[to].key - entries[from].key + 1 > (long long)(to - from + 1) * PK_DIRECT_MAX_SPARSE) {
+            from++;
+        }
+        if (to - from + 1 > bestCount) bestFrom = from, bestCount = to - from + 1;
+    }
+    if (bestCount <= pk->directCount) {
+        free(entries);
+        return 0;
+    }
+    
+    long long base = entries[bestFrom].key;
+    long long size = (long long)entries[bestFrom + bestCount - 1].key - base + 1;
+    if (size < PK_DIRECT_MIN_SIZE) size = PK_DIRECT_MIN_SIZE;
+    RecordNode** direct = (RecordNode**)calloc((size_t)size, sizeof(RecordNode*));
+    if (!direct) {
+        free(entries);
+        return 0;
+    }
+    free(pk->direct);
+    pk->direct = direct;
+    pk->directBase = base;
+    pk->directSize = (unsigned int)size;
+    pk->directCount = 0;
+    memset(pk->slots, 0, pk->capacity * sizeof(RecordNode*));
+    pk->count = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned int pos;
+        if (pkDirectPos(table, &entries[i].node->cells[table->primaryKey], &pos)) {
+            pk->direct[pos] = entries[i].node;
+            pk->directCount++;
+        } else {
+            pk->slots[pkFindSlot(table, &entries[i].node->cells[table->primaryKey])] = entries[i].node;
+            pk->count++;
+        }
+    }
+    free(entries);
+    return 1;
+}
+
+/* pkInsert - 把节点登记到主键索引
+ * 返回值：1 成功，0 主键重复（不登记）
+ */
+static int pkInsert(Table* table, RecordNode* node) {
+    if (!table->pk) return 1;
+    PrimaryKeyIndex* pk = table->pk;
+    const Cell* key = &node->cells[table->primaryKey];
+    unsigned int pos;
+    if (pkDirectPos(table, key, &pos)
+        || (table->columns[table->primaryKey].type == 1 && pkDirectCover(table, key->data.int_val) && pkDirectPos(table, key, &pos))) {
+        if (pk->direct[pos]) return pk->direct[pos] == node;
+        pk->direct[pos] = node;
+        pk->directCount++;
+        return 1;
+    }
+    
+    if ((unsigned long long)(pk->count + 1) * 100 > (unsigned long long)pk->capacity * PK_MAX_LOAD_PERCENT) {
+        if (table->columns[table->primaryKey].type == 1 && pkDirectReplan(table)) return pkInsert(table, node);
+        pkResize(table, pk->capacity * 2);
+    }
+    unsigned int slot = pkFindSlot(table, key);
+    if (table->pk->slots[slot]) return table->pk->slots[slot] == node;
+    table->pk->slots[slot] = node;
+    table->pk->count++;
+    return 1;
+}
+
+// 从主键索引中删除一个键（后移删除）
+static void pkErase(Table* table, const Cell* key) {
+    if (!table->pk) return;
+    PrimaryKeyIndex* pk = table->pk;
+    unsigned int pos;
+    if (pkDirectPos(table, key, &pos)) {
+        if (pk->direct[pos]) pk->directCount--;
+        pk->direct[pos] = NULL;
+        return;
+    }
+    unsigned int mask = pk->capacity - 1;
+    unsigned int hole = pkFindSlot(table, key);
+    if (!pk->slots[hole]) return;
+    pk->slots[hole] = NULL;
+    pk->count--;
+    // 后面同一探测链上的元素，如果它的理想位置不在 (hole, cur] 之间，就挪进空洞
+    unsigned int cur = (hole + 1) & mask;
+    while (pk->slots[cur]) {
+        unsigned int home = pkHashCell(table, &pk->slots[cur]->cells[table->primaryKey]) & mask;
+        if (((cur - home) & mask) >= ((cur - hole) & mask)) {
+            pk->slots[hole] = pk->slots[cur];
+            pk->slots[cur] = NULL;
+            hole = cur;
+        }
+        cur = (cur + 1) & mask;
+    }
+}
+
+// 记录的内容搬到了另一个节点上：让主键索引指向新节点
+static void pkRepoint(Table* table, RecordNode* from, RecordNode* to) {
+    if (!table->pk) return;
+    unsigned int pos;
+    if (pkDirectPos(table, &to->cells[table->primaryKey], &pos)) {
+        if (table->pk->direct[pos] == from) table->pk->direct[pos] = to;
+        return;
+    }
+    unsigned int slot = pkFindSlot(table, &to->cells[table->primaryKey]);
+    if (table->pk->slots[slot] == from) table->pk->slots[slot] = to;
+}
+
+static void freePrimaryKey(Table* table) {
+    if (!table->pk) return;
+    free(table->pk->slots);
+    free(table->pk->direct);
+    free(table->pk);
+    table->pk = NULL;
+}
+
+/* setPrimaryKey - 指定主键列并建立唯一哈希索引
+ * 
+ * @colIndex: 主键列下标，-1 表示取消主键
+ * 返回值：1 成功；0 现有数据中该列有重复值（保持没有主键）
+ * 时间复杂度：O(n)
+ */
+int setPrimaryKey(Table* table, int colIndex) {
+    lsmCheckKeyColumn(table, colIndex);  // LSM存储按原主键组织，换主键就不再写入
+    freePrimaryKey(table);
+    table->primaryKey = -1;
+    if (colIndex < 0 || colIndex >= table->numColumns) return colIndex < 0;
+    
+    table->primaryKey = colIndex;
+    table->pk = (PrimaryKeyIndex*)malloc(sizeof(PrimaryKeyIndex));
+    table->pk->capacity = PK_MIN_CAPACITY;
+    table->pk->slots = (RecordNode**)calloc(PK_MIN_CAPACITY, sizeof(RecordNode*));
+    table->pk->count = 0;
+    table->pk->direct = NULL;
+    table->pk->directBase = 0;
+    table->pk->directSize = 0;
+    table->pk->directCount = 0;
+    pkReserve(table, table->rowCount);
+    
+    // 整数主键：现有的值足够稠密就一次建好覆盖 [min, max] 的直接寻址数组
+    if (table->columns[colIndex].type == 1 && table->head) {
+        int minKey = INT_MAX, maxKey = INT_MIN;
+        for (RecordNode* cur = table->head; cur; cur = cur->next) {
+            int v = cur->cells[colIndex].data.int_val;
+            if (v < minKey) minKey = v;
+            if (v > maxKey) maxKey = v;
+        }
+        long long span = (long long)maxKey - minKey + 1;
+        if (span <= (long long)table->rowCount * PK_DIRECT_MAX_SPARSE && span <= INT_MAX) {
+            table->pk->direct = (RecordNode**)calloc((size_t)span, sizeof(RecordNode*));
+            if (table->pk->direct) {
+                table->pk->directBase = minKey;
+                table->pk->directSize = (unsigned int)span;
+            }
+        }
+    }
+    for (RecordNode* cur = table->head; cur; cur = cur->next) {
+        if (!pkInsert(table, cur)) {
+            freePrimaryKey(table);
+            table->primaryKey = -1;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* findRecordByKey - 按主键值查找记录
+ * @key: 只用到其中的主键值（整数或字符串）
+ * 返回值：记录节点，没有主键或找不到返回NULL
+ * 时间复杂度：O(1)；整数键落在直接寻址数组范围内时只是一次数组访问
+ */
+RecordNode* findRecordByKey(Table* table, const Cell* key) {
+    if (!table || !table->pk) return NULL;
+    unsigned int pos;
+    if (pkDirectPos(table, key, &pos)) return table->pk->direct[pos];
+    return table->pk->slots[pkFindSlot(table, key)];
+}
+
+/*==================== 行号索引（计数AVL树） ====================*/
+/* 行号是本程序的一等公民（删除、修改、打印都按行号），但链表按行号定位要 O(n)。
+ * 
+ * 行号树：按链表顺序排列记录的AVL树，每个节点记录子树中的记录数（size），
+ *   第k行 = 中序遍历的第k个节点，从根往下按左子树大小选方向即可找到，O(log n)。
+ *   树中没有键，插入/删除也按位置进行，之后的行号自然顺延，始终连续。
+ * 
+ * 链表仍是主存储（遍历、保存都走链表），树只负责"第k行在哪"：
+ *   - 第一次按行号访问时从链表 O(n) 建成平衡树，之后随追加、按行号插入/删除同步维护
+ *   - 按主键删除（搬移后继节点内容的做法）不知道行号，直接丢弃树，下次按行号访问时重建
+ */
+
+typedef struct RowTreeNode {
+    RecordNode* record;          // 对应的记录（不拥有所有权）
+    struct RowTreeNode* left;
+    struct RowTreeNode* right;
+    int height;                  // 节点高度
+    int size;                    // 子树中的记录数
+} RowTreeNode;
+
+static int rowTreeHeight(RowTreeNode* node) { return node ? node->height : 0; }
+static int rowTreeSize(RowTreeNode* node) { return node ? node->size : 0; }
+
+static void rowTreeUpdate(RowTreeNode* node) {
+    int hl = rowTreeHeight(node->left), hr = rowTreeHeight(node->right);
+    node->height = 1 + (hl > hr ? hl : hr);
+    node->size = 1 + rowTreeSize(node->left) + rowTreeSize(node->right);
+}
+
+static RowTreeNode* rowTreeRotateRight(RowTreeNode* y) {
+    RowTreeNode* x = y->left;
+    y->left = x->right;
+    x->right = y;
+    rowTreeUpdate(y);
+    rowTreeUpdate(x);
+    return x;
+}
+
+static RowTreeNode* rowTreeRotateLeft(RowTreeNode* x) {
+    RowTreeNode* y = x->right;
+    x->right = y->left;
+    y->left = x;
+    rowTreeUpdate(x);
+    rowTreeUpdate(y);
+    return y;
+}
+
+// 更新高度与大小，失衡时旋转（与AVL索引的四种情况相同）
+static RowTreeNode* rowTreeRebalance(RowTreeNode* node) {
+    rowTreeUpdate(node);
+    int balance = rowTreeHeight(node->left) - rowTreeHeight(node->right);
+    if (balance > 1) {
+        if (rowTreeHeight(node->left->left) < rowTreeHeight(node->left->right)) {
+            node->left = rowTreeRotateLeft(node->left);    // LR
+        }
+        return rowTreeRotateRight(node);                   // LL
+    }
+    if (balance < -1) {
+        if (rowTreeHeight(node->right->right) < rowTreeHeight(node->right->left)) {
+            node->right = rowTreeRotateRight(node->right); // RL
+        }
+        return rowTreeRotateLeft(node);                    // RR
+    }
+    return node;
+}
+
+// 在第pos个位置（从0开始）插入记录
+static RowTreeNode* rowTreeInsertAt(RowTreeNode* node, int pos, RecordNode* record) {
+    if (!node) {
+        RowTreeNode* newNode = (RowTreeNode*)malloc(sizeof(RowTreeNode));
+        newNode->record = record;
+        newNode->left = newNode->right = NULL;
+        newNode->height = 1;
+        newNode->size = 1;
+        return newNode;
+    }
+    int leftSize = rowTreeSize(node->left);
+    if (pos <= leftSize) node->left = rowTreeInsertAt(node->left, pos, record);
+    else node->right = rowTreeInsertAt(node->right, pos - leftSize - 1, record);
+    return rowTreeRebalance(node);
+}
+
+// 删除第pos个位置（从0开始）的节点
+static RowTreeNode* rowTreeDeleteAt(RowTreeNode* node, int pos) {
+    if (!node) return NULL;
+    int leftSize = rowTreeSize(node->left);
+    if (pos < leftSize) {
+        node->left = rowTreeDeleteAt(node->left, pos);
+    } else if (pos > leftSize) {
+        node->right = rowTreeDeleteAt(node->right, pos - leftSize - 1);
+    } else {
+        if (!node->left || !node->right) {
+            RowTreeNode* child = node->left ? node->left : node->right;
+            free(node);
+            return child;
+        }
+        // 两个孩子：用右子树的第一个记录顶替，再删掉它
+        RowTreeNode* succ = node->right;
+        while (succ->left) succ = succ->left;
+        node->record = succ->record;
+        node->right = rowTreeDeleteAt(node->right, 0);
+    }
+    return rowTreeRebalance(node);
+}
+
+// 第pos个位置（从0开始）的记录，O(log n)
+static RecordNode* rowTreeGet(RowTreeNode* node, int pos) {
+    while (node) {
+        int leftSize = rowTreeSize(node->left);
+        if (pos < leftSize) {
+            node = node->left;
+        } else if (pos > leftSize) {
+            pos -= leftSize + 1;
+            node = node->right;
+        } else {
+            return node->record;
+        }
+    }
+    return NULL;
+}
+
+// 按中序从链表建立n个节点的平衡树，*cur沿链表前进，O(n)
+static RowTreeNode* rowTreeBuild(RecordNode** cur, int n) {
+    if (n <= 0) return NULL;
+    RowTreeNode* node = (RowTreeNode*)malloc(sizeof(RowTreeNode));
+    node->left = rowTreeBuild(cur, n / 2);
+    node->record = *cur;
+    *cur = (*cur)->next;
+    node->right = rowTreeBuild(cur, n - n / 2 - 1);
+    rowTreeUpdate(node);
+    return node;
+}
+
+static void rowTreeFree(RowTreeNode* node) {
+    if (!node) return;
+    rowTreeFree(node->left);
+    rowTreeFree(node->right);
+    free(node);
+}
+
+// 丢弃行号树（下次按行号访问时重建）
+static void dropRowTree(Table* table) {
+    rowTreeFree(table->rowTree);
+    table->rowTree = NULL;
+}
+
+// 确保行号树已建立
+static void ensureRowTree(Table* table) {
+    if (table->rowTree || table->rowCount == 0) return;
+    RecordNode* cur = table->head;
+    table->rowTree = rowTreeBuild(&cur, table->rowCount);
+}
+
+/* unlinkRowAt - 把第rowNum行的节点从链表和行号树中摘下（不释放），rowCount减1
+ * 时间复杂度：O(log n)
+ */
+static RecordNode* unlinkRowAt(Table* table, int rowNum) {
+    ensureRowTree(table);
+    RecordNode* prev = rowNum > 1 ? rowTreeGet(table->rowTree, rowNum - 2) : NULL;  // 前驱节点指针
+    RecordNode* current = prev ? prev->next : table->head;  // 当前节点指针
+    if (!current) return NULL;  // 未找到目标节点
+    table->rowTree = rowTreeDeleteAt(table->rowTree, rowNum - 1);
+
+    // 更新链表结构
+    if (prev) {
+        // 情况1：删除的不是头节点，前驱节点跳过当前节点
+        prev->next = current->next;
+    } else {
+        // 情况2：删除的是头节点，head指针后移
+        table->head = current->next;
+    }
+    
+    // 如果删除的是尾节点，更新tail指针
+    if (table->tail == current) {
+        table->tail = prev;  // prev可能为NULL（删除唯一节点）
+    }
+    table->rowCount--;
+    return current;
+}
+
+/* linkRowAt - 把节点接到第rowNum行（1 ~ rowCount+1），rowCount加1
+ * 时间复杂度：O(log n)
+ */
+static void linkRowAt(Table* table, int rowNum, RecordNode* node) {
+    ensureRowTree(table);
+    RecordNode* prev = rowNum > 1 ? rowTreeGet(table->rowTree, rowNum - 2) : NULL;
+    if (prev) {
+        node->next = prev->next;
+        prev->next = node;
+    } else {
+        node->next = table->head;
+        table->head = node;
+    }
+    if (!node->next) table->tail = node;
+    table->rowTree = rowTreeInsertAt(table->rowTree, rowNum - 1, node);
+    table->rowCount++;
+}
 
 /*==================== 表操作函数 ====================*/
 
@@ -194,8 +992,9 @@ RecordNode* addRecord(Table* table, Cell* cells);
  * 算法：
  *   1. 分配Table结构体内存
  *   2. 深拷贝列定义（包括列名字符串）
- *   3. 初始化链表为空（head=NULL, tail=NULL）
- *   4. 初始化行数为0
+ *   3. 建立列名哈希表
+ *   4. 初始化链表为空（head=NULL, tail=NULL）
+ *   5. 初始化行数为0
  * 
  * 内存管理：
  *   - 使用 _strdup 深拷贝列名，避免悬空指针
@@ -236,6 +1035,16 @@ RecordNode* addRecord(Table* table, Cell* cells);
       • 表结构体 + 列数组 + 所有列名字符串
 
  */
+// 列名哈希（FNV-1a）
+static unsigned int hashColumnName(const char* name) {
+    unsigned int h = 2166136261u;
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
 Table* createTable(int numColumns, Column* columns) {
     // 分配表结构体内存
     Table* table = (Table*)malloc(sizeof(Table));
@@ -251,10 +1060,48 @@ Table* createTable(int numColumns, Column* columns) {
         table->columns[i].type = columns[i].type;
     }
     
+    // 建立列名哈希表：槽数取不小于2倍列数的2的幂，线性探测
+    table->columnSlotCount = 16;
+    while (table->columnSlotCount < numColumns * 2) table->columnSlotCount *= 2;
+    table->columnSlots = (int*)calloc(table->columnSlotCount, sizeof(int));
+    for (int i = 0; i < numColumns; i++) {
+        unsigned int slot = hashColumnName(table->columns[i].name) & (table->columnSlotCount - 1);
+        while (table->columnSlots[slot] != 0) {
+            if (strcmp(table->columns[table->columnSlots[slot] - 1].name, table->columns[i].name) == 0) break;//重名时保留第一列
+            slot = (slot + 1) & (table->columnSlotCount - 1);
+        }
+        if (table->columnSlots[slot] == 0) table->columnSlots[slot] = i + 1;
+    }
+    
     // 初始化空链表
     table->head = NULL;  // 头指针为空
     table->tail = NULL;  // 尾指针为空
     table->rowCount = 0; // 记录数为0
+    table->version = 0;
+    table->crackers = NULL; // 裂解列在第一次范围查询时才创建
+    table->indexes = NULL;  // 有序索引在第一次使用时才建立
+    table->checksum = 0;
+    table->checksumVersion = (unsigned int)-1; // 还没有对应的JSON文本
+    table->builds = NULL;
+    table->primaryKey = -1; // 默认没有主键，setPrimaryKey 指定
+    table->pk = NULL;
+    table->rowTree = NULL;  // 行号树在第一次按行号访问时才建立
+    table->clusterColumn = -1;
+    table->clusteredRows = 0;
+    table->autoCluster = 0;
+    table->kd = NULL;       // k-d树在第一次多列查询时才建立
+    table->store = NULL;    // 列存在菜单中开启
+    table->lsm = NULL;
+    table->shared = NULL;   // 共享内存在菜单中发布
+    table->map = NULL;
+    table->chash = NULL;    // 并发哈希索引在菜单中建立
+    table->skip = NULL;
+    
+    // 每个字符串列一个布隆过滤器
+    table->blooms = (StringBloom**)calloc(numColumns, sizeof(StringBloom*));
+    for (int i = 0; i < numColumns; i++) {
+        if (table->columns[i].type != 1) table->blooms[i] = createBloom(BLOOM_MIN_CAPACITY);
+    }
     
     return table;
 }
@@ -278,6 +1125,13 @@ Table* createTable(int numColumns, Column* columns) {
  */
 void freeTable(Table* table) {
     if (!table) return;  // 空指针检查
+    freeIndexBuilds(table);  // 先等后台建索引的线程退出，它们还在读这张表
+    freeColumnStore(table);  // 同样先等列存的合并线程
+    closeLsm(table);         // 和LSM的后台合并线程
+    stopSharing(table);
+    closeMappedFile(table);
+    dropConcurrentHash(table);
+    dropSkipList(table);
     
     // 遍历链表，释放所有记录节点
     RecordNode* current = table->head;
@@ -285,9 +1139,8 @@ void freeTable(Table* table) {
         RecordNode* next = current->next;  // 保存下一个节点指针
         
         // 释放当前节点的单元格数据（包括字符串）
-        freeCells(current->cells, table->numColumns);
-        free(current->cells);  // 释放单元格数组
-        free(current);         // 释放节点本身
+        freeCells(current->cells, table->columns, table->numColumns);
+        free(current);         // 释放节点本身（单元格数组在节点内）
         
         current = next;  // 移动到下一个节点
     }
@@ -297,22 +1150,53 @@ void freeTable(Table* table) {
         free(table->columns[i].name);  // 释放 _strdup 分配的字符串
     }
     
-    // 释放列定义数组和表结构体
+    // 释放列定义数组、列名哈希表和表结构体
     free(table->columns);
+    free(table->columnSlots);
+    freeCrackers(table);
+    freeColumnIndexes(table);
+    freePrimaryKey(table);
+    dropRowTree(table);
+    freeKdIndex(table);
+    for (int i = 0; i < table->numColumns; i++) freeBloom(table->blooms[i]);
+    free(table->blooms);
     free(table);
 }
 
+/*findColumnIndex - 按列名查找列下标
+ * 
+ * 参数：
+ *   @table: 数据表
+ *   @name: 列名
+ * 
+ * 返回值：列下标，不存在返回-1
+ * 
+ * 时间复杂度：平均O(1)（列名哈希表，线性探测），与列数无关
+ */
+int findColumnIndex(Table* table, const char* name) {
+    if (!table || !name) return -1;
+    unsigned int mask = (unsigned int)table->columnSlotCount - 1;
+    unsigned int slot = hashColumnName(name) & mask;
+    while (table->columnSlots[slot] != 0) {
+        int idx = table->columnSlots[slot] - 1;
+        if (strcmp(table->columns[idx].name, name) == 0) return idx;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
 /*deepCopyCells - 深拷贝单元格数组
  * 
  * 参数：
  *   @dest: 目标单元格数组
  *   @src: 源单元格数组
+ *   @columns: 列定义（单元格的类型由所在列决定）
  *   @numColumns: 列数（数组大小）
  * 
  * 算法：
  *   - 对每个单元格：
  *     - 如果是整数：直接复制值
- *     - 如果是字符串：使用 _strdup 深拷贝字符串
+ *     - 如果是字符串：短字符串直接整格复制，长字符串用 _strdup 深拷贝
  * 
  * 为什么需要深拷贝：
  *   - 避免多个Cell指向同一字符串
@@ -320,17 +1204,18 @@ void freeTable(Table* table) {
  * 
  * 时间复杂度：O(numColumns)
  */
-static void deepCopyCells(Cell* dest, Cell* src, int numColumns) {
+static void deepCopyCells(Cell* dest, Cell* src, const Column* columns, int numColumns) {
     for (int i = 0; i < numColumns; i++) {
-        dest[i].type = src[i].type;
-        
-        if (src[i].type == 1) {
+        if (columns[i].type == 1) {
             // 整数类型：直接复制值
             dest[i].data.int_val = src[i].data.int_val;
         } else {
             // 字符串类型：深拷贝字符串
-            const char* s = src[i].data.str_val ? src[i].data.str_val : "";
-            dest[i].data.str_val = _strdup(s);  // 分配新内存并复制
+            if (src[i].data.inline_str[CELL_INLINE_MAX] != CELL_HEAP_TAG) {
+                dest[i] = src[i];  // 内联字符串，复制整格即可
+            } else {
+                cellSetStr(&dest[i], cellStr(&src[i]));  // 分配新内存并复制
+            }
         }
     }
 }
@@ -339,10 +1224,11 @@ static void deepCopyCells(Cell* dest, Cell* src, int numColumns) {
  * 
  * 参数：
  *   @cells: 单元格数组
+ *   @columns: 列定义（单元格的类型由所在列决定）
  *   @numColumns: 列数
  * 
  * 算法：
- *   遍历每个单元格，如果是字符串类型，释放字符串内存
+ *   遍历每个单元格，如果所在列是字符串类型，释放字符串内存
  * 
  * 注意：
  *   - 只释放单元格内部的字符串，不释放cells数组本身
@@ -350,14 +1236,13 @@ static void deepCopyCells(Cell* dest, Cell* src, int numColumns) {
  * 
  * 时间复杂度：O(numColumns)
  */
-static void freeCells(Cell* cells, int numColumns) {
+static void freeCells(Cell* cells, const Column* columns, int numColumns) {
     if (!cells) return;  // 空指针检查
     
     for (int i = 0; i < numColumns; i++) {
-        // 如果是字符串类型，释放动态分配的字符串
-        if (cells[i].type != 1 && cells[i].data.str_val) {
-            free(cells[i].data.str_val);
-            cells[i].data.str_val = NULL;  // 防止悬空指针
+        // 如果是字符串类型，释放动态分配的字符串（内联字符串无需释放）
+        if (columns[i].type != 1) {
+            cellFreeStr(&cells[i]);  // 同时清空，防止悬空指针
         }
     }
 }
@@ -368,13 +1253,12 @@ static void freeCells(Cell* cells, int numColumns) {
  *   @table: 目标表
  *   @cells: 新记录的单元格数组
  * 
- * 返回值：新创建的RecordNode指针，失败返回NULL
+ * 返回值：新创建的RecordNode指针，失败（包括主键重复）返回NULL
  * 
  * 算法：链表尾插法
- *   1. 验证单元格类型与表定义是否匹配
- *   2. 创建新节点并深拷贝单元格数据
- *   3. 如果链表为空，head和tail都指向新节点
- *   4. 否则，将新节点链接到tail后，更新tail指针
+ *   1. 创建新节点（节点与单元格数组一次分配）并按列类型深拷贝单元格数据
+ *   2. 如果链表为空，head和tail都指向新节点
+ *   3. 否则，将新节点链接到tail后，更新tail指针
  * 
  * 时间复杂度：O(numColumns) - 因为有tail指针，不需要遍历链表
  * 空间复杂度：O(numColumns) - 深拷贝单元格数据
@@ -383,31 +1267,25 @@ static void freeCells(Cell* cells, int numColumns) {
  */
 RecordNode* addRecord(Table* table, Cell* cells) {
     if (!table || !cells) return NULL;  // 参数校验
+    waitIndexBuilds(table);  // 后台建索引的线程正在读链表，改表前等它完成
 
-    // 类型验证：确保每列的类型与表定义匹配
-    for (int i = 0; i < table->numColumns; i++) {
-        if (cells[i].type != table->columns[i].type) {
-            printf("Error: Column %d type mismatch!\n", i + 1);
-            return NULL;
-        }
-    }
-
-    // 分配新节点
-    RecordNode* newNode = (RecordNode*)malloc(sizeof(RecordNode));
+    // 分配新节点（单元格数组紧跟在节点后面）
+    RecordNode* newNode = (RecordNode*)malloc(sizeof(RecordNode) + table->numColumns * sizeof(Cell));
     if (!newNode) return NULL;
     
-    // 分配单元格数组
-    newNode->cells = (Cell*)malloc(table->numColumns * sizeof(Cell));
-    if (!newNode->cells) { 
-        free(newNode); 
-        return NULL; 
-    }
-    
     // 深拷贝单元格数据（避免共享字符串指针）
-    deepCopyCells(newNode->cells, cells, table->numColumns);
+    deepCopyCells(newNode->cells, cells, table->columns, table->numColumns);
     newNode->next = NULL;  // 作为尾节点，next为NULL
+    
+    // 主键唯一：重复时放弃插入
+    if (!pkInsert(table, newNode)) {
+        freeCells(newNode->cells, table->columns, table->numColumns);
+        free(newNode);
+        return NULL;
+    }
 
     // 链表插入逻辑
+    RecordNode* prevTail = table->tail;
     if (table->head == NULL) {
         // 情况1：空链表，head和tail都指向新节点
         table->head = newNode;
@@ -419,24 +1297,72 @@ RecordNode* addRecord(Table* table, Cell* cells) {
     }
     
     table->rowCount++;  // 行数加1
+    table->version++;
+    bloomAddRow(table, newNode);  // 维护字符串列的布隆过滤器
+    if (table->rowTree) table->rowTree = rowTreeInsertAt(table->rowTree, table->rowCount - 1, newNode);
+    clusterNoteAppend(table, prevTail);
+    storeNoteAppend(table, newNode);
+    lsmNotePut(table, newNode);
+    mapNoteLink(table, prevTail, newNode);
+    chashNoteInsert(table, newNode);
+    skipNoteInsert(table, newNode);
     return newNode;
 }
 
-/*deleteRecordByRowNum - 按行号删除记录
+/*insertRecordAt - 在第rowNum行插入新记录，原来的第rowNum行及之后的记录后移一行
  * 
  * 参数：
  *   @table: 目标表
- *   @rowNum: 行号（从1开始）
+ *   @rowNum: 插入位置（1 ~ rowCount+1，rowCount+1 即追加到表尾）
+ *   @cells: 新记录的单元格数组
+ * 
+ * 返回值：新创建的RecordNode指针，位置无效或主键重复返回NULL
+ * 
+ * 算法：行号树找到第rowNum-1行作为前驱，链表中接在它后面，再在树的同一位置插入
+ * 
+ * 时间复杂度：O(log n + numColumns)
+ */
+RecordNode* insertRecordAt(Table* table, int rowNum, Cell* cells) {
+    if (!table || !cells || rowNum < 1 || rowNum > table->rowCount + 1) return NULL;
+    if (rowNum == table->rowCount + 1) return addRecord(table, cells);
+    waitIndexBuilds(table);
+    
+    RecordNode* newNode = (RecordNode*)malloc(sizeof(RecordNode) + table->numColumns * sizeof(Cell));
+    if (!newNode) return NULL;
+    deepCopyCells(newNode->cells, cells, table->columns, table->numColumns);
+    if (!pkInsert(table, newNode)) {
+        freeCells(newNode->cells, table->columns, table->numColumns);
+        free(newNode);
+        return NULL;
+    }
+    
+    linkRowAt(table, rowNum, newNode);
+    clusterNoteInsert(table, rowNum);
+    storeInvalidate(table);  // 列存的主存行不能在中间插入
+    lsmNotePut(table, newNode);
+    mapNoteLink(table, rowNum > 1 ? rowTreeGet(table->rowTree, rowNum - 2) : NULL, newNode);
+    chashNoteInsert(table, newNode);
+    skipNoteInsert(table, newNode);
+    table->version++;      // 之后的行号都变了
+    bloomAddRow(table, newNode);
+    return newNode;
+}
+
+/*deleteRecordByRowNum - 按行号删除记录
+ * 
+ * 参数：
+ *   @table: 目标表
+ *   @rowNum: 行号（从1开始）
  * 
  * 返回值：成功返回1，失败返回0
  * 
  * 算法：单链表删除
- *   1. 遍历链表找到第rowNum个节点
+ *   1. 用行号树找到第rowNum-1个节点（前驱），当前节点就是它的后继
  *   2. 更新前驱节点的next指针跳过当前节点
  *   3. 处理特殊情况（删除头节点、尾节点）
- *   4. 释放被删除节点的内存
+ *   4. 从行号树中删除该位置，释放被删除节点的内存
  * 
- * 时间复杂度：O(rowNum) - 需要遍历到目标位置
+ * 时间复杂度：O(log n) - 行号树定位，不必遍历到目标位置
  * 
  * 关键指针操作：
  *   - prev: 当前节点的前驱节点
@@ -446,38 +1372,23 @@ RecordNode* addRecord(Table* table, Cell* cells) {
 int deleteRecordByRowNum(Table* table, int rowNum) {
     // 参数校验：表不能为空，行号必须在有效范围内
     if (!table || rowNum < 1 || rowNum > table->rowCount) return 0;
+    waitIndexBuilds(table);
     
-    RecordNode* prev = NULL;      // 前驱节点指针
-    RecordNode* current = table->head;  // 当前节点指针
-    int idx = 1;  // 当前行号（从1开始）
-    
-    // 遍历链表找到第rowNum行
-    while (current && idx < rowNum) {
-        prev = current;          // 保存前驱节点
-        current = current->next; // 移动到下一个节点
-        idx++;
-    }
+    RecordNode* current = unlinkRowAt(table, rowNum);  // 行号树定位前驱，摘下当前节点
     if (!current) return 0;  // 未找到目标节点
-
-    // 更新链表结构
-    if (prev) {
-        // 情况1：删除的不是头节点，前驱节点跳过当前节点
-        prev->next = current->next;
-    } else {
-        // 情况2：删除的是头节点，head指针后移
-        table->head = current->next;
-    }
-    
-    // 如果删除的是尾节点，更新tail指针
-    if (table->tail == current) {
-        table->tail = prev;  // prev可能为NULL（删除唯一节点）
-    }
+    if (rowNum <= table->clusteredRows) table->clusteredRows--;  // 有序前缀删掉一行仍然有序
 
     // 释放被删除节点的内存
-    freeCells(current->cells, table->numColumns);  // 释放单元格中的字符串
-    free(current->cells);  // 释放单元格数组
-    free(current);         // 释放节点本身
-    table->rowCount--;     // 行数减1
+    storeNoteDelete(table, current);
+    lsmNoteDelete(table, current);
+    mapNoteUnlink(table, rowNum > 1 ? rowTreeGet(table->rowTree, rowNum - 2) : NULL, current);
+    chashNoteRemove(table, current);
+    skipNoteRemove(table, current);
+    if (table->pk) pkErase(table, &current->cells[table->primaryKey]);
+    bloomRemoveRow(table, current);  // 先从布隆过滤器中减掉
+    freeCells(current->cells, table->columns, table->numColumns);  // 释放单元格中的字符串
+    free(current);         // 释放节点本身（单元格数组在节点内）
+    table->version++;      // 之后的行号都变了
     return 1;
 }
 
@@ -488,55 +1399,134 @@ int deleteRecordByRowNum(Table* table, int rowNum) {
  *   @rowNum: 行号（从1开始）
  *   @newCells: 新的单元格数据
  * 
- * 返回值：成功返回1，失败返回0
+ * 返回值：成功返回1，失败（包括新主键与其他记录重复）返回0
  * 
  * 算法：
- *   1. 验证新单元格类型与表定义匹配
- *   2. 遍历链表找到第rowNum个节点
- *   3. 释放旧单元格数据
- *   4. 深拷贝新单元格数据到节点
+ *   1. 用行号树找到第rowNum个节点
+ *   2. 释放旧单元格数据
+ *   3. 按列类型深拷贝新单元格数据到节点
  * 
- * 时间复杂度：O(rowNum + numColumns)
+ * 时间复杂度：O(log n + numColumns)
  * 
  * 注意：不改变链表结构，只更新节点内容
  */
 int updateRecordByRowNum(Table* table, int rowNum, Cell* newCells) {
     // 参数校验
     if (!table || !newCells || rowNum < 1 || rowNum > table->rowCount) return 0;
-    
-    // 类型校验：逐列确保新数据类型与表定义匹配
-    for (int i = 0; i < table->numColumns; i++) {
-        if (newCells[i].type != table->columns[i].type) {
-            printf("Error: Column %d type mismatch!\n", i + 1);
-            return 0;
+    waitIndexBuilds(table);
+
+    // 用行号树找到目标节点
+    ensureRowTree(table);
+    RecordNode* current = rowTreeGet(table->rowTree, rowNum - 1);
+    if (!current) return 0;  // 未找到目标节点
+    return replaceRecordCells(table, current, newCells);
+}
+
+/* replaceRecordCells - 用新数据替换一条记录的内容（按行号/按主键修改共用）
+ * 返回值：成功返回1；新主键已被其他记录使用返回0，记录不变
+ */
+static int replaceRecordCells(Table* table, RecordNode* node, Cell* newCells) {
+    int keyChanged = 0;
+    int clusterRow = 0;
+    if (table->pk) {
+        const Cell* newKey = &newCells[table->primaryKey];
+        keyChanged = !pkKeyEqual(table, &node->cells[table->primaryKey], newKey);
+        if (keyChanged) {
+            if (findRecordByKey(table, newKey)) return 0;  // 主键冲突
+            pkErase(table, &node->cells[table->primaryKey]);
         }
     }
-
-    // 遍历链表找到目标节点
-    RecordNode* current = table->head;
-    int idx = 1;
-    while (current && idx < rowNum) {
-        current = current->next;
-        idx++;
+    // 聚簇列的值变了：先按旧值找到它在有序前缀中的行号，改完再挪到新位置
+    int cc = table->clusterColumn;
+    if (cc >= 0 && (table->columns[cc].type == 1 ? node->cells[cc].data.int_val != newCells[cc].data.int_val
+                                                 : strcmp(cellStr(&node->cells[cc]), cellStr(&newCells[cc])) != 0)) {
+        clusterRow = clusterRowOf(table, node);
     }
-    if (!current) return 0;  // 未找到目标节点
 
     // 更新单元格数据
-    freeCells(current->cells, table->numColumns);  // 释放旧数据
-    deepCopyCells(current->cells, newCells, table->numColumns);  // 拷贝新数据
+    bloomRemoveRow(table, node);  // 旧值移出布隆过滤器
+    if (keyChanged) lsmNoteDelete(table, node);  // 旧主键不再存在
+    chashNoteRemove(table, node);
+    skipNoteRemove(table, node);
+    freeCells(node->cells, table->columns, table->numColumns);  // 释放旧数据
+    deepCopyCells(node->cells, newCells, table->columns, table->numColumns);  // 拷贝新数据
+    bloomAddRow(table, node);
+    storeNoteUpdate(table, node);
+    lsmNotePut(table, node);
+    mapNoteUpdate(table, node);
+    chashNoteInsert(table, node);
+    skipNoteInsert(table, node);
+    if (keyChanged) pkInsert(table, node);
+    if (clusterRow) clusterReposition(table, clusterRow);
+    table->version++;
+    return 1;
+}
+
+/* deleteRecordByKey - 按主键删除记录
+ * 
+ * 返回值：成功返回1，没有主键或找不到返回0
+ * 
+ * 算法：单链表删除需要前驱节点，这里不回头找前驱，而是把后继节点的内容搬到当前节点，
+ *       再摘掉后继节点（后继的主键改指向当前节点）。记录顺序不变。
+ *       只有删除尾节点时才需要找前驱（走行号树）。
+ *       这样做不知道被删记录的行号，行号树无法同步，直接丢弃，下次按行号访问时重建。
+ * 
+ * 时间复杂度：O(numColumns)，删除最后一行为 O(log n)
+ */
+int deleteRecordByKey(Table* table, const Cell* key) {
+    RecordNode* node = findRecordByKey(table, key);
+    if (!node) return 0;
+    if (!node->next) return deleteRecordByRowNum(table, table->rowCount);
+    waitIndexBuilds(table);
+    
+    RecordNode* next = node->next;
+    dropRowTree(table);
+    pkErase(table, &node->cells[table->primaryKey]);
+    bloomRemoveRow(table, node);
+    lsmNoteDelete(table, node);
+    chashNoteRemove(table, node);  // 并发索引：后继的内容搬到当前节点后，它的键改指向当前节点
+    chashNoteRemove(table, next);
+    skipNoteRemove(table, node);
+    skipNoteRemove(table, next);
+    freeCells(node->cells, table->columns, table->numColumns);
+    memcpy(node->cells, next->cells, table->numColumns * sizeof(Cell));  // 字符串的所有权一起搬过来
+    node->next = next->next;
+    if (table->tail == next) table->tail = node;
+    pkRepoint(table, next, node);
+    storeNoteDelete(table, next);  // 对列存来说：后继那一行删除，当前行改成后继的内容
+    storeNoteUpdate(table, node);
+    mapNoteUnlink(table, node, next);  // 映射表文件同样：摘掉后继的槽，当前槽改成后继的内容
+    mapNoteUpdate(table, node);
+    chashNoteInsert(table, node);
+    skipNoteInsert(table, node);
+    free(next);
+    table->rowCount--;
+    if (table->clusteredRows > 0) table->clusteredRows--;  // 不知道删的是哪一行，少算一行总是安全的
+    table->version++;      // 之后的行号都变了
     return 1;
 }
 
-// 获取指定行号的记录
+/* upsertRecord - 按主键插入或更新（UPSERT）
+ * 
+ * 主键值已存在则用cells替换该记录，否则追加为新记录
+ * 返回值：1 插入，2 更新，0 失败（没有主键）
+ * 时间复杂度：O(numColumns)
+ */
+int upsertRecord(Table* table, Cell* cells) {
+    if (!table || !cells || !table->pk) return 0;
+    RecordNode* node = findRecordByKey(table, &cells[table->primaryKey]);
+    if (node) {
+        waitIndexBuilds(table);
+        return replaceRecordCells(table, node, cells) ? 2 : 0;
+    }
+    return addRecord(table, cells) ? 1 : 0;
+}
+
+// 获取指定行号的记录：行号树定位，O(log n)
 RecordNode* getRecordByRowNum(Table* table, int rowNum) {
     if (!table || rowNum < 1 || rowNum > table->rowCount) return NULL;
-    RecordNode* cur = table->head;
-    int idx = 1;
-    while (cur && idx < rowNum) {
-        cur = cur->next;
-        idx++;
-    }
-    return cur;
+    ensureRowTree(table);
+    return rowTreeGet(table->rowTree, rowNum - 1);
 }
 
 /*==================== JSON保存/加载 ====================*/
@@ -557,6 +1547,9 @@ void saveTableToJson(Table* table, const char* filename) {
         cJSON_AddItemToArray(columnsArray, col);
     }
     cJSON_AddItemToObject(root, "columns", columnsArray);//将列数组添加到根对象
+    if (table->primaryKey >= 0) {
+        cJSON_AddStringToObject(root, "primaryKey", table->columns[table->primaryKey].name);//主键列名
+    }
     
     // 保存记录数据
     cJSON* recordsArray = cJSON_CreateArray();//创建记录数组
@@ -570,7 +1563,7 @@ void saveTableToJson(Table* table, const char* filename) {
                 cJSON_AddNumberToObject(record, table->columns[i].name, current->cells[i].data.int_val);
             } 
             else {
-                cJSON_AddStringToObject(record, table->columns[i].name, current->cells[i].data.str_val);
+                cJSON_AddStringToObject(record, table->columns[i].name, cellStr(&current->cells[i]));
             }
         }
         cJSON_AddItemToArray(recordsArray, record);
@@ -586,6 +1579,11 @@ void saveTableToJson(Table* table, const char* filename) {
     if (file) {
         fprintf(file, "%s", jsonString);
         fclose(file);
+        
+        // 记下这份JSON的校验和，已建立的索引带着它写到旁边的索引文件里
+        table->checksum = checksumText(jsonString, strlen(jsonString));
+        table->checksumVersion = table->version;
+        saveIndexFile(table, filename);
     }
     //内存清理
     cJSON_Delete(root);
@@ -605,22 +1603,24 @@ Table* loadTableFromJson(const char* filename) {
     
     //读取文件内容
     char* jsonStr = (char*)malloc(size + 1);// 分配内存（+1 是为了 '\0'）
-    fread(jsonStr, 1, size, file);// 读取整个文件
-    jsonStr[size] = '\0';// 添加字符串结束符
+    size_t length = fread(jsonStr, 1, size, file);// 读取整个文件（文本模式下换行转换后可能比 size 短）
+    jsonStr[length] = '\0';// 添加字符串结束符
     fclose(file);// 关闭文件
+    unsigned long long checksum = checksumText(jsonStr, length);// 用于校验索引文件是否属于这份数据
     
     //解析列定义
-    cJSON* root = cJSON_Parse(jsonStr);// 解析 JSON 字符串为对象
+    // 整棵树分配在少数几块大内存里，cJSON_Delete(root) 时一次性释放
+    cJSON* root = cJSON_ParseWithLengthArena(jsonStr, length + 1);// 解析 JSON 字符串为对象
     free(jsonStr);// 释放字符串内存（已经解析完了）
     if (!root) return NULL; // 解析失败
     
     int numColumns = cJSON_GetObjectItemCaseSensitive(root, "numColumns")->valueint;// 获取列数
     cJSON* columnsArray = cJSON_GetObjectItemCaseSensitive(root, "columns"); // 获取列数组
     
-    //解析每一列定义
+    //解析每一列定义（沿链表遍历，宽表也是O(列数)）
     Column* columns = (Column*)malloc(numColumns * sizeof(Column));
-    for (int i = 0; i < numColumns; i++) {
-        cJSON* col = cJSON_GetArrayItem(columnsArray, i);//获取第 i 个列对象
+    cJSON* col = columnsArray ? columnsArray->child : NULL;
+    for (int i = 0; i < numColumns && col; i++, col = col->next) {
         columns[i].name = _strdup(cJSON_GetObjectItemCaseSensitive(col, "name")->valuestring);//  读取列名并复制
         columns[i].type = cJSON_GetObjectItemCaseSensitive(col, "type")->valueint;//  读取列类型
     }
@@ -631,32 +1631,211 @@ Table* loadTableFromJson(const char* filename) {
     for (int i = 0; i < numColumns; i++) free(columns[i].name);
     free(columns);
     
-    //获取记录数组和数量
+    //获取记录数组
     cJSON* recordsArray = cJSON_GetObjectItemCaseSensitive(root, "records");
-    int count = cJSON_GetArraySize(recordsArray);//有多少条记录
-    for (int i = 0; i < count; i++) {//第635行：遍历每一条记录
-        cJSON* record = cJSON_GetArrayItem(recordsArray, i);//获取第i条记录（JSON对象）
-        Cell* cells = (Cell*)malloc(numColumns * sizeof(Cell));    // 第637行：为这一行分配单元格数组内存
-       //第639行：根据列名从JSON记录中获取对应的值
-        cJSON* value = cJSON_GetObjectItemCaseSensitive(record, table->columns[j].name);
+    bloomReserve(table, cJSON_GetArraySize(recordsArray));//按行数一次分配好布隆过滤器
+    
+    //有主键的表先建好主键索引，重复主键的记录在 addRecord 中被跳过
+    cJSON* primaryKey = cJSON_GetObjectItemCaseSensitive(root, "primaryKey");
+    if (cJSON_IsString(primaryKey)) {
+        setPrimaryKey(table, findColumnIndex(table, primaryKey->valuestring));
+        pkReserve(table, cJSON_GetArraySize(recordsArray));
+    }
+
+    //按列名批量取值：记录的键顺序通常相同，缓存上一条记录中各列的位置，
+    //顺序变化时再退回哈希查找，宽表每行也只需 O(列数)
+    const char** columnNames = (const char**)malloc(numColumns * sizeof(const char*));
+    for (int j = 0; j < numColumns; j++) columnNames[j] = table->columns[j].name;
+    cJSON_MemberCache* memberCache = cJSON_CreateMemberCache(columnNames, numColumns);
+    cJSON** values = (cJSON**)malloc(numColumns * sizeof(cJSON*));
+    Cell* cells = (Cell*)malloc(numColumns * sizeof(Cell));//单元格数组在各行之间复用
+
+    //沿链表遍历记录（cJSON_GetArrayItem(i) 每次都从头数，整体会退化为 O(n²)）
+    cJSON* record = NULL;
+    cJSON_ArrayForEach(record, recordsArray) {
+        //根据列名从JSON记录中获取对应的值
+        cJSON_GetMembersCaseSensitive(memberCache, record, values);
         for (int j = 0; j < numColumns; j++) {
-            cJSON* value = cJSON_GetObjectItemCaseSensitive(record, table->columns[j].name);
-            cells[j].type = table->columns[j].type;
+            cJSON* value = values[j];
             if (table->columns[j].type == 1) {
-                cells[j].data.int_val = value->valueint;
+                cells[j].data.int_val = value ? value->valueint : 0;//缺失的列按0处理
             } else {
-                cells[j].data.str_val = _strdup(value->valuestring);
+                cellSetStr(&cells[j], value ? value->valuestring : "");
             }
         }
         addRecord(table, cells);
-        freeCells(cells, numColumns);
-        free(cells);
+        freeCells(cells, table->columns, numColumns);
     }
-    
+
+    free(cells);
+    free(values);
+    cJSON_DeleteMemberCache(memberCache);
+    free(columnNames);
     cJSON_Delete(root);
+    
+    // 表内容就是这份JSON：有匹配的索引文件就直接装入，不用重建
+    table->checksum = checksum;
+    table->checksumVersion = table->version;
+    unsigned char* registered = (unsigned char*)calloc(table->numColumns, 1);
+    loadIndexFile(table, filename, registered);
+    // 索引文件里登记过、但没能装入的列，交给后台线程重建，加载立即返回
+    startIndexBuilds(table, registered);
+    free(registered);
     return table;
 }
 
+/* mergeTableFromJson - 把另一个JSON表文件按主键合并进来（批量UPSERT）
+ * 
+ * 参数：
+ *   @table: 目标表（必须已设主键）
+ *   @filename: 要合并的JSON文件（格式同 saveTableToJson，按列名对应，列可以少、顺序可以不同）
+ *   @inserted/@updated: 返回插入、更新的记录数
+ * 
+ * 规则：
+ *   - 主键已存在：记录中出现的列覆盖原值，没出现的列保持不变
+ *   - 主键不存在：追加新记录，没出现的列为0或空串
+ *   - 没有主键值或类型不符的记录跳过
+ * 
+ * 返回值：成功返回1；没有主键、文件无法读取或解析失败返回0
+ * 时间复杂度：O(m × numColumns)，m为文件中的记录数
+ */
+int mergeTableFromJson(Table* table, const char* filename, int* inserted, int* updated) {
+    *inserted = 0;
+    *updated = 0;
+    if (!table || !table->pk) return 0;
+    
+    FILE* file = fopen(filename, "r");
+    if (!file) return 0;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* jsonStr = (char*)malloc(size + 1);
+    size_t length = fread(jsonStr, 1, size, file);
+    jsonStr[length] = '\0';
+    fclose(file);
+    cJSON* root = cJSON_ParseWithLengthArena(jsonStr, length + 1);
+    free(jsonStr);
+    if (!root) return 0;
+    
+    cJSON* recordsArray = cJSON_GetObjectItemCaseSensitive(root, "records");
+    int numColumns = table->numColumns;
+    int pkCol = table->primaryKey;
+    bloomReserve(table, table->rowCount + cJSON_GetArraySize(recordsArray));
+    pkReserve(table, table->rowCount + cJSON_GetArraySize(recordsArray));
+    
+    const char** columnNames = (const char**)malloc(numColumns * sizeof(const char*));
+    for (int j = 0; j < numColumns; j++) columnNames[j] = table->columns[j].name;
+    cJSON_MemberCache* memberCache = cJSON_CreateMemberCache(columnNames, numColumns);
+    cJSON** values = (cJSON**)malloc(numColumns * sizeof(cJSON*));
+    Cell* cells = (Cell*)malloc(numColumns * sizeof(Cell));
+    
+    cJSON* record = NULL;
+    cJSON_ArrayForEach(record, recordsArray) {
+        cJSON_GetMembersCaseSensitive(memberCache, record, values);
+        cJSON* keyValue = values[pkCol];
+        int keyIsInt = table->columns[pkCol].type == 1;
+        if (!keyValue || (keyIsInt ? !cJSON_IsNumber(keyValue) : !cJSON_IsString(keyValue))) continue;
+        
+        // 先取主键找到已有记录，没出现的列从已有记录中取
+        if (keyIsInt) cells[pkCol].data.int_val = keyValue->valueint;
+        else cellSetStr(&cells[pkCol], keyValue->valuestring);
+        RecordNode* existing = findRecordByKey(table, &cells[pkCol]);
+        for (int j = 0; j < numColumns; j++) {
+            if (j == pkCol) continue;
+            cJSON* value = values[j];
+            if (table->columns[j].type == 1) {
+                if (cJSON_IsNumber(value)) cells[j].data.int_val = value->valueint;
+                else cells[j].data.int_val = existing ? existing->cells[j].data.int_val : 0;
+            } else {
+                if (cJSON_IsString(value)) cellSetStr(&cells[j], value->valuestring);
+                else cellSetStr(&cells[j], existing ? cellStr(&existing->cells[j]) : "");
+            }
+        }
+        
+        int result = upsertRecord(table, cells);
+        if (result == 1) (*inserted)++;
+        else if (result == 2) (*updated)++;
+        freeCells(cells, table->columns, numColumns);
+    }
+    
+    free(cells);
+    free(values);
+    cJSON_DeleteMemberCache(memberCache);
+    free(columnNames);
+    cJSON_Delete(root);
+    return 1;
+}
+
+/*==================== 查询临时内存（每次请求一个bump arena） ====================*/
+/* 一次查询里用到的临时数据（Top N 的排序数组、删除时的行号数组、为本次查询建的AVL索引等）
+ * 都从这里按顺序切出来，不单独 free；请求处理完调用 queryArenaReset 一次性回收。
+ * 
+ * 好处：
+ *   - 分配只是移动指针，没有 malloc/free 的开销
+ *   - 长时间运行也不会产生堆碎片，每次请求的延迟更稳定
+ * 
+ * 注意：queryAlloc 得到的内存在下一次 queryArenaReset 之后失效，不能挂到表上长期保存
+ */
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#define QUERY_ARENA_MIN_BLOCK (64 * 1024) // 最小块大小
+#define QUERY_ARENA_ALIGN 16              // 对齐字节数
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* prev; // 上一块（链表）
+    size_t size;             // 可用字节数
+    size_t used;             // 已用字节数
+} ArenaBlock;
+
+#define ARENA_HEADER_SIZE ((sizeof(ArenaBlock) + QUERY_ARENA_ALIGN - 1) & ~(size_t)(QUERY_ARENA_ALIGN - 1))
+
+// 每个线程一个查询arena，不需要加锁
+static THREAD_LOCAL ArenaBlock* queryArena = NULL;
+
+// 从查询arena分配size字节（16字节对齐），当前块不够时按倍数开新块
+void* queryAlloc(size_t size) {
+    size = (size + QUERY_ARENA_ALIGN - 1) & ~(size_t)(QUERY_ARENA_ALIGN - 1);
+    ArenaBlock* block = queryArena;
+    if (!block || block->size - block->used < size) {
+        size_t blockSize = block ? block->size * 2 : QUERY_ARENA_MIN_BLOCK;
+        while (blockSize < size) blockSize *= 2;
+        ArenaBlock* newBlock = (ArenaBlock*)malloc(ARENA_HEADER_SIZE + blockSize);
+        if (!newBlock) return NULL;
+        newBlock->prev = block;
+        newBlock->size = blockSize;
+        newBlock->used = 0;
+        queryArena = block = newBlock;
+    }
+    void* p = (char*)block + ARENA_HEADER_SIZE + block->used;
+    block->used += size;
+    return p;
+}
+
+// 请求结束时调用：只保留最大（最新）的一块并清空，其余块释放
+void queryArenaReset(void) {
+    if (!queryArena) return;
+    ArenaBlock* block = queryArena->prev;
+    while (block) {
+        ArenaBlock* prev = block->prev;
+        free(block);
+        block = prev;
+    }
+    queryArena->prev = NULL;
+    queryArena->used = 0;
+}
+
+// 程序退出时释放全部块
+void queryArenaRelease(void) {
+    queryArenaReset();
+    free(queryArena);
+    queryArena = NULL;
+}
+
 /*==================== AVL树操作 ====================*/
 /*AVL树（Adelson-Velsky and Landis Tree）是一种自平衡二叉搜索树
  * 
@@ -811,6 +1990,7 @@ AVLNode* rotateLeft(AVLNode* x) {
  *   @node: 当前子树的根节点
  *   @key: 整数键值
  *   @record: 指向数据记录的指针
+ *   @rowNum: 记录的行号
  * 
  * 返回值：插入后子树的新根节点
  * 
@@ -832,14 +2012,15 @@ AVLNode* rotateLeft(AVLNode* x) {
  * 时间复杂度：O(log n)
  * 空间复杂度：O(log n) - 递归调用栈
  */
-AVLNode* insertAVLInt(AVLNode* node, int key, RecordNode* record) {
+AVLNode* insertAVLInt(AVLNode* node, int key, RecordNode* record, int rowNum) {
     // 基础情况：找到插入位置，创建新节点
     if (!node) {
-        AVLNode* newNode = (AVLNode*)malloc(sizeof(AVLNode));
+        AVLNode* newNode = (AVLNode*)queryAlloc(sizeof(AVLNode));//节点取自查询arena
         newNode->intKey = key;
         newNode->strKey = NULL;
         newNode->keyType = 1;           // 整数类型
         newNode->record = record;       // 指向实际数据
+        newNode->rowNum = rowNum;
         newNode->left = newNode->right = NULL;
         newNode->height = 1;            // 叶子节点高度为1
         return newNode;
@@ -848,10 +2029,10 @@ AVLNode* insertAVLInt(AVLNode* node, int key, RecordNode* record) {
     // 递归插入（二叉搜索树规则）
     if (key < node->intKey) {
         // 键值小于当前节点，插入左子树
-        node->left = insertAVLInt(node->left, key, record);
+        node->left = insertAVLInt(node->left, key, record, rowNum);
     } else if (key > node->intKey) {
         // 键值大于当前节点，插入右子树
-        node->right = insertAVLInt(node->right, key, record);
+        node->right = insertAVLInt(node->right, key, record, rowNum);
     } else {
         // 键值相等，不插入重复键
         return node;
@@ -892,15 +2073,16 @@ AVLNode* insertAVLInt(AVLNode* node, int key, RecordNode* record) {
 }
 
 // 插入AVL节点（字符串键）
-AVLNode* insertAVLStr(AVLNode* node, const char* key, RecordNode* record) {
+AVLNode* insertAVLStr(AVLNode* node, const char* key, RecordNode* record, int rowNum) {
     //递归插入
     //创建新节点
     if (!node) {
-        AVLNode* newNode = (AVLNode*)malloc(sizeof(AVLNode));
+        AVLNode* newNode = (AVLNode*)queryAlloc(sizeof(AVLNode));//节点取自查询arena
         newNode->intKey = 0; // 整数键不使用，设为0
-        newNode->strKey = _strdup(key);// 复制字符串键
+        newNode->strKey = (char*)key;// 直接指向记录里的字符串：索引只在本次查询内使用，期间记录不会改变
         newNode->keyType = 2;// 标记为字符串类型
-        newNode->record = record;// 标记为字符串类型
+        newNode->record = record;// 指向实际数据
+        newNode->rowNum = rowNum;
         newNode->left = newNode->right = NULL;// 叶子节点
         newNode->height = 1;// 初始高度为1
         return newNode;
@@ -909,9 +2091,9 @@ AVLNode* insertAVLStr(AVLNode* node, const char* key, RecordNode* record) {
     //递归查找插入位置
     int cmp = strcmp(key, node->strKey);
     if (cmp < 0) { // 插入左子树
-        node->left = insertAVLStr(node->left, key, record);
+        node->left = insertAVLStr(node->left, key, record, rowNum);
     } else if (cmp > 0) {// 插入右子树
-        node->right = insertAVLStr(node->right, key, record);
+        node->right = insertAVLStr(node->right, key, record, rowNum);
     } else {
         return node;
     }
@@ -936,17 +2118,7 @@ AVLNode* insertAVLStr(AVLNode* node, const char* key, RecordNode* record) {
     return node;
 }
 
-// 释放AVL树
-void freeAVL(AVLNode* root) {
-    if (root) {
-        freeAVL(root->left);
-        freeAVL(root->right);
-        if (root->strKey) free(root->strKey);
-        free(root);
-    }
-}
-
-// 为指定列构建AVL索引
+// 为指定列构建AVL索引（节点在查询arena中，随 queryArenaReset 一起回收，不需要单独释放）
 AVLNode* buildAVLIndex(Table* table, int colIndex) {
     //表指针不为空,列索引不能超出范围,列索引不能超出范围
     if (!table || colIndex < 0 || colIndex >= table->numColumns) return NULL;
@@ -954,17 +2126,18 @@ AVLNode* buildAVLIndex(Table* table, int colIndex) {
     //初始化
     AVLNode* root = NULL;// AVL树根节点，初始为空
     RecordNode* cur = table->head; // 从链表头开始遍历
+    int rowNum = 1;
     
     //根据列类型构建索引
     if (table->columns[colIndex].type == 1) {//整数型
         while (cur) {
             //提取该记录在 colIndex 列的整数值：cur->cells[colIndex].data.int_val
-            root = insertAVLInt(root, cur->cells[colIndex].data.int_val, cur);
+            root = insertAVLInt(root, cur->cells[colIndex].data.int_val, cur, rowNum++);
             cur = cur->next;
         }
     } else {//字符串
         while (cur) {
-            root = insertAVLStr(root, cur->cells[colIndex].data.str_val, cur);
+            root = insertAVLStr(root, cellStr(&cur->cells[colIndex]), cur, rowNum++);
             cur = cur->next;
         }
     }
@@ -974,45 +2147,111 @@ AVLNode* buildAVLIndex(Table* table, int colIndex) {
 /*==================== 检索结果管理 ====================*/
 
 
-// 创建结果集
-SearchResult* createSearchResult() {
-    SearchResult* sr = (SearchResult*)malloc(sizeof(SearchResult));//// 1. 分配容器结构体本身
-    sr->capacity = 16;
+#define RESULT_POOL_SIZE 8            // 每个线程最多缓存的结果集个数
+#define RESULT_POOL_MAX_KEEP (1 << 20) // 超过这么多行号的数组不缓存，避免长期占用大块内存
+
+// 结果池：freeSearchResult 放回，createSearchResult 取出（每个线程一份，不需要加锁）
+static THREAD_LOCAL SearchResult* resultPool[RESULT_POOL_SIZE];
+static THREAD_LOCAL int resultPoolCount = 0;
+
+/* createSearchResult - 创建结果集
+ * 
+ * 参数：
+ *   @expected: 预估结果数（由调用者按选择率估算，如Top N为n，范围查询为行数的一半）
+ * 
+ * 算法：优先从结果池中取容量最接近且不小于expected的结果集；
+ *   没有合适的就取池中最大的一个扩到expected，池空时才新分配
+ */
+SearchResult* createSearchResult(int expected) {
+    if (expected < 16) expected = 16;
+    SearchResult* sr = NULL;
+    int best = -1;
+    for (int i = 0; i < resultPoolCount; i++) {
+        if (best < 0) { best = i; continue; }
+        int cap = resultPool[i]->capacity, bestCap = resultPool[best]->capacity;
+        if (bestCap < expected ? cap > bestCap : (cap >= expected && cap < bestCap)) best = i;
+    }
+    if (best >= 0) {
+        sr = resultPool[best];
+        resultPool[best] = resultPool[--resultPoolCount];
+    } else {
+        sr = (SearchResult*)malloc(sizeof(SearchResult));
+        sr->rowNums = NULL;
+        sr->capacity = 0;
+    }
+    if (sr->capacity < expected) {
+        free(sr->rowNums);
+        sr->capacity = expected;
+        sr->rowNums = (unsigned int*)malloc(sr->capacity * sizeof(unsigned int));
+    }
     sr->count = 0;
-    //// 4. 分配内部的动态数组
-    sr->records = (RecordNode**)malloc(sr->capacity * sizeof(RecordNode*));
-    sr->rowNums = (int*)malloc(sr->capacity * sizeof(int));
-    return sr;// 返回新创建的容器指针
+    return sr;
 }
 
 //添加结果 
-void addToResultWithRowNum(SearchResult* sr, RecordNode* rec, int rowNum) {
-    if (sr->count >= sr->capacity) {//// 1. 检查容量是否足够
+void addToResult(SearchResult* sr, int rowNum) {
+    if (sr->count >= sr->capacity) {// 检查容量是否足够（预估偏小时才会走到这里）
         sr->capacity *= 2;
-        sr->records = (RecordNode**)realloc(sr->records, sr->capacity * sizeof(RecordNode*));
-        sr->rowNums = (int*)realloc(sr->rowNums, sr->capacity * sizeof(int));
+        sr->rowNums = (unsigned int*)realloc(sr->rowNums, sr->capacity * sizeof(unsigned int));
     }
-    // 4. 将新记录和行号添加到数组末尾
-    sr->records[sr->count] = rec;
-    sr->rowNums[sr->count] = rowNum;
-    // 5. 更新计数器
-    sr->count++;
+    sr->rowNums[sr->count++] = (unsigned int)rowNum;
 }
 
-// 兼容旧调用（行号设为0表示未知）提供一个更简单的接口，用于添加记录
-void addToResult(SearchResult* sr, RecordNode* rec) {
-    addToResultWithRowNum(sr, rec, 0);
+//释放结果集：放回结果池，池满或数组过大时才真正释放
+void freeSearchResult(SearchResult* sr) {
+    if (!sr) return;
+    if (resultPoolCount < RESULT_POOL_SIZE && sr->capacity <= RESULT_POOL_MAX_KEEP) {
+        resultPool[resultPoolCount++] = sr;
+        return;
+    }
+    free(sr->rowNums);
+    free(sr);
 }
 
-//释放内存
-void freeSearchResult(SearchResult* sr) {
-    if (sr) {
-        free(sr->records);
+// 清空本线程的结果池（结果池是线程局部的，工作线程退出前调用）
+void freeResultPool(void) {
+    while (resultPoolCount > 0) {
+        SearchResult* sr = resultPool[--resultPoolCount];
         free(sr->rowNums);
         free(sr);
     }
 }
 
+// 行号排序辅助：{行号, 在结果中的位置}
+typedef struct {
+    unsigned int rowNum;
+    int pos;
+} RowRef;
+
+static int cmpRowRef(const void* a, const void* b) {
+    unsigned int x = ((const RowRef*)a)->rowNum, y = ((const RowRef*)b)->rowNum;
+    return (x > y) - (x < y);
+}
+
+/* resolveResultRows - 取出结果集前count条对应的记录节点
+ * 
+ * 算法：行号排序后沿链表走一遍，out[i] 对应 sr->rowNums[i]
+ * 时间复杂度：O(count log count + 最大行号)
+ */
+void resolveResultRows(Table* table, SearchResult* sr, int count, RecordNode** out) {
+    if (count > sr->count) count = sr->count;
+    RowRef* refs = (RowRef*)queryAlloc((count > 0 ? count : 1) * sizeof(RowRef));
+    for (int i = 0; i < count; i++) {
+        refs[i].rowNum = sr->rowNums[i];
+        refs[i].pos = i;
+    }
+    qsort(refs, count, sizeof(RowRef), cmpRowRef);
+    RecordNode* cur = table->head;
+    unsigned int rowNum = 1;
+    for (int i = 0; i < count; i++) {
+        while (cur && rowNum < refs[i].rowNum) {
+            cur = cur->next;
+            rowNum++;
+        }
+        out[refs[i].pos] = (refs[i].rowNum >= 1) ? cur : NULL;
+    }
+}
+
 /*==================== 检索函数 ====================*/
 //—————————————————————————————————最大最小查找————————————————————————————————————
 
@@ -1118,7 +2357,6 @@ AVLNode* avlFindMin(AVLNode* root) {
  * 用于Top N查找时临时存储记录信息
  */
 typedef struct {
-    RecordNode* record;  // 记录指针
     int rowNum;          // 行号
     int value;           // 排序依据的值
 } SortItem;
@@ -1167,26 +2405,25 @@ static int cmpAscending(const void* a, const void* b) {
  *   - 取值：O(N)
  *   总计：O(n log n)
  * 
- * 空间复杂度：O(n) - 临时数组
+ * 空间复杂度：O(n) - 临时数组（取自查询arena，请求结束统一回收）
  * 
  * 应用场景：找分数最高的前10名学生、薪资最高的前20名员工
  */
 SearchResult* linearFindTopN(Table* table, int colIndex, int n) {
     // 参数校验
     if (!table || !table->head || table->columns[colIndex].type != 1 || n <= 0) {
-        return createSearchResult();
+        return createSearchResult(0);
     }
     
     // 收集所有记录到临时数组
     int total = table->rowCount;
-    SortItem* items = (SortItem*)malloc(total * sizeof(SortItem));
+    SortItem* items = (SortItem*)queryAlloc(total * sizeof(SortItem));//临时数组取自查询arena
     RecordNode* cur = table->head;
     int idx = 0;//  临时数组的索引，从0开始
     int rowNum = 1;//当前遍历的行号，从1开始
     
     // 遍历链表，填充数组
     while (cur) {
-        items[idx].record = cur;// 将当前记录节点的指针存入数组
         items[idx].rowNum = rowNum;// 将当前行号存入数组
         items[idx].value = cur->cells[colIndex].data.int_val;  // 提取排序键
         idx++;
@@ -1198,30 +2435,28 @@ SearchResult* linearFindTopN(Table* table, int colIndex, int n) {
     qsort(items, total, sizeof(SortItem), cmpDescending);
     
     // 取前n个（如果总数不足n，则取全部）
-    SearchResult* sr = createSearchResult();
-    int count = (n < total) ? n : total;// 计算实际要取的记录数（不能超过总数）
+    int count = (n < total) ? n : total;
+    SearchResult* sr = createSearchResult(count);// 计算实际要取的记录数（不能超过总数）
     for (int i = 0; i < count; i++) {
-        addToResultWithRowNum(sr, items[i].record, items[i].rowNum);
+        addToResult(sr, items[i].rowNum);
     }
     
-    free(items);  // 释放临时数组
     return sr;
 }
 
 // 线性遍历：查找最小的前n项
 SearchResult* linearFindBottomN(Table* table, int colIndex, int n) {
     if (!table || !table->head || table->columns[colIndex].type != 1 || n <= 0) {
-        return createSearchResult();
+        return createSearchResult(0);
     }
     
     // 收集所有记录
     int total = table->rowCount;
-    SortItem* items = (SortItem*)malloc(total * sizeof(SortItem));
+    SortItem* items = (SortItem*)queryAlloc(total * sizeof(SortItem));//临时数组取自查询arena
     RecordNode* cur = table->head;
     int idx = 0;
     int rowNum = 1;
     while (cur) {
-        items[idx].record = cur;
         items[idx].rowNum = rowNum;
         items[idx].value = cur->cells[colIndex].data.int_val;
         idx++;
@@ -1233,13 +2468,12 @@ SearchResult* linearFindBottomN(Table* table, int colIndex, int n) {
     qsort(items, total, sizeof(SortItem), cmpAscending);
     
     // 取前n个
-    SearchResult* sr = createSearchResult();
     int count = (n < total) ? n : total;
+    SearchResult* sr = createSearchResult(count);
     for (int i = 0; i < count; i++) {
-        addToResultWithRowNum(sr, items[i].record, items[i].rowNum);
+        addToResult(sr, items[i].rowNum);
     }
     
-    free(items);
     return sr;
 }
 
@@ -1249,7 +2483,7 @@ static void avlCollectTopN(AVLNode* node, SearchResult* sr, int n, int* collecte
     //优先访问右子树
     avlCollectTopN(node->right, sr, n, collected);
     if (*collected < n) {
-        addToResult(sr, node->record);  // AVL遍历时行号未知，设为0
+        addToResult(sr, node->rowNum);
         (*collected)++;
     }
     avlCollectTopN(node->left, sr, n, collected);
@@ -1257,7 +2491,7 @@ static void avlCollectTopN(AVLNode* node, SearchResult* sr, int n, int* collecte
 
 //AVL树 Top N 查找的入口函数
 SearchResult* avlFindTopN(AVLNode* root, int n) {
-    SearchResult* sr = createSearchResult();
+    SearchResult* sr = createSearchResult(n);
     int collected = 0;
     avlCollectTopN(root, sr, n, &collected);//启动核心的 Top N 收集过程
     return sr;
@@ -1268,14 +2502,14 @@ static void avlCollectBottomN(AVLNode* node, SearchResult* sr, int n, int* colle
     if (!node || *collected >= n) return;
     avlCollectBottomN(node->left, sr, n, collected);
     if (*collected < n) {
-        addToResult(sr, node->record);
+        addToResult(sr, node->rowNum);
         (*collected)++;
     }
     avlCollectBottomN(node->right, sr, n, collected);
 }
 
 SearchResult* avlFindBottomN(AVLNode* root, int n) {
-    SearchResult* sr = createSearchResult();
+    SearchResult* sr = createSearchResult(n);
     int collected = 0;
     avlCollectBottomN(root, sr, n, &collected);
     return sr;
@@ -1283,12 +2517,13 @@ SearchResult* avlFindBottomN(AVLNode* root, int n) {
 
 // 线性遍历：等值查找（整数）- 带行号
 SearchResult* linearFindEqual(Table* table, int colIndex, int value) {
-    SearchResult* sr = createSearchResult();
+    SearchResult* sr = createSearchResult(table->rowCount / 64);//等值查询按约1/64的选择率预估
+    if (table->columns[colIndex].type != 1) return sr;//类型只在列上检查一次
     RecordNode* cur = table->head;
     int rowNum = 1;
     while (cur) {
-        if (cur->cells[colIndex].type == 1 && cur->cells[colIndex].data.int_val == value) {
-            addToResultWithRowNum(sr, cur, rowNum);
+        if (cur->cells[colIndex].data.int_val == value) {
+            addToResult(sr, rowNum);
         }
         cur = cur->next;
         rowNum++;
@@ -1298,12 +2533,13 @@ SearchResult* linearFindEqual(Table* table, int colIndex, int value) {
 
 // 线性遍历：大于等于 - 带行号
 SearchResult* linearFindGE(Table* table, int colIndex, int value) {
-    SearchResult* sr = createSearchResult();
+    SearchResult* sr = createSearchResult(table->rowCount / 2);//范围查询按一半预估
+    if (table->columns[colIndex].type != 1) return sr;//类型只在列上检查一次
     RecordNode* cur = table->head;
     int rowNum = 1;
     while (cur) {
-        if (cur->cells[colIndex].type == 1 && cur->cells[colIndex].data.int_val >= value) {
-            addToResultWithRowNum(sr, cur, rowNum);
+        if (cur->cells[colIndex].data.int_val >= value) {
+            addToResult(sr, rowNum);
         }
         cur = cur->next;
         rowNum++;
@@ -1313,12 +2549,30 @@ SearchResult* linearFindGE(Table* table, int colIndex, int value) {
 
 // 线性遍历：小于等于 - 带行号
 SearchResult* linearFindLE(Table* table, int colIndex, int value) {
-    SearchResult* sr = createSearchResult();
+    SearchResult* sr = createSearchResult(table->rowCount / 2);
+    if (table->columns[colIndex].type != 1) return sr;//类型只在列上检查一次
+    RecordNode* cur = table->head;
+    int rowNum = 1;
+    while (cur) {
+        if (cur->cells[colIndex].data.int_val <= value) {
+            addToResult(sr, rowNum);
+        }
+        cur = cur->next;
+        rowNum++;
+    }
+    return sr;
+}
+
+// 线性遍历：区间 [low, high] - 带行号
+SearchResult* linearFindBetween(Table* table, int colIndex, int low, int high) {
+    SearchResult* sr = createSearchResult(table->rowCount / 4);//区间查询按1/4预估
+    if (table->columns[colIndex].type != 1) return sr;
     RecordNode* cur = table->head;
     int rowNum = 1;
     while (cur) {
-        if (cur->cells[colIndex].type == 1 && cur->cells[colIndex].data.int_val <= value) {
-            addToResultWithRowNum(sr, cur, rowNum);
+        int v = cur->cells[colIndex].data.int_val;
+        if (v >= low && v <= high) {
+            addToResult(sr, rowNum);
         }
         cur = cur->next;
         rowNum++;
@@ -1345,18 +2599,16 @@ SearchResult* linearFindLE(Table* table, int colIndex, int value) {
  * 应用场景：模糊搜索，如查找姓名包含"李"的所有学生
  */
 SearchResult* linearFindContains(Table* table, int colIndex, const char* substr) {
-    SearchResult* sr = createSearchResult();
+    SearchResult* sr = createSearchResult(table->rowCount / 8);//子串匹配按约1/8预估
+    if (table->columns[colIndex].type != 2) return sr;//类型只在列上检查一次
     RecordNode* cur = table->head;
     int rowNum = 1;
     
     // 遍历链表
     while (cur) {
-        // 检查类型和指针有效性
-        if (cur->cells[colIndex].type == 2 && cur->cells[colIndex].data.str_val) {
-            // strstr: 查找子串，找到返回位置指针，未找到返回NULL
-            if (strstr(cur->cells[colIndex].data.str_val, substr)) {
-                addToResultWithRowNum(sr, cur, rowNum);
-            }
+        // strstr: 查找子串，找到返回位置指针，未找到返回NULL
+        if (strstr(cellStr(&cur->cells[colIndex]), substr)) {
+            addToResult(sr, rowNum);
         }
         cur = cur->next;  // 移动到下一个节点
         rowNum++;
@@ -1374,9 +2626,10 @@ SearchResult* linearFindContains(Table* table, int colIndex, const char* substr)
  * 返回值：包含所有匹配记录的SearchResult
  * 
  * 算法：
- *   遍历链表，使用strcmp检查每个字符串是否完全相等
+ *   1. 先查该列的布隆过滤器，一定不存在时直接返回空结果
+ *   2. 否则遍历链表，使用strcmp检查每个字符串是否完全相等
  * 
- * 时间复杂度：O(n * m)
+ * 时间复杂度：O(n * m)；值不存在时（约99%的情况被过滤器拦下）为O(m)
  *   - n: 记录数
  *   - m: 字符串平均长度（strcmp的复杂度）
  * 
@@ -1385,18 +2638,18 @@ SearchResult* linearFindContains(Table* table, int colIndex, const char* substr)
  *   - Contains: "张三" 可以匹配 "张三丰"、"小张三"等
  */
 SearchResult* linearFindStrEqual(Table* table, int colIndex, const char* value) {
-    SearchResult* sr = createSearchResult();
+    if (table->columns[colIndex].type != 2 || !bloomMayContain(table, colIndex, value)) {
+        return createSearchResult(0);//类型不对，或布隆过滤器判定一定不存在
+    }
+    SearchResult* sr = createSearchResult(table->rowCount / 64);
     RecordNode* cur = table->head;
     int rowNum = 1;
     
     // 遍历链表
     while (cur) {
-        // 检查类型和指针有效性
-        if (cur->cells[colIndex].type == 2 && cur->cells[colIndex].data.str_val) {
-            // strcmp: 字符串比较，相等返回0
-            if (strcmp(cur->cells[colIndex].data.str_val, value) == 0) {
-                addToResultWithRowNum(sr, cur, rowNum);
-            }
+        // strcmp: 字符串比较，相等返回0（短字符串就在节点内，不用再跟指针）
+        if (strcmp(cellStr(&cur->cells[colIndex]), value) == 0) {
+            addToResult(sr, rowNum);
         }
         cur = cur->next;
         rowNum++;
@@ -1432,7 +2685,7 @@ void avlFindGEHelper(AVLNode* node, int value, SearchResult* sr) {
     if (node->intKey >= value) {
         // 当前节点 >= value，左子树可能有满足条件的
         avlFindGEHelper(node->left, value, sr);  // 递归左子树
-        addToResult(sr, node->record);           // 加入当前节点
+        addToResult(sr, node->rowNum);           // 加入当前节点
         avlFindGEHelper(node->right, value, sr); // 递归右子树
     } else {
         // 当前节点 < value，左子树肯定全部 < value（剪枝）
@@ -1451,7 +2704,7 @@ void avlFindGEHelper(AVLNode* node, int value, SearchResult* sr) {
  * 时间复杂度：O(log n + k)，优于线性查找的O(n)
  */
 SearchResult* avlFindGE(AVLNode* root, int value) {
-    SearchResult* sr = createSearchResult();
+    SearchResult* sr = createSearchResult(0);//树不知道总行数，靠结果池里上次的容量
     avlFindGEHelper(root, value, sr);
     return sr;
 }
@@ -1461,7 +2714,7 @@ void avlFindLEHelper(AVLNode* node, int value, SearchResult* sr) {
     if (!node) return;
     if (node->intKey <= value) {
         avlFindLEHelper(node->left, value, sr);
-        addToResult(sr, node->record);
+        addToResult(sr, node->rowNum);
         avlFindLEHelper(node->right, value, sr);
     } else {
         avlFindLEHelper(node->left, value, sr);
@@ -1470,7 +2723,7 @@ void avlFindLEHelper(AVLNode* node, int value, SearchResult* sr) {
 
 ///*avlFindGE - AVL树范围查找接口（<=）
 SearchResult* avlFindLE(AVLNode* root, int value) {
-    SearchResult* sr = createSearchResult();
+    SearchResult* sr = createSearchResult(0);
     avlFindLEHelper(root, value, sr);
     return sr;
 }
@@ -1485,75 +2738,6079 @@ AVLNode* avlFindEqual(AVLNode* root, int value) {
     return NULL;
 }
 
-/*==================== 工具函数 ====================*/
+/*==================== 自适应索引（数据库裂解） ====================*/
+/* Database Cracking：不预先建索引，而是在查询时顺手整理数据
+ * 
+ * 裂解列（CrackerColumn）是某个整数列的副本（值 + 行号）。每次范围查询都以查询的
+ * 边界为枢轴，只把边界所在的那一段按"小于枢轴 / 不小于枢轴"原地划分（类似快排的一趟），
+ * 并记下枢轴值和分界位置。分界越来越多，每段越来越短，查询就自动越来越快：
+ *   - 第一次查询：O(n)，和线性扫描差不多，没有额外的建索引开销
+ *   - 之后：O(log p + 段长)，p为已记录的枢轴数
+ * 
+ * 枢轴按值有序保存在数组里，二分查找（枢轴数量等于不同边界值的个数，很小）
+ * 不变式：对每个枢轴(value, pos)，位置 < pos 的值都 < value，位置 >= pos 的值都 >= value
+ * 
+ * 表被修改后（version变化）行号会变，裂解列整体丢弃，下次查询时重新复制
+ */
 
-// 控制台输入转 UTF-8（用于处理 Windows 控制台输入）
-// Windows PowerShell/cmd 实际上使用系统代码页 (通常是 GBK/936)，即使设置了 65001
-static void consoleInputToUtf8(char* dest, const char* src, int destSize) {
-    // 检查是否有非 ASCII 字符
-    int hasNonAscii = 0;
-    const unsigned char* p = (const unsigned char*)src;
-    while (*p) {
-        if (*p >= 0x80) {
-            hasNonAscii = 1;
-            break;
-        }
-        p++;
-    }
-    
-    // 如果是纯 ASCII，直接复制
-    if (!hasNonAscii) {
-        strncpy(dest, src, destSize - 1);
-        dest[destSize - 1] = '\0';
-        return;
+typedef struct {
+    int value;  // 枢轴值
+    int pos;    // 分界位置
+} CrackPivot;
+
+typedef struct CrackerColumn {
+    int* values;              // 列值副本（会被不断重排）
+    unsigned int* rowNums;    // 与values一一对应的行号
+    int count;                // 元素个数（= 建立时的行数）
+    CrackPivot* pivots;       // 按value升序的枢轴数组
+    int pivotCount;
+    int pivotCapacity;
+    unsigned int version;     // 建立时表的version
+} CrackerColumn;
+
+static void freeCracker(CrackerColumn* cc) {
+    if (!cc) return;
+    free(cc->values);
+    free(cc->rowNums);
+    free(cc->pivots);
+    free(cc);
+}
+
+static void freeCrackers(Table* table) {
+    if (!table->crackers) return;
+    for (int i = 0; i < table->numColumns; i++) freeCracker(table->crackers[i]);
+    free(table->crackers);
+    table->crackers = NULL;
+}
+
+// 取得列的裂解列：不存在或已过期时从链表复制一份（只复制，不排序）
+static CrackerColumn* getCracker(Table* table, int colIndex) {
+    if (!table->crackers) {
+        table->crackers = (CrackerColumn**)calloc(table->numColumns, sizeof(CrackerColumn*));
     }
+    CrackerColumn* cc = table->crackers[colIndex];
+    if (cc && cc->version == table->version) return cc;
+    freeCracker(cc);
     
-    // 对于非 ASCII 输入，强制使用系统代码页 (CP_ACP，通常是 GBK/936) 进行转换
-    // 因为 Windows 传统控制台不真正支持 UTF-8 输入
+    cc = (CrackerColumn*)malloc(sizeof(CrackerColumn));
+    cc->count = table->rowCount;
+    cc->values = (int*)malloc((cc->count > 0 ? cc->count : 1) * sizeof(int));
+    cc->rowNums = (unsigned int*)malloc((cc->count > 0 ? cc->count : 1) * sizeof(unsigned int));
+    cc->pivotCapacity = 16;
+    cc->pivots = (CrackPivot*)malloc(cc->pivotCapacity * sizeof(CrackPivot));
+    cc->pivotCount = 0;
+    cc->version = table->version;
     
-    // 步骤1: 系统代码页 (GBK) -> Unicode (wchar_t)
-    int wlen = MultiByteToWideChar(CP_ACP, 0, src, -1, NULL, 0);
-    if (wlen <= 0) {
-        strncpy(dest, src, destSize - 1);
-        dest[destSize - 1] = '\0';
-        return;
+    RecordNode* cur = table->head;
+    for (int i = 0; i < cc->count && cur; i++, cur = cur->next) {
+        cc->values[i] = cur->cells[colIndex].data.int_val;
+        cc->rowNums[i] = (unsigned int)(i + 1);
     }
-    
-    wchar_t* wbuf = (wchar_t*)malloc(wlen * sizeof(wchar_t));
-    if (!wbuf) {
-        strncpy(dest, src, destSize - 1);
-        dest[destSize - 1] = '\0';
-        return;
+    table->crackers[colIndex] = cc;
+    return cc;
+}
+
+/* crackAt - 以value为枢轴裂解，返回分界位置p（[0,p) < value <= [p,count)）
+ * 
+ * 算法：
+ *   1. 二分查找枢轴数组：已有相同枢轴直接返回其位置
+ *   2. 否则value落在前后两个枢轴之间的一段 [lo, hi)，只对这一段做一趟划分
+ *   3. 把新枢轴插入有序数组
+ * 
+ * 时间复杂度：O(log p + 段长)
+ */
+static int crackAt(CrackerColumn* cc, int value) {
+    // 二分：找第一个枢轴值 >= value 的下标
+    int left = 0, right = cc->pivotCount;
+    while (left < right) {
+        int mid = (left + right) / 2;
+        if (cc->pivots[mid].value < value) left = mid + 1;
+        else right = mid;
     }
+    if (left < cc->pivotCount && cc->pivots[left].value == value) return cc->pivots[left].pos;
     
-    MultiByteToWideChar(CP_ACP, 0, src, -1, wbuf, wlen);
+    int lo = left > 0 ? cc->pivots[left - 1].pos : 0;
+    int hi = left < cc->pivotCount ? cc->pivots[left].pos : cc->count;
     
-    // 步骤2: Unicode -> UTF-8
-    int utf8len = WideCharToMultiByte(CP_UTF8, 0, wbuf, -1, NULL, 0, NULL, NULL);
-    if (utf8len <= 0 || utf8len > destSize) {
-        free(wbuf);
-        strncpy(dest, src, destSize - 1);
-        dest[destSize - 1] = '\0';
-        return;
+    // 双指针原地划分：左边放 < value，右边放 >= value
+    int i = lo, j = hi - 1;
+    while (i <= j) {
+        while (i <= j && cc->values[i] < value) i++;
+        while (i <= j && cc->values[j] >= value) j--;
+        if (i < j) {
+            int v = cc->values[i]; cc->values[i] = cc->values[j]; cc->values[j] = v;
+            unsigned int r = cc->rowNums[i]; cc->rowNums[i] = cc->rowNums[j]; cc->rowNums[j] = r;
+            i++;
+            j--;
+        }
     }
     
-    WideCharToMultiByte(CP_UTF8, 0, wbuf, -1, dest, destSize, NULL, NULL);
-    free(wbuf);
+    // 记录新枢轴
+    if (cc->pivotCount >= cc->pivotCapacity) {
+        cc->pivotCapacity *= 2;
+        cc->pivots = (CrackPivot*)realloc(cc->pivots, cc->pivotCapacity * sizeof(CrackPivot));
+    }
+    memmove(&cc->pivots[left + 1], &cc->pivots[left], (cc->pivotCount - left) * sizeof(CrackPivot));
+    cc->pivots[left].value = value;
+    cc->pivots[left].pos = i;
+    cc->pivotCount++;
+    return i;
 }
 
-static void readLine(char* buf, int size) {
-    fflush(stdout);
-    char tempBuf[512];
-    if (fgets(tempBuf, sizeof(tempBuf), stdin)) {
-        size_t len = strlen(tempBuf);
-        if (len > 0 && tempBuf[len - 1] == '\n') tempBuf[len - 1] = '\0';
-        len = strlen(tempBuf);
-        if (len > 0 && tempBuf[len - 1] == '\r') tempBuf[len - 1] = '\0';
-        
-        // 将可能的 GBK 输入转换为 UTF-8
-        consoleInputToUtf8(buf, tempBuf, size);
-    } else if (size > 0) {
-        buf[0] = '\0';
+/* crackFindRange - 裂解方式查找 low <= 值 <= high 的记录
+ * 
+ * 参数：
+ *   @table: 数据表
+ *   @colIndex: 列索引（必须是整数列）
+ *   @low/@high: 闭区间边界
+ * 
+ * 返回值：SearchResult（行号不保证有序）
+ * 
+ * 算法：分别以low和high+1裂解，两个分界之间就是结果
+ */
+SearchResult* crackFindRange(Table* table, int colIndex, int low, int high) {
+    if (!table || colIndex < 0 || colIndex >= table->numColumns || table->columns[colIndex].type != 1 || low > high) {
+        return createSearchResult(0);
+    }
+    CrackerColumn* cc = getCracker(table, colIndex);
+    int from = (low == INT_MIN) ? 0 : crackAt(cc, low);
+    int to = (high == INT_MAX) ? cc->count : crackAt(cc, high + 1);
+    SearchResult* sr = createSearchResult(to - from);
+    for (int i = from; i < to; i++) {
+        addToResult(sr, cc->rowNums[i]);
+    }
+    return sr;
+}
+
+// 裂解：等值查找
+SearchResult* crackFindEqual(Table* table, int colIndex, int value) {
+    return crackFindRange(table, colIndex, value, value);
+}
+
+// 裂解：大于等于
+SearchResult* crackFindGE(Table* table, int colIndex, int value) {
+    return crackFindRange(table, colIndex, value, INT_MAX);
+}
+
+// 裂解：小于等于
+SearchResult* crackFindLE(Table* table, int colIndex, int value) {
+    return crackFindRange(table, colIndex, INT_MIN, value);
+}
+
+/*==================== 持久化索引 ====================*/
+/* 有序索引（ColumnIndex）：按键排序的 (键, 行号) 数组，二分查找，作用与AVL索引相同，
+ * 但全部是连续数组，没有指针，可以原样写到磁盘、原样读回（文件布局 = 内存布局，也可以直接映射）。
+ * 
+ * 索引文件：与表文件同名加 ".idx"，保存表时写出，加载表时校验后直接装入，热启动不用重建索引。
+ * 
+ * 文件格式（本机字节序）：
+ *   IndexFileHeader
+ *   重复 indexCount 次：
+ *     IndexSectionHeader（列号、类型、条目数、字符串池大小）
+ *     条目数为 INDEX_SECTION_STALE 时只登记了这一列有索引，后面没有数据（保存时索引已过期，加载后在后台重建）
+ *     unsigned int rowNums[count]   行号
+ *     int keys[count]               整数列为键值；字符串列为键在字符串池中的偏移
+ *     char pool[poolSize]           字符串池（仅字符串列，相同字符串只存一份）
+ * 
+ * 校验：文件头记录JSON文本的校验和、行数、列数，任何一项与刚加载的表不符就忽略整个文件；
+ *   每个索引段还会检查行号和偏移是否越界。内存中的索引记录建立时的表version，表被修改后自动重建。
+ */
+
+#define INDEX_FILE_MAGIC "TIDX"
+#define INDEX_FILE_FORMAT 2
+#define INDEX_SECTION_STALE (-1)       // 只登记、不带数据的索引段的条目数
+
+typedef struct {
+    char magic[4];                 // "TIDX"
+    unsigned int format;           // 文件格式版本
+    unsigned long long checksum;   // 表JSON文本的校验和
+    int rowCount;                  // 表行数
+    int numColumns;                // 表列数
+    int indexCount;                // 索引段个数
+    int reserved;
+} IndexFileHeader;
+
+typedef struct {
+    int colIndex;                  // 列号
+    int type;                      // 列类型（1=int, 2=string）
+    int count;                     // 条目数（= 行数）
+    unsigned int poolSize;         // 字符串池字节数（整数列为0）
+} IndexSectionHeader;
+
+typedef struct ColumnIndex {
+    IndexSectionHeader info;
+    unsigned int* rowNums;         // 按键排序后的行号
+    int* keys;                     // 键（或字符串偏移）
+    char* pool;                    // 字符串池
+    unsigned int version;          // 建立/装入时表的version
+    void* block;                   // rowNums、keys、pool 共用的一块内存
+} ColumnIndex;
+
+// 校验和：FNV-1a，每次处理8个字节
+static unsigned long long checksumText(const char* text, size_t length) {
+    unsigned long long h = 14695981039346656037ULL;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        unsigned long long w;
+        memcpy(&w, text + i, 8);
+        h = (h ^ w) * 1099511628211ULL;
+    }
+    for (; i < length; i++) {
+        h = (h ^ (unsigned char)text[i]) * 1099511628211ULL;
+    }
+    return h ^ length;
+}
+
+static size_t indexBlockSize(const IndexSectionHeader* info) {
+    return (size_t)info->count * (sizeof(unsigned int) + sizeof(int)) + info->poolSize;
+}
+
+// 按段头分配一块内存并设置好三个数组指针
+static ColumnIndex* allocColumnIndex(const IndexSectionHeader* info) {
+    ColumnIndex* ix = (ColumnIndex*)malloc(sizeof(ColumnIndex));
+    ix->info = *info;
+    ix->block = malloc(indexBlockSize(info) + 1);
+    ix->rowNums = (unsigned int*)ix->block;
+    ix->keys = (int*)(ix->rowNums + info->count);
+    ix->pool = (char*)(ix->keys + info->count);
+    return ix;
+}
+
+static void freeColumnIndex(ColumnIndex* ix) {
+    if (!ix) return;
+    free(ix->block);
+    free(ix);
+}
+
+static void freeColumnIndexes(Table* table) {
+    if (!table->indexes) return;
+    for (int i = 0; i < table->numColumns; i++) freeColumnIndex(table->indexes[i]);
+    free(table->indexes);
+    table->indexes = NULL;
+}
+
+// 排序辅助
+typedef struct {
+    int key;
+    unsigned int rowNum;
+} IntKeyRow;
+
+typedef struct {
+    const char* key;
+    unsigned int rowNum;
+} StrKeyRow;
+
+static int cmpIntKeyRow(const void* a, const void* b) {
+    const IntKeyRow* x = (const IntKeyRow*)a;
+    const IntKeyRow* y = (const IntKeyRow*)b;
+    if (x->key != y->key) return (x->key > y->key) - (x->key < y->key);
+    return (x->rowNum > y->rowNum) - (x->rowNum < y->rowNum);
+}
+
+static int cmpStrKeyRow(const void* a, const void* b) {
+    const StrKeyRow* x = (const StrKeyRow*)a;
+    const StrKeyRow* y = (const StrKeyRow*)b;
+    int c = strcmp(x->key, y->key);
+    if (c != 0) return c;
+    return (x->rowNum > y->rowNum) - (x->rowNum < y->rowNum);
+}
+
+#define INDEX_PROGRESS_STEP 4096   // 每处理这么多行报告一次进度
+
+// 从表中建立某列的有序索引：O(n log n)
+// @progress: 若不为NULL，随时写入已收集的行数（后台建索引时给统计命令看）
+static ColumnIndex* buildColumnIndex(Table* table, int colIndex, volatile LONG* progress) {
+    IndexSectionHeader info;
+    info.colIndex = colIndex;
+    info.type = table->columns[colIndex].type;
+    info.count = table->rowCount;
+    info.poolSize = 0;
+    ColumnIndex* ix = NULL;
+    
+    if (info.type == 1) {
+        IntKeyRow* pairs = (IntKeyRow*)queryAlloc((info.count > 0 ? info.count : 1) * sizeof(IntKeyRow));
+        int i = 0;
+        for (RecordNode* cur = table->head; cur; cur = cur->next, i++) {
+            pairs[i].key = cur->cells[colIndex].data.int_val;
+            pairs[i].rowNum = (unsigned int)(i + 1);
+            if (progress && (i & (INDEX_PROGRESS_STEP - 1)) == 0) InterlockedExchange(progress, i);
+        }
+        if (progress) InterlockedExchange(progress, info.count);
+        qsort(pairs, info.count, sizeof(IntKeyRow), cmpIntKeyRow);
+        ix = allocColumnIndex(&info);
+        for (i = 0; i < info.count; i++) {
+            ix->keys[i] = pairs[i].key;
+            ix->rowNums[i] = pairs[i].rowNum;
+        }
+    } else {
+        StrKeyRow* pairs = (StrKeyRow*)queryAlloc((info.count > 0 ? info.count : 1) * sizeof(StrKeyRow));
+        int i = 0;
+        for (RecordNode* cur = table->head; cur; cur = cur->next, i++) {
+            pairs[i].key = cellStr(&cur->cells[colIndex]);
+            pairs[i].rowNum = (unsigned int)(i + 1);
+            if (progress && (i & (INDEX_PROGRESS_STEP - 1)) == 0) InterlockedExchange(progress, i);
+        }
+        if (progress) InterlockedExchange(progress, info.count);
+        qsort(pairs, info.count, sizeof(StrKeyRow), cmpStrKeyRow);
+        // 相同的字符串排在一起，只存一份
+        for (i = 0; i < info.count; i++) {
+            if (i == 0 || strcmp(pairs[i].key, pairs[i - 1].key) != 0) info.poolSize += (unsigned int)strlen(pairs[i].key) + 1;
+        }
+        ix = allocColumnIndex(&info);
+        unsigned int offset = 0;
+        for (i = 0; i < info.count; i++) {
+            if (i == 0 || strcmp(pairs[i].key, pairs[i - 1].key) != 0) {
+                size_t len = strlen(pairs[i].key) + 1;
+                memcpy(ix->pool + offset, pairs[i].key, len);
+                ix->keys[i] = (int)offset;
+                offset += (unsigned int)len;
+            } else {
+                ix->keys[i] = ix->keys[i - 1];
+            }
+            ix->rowNums[i] = pairs[i].rowNum;
+        }
+    }
+    ix->version = table->version;
+    return ix;
+}
+
+/* getColumnIndex - 取得某列的有序索引
+ * 
+ * 已有且表没被修改过（version相同）直接返回，否则重新建立。
+ * 该列正在后台建立时等它完成（不想等的查询用 readyColumnIndex）。
+ * @built: 若不为NULL，返回本次是否新建了索引
+ */
+ColumnIndex* getColumnIndex(Table* table, int colIndex, int* built) {
+    if (built) *built = 0;
+    if (table->builds && table->builds[colIndex]) waitIndexBuilds(table);
+    if (!table->indexes) {
+        table->indexes = (ColumnIndex**)calloc(table->numColumns, sizeof(ColumnIndex*));
+    }
+    ColumnIndex* ix = table->indexes[colIndex];
+    if (ix && ix->version == table->version) return ix;
+    freeColumnIndex(ix);
+    ix = buildColumnIndex(table, colIndex, NULL);
+    table->indexes[colIndex] = ix;
+    if (built) *built = 1;
+    return ix;
+}
+
+// 第一个键 >= value 的位置
+static int indexLowerBound(const ColumnIndex* ix, int value) {
+    int lo = 0, hi = ix->info.count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (ix->keys[mid] < value) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// 第一个键 > value 的位置
+static int indexUpperBound(const ColumnIndex* ix, int value) {
+    int lo = 0, hi = ix->info.count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (ix->keys[mid] <= value) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* indexFindRange - 用有序索引查找 low <= 值 <= high 的记录（整数列）
+ * 时间复杂度：O(log n + k)，结果按值有序
+ */
+SearchResult* indexFindRange(Table* table, int colIndex, int low, int high) {
+    if (table->columns[colIndex].type != 1 || low > high) return createSearchResult(0);
+    ColumnIndex* ix = getColumnIndex(table, colIndex, NULL);
+    int from = indexLowerBound(ix, low);
+    int to = indexUpperBound(ix, high);
+    SearchResult* sr = createSearchResult(to - from);
+    for (int i = from; i < to; i++) addToResult(sr, ix->rowNums[i]);
+    return sr;
+}
+
+/* indexFindStrEqual - 用有序索引查找字符串相等的记录
+ * 时间复杂度：O(m log n + k)
+ */
+SearchResult* indexFindStrEqual(Table* table, int colIndex, const char* value) {
+    if (table->columns[colIndex].type != 2) return createSearchResult(0);
+    ColumnIndex* ix = getColumnIndex(table, colIndex, NULL);
+    int lo = 0, hi = ix->info.count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strcmp(ix->pool + ix->keys[mid], value) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    SearchResult* sr = createSearchResult(16);
+    for (int i = lo; i < ix->info.count && strcmp(ix->pool + ix->keys[i], value) == 0; i++) {
+        addToResult(sr, ix->rowNums[i]);
+    }
+    return sr;
+}
+
+// 索引文件名：表文件名 + ".idx"
+static void indexFileName(char* out, size_t size, const char* tableFilename) {
+    snprintf(out, size, "%s.idx", tableFilename);
+}
+
+/* saveIndexFile - 把当前有效的索引写入索引文件
+ * 表内容必须与 table->checksum 对应（刚保存或刚加载），没有可写的索引时删除旧索引文件
+ */
+static void saveIndexFile(Table* table, const char* tableFilename) {
+    char path[512];
+    indexFileName(path, sizeof(path), tableFilename);
+    if (table->checksumVersion != table->version) {
+        remove(path);//旧索引文件已经对不上了
+        return;
+    }
+    waitIndexBuilds(table);  // 正在建的索引也要写进去
+    
+    int indexCount = 0;
+    for (int i = 0; table->indexes && i < table->numColumns; i++) {
+        if (table->indexes[i]) indexCount++;
+    }
+    if (indexCount == 0) {
+        remove(path);
+        return;
+    }
+    
+    FILE* file = fopen(path, "wb");
+    if (!file) return;
+    IndexFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_FILE_MAGIC, 4);
+    header.format = INDEX_FILE_FORMAT;
+    header.checksum = table->checksum;
+    header.rowCount = table->rowCount;
+    header.numColumns = table->numColumns;
+    header.indexCount = indexCount;
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; ok && i < table->numColumns; i++) {
+        ColumnIndex* ix = table->indexes[i];
+        if (!ix) continue;
+        if (ix->version != table->version) {
+            // 表改过、索引过期：不在这里重建（保存不用等），只登记，加载时在后台重建
+            IndexSectionHeader info;
+            memset(&info, 0, sizeof(info));
+            info.colIndex = i;
+            info.type = table->columns[i].type;
+            info.count = INDEX_SECTION_STALE;
+            ok = fwrite(&info, sizeof(info), 1, file) == 1;
+            continue;
+        }
+        ok = fwrite(&ix->info, sizeof(ix->info), 1, file) == 1
+            && fwrite(ix->block, 1, indexBlockSize(&ix->info), file) == indexBlockSize(&ix->info);
+    }
+    fclose(file);
+    if (!ok) remove(path);//写了一半的文件不能留下
+}
+
+// 检查读入的索引段是否自洽（行号、偏移不越界，字符串池以'\0'结尾）
+static int validateColumnIndex(const ColumnIndex* ix, int rowCount) {
+    for (int i = 0; i < ix->info.count; i++) {
+        if (ix->rowNums[i] < 1 || ix->rowNums[i] > (unsigned int)rowCount) return 0;
+        if (ix->info.type == 2 && (ix->keys[i] < 0 || (unsigned int)ix->keys[i] >= ix->info.poolSize)) return 0;
+    }
+    if (ix->info.type == 2 && ix->info.poolSize > 0 && ix->pool[ix->info.poolSize - 1] != '\0') return 0;
+    return 1;
+}
+
+/* loadIndexFile - 装入与表匹配的索引文件
+ * 
+ * @registered: 若不为NULL，标记文件中登记了索引的列（即使数据已过期、没能装入），
+ *              调用者据此决定要在后台重建哪些索引
+ * 返回值：装入的索引个数（文件不存在或校验失败返回0，之后按需重建）
+ */
+static int loadIndexFile(Table* table, const char* tableFilename, unsigned char* registered) {
+    char path[512];
+    indexFileName(path, sizeof(path), tableFilename);
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+    
+    IndexFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, INDEX_FILE_MAGIC, 4) != 0
+        || header.format != INDEX_FILE_FORMAT
+        || header.numColumns != table->numColumns) {
+        fclose(file);
+        return 0;
+    }
+    if (header.checksum != table->checksum
+        || table->checksumVersion != table->version
+        || header.rowCount != table->rowCount) {
+        // 数据已过期：只读各段的段头，记下登记过哪些列
+        IndexSectionHeader info;
+        for (int n = 0; registered && n < header.indexCount; n++) {
+            if (fread(&info, sizeof(info), 1, file) != 1) break;
+            if (info.colIndex < 0 || info.colIndex >= table->numColumns
+                || info.type != table->columns[info.colIndex].type) break;
+            registered[info.colIndex] = 1;
+            if (info.count == INDEX_SECTION_STALE) continue;
+            if (fseek(file, (long)indexBlockSize(&info), SEEK_CUR) != 0) break;
+        }
+        fclose(file);
+        return 0;
+    }
+    
+    if (!table->indexes) {
+        table->indexes = (ColumnIndex**)calloc(table->numColumns, sizeof(ColumnIndex*));
+    }
+    int loaded = 0;
+    for (int n = 0; n < header.indexCount; n++) {
+        IndexSectionHeader info;
+        if (fread(&info, sizeof(info), 1, file) != 1) break;
+        if (info.colIndex >= 0 && info.colIndex < table->numColumns && info.count == INDEX_SECTION_STALE
+            && info.type == table->columns[info.colIndex].type) {
+            if (registered) registered[info.colIndex] = 1;  // 只有登记，由调用者在后台重建
+            continue;
+        }
+        if (info.colIndex < 0 || info.colIndex >= table->numColumns
+            || info.type != table->columns[info.colIndex].type
+            || info.count != table->rowCount
+            || (info.type == 1 && info.poolSize != 0)) break;
+        if (registered) registered[info.colIndex] = 1;
+        ColumnIndex* ix = allocColumnIndex(&info);
+        if (fread(ix->block, 1, indexBlockSize(&info), file) != indexBlockSize(&info)
+            || !validateColumnIndex(ix, table->rowCount)) {
+            freeColumnIndex(ix);
+            break;
+        }
+        ix->version = table->version;
+        freeColumnIndex(table->indexes[info.colIndex]);
+        table->indexes[info.colIndex] = ix;
+        loaded++;
+    }
+    fclose(file);
+    return loaded;
+}
+
+/*==================== 后台建索引 ====================*/
+/* 加载表时，索引文件里登记过、但数据已过期（或损坏）的索引要重建。
+ * 为了不让用户等，加载在行数据就绪后立即返回，重建交给每列一个后台线程：
+ *   - 建好之前，查询走 linearFind* 线性扫描（searchPreferIndex）；
+ *   - 线程把索引写进 table->indexes 后才置 done，查询看到 done 就整体切换到索引，
+ *     不会看到建了一半的索引；
+ *   - 后台线程只读表，增删改表（以及释放表、保存索引）之前先等所有线程结束。
+ * 进度可以在主菜单的 "Index Stats" 中查看。
+ */
+
+typedef struct IndexBuild {
+    Table* table;
+    int colIndex;
+    volatile LONG progress;        // 已收集的行数
+    volatile LONG done;            // 1 = 索引已写入 table->indexes
+    double elapsedMs;              // 建索引用时（done之后有效）
+    HANDLE thread;                 // 线程句柄（等待结束后为NULL）
+} IndexBuild;
+
+static DWORD WINAPI indexBuildThread(LPVOID param) {
+    IndexBuild* b = (IndexBuild*)param;
+    HighResTimer timer;
+    timerStart(&timer);
+    ColumnIndex* ix = buildColumnIndex(b->table, b->colIndex, &b->progress);
+    b->elapsedMs = timerEndMs(&timer);
+    queryArenaRelease();  // 本线程的临时内存
+    b->table->indexes[b->colIndex] = ix;
+    InterlockedExchange(&b->done, 1);  // 发布：之前的写入对看到done的线程都可见
+    return 0;
+}
+
+/* startIndexBuilds - 为登记过、但还没有索引的列启动后台建索引线程
+ * 线程创建失败的列就地同步建立
+ */
+static void startIndexBuilds(Table* table, const unsigned char* registered) {
+    for (int i = 0; i < table->numColumns; i++) {
+        if (!registered[i] || (table->indexes && table->indexes[i])) continue;
+        if (!table->indexes) table->indexes = (ColumnIndex**)calloc(table->numColumns, sizeof(ColumnIndex*));
+        if (!table->builds) table->builds = (IndexBuild**)calloc(table->numColumns, sizeof(IndexBuild*));
+        
+        IndexBuild* b = (IndexBuild*)calloc(1, sizeof(IndexBuild));
+        b->table = table;
+        b->colIndex = i;
+        table->builds[i] = b;
+        b->thread = CreateThread(NULL, 0, indexBuildThread, b, 0, NULL);
+        if (!b->thread) indexBuildThread(b);
+    }
+}
+
+// 等所有后台建索引线程结束（任务记录保留给统计命令）
+static void waitIndexBuilds(Table* table) {
+    if (!table->builds) return;
+    for (int i = 0; i < table->numColumns; i++) {
+        IndexBuild* b = table->builds[i];
+        if (!b || !b->thread) continue;
+        WaitForSingleObject(b->thread, INFINITE);
+        CloseHandle(b->thread);
+        b->thread = NULL;
+    }
+}
+
+static void freeIndexBuilds(Table* table) {
+    if (!table->builds) return;
+    waitIndexBuilds(table);
+    for (int i = 0; i < table->numColumns; i++) free(table->builds[i]);
+    free(table->builds);
+    table->builds = NULL;
+}
+
+// 该列是否正在后台建索引
+static int indexBuildPending(Table* table, int colIndex) {
+    IndexBuild* b = table->builds ? table->builds[colIndex] : NULL;
+    return b && InterlockedCompareExchange(&b->done, 0, 0) == 0;
+}
+
+/* readyColumnIndex - 不等待地取得某列可用的索引
+ * 正在后台建立、尚未建立或已过期都返回NULL
+ */
+ColumnIndex* readyColumnIndex(Table* table, int colIndex) {
+    if (!table->indexes || indexBuildPending(table, colIndex)) return NULL;
+    ColumnIndex* ix = table->indexes[colIndex];
+    return (ix && ix->version == table->version) ? ix : NULL;
+}
+
+/* searchPreferIndex - 有就绪的索引就用索引，否则退回线性扫描
+ * 
+ * 整数列查 low <= 值 <= high，字符串列（strValue不为NULL）查等于strValue。
+ * @usedIndex: 若不为NULL，返回是否用了索引
+ */
+SearchResult* searchPreferIndex(Table* table, int colIdx, int low, int high, const char* strValue, int* usedIndex) {
+    int ready = readyColumnIndex(table, colIdx) != NULL;
+    if (usedIndex) *usedIndex = ready;
+    if (strValue) {
+        return ready ? indexFindStrEqual(table, colIdx, strValue) : linearFindStrEqual(table, colIdx, strValue);
+    }
+    return ready ? indexFindRange(table, colIdx, low, high) : linearFindBetween(table, colIdx, low, high);
+}
+
+// 统计命令：各列索引状态与后台建索引进度
+void printIndexStats(Table* table) {
+    printf("\n--- Index Stats ---\n");
+    for (int i = 0; i < table->numColumns; i++) {
+        IndexBuild* b = table->builds ? table->builds[i] : NULL;
+        printf("  [%d] %-12s ", i, table->columns[i].name);
+        if (b && indexBuildPending(table, i)) {
+            LONG done = InterlockedCompareExchange(&b->progress, 0, 0);
+            if (done >= table->rowCount) {
+                printf("building in background: sorting (queries use linear scan)\n");
+            } else {
+                printf("building in background: %ld/%d rows, %.0f%% (queries use linear scan)\n",
+                       (long)done, table->rowCount, table->rowCount ? 100.0 * done / table->rowCount : 100.0);
+            }
+            continue;
+        }
+        ColumnIndex* ix = table->indexes ? table->indexes[i] : NULL;  // 建完之后才能读这一格
+        if (ix && ix->version == table->version) {
+            if (b) printf("ready, built in background in %.2f ms", b->elapsedMs);
+            else printf("ready");
+            printf(" (%d entries)\n", ix->info.count);
+        } else if (ix) {
+            printf("stale, rebuilt on next use\n");
+        } else {
+            printf("not indexed\n");
+        }
+    }
+}
+
+// 检索菜单用：有序索引查找并打印耗时（第一次用到该列时包含建索引时间）
+// 该列还在后台建立时不等待，用线性扫描回答
+static void reportIndexSearch(Table* table, int colIdx, int low, int high, const char* strValue) {
+    HighResTimer timer;
+    int built = 0;
+    if (indexBuildPending(table, colIdx)) {
+        int usedIndex;
+        timerStart(&timer);
+        SearchResult* sr = searchPreferIndex(table, colIdx, low, high, strValue, &usedIndex);
+        double t = timerEndMicro(&timer);
+        printf("Sorted index:  %.2f us (%.4f ms), found %d (%s)\n", t, t/1000.0, sr->count,
+               usedIndex ? "just finished building" : "building in background, answered by scan");
+        freeSearchResult(sr);
+        return;
+    }
+    timerStart(&timer);
+    getColumnIndex(table, colIdx, &built);
+    SearchResult* sr = strValue ? indexFindStrEqual(table, colIdx, strValue) : indexFindRange(table, colIdx, low, high);
+    double t = timerEndMicro(&timer);
+    printf("Sorted index:  %.2f us (%.4f ms), found %d (%s)\n", t, t/1000.0, sr->count,
+           built ? "built now, saved with the table" : "ready, no build needed");
+    freeSearchResult(sr);
+}
+
+/*==================== 聚簇表 ====================*/
+/* 聚簇（CLUSTER）：按某一列的值重排记录，使表的行顺序就是该列的顺序
+ *   - 该列上的范围查询变成一段连续的行号，二分查找定出首尾即可，不必扫描全表
+ *   - 全量 CLUSTER 还会按新顺序重新分配所有节点，相邻的行在内存中也相邻，顺序扫描更快
+ * 
+ * 维护：表只保证前 clusteredRows 行有序（有序前缀），之后的行是还没归位的新行
+ *   - 追加的行不小于最后一行时直接计入前缀（顺序递增的学号始终保持聚簇）
+ *   - 删除不破坏顺序；修改了聚簇列的行按新值挪到前缀中的正确位置
+ *   - 按行号插入的行放不下时，前缀截短到插入位置之前
+ *   - 开启自动聚簇后，主循环在每次请求之后调用 reclusterStep，
+ *     每次把最多 CLUSTER_STEP_ROWS 个未归位的行排序后归并进前缀，不让任何一次请求等待整表排序
+ *   - 查询 = 前缀中二分出的连续区间 + 未归位部分的线性扫描，任何时候结果都正确
+ */
+
+#define CLUSTER_STEP_ROWS 4096   // 每次增量聚簇最多归位的行数
+
+typedef struct {
+    int intKey;
+    const char* strKey;
+    RecordNode* node;
+    int seq;                     // 原来的先后次序（排序稳定）
+} ClusterEntry;
+
+static int cmpClusterInt(const void* a, const void* b) {
+    const ClusterEntry* x = (const ClusterEntry*)a;
+    const ClusterEntry* y = (const ClusterEntry*)b;
+    if (x->intKey != y->intKey) return (x->intKey > y->intKey) - (x->intKey < y->intKey);
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static int cmpClusterStr(const void* a, const void* b) {
+    const ClusterEntry* x = (const ClusterEntry*)a;
+    const ClusterEntry* y = (const ClusterEntry*)b;
+    int c = strcmp(x->strKey, y->strKey);
+    if (c != 0) return c;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+// 比较两个单元格在聚簇列上的值
+static int clusterCompare(Table* table, const Cell* a, const Cell* b) {
+    if (table->columns[table->clusterColumn].type == 1) {
+        return (a->data.int_val > b->data.int_val) - (a->data.int_val < b->data.int_val);
+    }
+    return strcmp(cellStr(a), cellStr(b));
+}
+
+// 把n个节点按聚簇列稳定排序（entries由调用者从查询arena分配）
+static void clusterSortEntries(Table* table, ClusterEntry* entries, int n) {
+    int col = table->clusterColumn;
+    for (int i = 0; i < n; i++) {
+        entries[i].intKey = entries[i].node->cells[col].data.int_val;
+        entries[i].strKey = table->columns[col].type == 1 ? NULL : cellStr(&entries[i].node->cells[col]);
+        entries[i].seq = i;
+    }
+    qsort(entries, n, sizeof(ClusterEntry), table->columns[col].type == 1 ? cmpClusterInt : cmpClusterStr);
+}
+
+// 有序前缀中第一个值 >= key（strict=0）或 > key（strict=1）的行号，没有则为 clusteredRows+1
+static int clusterBound(Table* table, const Cell* key, int strict) {
+    int lo = 1, hi = table->clusteredRows + 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = clusterCompare(table, &getRecordByRowNum(table, mid)->cells[table->clusterColumn], key);
+        if (c < 0 || (strict && c == 0)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* clusterTable - 按指定列聚簇整张表（CLUSTER）
+ * 
+ * 算法：稳定排序后按新顺序重新分配全部节点、拷贝单元格（字符串随单元格一起搬），再释放旧节点
+ * 返回值：成功返回1
+ * 时间复杂度：O(n log n)
+ */
+int clusterTable(Table* table, int colIndex) {
+    if (!table || colIndex < 0 || colIndex >= table->numColumns) return 0;
+    waitIndexBuilds(table);
+    table->clusterColumn = colIndex;
+    int n = table->rowCount;
+    ClusterEntry* entries = (ClusterEntry*)queryAlloc((n > 0 ? n : 1) * sizeof(ClusterEntry));
+    int i = 0;
+    for (RecordNode* cur = table->head; cur; cur = cur->next) entries[i++].node = cur;
+    clusterSortEntries(table, entries, n);
+    
+    // 先把新节点全部分配好再释放旧节点，新节点才会连续地排在一起
+    size_t nodeSize = sizeof(RecordNode) + table->numColumns * sizeof(Cell);
+    RecordNode** fresh = (RecordNode**)queryAlloc((n > 0 ? n : 1) * sizeof(RecordNode*));
+    for (i = 0; i < n; i++) {
+        fresh[i] = (RecordNode*)malloc(nodeSize);
+        if (!fresh[i]) break;
+    }
+    int moved = (i == n);
+    if (!moved) {
+        // 内存不够：只按顺序重新链接，不搬节点
+        while (i > 0) free(fresh[--i]);
+        for (i = 0; i < n; i++) fresh[i] = entries[i].node;
+    } else {
+        for (i = 0; i < n; i++) {
+            memcpy(fresh[i], entries[i].node, nodeSize);
+            free(entries[i].node);
+        }
+    }
+    for (i = 0; i < n; i++) fresh[i]->next = i + 1 < n ? fresh[i + 1] : NULL;
+    table->head = n > 0 ? fresh[0] : NULL;
+    table->tail = n > 0 ? fresh[n - 1] : NULL;
+    if (moved && table->pk) setPrimaryKey(table, table->primaryKey);  // 节点地址变了，主键索引重建
+    if (moved) {
+        rebuildConcurrentHash(table);
+        rebuildSkipList(table);
+    }
+    storeInvalidate(table);
+    mapInvalidate(table);
+    
+    dropRowTree(table);
+    table->clusteredRows = n;
+    table->version++;      // 行号全变了
+    return 1;
+}
+
+// 取消聚簇（行顺序保持现状）
+void unclusterTable(Table* table) {
+    table->clusterColumn = -1;
+    table->clusteredRows = 0;
+    table->autoCluster = 0;
+}
+
+/* reclusterStep - 增量聚簇一步：把最多 CLUSTER_STEP_ROWS 个未归位的行排序后归并进有序前缀
+ * 
+ * 新行都不小于前缀最后一行时直接接上，否则与前缀做一次链表归并 O(前缀长度 + 本批行数)
+ * 返回值：本次归位的行数（没开自动聚簇或已全部归位返回0）
+ */
+int reclusterStep(Table* table) {
+    if (!table || table->clusterColumn < 0 || !table->autoCluster) return 0;
+    if (table->clusteredRows >= table->rowCount) return 0;
+    waitIndexBuilds(table);
+    
+    int prefix = table->clusteredRows;
+    int batch = table->rowCount - prefix;
+    if (batch > CLUSTER_STEP_ROWS) batch = CLUSTER_STEP_ROWS;
+    RecordNode* prefixLast = prefix > 0 ? getRecordByRowNum(table, prefix) : NULL;
+    RecordNode* cur = prefixLast ? prefixLast->next : table->head;
+    ClusterEntry* entries = (ClusterEntry*)queryAlloc(batch * sizeof(ClusterEntry));
+    for (int i = 0; i < batch; i++, cur = cur->next) entries[i].node = cur;
+    RecordNode* after = cur;  // 本批之后仍未归位的行
+    clusterSortEntries(table, entries, batch);
+    
+    int col = table->clusterColumn;
+    RecordNode** link;
+    RecordNode* last = NULL;
+    RecordNode* relinkFrom = prefixLast;  // 链表从这里之后被改过
+    int bi = 0;
+    if (!prefixLast || clusterCompare(table, &prefixLast->cells[col], &entries[0].node->cells[col]) <= 0) {
+        link = prefixLast ? &prefixLast->next : &table->head;  // 整批都排在前缀之后
+        // 本批内部顺序变了也要让列存失效：它的主存行按节点认，假定与链表同序
+        RecordNode* orig = *link;
+        for (int i = 0; i < batch; i++, orig = orig->next) {
+            if (entries[i].node != orig) {
+                storeInvalidate(table);
+                break;
+            }
+        }
+    } else {
+        // 链表归并：相等时前缀中的行在前（稳定）
+        storeInvalidate(table);
+        relinkFrom = NULL;
+        link = &table->head;
+        RecordNode* a = table->head;
+        for (int ai = 0; ai < prefix; ) {
+            if (bi < batch && clusterCompare(table, &entries[bi].node->cells[col], &a->cells[col]) < 0) {
+                last = entries[bi++].node;
+            } else {
+                last = a;
+                a = a->next;
+                ai++;
+            }
+            *link = last;
+            link = &last->next;
+        }
+    }
+    for (; bi < batch; bi++) {
+        last = entries[bi].node;
+        *link = last;
+        link = &last->next;
+    }
+    *link = after;
+    if (!after) table->tail = last;
+    mapRelink(table, relinkFrom);
+    
+    dropRowTree(table);
+    table->clusteredRows += batch;
+    table->version++;
+    return batch;
+}
+
+/* clusterNoteAppend - addRecord 追加一行后调用：新行接得上有序前缀就计入前缀
+ * @prevTail: 追加前的最后一行
+ */
+static void clusterNoteAppend(Table* table, RecordNode* prevTail) {
+    if (table->clusterColumn < 0 || table->clusteredRows != table->rowCount - 1) return;
+    if (!prevTail || clusterCompare(table, &prevTail->cells[table->clusterColumn], &table->tail->cells[table->clusterColumn]) <= 0) {
+        table->clusteredRows++;
+    }
+}
+
+/* clusterNoteInsert - 在第rowNum行插入一行后调用：放得下就计入前缀，否则前缀截短到插入位置之前 */
+static void clusterNoteInsert(Table* table, int rowNum) {
+    int prefix = table->clusteredRows;
+    if (table->clusterColumn < 0 || rowNum > prefix + 1) return;
+    int col = table->clusterColumn;
+    const Cell* value = &getRecordByRowNum(table, rowNum)->cells[col];
+    int fits = (rowNum == 1 || clusterCompare(table, &getRecordByRowNum(table, rowNum - 1)->cells[col], value) <= 0)
+            && (rowNum > prefix || clusterCompare(table, value, &getRecordByRowNum(table, rowNum + 1)->cells[col]) <= 0);
+    table->clusteredRows = fits ? prefix + 1 : rowNum - 1;
+}
+
+/* clusterRowOf - 节点在有序前缀中的行号（按节点当前的聚簇列值二分），不在前缀中返回0
+ * 时间复杂度：O(log² n + 相同值的行数)
+ */
+static int clusterRowOf(Table* table, RecordNode* node) {
+    if (table->clusterColumn < 0 || table->clusteredRows == 0) return 0;
+    int col = table->clusterColumn;
+    int row = clusterBound(table, &node->cells[col], 0);
+    RecordNode* cur = row <= table->clusteredRows ? getRecordByRowNum(table, row) : NULL;
+    for (; cur && row <= table->clusteredRows; cur = cur->next, row++) {
+        if (cur == node) return row;
+        if (clusterCompare(table, &cur->cells[col], &node->cells[col]) != 0) break;
+    }
+    return 0;
+}
+
+/* clusterReposition - 有序前缀中第rowNum行的聚簇列值改变后，把它挪到前缀中的正确位置 */
+static void clusterReposition(Table* table, int rowNum) {
+    int col = table->clusterColumn;
+    RecordNode* node = getRecordByRowNum(table, rowNum);
+    int prefix = table->clusteredRows;
+    if ((rowNum == 1 || clusterCompare(table, &getRecordByRowNum(table, rowNum - 1)->cells[col], &node->cells[col]) <= 0)
+        && (rowNum == prefix || clusterCompare(table, &node->cells[col], &getRecordByRowNum(table, rowNum + 1)->cells[col]) <= 0)) {
+        return;  // 仍然有序
+    }
+    storeInvalidate(table);
+    unlinkRowAt(table, rowNum);
+    mapNoteUnlink(table, rowNum > 1 ? getRecordByRowNum(table, rowNum - 1) : NULL, node);
+    table->clusteredRows--;
+    int target = clusterBound(table, &node->cells[col], 1);  // 相同值的行之后
+    linkRowAt(table, target, node);
+    mapNoteLink(table, target > 1 ? getRecordByRowNum(table, target - 1) : NULL, node);
+    table->clusteredRows++;
+}
+
+/* clusterFindRange - 聚簇列（整数）上查找 low <= 值 <= high 的记录
+ * 前缀中二分出一段连续行号，未归位的行线性扫描
+ * 时间复杂度：O(log² n + k + 未归位行数)
+ */
+SearchResult* clusterFindRange(Table* table, int low, int high) {
+    int col = table->clusterColumn;
+    if (col < 0 || table->columns[col].type != 1 || low > high) return createSearchResult(0);
+    Cell lowCell, highCell;
+    lowCell.data.int_val = low;
+    highCell.data.int_val = high;
+    int from = clusterBound(table, &lowCell, 0);
+    int to = clusterBound(table, &highCell, 1);
+    SearchResult* sr = createSearchResult(to - from);
+    for (int row = from; row < to; row++) addToResult(sr, row);
+    
+    int row = table->clusteredRows + 1;
+    for (RecordNode* cur = getRecordByRowNum(table, row); cur; cur = cur->next, row++) {
+        int v = cur->cells[col].data.int_val;
+        if (v >= low && v <= high) addToResult(sr, row);
+    }
+    return sr;
+}
+
+/* clusterFindStrEqual - 聚簇列（字符串）上查找等于value的记录 */
+SearchResult* clusterFindStrEqual(Table* table, const char* value) {
+    int col = table->clusterColumn;
+    if (col < 0 || table->columns[col].type != 2) return createSearchResult(0);
+    Cell key;
+    cellSetStr(&key, value);
+    int from = clusterBound(table, &key, 0);
+    int to = clusterBound(table, &key, 1);
+    cellFreeStr(&key);
+    SearchResult* sr = createSearchResult(to - from);
+    for (int row = from; row < to; row++) addToResult(sr, row);
+    
+    int row = table->clusteredRows + 1;
+    for (RecordNode* cur = getRecordByRowNum(table, row); cur; cur = cur->next, row++) {
+        if (strcmp(cellStr(&cur->cells[col]), value) == 0) addToResult(sr, row);
+    }
+    return sr;
+}
+
+// 检索菜单用：查询列正是聚簇列时，打印按聚簇查找的耗时
+static void reportClusterSearch(Table* table, int colIdx, int low, int high, const char* strValue) {
+    if (colIdx != table->clusterColumn) return;
+    HighResTimer timer;
+    timerStart(&timer);
+    SearchResult* sr = strValue ? clusterFindStrEqual(table, strValue) : clusterFindRange(table, low, high);
+    double t = timerEndMicro(&timer);
+    printf("Clustered:     %.2f us (%.4f ms), found %d (%d of %d rows in order)\n", t, t/1000.0, sr->count,
+           table->clusteredRows, table->rowCount);
+    freeSearchResult(sr);
+}
+
+/*==================== 多维索引（k-d树） ====================*/
+/* "age 19~21 且 score 85~95" 这样的多列条件，用单列索引要各查一次再求交集。
+ * k-d树把多个整数列的值看成多维空间中的点：
+ *   - 每层按一个维度（轮流）取中位数把点分成两半，左边 <= 中位数 <= 右边
+ *   - 范围查询：某一维的查询区间整个落在中位数一侧时，另一侧整棵子树跳过
+ *   - 最近邻：先走查询点所在的一侧，另一侧只有可能更近时才去看
+ * 
+ * 存储：隐式树，点按建树后的顺序放在一个数组里，区间 [lo, hi) 的中点就是子树根，
+ *   没有指针，建树时用快速选择原地划分，O(n log n)。
+ * 
+ * 最近邻的距离：各维先除以该列的取值范围再算欧氏距离，
+ *   避免 score（0~100）的差距把 age（十几到二十几）的差距完全盖住。
+ * 
+ * 缓存：表上保留最近一次用到的k-d树，列组合相同、表没被修改（version相同）就直接用。
+ */
+
+#define KD_MAX_DIMS 4     // 最多维数
+#define KD_LEAF_SIZE 8    // 子树不超过这么多点时直接逐个比较
+
+typedef struct {
+    int coords[KD_MAX_DIMS];   // 各维的值
+    unsigned int rowNum;       // 行号
+} KdPoint;
+
+typedef struct KdIndex {
+    int dims;                  // 维数
+    int cols[KD_MAX_DIMS];     // 各维对应的列
+    double scale[KD_MAX_DIMS]; // 最近邻距离用：1 / 该列取值范围
+    KdPoint* points;           // 建树后顺序的点
+    int count;
+    unsigned int version;      // 建立时表的version
+} KdIndex;
+
+static void freeKdIndex(Table* table) {
+    if (!table->kd) return;
+    free(table->kd->points);
+    free(table->kd);
+    table->kd = NULL;
+}
+
+// 快速选择：把 [lo, hi) 中第k小（按第d维）的点放到位置k，左边都 <= 它，右边都 >= 它
+static void kdSelect(KdPoint* p, int lo, int hi, int k, int d) {
+    while (hi - lo > 1) {
+        int mid = lo + (hi - lo) / 2;
+        // 三数取中作为枢轴
+        if (p[mid].coords[d] < p[lo].coords[d]) { KdPoint t = p[mid]; p[mid] = p[lo]; p[lo] = t; }
+        if (p[hi - 1].coords[d] < p[lo].coords[d]) { KdPoint t = p[hi - 1]; p[hi - 1] = p[lo]; p[lo] = t; }
+        if (p[hi - 1].coords[d] < p[mid].coords[d]) { KdPoint t = p[hi - 1]; p[hi - 1] = p[mid]; p[mid] = t; }
+        int pivot = p[mid].coords[d];
+        int i = lo, j = hi - 1;
+        while (i <= j) {
+            while (p[i].coords[d] < pivot) i++;
+            while (p[j].coords[d] > pivot) j--;
+            if (i <= j) {
+                KdPoint t = p[i]; p[i] = p[j]; p[j] = t;
+                i++;
+                j--;
+            }
+        }
+        if (k <= j) hi = j + 1;
+        else if (k >= i) lo = i;
+        else return;  // j < k < i：位置k上的值就是枢轴
+    }
+}
+
+static void kdBuild(KdPoint* p, int lo, int hi, int depth, int dims) {
+    if (hi - lo <= KD_LEAF_SIZE) return;
+    int mid = lo + (hi - lo) / 2;
+    int d = depth % dims;
+    kdSelect(p, lo, hi, mid, d);
+    kdBuild(p, lo, mid, depth + 1, dims);
+    kdBuild(p, mid + 1, hi, depth + 1, dims);
+}
+
+/* getKdIndex - 取得指定列组合上的k-d树（列组合不同或表已修改时重建）
+ * 返回值：k-d树；维数不对或有非整数列返回NULL
+ */
+KdIndex* getKdIndex(Table* table, const int* cols, int dims, int* built) {
+    if (built) *built = 0;
+    if (dims < 1 || dims > KD_MAX_DIMS) return NULL;
+    for (int d = 0; d < dims; d++) {
+        if (cols[d] < 0 || cols[d] >= table->numColumns || table->columns[cols[d]].type != 1) return NULL;
+    }
+    KdIndex* kd = table->kd;
+    if (kd && kd->version == table->version && kd->dims == dims && memcmp(kd->cols, cols, dims * sizeof(int)) == 0) {
+        return kd;
+    }
+    freeKdIndex(table);
+    
+    kd = (KdIndex*)calloc(1, sizeof(KdIndex));
+    kd->dims = dims;
+    memcpy(kd->cols, cols, dims * sizeof(int));
+    kd->count = table->rowCount;
+    kd->points = (KdPoint*)malloc((kd->count > 0 ? kd->count : 1) * sizeof(KdPoint));
+    int minV[KD_MAX_DIMS], maxV[KD_MAX_DIMS];
+    for (int d = 0; d < dims; d++) minV[d] = INT_MAX, maxV[d] = INT_MIN;
+    int i = 0;
+    for (RecordNode* cur = table->head; cur; cur = cur->next, i++) {
+        kd->points[i].rowNum = (unsigned int)(i + 1);
+        for (int d = 0; d < dims; d++) {
+            int v = cur->cells[cols[d]].data.int_val;
+            kd->points[i].coords[d] = v;
+            if (v < minV[d]) minV[d] = v;
+            if (v > maxV[d]) maxV[d] = v;
+        }
+    }
+    for (int d = 0; d < dims; d++) {
+        double span = kd->count > 0 ? (double)maxV[d] - minV[d] : 0.0;
+        kd->scale[d] = span > 0 ? 1.0 / span : 1.0;
+    }
+    kdBuild(kd->points, 0, kd->count, 0, dims);
+    kd->version = table->version;
+    table->kd = kd;
+    if (built) *built = 1;
+    return kd;
+}
+
+static int kdInside(const KdPoint* p, int dims, const int* low, const int* high) {
+    for (int d = 0; d < dims; d++) {
+        if (p->coords[d] < low[d] || p->coords[d] > high[d]) return 0;
+    }
+    return 1;
+}
+
+// 范围查询递归：只进入与查询框相交的一侧；visited 统计检查过的点数
+static void kdRange(const KdIndex* kd, int lo, int hi, int depth, const int* low, const int* high,
+                    SearchResult* sr, int* visited) {
+    if (hi - lo <= KD_LEAF_SIZE) {
+        for (int i = lo; i < hi; i++) {
+            (*visited)++;
+            if (kdInside(&kd->points[i], kd->dims, low, high)) addToResult(sr, kd->points[i].rowNum);
+        }
+        return;
+    }
+    int mid = lo + (hi - lo) / 2;
+    int d = depth % kd->dims;
+    int split = kd->points[mid].coords[d];
+    (*visited)++;
+    if (kdInside(&kd->points[mid], kd->dims, low, high)) addToResult(sr, kd->points[mid].rowNum);
+    if (low[d] <= split) kdRange(kd, lo, mid, depth + 1, low, high, sr, visited);
+    if (high[d] >= split) kdRange(kd, mid + 1, hi, depth + 1, low, high, sr, visited);
+}
+
+/* kdFindRange - 多列范围查询：low[d] <= 第d列 <= high[d] 对所有d成立
+ * @visited: 若不为NULL，返回检查过的点数（体现跳过了多少区域）
+ * 时间复杂度：二维时约 O(√n + k)
+ */
+SearchResult* kdFindRange(Table* table, const int* cols, int dims, const int* low, const int* high, int* visited) {
+    int dummy = 0;
+    if (!visited) visited = &dummy;
+    *visited = 0;
+    KdIndex* kd = getKdIndex(table, cols, dims, NULL);
+    if (!kd) return createSearchResult(0);
+    SearchResult* sr = createSearchResult(64);
+    kdRange(kd, 0, kd->count, 0, low, high, sr, visited);
+    return sr;
+}
+
+// 线性扫描版本（对比用）
+SearchResult* linearFindMultiRange(Table* table, const int* cols, int dims, const int* low, const int* high) {
+    SearchResult* sr = createSearchResult(64);
+    int rowNum = 1;
+    for (RecordNode* cur = table->head; cur; cur = cur->next, rowNum++) {
+        int d = 0;
+        while (d < dims && cur->cells[cols[d]].data.int_val >= low[d] && cur->cells[cols[d]].data.int_val <= high[d]) d++;
+        if (d == dims) addToResult(sr, rowNum);
+    }
+    return sr;
+}
+
+// 最近邻搜索状态：容量为k的最大堆（堆顶是目前第k近的点）
+typedef struct {
+    const KdIndex* kd;
+    const int* target;
+    int k;
+    int size;
+    double* dist;
+    unsigned int* rows;
+    int visited;
+} KdNearest;
+
+static double kdDistance(const KdIndex* kd, const KdPoint* p, const int* target) {
+    double sum = 0;
+    for (int d = 0; d < kd->dims; d++) {
+        double diff = ((double)p->coords[d] - target[d]) * kd->scale[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+static void kdHeapOffer(KdNearest* s, double dist, unsigned int row) {
+    int i;
+    if (s->size < s->k) {
+        i = s->size++;
+        while (i > 0 && s->dist[(i - 1) / 2] < dist) {  // 上浮
+            s->dist[i] = s->dist[(i - 1) / 2];
+            s->rows[i] = s->rows[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+    } else if (dist < s->dist[0]) {
+        i = 0;
+        for (;;) {  // 替换堆顶后下沉
+            int c = 2 * i + 1;
+            if (c >= s->size) break;
+            if (c + 1 < s->size && s->dist[c + 1] > s->dist[c]) c++;
+            if (s->dist[c] <= dist) break;
+            s->dist[i] = s->dist[c];
+            s->rows[i] = s->rows[c];
+            i = c;
+        }
+    } else {
+        return;
+    }
+    s->dist[i] = dist;
+    s->rows[i] = row;
+}
+
+static void kdNearestVisit(KdNearest* s, int lo, int hi, int depth) {
+    const KdIndex* kd = s->kd;
+    if (hi - lo <= KD_LEAF_SIZE) {
+        for (int i = lo; i < hi; i++) {
+            s->visited++;
+            kdHeapOffer(s, kdDistance(kd, &kd->points[i], s->target), kd->points[i].rowNum);
+        }
+        return;
+    }
+    int mid = lo + (hi - lo) / 2;
+    int d = depth % kd->dims;
+    s->visited++;
+    kdHeapOffer(s, kdDistance(kd, &kd->points[mid], s->target), kd->points[mid].rowNum);
+    
+    double gap = ((double)s->target[d] - kd->points[mid].coords[d]) * kd->scale[d];
+    int nearLeft = s->target[d] <= kd->points[mid].coords[d];
+    if (nearLeft) kdNearestVisit(s, lo, mid, depth + 1);
+    else kdNearestVisit(s, mid + 1, hi, depth + 1);
+    // 分割面比目前第k近的点还近，另一侧才可能有更近的点
+    if (s->size < s->k || gap * gap < s->dist[0]) {
+        if (nearLeft) kdNearestVisit(s, mid + 1, hi, depth + 1);
+        else kdNearestVisit(s, lo, mid, depth + 1);
+    }
+}
+
+/* kdFindNearest - 与target最接近的k条记录（按各列取值范围归一化后的欧氏距离）
+ * 返回值：按距离从近到远排列的行号
+ * @visited: 若不为NULL，返回检查过的点数
+ */
+SearchResult* kdFindNearest(Table* table, const int* cols, int dims, const int* target, int k, int* visited) {
+    KdIndex* kd = getKdIndex(table, cols, dims, NULL);
+    if (visited) *visited = 0;
+    if (!kd || k <= 0) return createSearchResult(0);
+    if (k > kd->count) k = kd->count;
+    KdNearest s;
+    s.kd = kd;
+    s.target = target;
+    s.k = k;
+    s.size = 0;
+    s.dist = (double*)queryAlloc((k > 0 ? k : 1) * sizeof(double));
+    s.rows = (unsigned int*)queryAlloc((k > 0 ? k : 1) * sizeof(unsigned int));
+    s.visited = 0;
+    kdNearestVisit(&s, 0, kd->count, 0);
+    if (visited) *visited = s.visited;
+    
+    // 依次弹出堆顶（最远的），倒着放就是从近到远
+    SearchResult* sr = createSearchResult(s.size);
+    sr->count = s.size;
+    while (s.size > 0) {
+        sr->rowNums[s.size - 1] = s.rows[0];
+        s.size--;
+        double lastDist = s.dist[s.size];
+        unsigned int lastRow = s.rows[s.size];
+        int i = 0;
+        for (;;) {
+            int c = 2 * i + 1;
+            if (c >= s.size) break;
+            if (c + 1 < s.size && s.dist[c + 1] > s.dist[c]) c++;
+            if (s.dist[c] <= lastDist) break;
+            s.dist[i] = s.dist[c];
+            s.rows[i] = s.rows[c];
+            i = c;
+        }
+        s.dist[i] = lastDist;
+        s.rows[i] = lastRow;
+    }
+    return sr;
+}
+
+/*==================== 列存主表 + 增量区 ====================*/
+/* 链表按行存放，追加快；但扫描一列要逐个跟指针，把整行都读进缓存。
+ * 开启列存后，表另外维护一份两层的副本专门回答扫描：
+ *   - 主存（MainStore）：按列连续存放的压缩只读快照
+ *       整数列存 值-最小值，按值域选1/2/4字节；字符串列存有序字典 + 字典码
+ *       扫描一列就是顺序读一段紧凑的数组，一次无符号比较判断一个值
+ *   - 增量区（DeltaStore）：建主存之后的改动，按行保存单元格副本
+ *       追加的行、修改过的主存行（新值）、删除的主存行（下标）
+ *   - 查询 = 扫描主存（跳过删改过的行）+ 检查增量区的行，按行号归并
+ * 
+ * 合并：增量区超过主存行数的 1/16（至少 STORE_MERGE_MIN 条）时，主循环在请求之间启动后台线程，
+ *   把旧主存和增量区的副本归并成新主存。线程只读旧主存和副本，不碰链表，查询和增删改都不用等它；
+ *   合并期间的改动照常记进增量区，另记一份日志，新主存装上时在它上面重放日志得到新的增量区。
+ * 
+ * 主存行（去掉删除的）在前、追加的行在后，与表的行顺序一致，所以只有追加/修改/删除能增量维护；
+ * 按行号在中间插入、聚簇重排等改变行顺序的操作直接丢弃主存，下次查询时从链表重建。
+ */
+
+#define STORE_MERGE_MIN 1024     // 增量区至少这么多条改动才合并
+#define STORE_MERGE_SHIFT 4      // 或超过主存行数的 1/16
+
+#define STORE_ROW_LIVE 0         // 主存行状态：未改动
+#define STORE_ROW_DELETED 1      //             已删除
+#define STORE_ROW_UPDATED 2      //             已修改，新值在增量区
+
+#define STORE_OP_APPEND 1
+#define STORE_OP_UPDATE 2
+#define STORE_OP_DELETE 3
+
+typedef struct {
+    int width;                   // 每个值占的字节数（1/2/4）
+    int base;                    // 整数列：最小值，存 值-base
+    char** dict;                 // 字符串列：有序、不重复的字典（整数列为NULL）
+    int dictSize;
+    unsigned char* codes;        // rows个压缩值（整数列）或字典码（字符串列）
+} StoreColumn;
+
+typedef struct {
+    RecordNode* node;
+    int row;
+} StoreSlot;
+
+typedef struct MainStore {
+    int rows;
+    StoreColumn* cols;           // 每列一个
+    RecordNode** nodes;          // 每行对应的记录节点，只用来认出是哪一行，不解引用
+    StoreSlot* slots;            // 节点 -> 主存行 的哈希表（线性探测）
+    int slotCount;               // 槽数（2的幂）
+} MainStore;
+
+typedef struct {
+    RecordNode* node;            // 追加的行：所属节点
+    int row;                     // 修改的行：主存行下标
+    Cell* cells;                 // 单元格副本
+} DeltaRow;
+
+typedef struct {
+    unsigned char* state;        // 每个主存行的状态 STORE_ROW_*
+    int* deleted;                // 删除的主存行下标（升序）
+    int deletedCount, deletedCap;
+    DeltaRow* updates;           // 修改过的主存行（按下标升序）
+    int updateCount, updateCap;
+    DeltaRow* inserts;           // 追加的行（按行号顺序）
+    int insertCount, insertCap;
+} DeltaStore;
+
+typedef struct {
+    int op;                      // STORE_OP_*
+    RecordNode* node;
+    Cell* cells;                 // 追加/修改的新值副本（删除为NULL）
+} StoreLogEntry;
+
+typedef struct ColumnStore {
+    const Column* columns;       // 表的列定义（建表后不变，合并线程只读）
+    int numColumns;
+    MainStore* main;             // NULL表示需要从链表重建
+    DeltaStore delta;
+    // 后台合并
+    int merging;                 // 1 = 合并已开始、新主存还没装上
+    HANDLE thread;               // 合并线程（没有或已结束为NULL）
+    volatile LONG done;          // 1 = merged 已建好
+    DeltaStore snapshot;         // 合并开始时增量区的副本（线程独占）
+    MainStore* merged;           // 线程建好的新主存
+    StoreLogEntry* log;          // 合并期间的改动
+    int logCount, logCap;
+    double runMs;                // 合并线程写入的本次用时
+    int merges;                  // 已完成的合并次数
+    double mergeMs;              // 最近一次合并用时（装上新主存时从runMs拷过来）
+} ColumnStore;
+
+// 压缩值的读写（按列宽）
+static unsigned int storeCode(const StoreColumn* sc, int i) {
+    if (sc->width == 1) return sc->codes[i];
+    if (sc->width == 2) return ((const unsigned short*)sc->codes)[i];
+    return ((const unsigned int*)sc->codes)[i];
+}
+
+static void storeSetCode(StoreColumn* sc, int i, unsigned int v) {
+    if (sc->width == 1) sc->codes[i] = (unsigned char)v;
+    else if (sc->width == 2) ((unsigned short*)sc->codes)[i] = (unsigned short)v;
+    else ((unsigned int*)sc->codes)[i] = v;
+}
+
+static int storeWidth(unsigned long long maxCode) {
+    return maxCode <= 0xFF ? 1 : (maxCode <= 0xFFFF ? 2 : 4);
+}
+
+typedef struct {
+    const char* s;
+    int row;
+} StoreStrRow;
+
+static int cmpStoreStrRow(const void* a, const void* b) {
+    return strcmp(((const StoreStrRow*)a)->s, ((const StoreStrRow*)b)->s);
+}
+
+/* storeBuildColumn - 把一列的n个值压缩进sc
+ * 整数列给ints（strs为NULL），字符串列给strs（ints为NULL）
+ * 字符串列：排序后去重得到字典，每行存字典码；字典有序，码的大小顺序就是字符串的顺序
+ */
+static void storeBuildColumn(StoreColumn* sc, const int* ints, const char** strs, int n) {
+    memset(sc, 0, sizeof(StoreColumn));
+    if (ints) {
+        int lo = n > 0 ? ints[0] : 0, hi = lo;
+        for (int i = 1; i < n; i++) {
+            if (ints[i] < lo) lo = ints[i];
+            if (ints[i] > hi) hi = ints[i];
+        }
+        sc->base = lo;
+        sc->width = storeWidth((unsigned long long)((long long)hi - lo));
+        sc->codes = (unsigned char*)malloc((n > 0 ? n : 1) * sc->width);
+        for (int i = 0; i < n; i++) storeSetCode(sc, i, (unsigned int)((long long)ints[i] - lo));
+        return;
+    }
+    
+    StoreStrRow* sorted = (StoreStrRow*)malloc((n > 0 ? n : 1) * sizeof(StoreStrRow));
+    for (int i = 0; i < n; i++) {
+        sorted[i].s = strs[i];
+        sorted[i].row = i;
+    }
+    qsort(sorted, n, sizeof(StoreStrRow), cmpStoreStrRow);
+    int distinct = 0;
+    for (int i = 0; i < n; i++) {
+        if (i == 0 || strcmp(sorted[i - 1].s, sorted[i].s) != 0) distinct++;
+    }
+    sc->width = storeWidth(distinct > 0 ? (unsigned long long)(distinct - 1) : 0);
+    sc->codes = (unsigned char*)malloc((n > 0 ? n : 1) * sc->width);
+    sc->dict = (char**)malloc((distinct > 0 ? distinct : 1) * sizeof(char*));
+    for (int i = 0; i < n; i++) {
+        if (i == 0 || strcmp(sorted[i - 1].s, sorted[i].s) != 0) sc->dict[sc->dictSize++] = _strdup(sorted[i].s);
+        storeSetCode(sc, sorted[i].row, (unsigned int)(sc->dictSize - 1));
+    }
+    free(sorted);
+}
+
+static unsigned int storeHashNode(const RecordNode* node) {
+    unsigned long long x = (unsigned long long)(size_t)node;
+    x = (x >> 4) * 0x9E3779B97F4A7C15ull;
+    return (unsigned int)(x >> 32);
+}
+
+// 建 节点 -> 主存行 的哈希表
+static void storeBuildSlots(MainStore* m) {
+    m->slotCount = 16;
+    while (m->slotCount < m->rows * 2) m->slotCount *= 2;
+    m->slots = (StoreSlot*)calloc(m->slotCount, sizeof(StoreSlot));
+    unsigned int mask = (unsigned int)m->slotCount - 1;
+    for (int i = 0; i < m->rows; i++) {
+        unsigned int slot = storeHashNode(m->nodes[i]) & mask;
+        while (m->slots[slot].node) slot = (slot + 1) & mask;
+        m->slots[slot].node = m->nodes[i];
+        m->slots[slot].row = i;
+    }
+}
+
+// 节点在主存中的行下标，不在主存中返回-1
+static int storeFindRow(const MainStore* m, const RecordNode* node) {
+    unsigned int mask = (unsigned int)m->slotCount - 1;
+    unsigned int slot = storeHashNode(node) & mask;
+    while (m->slots[slot].node) {
+        if (m->slots[slot].node == node) return m->slots[slot].row;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+static void freeMainStore(MainStore* m, int numColumns) {
+    if (!m) return;
+    for (int c = 0; c < numColumns; c++) {
+        for (int i = 0; i < m->cols[c].dictSize; i++) free(m->cols[c].dict[i]);
+        free(m->cols[c].dict);
+        free(m->cols[c].codes);
+    }
+    free(m->cols);
+    free(m->nodes);
+    free(m->slots);
+    free(m);
+}
+
+/* storeBuildFromTable - 按链表的当前内容建主存
+ * 时间复杂度：O(n × 列数)，字符串列另加排序 O(n log n)
+ */
+static MainStore* storeBuildFromTable(Table* table) {
+    int n = table->rowCount;
+    MainStore* m = (MainStore*)calloc(1, sizeof(MainStore));
+    m->rows = n;
+    m->nodes = (RecordNode**)malloc((n > 0 ? n : 1) * sizeof(RecordNode*));
+    int i = 0;
+    for (RecordNode* cur = table->head; cur; cur = cur->next) m->nodes[i++] = cur;
+    
+    m->cols = (StoreColumn*)calloc(table->numColumns, sizeof(StoreColumn));
+    int* ints = (int*)malloc((n > 0 ? n : 1) * sizeof(int));
+    const char** strs = (const char**)malloc((n > 0 ? n : 1) * sizeof(char*));
+    for (int c = 0; c < table->numColumns; c++) {
+        if (table->columns[c].type == 1) {
+            for (i = 0; i < n; i++) ints[i] = m->nodes[i]->cells[c].data.int_val;
+            storeBuildColumn(&m->cols[c], ints, NULL, n);
+        } else {
+            for (i = 0; i < n; i++) strs[i] = cellStr(&m->nodes[i]->cells[c]);
+            storeBuildColumn(&m->cols[c], NULL, strs, n);
+        }
+    }
+    free(ints);
+    free(strs);
+    storeBuildSlots(m);
+    return m;
+}
+
+/* storeMerge - 旧主存 + 增量区 => 新主存（在合并线程中运行，只读old和d）
+ * 新主存的行：旧主存中没删的行（修改过的取增量区的新值），然后是追加的行
+ */
+static MainStore* storeMerge(const MainStore* old, const DeltaStore* d, const Column* columns, int numColumns) {
+    int n = old->rows - d->deletedCount + d->insertCount;
+    MainStore* m = (MainStore*)calloc(1, sizeof(MainStore));
+    m->rows = n;
+    m->nodes = (RecordNode**)malloc((n > 0 ? n : 1) * sizeof(RecordNode*));
+    int k = 0;
+    for (int i = 0; i < old->rows; i++) {
+        if (d->state[i] != STORE_ROW_DELETED) m->nodes[k++] = old->nodes[i];
+    }
+    for (int j = 0; j < d->insertCount; j++) m->nodes[k++] = d->inserts[j].node;
+    
+    m->cols = (StoreColumn*)calloc(numColumns, sizeof(StoreColumn));
+    int* ints = (int*)malloc((n > 0 ? n : 1) * sizeof(int));
+    const char** strs = (const char**)malloc((n > 0 ? n : 1) * sizeof(char*));
+    for (int c = 0; c < numColumns; c++) {
+        const StoreColumn* sc = &old->cols[c];
+        int isInt = columns[c].type == 1;
+        int u = 0;
+        k = 0;
+        for (int i = 0; i < old->rows; i++) {
+            if (d->state[i] == STORE_ROW_DELETED) continue;
+            if (d->state[i] == STORE_ROW_UPDATED) {
+                const Cell* cell = &d->updates[u++].cells[c];  // 修改过的行与updates同序
+                if (isInt) ints[k++] = cell->data.int_val;
+                else strs[k++] = cellStr(cell);
+            } else if (isInt) {
+                ints[k++] = (int)((long long)sc->base + storeCode(sc, i));
+            } else {
+                strs[k++] = sc->dict[storeCode(sc, i)];
+            }
+        }
+        for (int j = 0; j < d->insertCount; j++) {
+            const Cell* cell = &d->inserts[j].cells[c];
+            if (isInt) ints[k++] = cell->data.int_val;
+            else strs[k++] = cellStr(cell);
+        }
+        storeBuildColumn(&m->cols[c], isInt ? ints : NULL, isInt ? NULL : strs, n);
+    }
+    free(ints);
+    free(strs);
+    storeBuildSlots(m);
+    return m;
+}
+
+static Cell* storeCopyCells(const ColumnStore* s, const Cell* cells) {
+    Cell* copy = (Cell*)malloc(s->numColumns * sizeof(Cell));
+    deepCopyCells(copy, (Cell*)cells, s->columns, s->numColumns);
+    return copy;
+}
+
+static void storeFreeCells(const ColumnStore* s, Cell* cells) {
+    if (!cells) return;
+    freeCells(cells, s->columns, s->numColumns);
+    free(cells);
+}
+
+static void deltaInit(DeltaStore* d, int mainRows) {
+    memset(d, 0, sizeof(DeltaStore));
+    d->state = (unsigned char*)calloc(mainRows > 0 ? mainRows : 1, 1);
+}
+
+static void deltaFree(const ColumnStore* s, DeltaStore* d) {
+    for (int i = 0; i < d->updateCount; i++) storeFreeCells(s, d->updates[i].cells);
+    for (int i = 0; i < d->insertCount; i++) storeFreeCells(s, d->inserts[i].cells);
+    free(d->state);
+    free(d->deleted);
+    free(d->updates);
+    free(d->inserts);
+    memset(d, 0, sizeof(DeltaStore));
+}
+
+// 深拷贝增量区（合并线程用的快照）
+static void deltaCopy(const ColumnStore* s, DeltaStore* dst, const DeltaStore* src, int mainRows) {
+    deltaInit(dst, mainRows);
+    memcpy(dst->state, src->state, mainRows);
+    dst->deletedCount = dst->deletedCap = src->deletedCount;
+    dst->deleted = (int*)malloc((src->deletedCount > 0 ? src->deletedCount : 1) * sizeof(int));
+    memcpy(dst->deleted, src->deleted, src->deletedCount * sizeof(int));
+    dst->updateCount = dst->updateCap = src->updateCount;
+    dst->updates = (DeltaRow*)malloc((src->updateCount > 0 ? src->updateCount : 1) * sizeof(DeltaRow));
+    for (int i = 0; i < src->updateCount; i++) {
+        dst->updates[i] = src->updates[i];
+        dst->updates[i].cells = storeCopyCells(s, src->updates[i].cells);
+    }
+    dst->insertCount = dst->insertCap = src->insertCount;
+    dst->inserts = (DeltaRow*)malloc((src->insertCount > 0 ? src->insertCount : 1) * sizeof(DeltaRow));
+    for (int i = 0; i < src->insertCount; i++) {
+        dst->inserts[i] = src->inserts[i];
+        dst->inserts[i].cells = storeCopyCells(s, src->inserts[i].cells);
+    }
+}
+
+static int deltaSize(const DeltaStore* d) {
+    return d->deletedCount + d->updateCount + d->insertCount;
+}
+
+// updates中第一个下标 >= row 的位置
+static int deltaUpdatePos(const DeltaStore* d, int row) {
+    int lo = 0, hi = d->updateCount;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (d->updates[mid].row < row) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* deltaApply - 把一次改动记进增量区
+ * 
+ * 参数：
+ *   @m/@d: 主存和它的增量区
+ *   @op: STORE_OP_APPEND / STORE_OP_UPDATE / STORE_OP_DELETE
+ *   @node: 被改动的记录节点（删除时节点还没释放）
+ *   @cells: 追加/修改后的新值（删除时不用）
+ * 
+ * 节点在主存中（且没删过）就改主存行的状态，否则是追加的行，在inserts中从后往前找
+ * （删掉的节点地址可能被新追加的行重用，所以已删除的主存行不算命中）
+ * 时间复杂度：O(增量区大小)
+ */
+static void deltaApply(const ColumnStore* s, const MainStore* m, DeltaStore* d, int op, RecordNode* node, const Cell* cells) {
+    if (op == STORE_OP_APPEND) {
+        if (d->insertCount == d->insertCap) {
+            d->insertCap = d->insertCap ? d->insertCap * 2 : 16;
+            d->inserts = (DeltaRow*)realloc(d->inserts, d->insertCap * sizeof(DeltaRow));
+        }
+        d->inserts[d->insertCount].node = node;
+        d->inserts[d->insertCount].row = -1;
+        d->inserts[d->insertCount].cells = storeCopyCells(s, cells);
+        d->insertCount++;
+        return;
+    }
+    
+    int row = storeFindRow(m, node);
+    if (row >= 0 && d->state[row] != STORE_ROW_DELETED) {
+        int pos = deltaUpdatePos(d, row);
+        if (op == STORE_OP_UPDATE) {
+            if (d->state[row] == STORE_ROW_UPDATED) {
+                storeFreeCells(s, d->updates[pos].cells);
+                d->updates[pos].cells = storeCopyCells(s, cells);
+                return;
+            }
+            if (d->updateCount == d->updateCap) {
+                d->updateCap = d->updateCap ? d->updateCap * 2 : 16;
+                d->updates = (DeltaRow*)realloc(d->updates, d->updateCap * sizeof(DeltaRow));
+            }
+            memmove(&d->updates[pos + 1], &d->updates[pos], (d->updateCount - pos) * sizeof(DeltaRow));
+            d->updates[pos].node = NULL;
+            d->updates[pos].row = row;
+            d->updates[pos].cells = storeCopyCells(s, cells);
+            d->updateCount++;
+            d->state[row] = STORE_ROW_UPDATED;
+            return;
+        }
+        if (d->state[row] == STORE_ROW_UPDATED) {
+            storeFreeCells(s, d->updates[pos].cells);
+            memmove(&d->updates[pos], &d->updates[pos + 1], (d->updateCount - pos - 1) * sizeof(DeltaRow));
+            d->updateCount--;
+        }
+        d->state[row] = STORE_ROW_DELETED;
+        if (d->deletedCount == d->deletedCap) {
+            d->deletedCap = d->deletedCap ? d->deletedCap * 2 : 16;
+            d->deleted = (int*)realloc(d->deleted, d->deletedCap * sizeof(int));
+        }
+        pos = d->deletedCount;
+        while (pos > 0 && d->deleted[pos - 1] > row) pos--;
+        memmove(&d->deleted[pos + 1], &d->deleted[pos], (d->deletedCount - pos) * sizeof(int));
+        d->deleted[pos] = row;
+        d->deletedCount++;
+        return;
+    }
+    
+    for (int j = d->insertCount - 1; j >= 0; j--) {
+        if (d->inserts[j].node != node) continue;
+        storeFreeCells(s, d->inserts[j].cells);
+        if (op == STORE_OP_UPDATE) {
+            d->inserts[j].cells = storeCopyCells(s, cells);
+        } else {
+            memmove(&d->inserts[j], &d->inserts[j + 1], (d->insertCount - j - 1) * sizeof(DeltaRow));
+            d->insertCount--;
+        }
+        return;
+    }
+}
+
+/* storeNote - 增删改之后调用（删除在释放节点之前调用），把改动记进增量区
+ * 正在后台合并时另记一份日志，新主存装上后重放
+ */
+static void storeNote(Table* table, int op, RecordNode* node) {
+    ColumnStore* s = table->store;
+    if (!s || !s->main) return;
+    deltaApply(s, s->main, &s->delta, op, node, node->cells);
+    if (!s->merging) return;
+    if (s->logCount == s->logCap) {
+        s->logCap = s->logCap ? s->logCap * 2 : 64;
+        s->log = (StoreLogEntry*)realloc(s->log, s->logCap * sizeof(StoreLogEntry));
+    }
+    s->log[s->logCount].op = op;
+    s->log[s->logCount].node = node;
+    s->log[s->logCount].cells = op == STORE_OP_DELETE ? NULL : storeCopyCells(s, node->cells);
+    s->logCount++;
+}
+
+static void storeNoteAppend(Table* table, RecordNode* node) { storeNote(table, STORE_OP_APPEND, node); }
+static void storeNoteUpdate(Table* table, RecordNode* node) { storeNote(table, STORE_OP_UPDATE, node); }
+static void storeNoteDelete(Table* table, RecordNode* node) { storeNote(table, STORE_OP_DELETE, node); }
+
+static DWORD WINAPI storeMergeThread(LPVOID param) {
+    ColumnStore* s = (ColumnStore*)param;
+    HighResTimer timer;
+    timerStart(&timer);
+    s->merged = storeMerge(s->main, &s->snapshot, s->columns, s->numColumns);
+    s->runMs = timerEndMs(&timer);
+    InterlockedExchange(&s->done, 1);  // 发布merged
+    return 0;
+}
+
+// 开始一次后台合并：拍下增量区的副本交给线程（线程创建失败就地合并）
+static void storeStartMerge(ColumnStore* s) {
+    deltaCopy(s, &s->snapshot, &s->delta, s->main->rows);
+    s->merged = NULL;
+    s->done = 0;
+    s->merging = 1;
+    s->thread = CreateThread(NULL, 0, storeMergeThread, s, 0, NULL);
+    if (!s->thread) storeMergeThread(s);
+}
+
+/* storeFinishMerge - 合并完成就装上新主存：在新主存上重放合并期间的日志，得到新的增量区
+ * @wait: 1 = 还没完成就等它完成；0 = 没完成直接返回
+ * 返回值：装上了新主存返回1
+ */
+static int storeFinishMerge(ColumnStore* s, int wait) {
+    if (!s->merging) return 0;
+    if (!wait && InterlockedCompareExchange(&s->done, 0, 0) == 0) return 0;
+    if (s->thread) {
+        WaitForSingleObject(s->thread, INFINITE);
+        CloseHandle(s->thread);
+        s->thread = NULL;
+    }
+    s->merging = 0;
+    
+    MainStore* fresh = s->merged;
+    DeltaStore d;
+    deltaInit(&d, fresh->rows);
+    for (int i = 0; i < s->logCount; i++) {
+        deltaApply(s, fresh, &d, s->log[i].op, s->log[i].node, s->log[i].cells);
+        storeFreeCells(s, s->log[i].cells);
+    }
+    s->logCount = 0;
+    deltaFree(s, &s->snapshot);
+    freeMainStore(s->main, s->numColumns);
+    deltaFree(s, &s->delta);
+    s->main = fresh;
+    s->merged = NULL;
+    s->delta = d;
+    s->mergeMs = s->runMs;
+    s->merges++;
+    return 1;
+}
+
+/* storeInvalidate - 行顺序变了（中间插入、聚簇重排）：丢弃主存和增量区，下次查询时重建
+ * 正在合并就先等合并线程结束（只有改表的一方等，查询不受影响）
+ */
+static void storeInvalidate(Table* table) {
+    ColumnStore* s = table->store;
+    if (!s || !s->main) return;
+    storeFinishMerge(s, 1);
+    freeMainStore(s->main, s->numColumns);
+    s->main = NULL;
+    deltaFree(s, &s->delta);
+}
+
+// 开启列存：按当前内容建主存
+void enableColumnStore(Table* table) {
+    if (!table || table->store) return;
+    ColumnStore* s = (ColumnStore*)calloc(1, sizeof(ColumnStore));
+    s->columns = table->columns;
+    s->numColumns = table->numColumns;
+    s->main = storeBuildFromTable(table);
+    deltaInit(&s->delta, s->main->rows);
+    table->store = s;
+}
+
+// 关闭列存（释放表时也调用）
+static void freeColumnStore(Table* table) {
+    ColumnStore* s = table->store;
+    if (!s) return;
+    storeFinishMerge(s, 1);
+    freeMainStore(s->main, s->numColumns);
+    deltaFree(s, &s->delta);
+    free(s->log);
+    free(s);
+    table->store = NULL;
+}
+
+/* storeStep - 主循环在请求之间调用：装上已完成的合并；增量区够大就启动下一次后台合并
+ * 返回值：启动了合并返回1
+ */
+int storeStep(Table* table) {
+    ColumnStore* s = table ? table->store : NULL;
+    if (!s || !s->main) return 0;
+    storeFinishMerge(s, 0);
+    if (s->merging) return 0;
+    int threshold = s->main->rows >> STORE_MERGE_SHIFT;
+    if (threshold < STORE_MERGE_MIN) threshold = STORE_MERGE_MIN;
+    if (deltaSize(&s->delta) < threshold) return 0;
+    storeStartMerge(s);
+    return 1;
+}
+
+// 立即把增量区合并进主存（等待完成）
+void storeMergeNow(Table* table) {
+    ColumnStore* s = table ? table->store : NULL;
+    if (!s || !s->main) return;
+    if (!s->merging && deltaSize(&s->delta) > 0) storeStartMerge(s);
+    storeFinishMerge(s, 1);
+}
+
+// 查询前调用：装上已完成的合并，主存被丢弃过就从链表重建
+static ColumnStore* readyColumnStore(Table* table) {
+    ColumnStore* s = table->store;
+    if (!s) return NULL;
+    storeFinishMerge(s, 0);
+    if (!s->main) {
+        s->main = storeBuildFromTable(table);
+        deltaInit(&s->delta, s->main->rows);
+    }
+    return s;
+}
+
+typedef struct {
+    int col;
+    int low, high;               // 整数列：low <= 值 <= high
+    const char* value;           // 字符串列：等于value（整数查询为NULL）
+} StoreQuery;
+
+static int storeCellMatches(const StoreQuery* q, const Cell* cells) {
+    if (q->value) return strcmp(cellStr(&cells[q->col]), q->value) == 0;
+    int v = cells[q->col].data.int_val;
+    return v >= q->low && v <= q->high;
+}
+
+/* storeScanMain - 扫描主存的一列，把压缩值落在查询区间内的行下标写进cand，返回个数
+ * 查询先换算成压缩值的区间 [from, from+span]（字符串等值在有序字典里二分出字典码），
+ * 每种宽度一个紧凑循环，(code - from) <= span 一次无符号比较判断
+ */
+static int storeScanMain(const MainStore* m, const StoreQuery* q, unsigned int* cand) {
+    const StoreColumn* sc = &m->cols[q->col];
+    unsigned int from, span;
+    if (q->value) {
+        int lo = 0, hi = sc->dictSize;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (strcmp(sc->dict[mid], q->value) < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo >= sc->dictSize || strcmp(sc->dict[lo], q->value) != 0) return 0;
+        from = (unsigned int)lo;
+        span = 0;
+    } else {
+        long long lo = (long long)q->low - sc->base, hi = (long long)q->high - sc->base;
+        long long maxCode = sc->width == 1 ? 0xFF : (sc->width == 2 ? 0xFFFF : 0xFFFFFFFFLL);
+        if (lo < 0) lo = 0;
+        if (hi > maxCode) hi = maxCode;
+        if (lo > hi) return 0;
+        from = (unsigned int)lo;
+        span = (unsigned int)(hi - lo);
+    }
+    
+    int n = 0;
+    if (sc->width == 1) {
+        const unsigned char* p = sc->codes;
+        for (int i = 0; i < m->rows; i++) if ((unsigned int)(p[i] - from) <= span) cand[n++] = i;
+    } else if (sc->width == 2) {
+        const unsigned short* p = (const unsigned short*)sc->codes;
+        for (int i = 0; i < m->rows; i++) if ((unsigned int)(p[i] - from) <= span) cand[n++] = i;
+    } else {
+        const unsigned int* p = (const unsigned int*)sc->codes;
+        for (int i = 0; i < m->rows; i++) if (p[i] - from <= span) cand[n++] = i;
+    }
+    return n;
+}
+
+/* storeFind - 列存查询：主存命中 + 增量区，结果按行号升序
+ * 
+ * 主存命中中跳过删改过的行，修改过的行用增量区的新值判断，两者按主存下标归并；
+ * 主存行的行号 = 下标 + 1 - 它前面删掉的行数，追加的行排在所有主存行之后
+ * 时间复杂度：O(n)顺序扫描压缩列 + O(增量区大小)
+ */
+static SearchResult* storeFind(Table* table, const StoreQuery* q) {
+    ColumnStore* s = readyColumnStore(table);
+    if (!s) return createSearchResult(0);
+    const MainStore* m = s->main;
+    const DeltaStore* d = &s->delta;
+    unsigned int* cand = (unsigned int*)queryAlloc((m->rows > 0 ? m->rows : 1) * sizeof(unsigned int));
+    int nc = storeScanMain(m, q, cand);
+    SearchResult* sr = createSearchResult(nc);
+    
+    int i = 0, u = 0, del = 0;
+    while (i < nc || u < d->updateCount) {
+        int row;
+        if (u < d->updateCount && (i >= nc || d->updates[u].row < (int)cand[i])) {
+            row = d->updates[u].row;
+            if (!storeCellMatches(q, d->updates[u++].cells)) continue;
+        } else {
+            row = (int)cand[i++];
+            if (d->state[row] != STORE_ROW_LIVE) continue;  // 删掉的不要，修改过的以增量区为准
+        }
+        while (del < d->deletedCount && d->deleted[del] < row) del++;
+        addToResult(sr, row + 1 - del);
+    }
+    int liveRows = m->rows - d->deletedCount;
+    for (int j = 0; j < d->insertCount; j++) {
+        if (storeCellMatches(q, d->inserts[j].cells)) addToResult(sr, liveRows + j + 1);
+    }
+    return sr;
+}
+
+// 列存上查找整数列 low <= 值 <= high 的记录
+SearchResult* storeFindRange(Table* table, int colIdx, int low, int high) {
+    StoreQuery q;
+    q.col = colIdx;
+    q.low = low;
+    q.high = high;
+    q.value = NULL;
+    return storeFind(table, &q);
+}
+
+// 列存上查找字符串列等于value的记录
+SearchResult* storeFindStrEqual(Table* table, int colIdx, const char* value) {
+    StoreQuery q;
+    q.col = colIdx;
+    q.low = 0;
+    q.high = -1;
+    q.value = value;
+    return storeFind(table, &q);
+}
+
+// 列存状态：主存大小（压缩后）、增量区、合并情况
+void printColumnStoreStats(Table* table) {
+    ColumnStore* s = table->store;
+    if (!s) {
+        printf("Column store is off.\n");
+        return;
+    }
+    if (!s->main) {
+        printf("Column store: main dropped after rows were reordered, rebuilt on next search.\n");
+        return;
+    }
+    size_t mainBytes = 0;
+    for (int c = 0; c < s->numColumns; c++) {
+        const StoreColumn* sc = &s->main->cols[c];
+        mainBytes += (size_t)s->main->rows * sc->width;
+        for (int i = 0; i < sc->dictSize; i++) mainBytes += strlen(sc->dict[i]) + 1;
+    }
+    size_t rowBytes = (size_t)table->rowCount * (sizeof(RecordNode) + table->numColumns * sizeof(Cell));
+    printf("Main:  %d rows, %.1f KB compressed (row store %.1f KB)\n", s->main->rows, mainBytes / 1024.0, rowBytes / 1024.0);
+    for (int c = 0; c < s->numColumns; c++) {
+        const StoreColumn* sc = &s->main->cols[c];
+        if (sc->dict) printf("  [%d] %-12s dictionary %d values, %d-byte codes\n", c, table->columns[c].name, sc->dictSize, sc->width);
+        else printf("  [%d] %-12s base %d, %d-byte values\n", c, table->columns[c].name, sc->base, sc->width);
+    }
+    printf("Delta: %d appended, %d updated, %d deleted\n", s->delta.insertCount, s->delta.updateCount, s->delta.deletedCount);
+    printf("Merges: %d", s->merges);
+    if (s->merges > 0) printf(" (last %.2f ms)", s->mergeMs);
+    if (s->merging) printf(", merging in background");
+    printf("\n");
+}
+
+// 检索菜单用：开启了列存时，打印按列存查询的耗时
+static void reportStoreSearch(Table* table, int colIdx, int low, int high, const char* strValue) {
+    ColumnStore* s = table->store;
+    if (!s) return;
+    int rebuilt = !s->main;
+    HighResTimer timer;
+    timerStart(&timer);
+    SearchResult* sr = strValue ? storeFindStrEqual(table, colIdx, strValue) : storeFindRange(table, colIdx, low, high);
+    double t = timerEndMicro(&timer);
+    if (rebuilt) {
+        printf("Column store:  %.2f us (%.4f ms), found %d (main rebuilt from rows)\n", t, t/1000.0, sr->count);
+    } else {
+        printf("Column store:  %.2f us (%.4f ms), found %d (main %d rows + delta %d changes)\n", t, t/1000.0,
+               sr->count, s->main->rows, deltaSize(&s->delta));
+    }
+    freeSearchResult(sr);
+}
+
+/*==================== LSM存储引擎 ====================*/
+/* 写多的表（如事件流水）每次保存都重写整个JSON太慢。LSM存储按主键把表持久化到一组文件：
+ *   <名字>.lsm      清单：列定义、主键列、现有的有序段（从新到旧）
+ *   <名字>.wal      预写日志：内存表中的每次改动追加一条，重新打开时重放
+ *   <名字>.run<N>   不可变的有序段：按主键排好序的记录 + 栅栏指针 + 布隆过滤器
+ * 
+ * 写：追加一条WAL记录（顺序写），再放进内存表（按主键有序的数组）；
+ *     内存表满 LSM_MEMTABLE_ROWS 条就整体顺序写成一个新段，清空WAL
+ * 按主键读：内存表 -> 各段从新到旧；每段先问布隆过滤器，可能存在再用栅栏指针
+ *     二分出唯一一个块（LSM_FENCE_EVERY 条），只从磁盘读这一块
+ * 范围读：每段从栅栏定位的块开始顺序读，多路归并，新的版本覆盖旧的
+ * 合并（按大小分层 size-tiered）：段按条数分层，第t层约为内存表的 LSM_MAX_RUNS^t 倍；
+ *     同一层相邻的段攒够 LSM_MAX_RUNS 个时，后台线程把它们归并成上一层的一个段，丢掉被覆盖的旧版本
+ *     （包含最旧的段时墓碑也一起丢掉）；期间新刷出的段照常加在前面，装上时只替换被合并的那几段。
+ *     每条记录大约被重写 层数 次，段数保持在 O(LSM_MAX_RUNS × 层数)
+ * 
+ * 表在内存中照常使用，LSM只负责持久化：增删改通过 lsmNotePut / lsmNoteDelete 同步写入。
+ * 从LSM打开的表按主键顺序排列行。
+ */
+
+#define LSM_MEMTABLE_ROWS 4096   // 内存表条数上限，满了刷成一个段
+#define LSM_FENCE_EVERY 64       // 每块条数（每块一个栅栏指针）
+#define LSM_MAX_RUNS 4           // 同一层的段数达到此值时合并（也是相邻两层的大小倍数）
+#define LSM_MAGIC "TLSM"
+#define LSM_RUN_MAGIC "TRUN"
+#define LSM_FORMAT 2             // 2：字符串长度前缀改为4字节
+
+typedef struct {
+    Cell key;                    // 主键值（字符串键单独持有）
+    Cell* cells;                 // 整行副本，NULL表示删除（墓碑）
+} LsmEntry;
+
+typedef struct {
+    unsigned char* data;
+    size_t size, cap;
+} LsmBuf;
+
+typedef struct {
+    char magic[4];
+    int format;
+    int count;                   // 记录条数
+    int fenceCount;              // 块数
+    unsigned int dataEnd;        // 数据区结束位置（栅栏区从这里开始）
+    unsigned int bloomBlocks;    // 布隆过滤器块数（紧跟栅栏区）
+    int bloomItems;
+    int reserved;
+} LsmRunHeader;
+
+typedef struct {
+    int id;
+    int count;
+    int fenceCount;
+    Cell* fenceKeys;             // 每块第一条的主键
+    unsigned int* fenceOffsets;  // 每块在文件中的位置，fenceOffsets[fenceCount] = 数据区末尾
+    StringBloom* bloom;          // 段内主键的布隆过滤器
+    FILE* file;                  // 读句柄（只在主线程用）
+} LsmRun;
+
+typedef struct LsmStore {
+    char base[256];              // 文件名前缀
+    Column* columns;             // 列定义副本
+    int numColumns;
+    int keyColumn;               // 主键列
+    LsmEntry** mem;              // 内存表：按主键有序
+    int memCount, memCap;
+    FILE* wal;
+    LsmBuf buf;                  // 编码/读块用的缓冲（主线程）
+    LsmRun** runs;               // 有序段，从新到旧
+    int runCount;
+    int nextRunId;
+    // 后台合并
+    int compacting;              // 1 = 合并已开始、结果还没装上
+    HANDLE thread;
+    volatile LONG done;
+    int* compactIds;             // 参与合并的段（从新到旧、相邻），线程只读
+    int compactCount;
+    int compactTarget;           // 合并结果的段号
+    int compactDropTombstones;   // 1 = 合并的段包含最旧的段，墓碑可以丢掉
+    int compactOk;               // 线程写入：是否成功
+    double compactRunMs;         // 线程写入：用时
+    // 统计
+    int flushes, compactions;
+    double compactMs;
+    long long walRecords;
+    int lookups, bloomSkips, blocksRead;
+} LsmStore;
+
+static void lsmBufPut(LsmBuf* b, const void* p, size_t n) {
+    if (b->size + n > b->cap) {
+        while (b->size + n > b->cap) b->cap = b->cap ? b->cap * 2 : 256;
+        b->data = (unsigned char*)realloc(b->data, b->cap);
+    }
+    memcpy(b->data + b->size, p, n);
+    b->size += n;
+}
+
+// 单元格编码：整数4字节；字符串4字节长度 + 内容
+static void lsmPutCell(LsmBuf* b, int type, const Cell* cell) {
+    if (type == 1) {
+        lsmBufPut(b, &cell->data.int_val, 4);
+        return;
+    }
+    const char* s = cellStr(cell);
+    unsigned int len = (unsigned int)strlen(s);
+    lsmBufPut(b, &len, 4);
+    lsmBufPut(b, s, len);
+}
+
+// 解码一个单元格，返回用掉的字节数，数据不完整返回0
+static size_t lsmGetCell(int type, const unsigned char* p, size_t n, Cell* out) {
+    if (type == 1) {
+        if (n < 4) return 0;
+        memcpy(&out->data.int_val, p, 4);
+        return 4;
+    }
+    if (n < 4) return 0;
+    unsigned int len;
+    memcpy(&len, p, 4);
+    if (n - 4 < len) return 0;
+    memset(out->data.inline_str, 0, sizeof(out->data.inline_str));
+    if (len <= CELL_INLINE_MAX) {
+        memcpy(out->data.inline_str, p + 4, len);
+    } else {
+        char* s = (char*)malloc((size_t)len + 1);
+        memcpy(s, p + 4, len);
+        s[len] = '\0';
+        out->data.str_val = s;
+        out->data.inline_str[CELL_INLINE_MAX] = CELL_HEAP_TAG;
+    }
+    return 4 + (size_t)len;
+}
+
+static int lsmKeyType(const LsmStore* lsm) {
+    return lsm->columns[lsm->keyColumn].type;
+}
+
+static int lsmCompare(const LsmStore* lsm, const Cell* a, const Cell* b) {
+    if (lsmKeyType(lsm) == 1) return (a->data.int_val > b->data.int_val) - (a->data.int_val < b->data.int_val);
+    return strcmp(cellStr(a), cellStr(b));
+}
+
+static unsigned long long lsmKeyHash(const LsmStore* lsm, const Cell* key) {
+    if (lsmKeyType(lsm) != 1) return bloomHash(cellStr(key));
+    unsigned long long h = (unsigned int)key->data.int_val * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// 记录编码：1字节标记（1 = 墓碑）+ 主键 + 整行（墓碑没有）
+static void lsmEncode(const LsmStore* lsm, LsmBuf* b, const Cell* key, const Cell* cells) {
+    unsigned char flag = cells ? 0 : 1;
+    b->size = 0;
+    lsmBufPut(b, &flag, 1);
+    lsmPutCell(b, lsmKeyType(lsm), key);
+    for (int c = 0; cells && c < lsm->numColumns; c++) lsmPutCell(b, lsm->columns[c].type, &cells[c]);
+}
+
+static int lsmDecode(const LsmStore* lsm, const unsigned char* p, size_t n, LsmEntry* e) {
+    if (n < 1) return 0;
+    size_t pos = 1, k;
+    memset(e, 0, sizeof(LsmEntry));
+    if (!(k = lsmGetCell(lsmKeyType(lsm), p + pos, n - pos, &e->key))) return 0;
+    pos += k;
+    if (p[0] & 1) return 1;
+    e->cells = (Cell*)calloc(lsm->numColumns, sizeof(Cell));
+    for (int c = 0; c < lsm->numColumns; c++) {
+        if (!(k = lsmGetCell(lsm->columns[c].type, p + pos, n - pos, &e->cells[c]))) {
+            freeCells(e->cells, lsm->columns, lsm->numColumns);
+            free(e->cells);
+            if (lsmKeyType(lsm) != 1) cellFreeStr(&e->key);
+            return 0;
+        }
+        pos += k;
+    }
+    return 1;
+}
+
+static void lsmFreeEntry(const LsmStore* lsm, LsmEntry* e) {
+    if (lsmKeyType(lsm) != 1) cellFreeStr(&e->key);
+    if (e->cells) {
+        freeCells(e->cells, lsm->columns, lsm->numColumns);
+        free(e->cells);
+    }
+    e->cells = NULL;
+}
+
+static void lsmRunName(char* out, size_t size, const char* base, int id) {
+    snprintf(out, size, "%s.run%d", base, id);
+}
+
+/*-------- 写段 --------*/
+
+typedef struct {
+    const LsmStore* lsm;
+    FILE* file;
+    LsmBuf buf;
+    LsmBuf fences;               // 栅栏区（位置 + 键），数据写完后接在后面
+    int count;
+    int fenceCount;
+    unsigned int offset;         // 下一条记录的位置
+    StringBloom* bloom;
+} LsmRunWriter;
+
+static int lsmWriterOpen(LsmRunWriter* w, const LsmStore* lsm, const char* path, int expected) {
+    memset(w, 0, sizeof(LsmRunWriter));
+    w->lsm = lsm;
+    w->file = fopen(path, "wb");
+    if (!w->file) return 0;
+    LsmRunHeader header;
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, w->file);  // 先占位，写完再回填
+    w->offset = sizeof(header);
+    w->bloom = createBloom(expected);
+    return 1;
+}
+
+static void lsmWriterAdd(LsmRunWriter* w, const Cell* key, const Cell* cells) {
+    if (w->count % LSM_FENCE_EVERY == 0) {
+        lsmBufPut(&w->fences, &w->offset, 4);
+        lsmPutCell(&w->fences, lsmKeyType(w->lsm), key);
+        w->fenceCount++;
+    }
+    lsmEncode(w->lsm, &w->buf, key, cells);
+    unsigned int len = (unsigned int)w->buf.size;
+    fwrite(&len, 4, 1, w->file);
+    fwrite(w->buf.data, 1, len, w->file);
+    w->offset += 4 + len;
+    bloomAddHash(w->bloom, lsmKeyHash(w->lsm, key));
+    w->count++;
+}
+
+// 写栅栏区、布隆过滤器，回填文件头。返回值：成功返回1（失败时文件已删除）
+static int lsmWriterClose(LsmRunWriter* w, const char* path) {
+    LsmRunHeader header;
+    memcpy(header.magic, LSM_RUN_MAGIC, 4);
+    header.format = LSM_FORMAT;
+    header.count = w->count;
+    header.fenceCount = w->fenceCount;
+    header.dataEnd = w->offset;
+    header.bloomBlocks = w->bloom->numBlocks;
+    header.bloomItems = w->bloom->items;
+    header.reserved = 0;
+    size_t bloomBytes = (size_t)w->bloom->numBlocks * BLOOM_BLOCK_SIZE;
+    int ok = fwrite(w->fences.data ? w->fences.data : (unsigned char*)"", 1, w->fences.size, w->file) == w->fences.size
+          && fwrite(w->bloom->counters, 1, bloomBytes, w->file) == bloomBytes
+          && fseek(w->file, 0, SEEK_SET) == 0
+          && fwrite(&header, sizeof(header), 1, w->file) == 1;
+    ok = (fclose(w->file) == 0) && ok;
+    free(w->buf.data);
+    free(w->fences.data);
+    freeBloom(w->bloom);
+    if (!ok) remove(path);
+    return ok;
+}
+
+/*-------- 读段 --------*/
+
+static void lsmCloseRun(const LsmStore* lsm, LsmRun* run) {
+    if (!run) return;
+    for (int i = 0; lsmKeyType(lsm) != 1 && i < run->fenceCount; i++) cellFreeStr(&run->fenceKeys[i]);
+    free(run->fenceKeys);
+    free(run->fenceOffsets);
+    freeBloom(run->bloom);
+    if (run->file) fclose(run->file);
+    free(run);
+}
+
+// 打开一个段：读入文件头、栅栏指针和布隆过滤器，记录留在磁盘上
+static LsmRun* lsmOpenRun(const LsmStore* lsm, int id) {
+    char path[300];
+    lsmRunName(path, sizeof(path), lsm->base, id);
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    LsmRunHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, LSM_RUN_MAGIC, 4) != 0
+        || header.format != LSM_FORMAT || header.fenceCount < 0 || fseek(file, 0, SEEK_END) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    long fileSize = ftell(file);
+    size_t bloomBytes = (size_t)header.bloomBlocks * BLOOM_BLOCK_SIZE;
+    if (fileSize < (long)header.dataEnd || header.bloomBlocks == 0 || (header.bloomBlocks & (header.bloomBlocks - 1))
+        || (size_t)(fileSize - header.dataEnd) < bloomBytes) {
+        fclose(file);
+        return NULL;
+    }
+    size_t tailSize = (size_t)(fileSize - header.dataEnd);
+    unsigned char* tail = (unsigned char*)malloc(tailSize > 0 ? tailSize : 1);
+    fseek(file, (long)header.dataEnd, SEEK_SET);
+    if (fread(tail, 1, tailSize, file) != tailSize) {
+        free(tail);
+        fclose(file);
+        return NULL;
+    }
+    
+    LsmRun* run = (LsmRun*)calloc(1, sizeof(LsmRun));
+    run->id = id;
+    run->count = header.count;
+    run->file = file;
+    run->fenceKeys = (Cell*)calloc(header.fenceCount + 1, sizeof(Cell));
+    run->fenceOffsets = (unsigned int*)malloc((header.fenceCount + 1) * sizeof(unsigned int));
+    size_t pos = 0, fenceEnd = tailSize - bloomBytes;
+    int ok = 1;
+    for (int i = 0; ok && i < header.fenceCount; i++) {
+        size_t k = 0;
+        ok = pos + 4 <= fenceEnd;
+        if (ok) memcpy(&run->fenceOffsets[i], tail + pos, 4);
+        ok = ok && (k = lsmGetCell(lsmKeyType(lsm), tail + pos + 4, fenceEnd - pos - 4, &run->fenceKeys[i])) != 0;
+        if (ok) run->fenceCount++;
+        pos += 4 + k;
+    }
+    run->fenceOffsets[run->fenceCount] = header.dataEnd;
+    if (ok && pos == fenceEnd) {
+        run->bloom = (StringBloom*)malloc(sizeof(StringBloom));
+        run->bloom->counters = (unsigned char*)malloc(bloomBytes);
+        memcpy(run->bloom->counters, tail + fenceEnd, bloomBytes);
+        run->bloom->numBlocks = header.bloomBlocks;
+        run->bloom->capacity = header.bloomItems;
+        run->bloom->items = header.bloomItems;
+    }
+    free(tail);
+    if (!run->bloom) {
+        lsmCloseRun(lsm, run);
+        return NULL;
+    }
+    return run;
+}
+
+/* lsmRunGet - 在一个段中按主键查找
+ * 返回值：1 找到（*out 为解码出的记录，可能是墓碑），0 不在此段
+ * 布隆过滤器说不存在就不碰磁盘；否则二分栅栏定位到一个块，只读这一块
+ */
+static int lsmRunGet(LsmStore* lsm, LsmRun* run, const Cell* key, LsmEntry* out) {
+    if (!bloomMayContainHash(run->bloom, lsmKeyHash(lsm, key))) {
+        lsm->bloomSkips++;
+        return 0;
+    }
+    int lo = 0, hi = run->fenceCount;  // 最后一个首键 <= key 的块
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (lsmCompare(lsm, &run->fenceKeys[mid], key) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return 0;
+    int block = lo - 1;
+    unsigned int from = run->fenceOffsets[block], to = run->fenceOffsets[block + 1];
+    lsm->buf.size = 0;
+    if (lsm->buf.cap < to - from) {
+        lsm->buf.cap = to - from;
+        lsm->buf.data = (unsigned char*)realloc(lsm->buf.data, lsm->buf.cap);
+    }
+    if (fseek(run->file, (long)from, SEEK_SET) != 0 || fread(lsm->buf.data, 1, to - from, run->file) != to - from) return 0;
+    lsm->blocksRead++;
+    
+    size_t pos = 0, size = to - from;
+    while (pos + 4 <= size) {
+        unsigned int len;
+        memcpy(&len, lsm->buf.data + pos, 4);
+        if (pos + 4 + len > size) break;
+        LsmEntry e;
+        if (!lsmDecode(lsm, lsm->buf.data + pos + 4, len, &e)) break;
+        int c = lsmCompare(lsm, &e.key, key);
+        if (c == 0) {
+            *out = e;
+            return 1;
+        }
+        lsmFreeEntry(lsm, &e);
+        if (c > 0) break;
+        pos += 4 + len;
+    }
+    return 0;
+}
+
+/*-------- 多路归并 --------*/
+
+typedef struct {
+    int isMem;                   // 1 = 内存表，0 = 段文件
+    int memPos;
+    FILE* file;
+    unsigned int pos, end;
+    LsmBuf buf;
+    LsmEntry cur;                // 当前记录（段文件的由游标持有，内存表的只是引用）
+    int valid;
+} LsmCursor;
+
+static void lsmCursorNext(const LsmStore* lsm, LsmCursor* c) {
+    if (c->isMem) {
+        if (c->valid) c->memPos++;
+        c->valid = c->memPos < lsm->memCount;
+        if (c->valid) c->cur = *lsm->mem[c->memPos];
+        return;
+    }
+    if (c->valid) lsmFreeEntry(lsm, &c->cur);
+    c->valid = 0;
+    unsigned int len;
+    if (c->pos + 4 > c->end || fread(&len, 4, 1, c->file) != 1 || c->pos + 4 + len > c->end) return;
+    c->buf.size = 0;
+    if (c->buf.cap < len) {
+        c->buf.cap = len;
+        c->buf.data = (unsigned char*)realloc(c->buf.data, c->buf.cap);
+    }
+    if (fread(c->buf.data, 1, len, c->file) != len) return;
+    c->pos += 4 + len;
+    c->valid = lsmDecode(lsm, c->buf.data, len, &c->cur);
+}
+
+// 段游标：从第block块开始顺序读
+static void lsmCursorOpenRun(const LsmStore* lsm, LsmCursor* c, FILE* file, const LsmRun* run, int block) {
+    memset(c, 0, sizeof(LsmCursor));
+    c->file = file;
+    c->pos = run->fenceOffsets[block];
+    c->end = run->fenceOffsets[run->fenceCount];
+    fseek(file, (long)c->pos, SEEK_SET);
+    lsmCursorNext(lsm, c);
+}
+
+static void lsmCursorClose(const LsmStore* lsm, LsmCursor* c) {
+    if (!c->isMem && c->valid) lsmFreeEntry(lsm, &c->cur);
+    free(c->buf.data);
+    c->valid = 0;
+}
+
+// 当前最小的键所在的游标；同一个键取下标最小的（最新的），没有了返回-1
+static int lsmMergePick(const LsmStore* lsm, LsmCursor* cs, int n) {
+    int best = -1;
+    for (int i = 0; i < n; i++) {
+        if (cs[i].valid && (best < 0 || lsmCompare(lsm, &cs[i].cur.key, &cs[best].cur.key) < 0)) best = i;
+    }
+    return best;
+}
+
+// 所有停在winner这个键上的游标都前进一步（旧版本一起跳过）
+static void lsmMergeAdvance(const LsmStore* lsm, LsmCursor* cs, int n, int winner) {
+    for (int i = 0; i < n; i++) {
+        if (i != winner && cs[i].valid && lsmCompare(lsm, &cs[i].cur.key, &cs[winner].cur.key) == 0) lsmCursorNext(lsm, &cs[i]);
+    }
+    lsmCursorNext(lsm, &cs[winner]);
+}
+
+/*-------- 清单、内存表、WAL --------*/
+
+// 写清单：先写临时文件再替换，任何时候磁盘上都有一份完整的清单
+static int lsmWriteManifest(const LsmStore* lsm) {
+    char path[300], tmp[310];
+    snprintf(path, sizeof(path), "%s.lsm", lsm->base);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* file = fopen(tmp, "wb");
+    if (!file) return 0;
+    int head[5] = { LSM_FORMAT, lsm->numColumns, lsm->keyColumn, lsm->nextRunId, lsm->runCount };
+    int ok = fwrite(LSM_MAGIC, 1, 4, file) == 4 && fwrite(head, sizeof(head), 1, file) == 1;
+    for (int c = 0; ok && c < lsm->numColumns; c++) {
+        int nameLen = (int)strlen(lsm->columns[c].name);
+        ok = fwrite(&lsm->columns[c].type, 4, 1, file) == 1 && fwrite(&nameLen, 4, 1, file) == 1
+          && fwrite(lsm->columns[c].name, 1, nameLen, file) == (size_t)nameLen;
+    }
+    for (int i = 0; ok && i < lsm->runCount; i++) ok = fwrite(&lsm->runs[i]->id, 4, 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    if (ok) ok = MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING) != 0;
+    if (!ok) remove(tmp);
+    return ok;
+}
+
+// 内存表中第一个键 >= key 的位置
+static int lsmMemLowerBound(const LsmStore* lsm, const Cell* key) {
+    int lo = 0, hi = lsm->memCount;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (lsmCompare(lsm, &lsm->mem[mid]->key, key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// 放进内存表（同一个键只留最新的版本），cells为NULL表示删除
+static void lsmMemPut(LsmStore* lsm, const Cell* key, const Cell* cells) {
+    int pos = lsmMemLowerBound(lsm, key);
+    LsmEntry* e;
+    if (pos < lsm->memCount && lsmCompare(lsm, &lsm->mem[pos]->key, key) == 0) {
+        e = lsm->mem[pos];
+        lsmFreeEntry(lsm, e);
+    } else {
+        if (lsm->memCount == lsm->memCap) {
+            lsm->memCap = lsm->memCap ? lsm->memCap * 2 : 256;
+            lsm->mem = (LsmEntry**)realloc(lsm->mem, lsm->memCap * sizeof(LsmEntry*));
+        }
+        memmove(&lsm->mem[pos + 1], &lsm->mem[pos], (lsm->memCount - pos) * sizeof(LsmEntry*));
+        e = (LsmEntry*)malloc(sizeof(LsmEntry));
+        lsm->mem[pos] = e;
+        lsm->memCount++;
+    }
+    e->key = *key;
+    if (lsmKeyType(lsm) != 1) cellSetStr(&e->key, cellStr(key));
+    e->cells = NULL;
+    if (cells) {
+        e->cells = (Cell*)malloc(lsm->numColumns * sizeof(Cell));
+        deepCopyCells(e->cells, (Cell*)cells, lsm->columns, lsm->numColumns);
+    }
+}
+
+static void lsmMemClear(LsmStore* lsm) {
+    for (int i = 0; i < lsm->memCount; i++) {
+        lsmFreeEntry(lsm, lsm->mem[i]);
+        free(lsm->mem[i]);
+    }
+    lsm->memCount = 0;
+}
+
+// WAL记录：4字节长度 + 4字节校验 + 编码后的记录；每条写完就交给操作系统
+static void lsmWalAppend(LsmStore* lsm, const Cell* key, const Cell* cells) {
+    if (!lsm->wal) return;
+    lsmEncode(lsm, &lsm->buf, key, cells);
+    unsigned int head[2];
+    head[0] = (unsigned int)lsm->buf.size;
+    head[1] = (unsigned int)checksumText((const char*)lsm->buf.data, lsm->buf.size);
+    fwrite(head, sizeof(head), 1, lsm->wal);
+    fwrite(lsm->buf.data, 1, lsm->buf.size, lsm->wal);
+    fflush(lsm->wal);
+    lsm->walRecords++;
+}
+
+// 重放WAL到内存表，遇到写了一半的尾部记录就停
+// 返回值：1 整个文件都是完整的记录，0 尾部有残缺（不能再接着往后追加）
+static int lsmWalReplay(LsmStore* lsm, FILE* file) {
+    unsigned int head[2];
+    long end = 0;
+    while (fread(head, sizeof(head), 1, file) == 1 && head[0] < (1u << 30)) {
+        lsm->buf.size = 0;
+        if (lsm->buf.cap < head[0]) {
+            lsm->buf.cap = head[0];
+            lsm->buf.data = (unsigned char*)realloc(lsm->buf.data, lsm->buf.cap);
+        }
+        if (fread(lsm->buf.data, 1, head[0], file) != head[0]) break;
+        if ((unsigned int)checksumText((const char*)lsm->buf.data, head[0]) != head[1]) break;
+        LsmEntry e;
+        if (!lsmDecode(lsm, lsm->buf.data, head[0], &e)) break;
+        lsmMemPut(lsm, &e.key, e.cells);
+        lsmFreeEntry(lsm, &e);
+        lsm->walRecords++;
+        end = ftell(file);
+    }
+    fseek(file, 0, SEEK_END);
+    return ftell(file) == end;
+}
+
+/*-------- 刷盘与后台合并 --------*/
+
+static DWORD WINAPI lsmCompactThread(LPVOID param) {
+    LsmStore* lsm = (LsmStore*)param;
+    HighResTimer timer;
+    timerStart(&timer);
+    int n = lsm->compactCount, total = 0, ok = 1;
+    LsmCursor* cs = (LsmCursor*)calloc(n, sizeof(LsmCursor));
+    LsmRun** inputs = (LsmRun**)calloc(n, sizeof(LsmRun*));
+    for (int i = 0; i < n; i++) {
+        // 段的元数据线程自己读一份，文件句柄也各用各的，不和主线程共享
+        inputs[i] = lsmOpenRun(lsm, lsm->compactIds[i]);
+        if (!inputs[i]) { ok = 0; continue; }
+        lsmCursorOpenRun(lsm, &cs[i], inputs[i]->file, inputs[i], 0);
+        total += inputs[i]->count;
+    }
+    char path[300];
+    lsmRunName(path, sizeof(path), lsm->base, lsm->compactTarget);
+    LsmRunWriter w;
+    if (ok) ok = lsmWriterOpen(&w, lsm, path, total);
+    if (ok) {
+        int winner;
+        while ((winner = lsmMergePick(lsm, cs, n)) >= 0) {
+            if (cs[winner].cur.cells || !lsm->compactDropTombstones) lsmWriterAdd(&w, &cs[winner].cur.key, cs[winner].cur.cells);
+            lsmMergeAdvance(lsm, cs, n, winner);
+        }
+        ok = lsmWriterClose(&w, path);
+    }
+    for (int i = 0; i < n; i++) {
+        lsmCursorClose(lsm, &cs[i]);
+        lsmCloseRun(lsm, inputs[i]);
+    }
+    free(cs);
+    free(inputs);
+    lsm->compactOk = ok;
+    lsm->compactRunMs = timerEndMs(&timer);
+    InterlockedExchange(&lsm->done, 1);
+    return 0;
+}
+
+// 段所在的层：条数不超过 内存表大小 × LSM_MAX_RUNS^t 的最小t
+static int lsmTier(const LsmRun* run) {
+    long long size = LSM_MEMTABLE_ROWS;
+    int t = 0;
+    while (run->count > size) {
+        size *= LSM_MAX_RUNS;
+        t++;
+    }
+    return t;
+}
+
+// 找一组同层、相邻、至少 LSM_MAX_RUNS 个的段（从最新的开始找），找到返回1
+static int lsmPickCompaction(const LsmStore* lsm, int* from, int* count) {
+    for (int i = 0; i < lsm->runCount; ) {
+        int j = i + 1;
+        while (j < lsm->runCount && lsmTier(lsm->runs[j]) == lsmTier(lsm->runs[i])) j++;
+        if (j - i >= LSM_MAX_RUNS) {
+            *from = i;
+            *count = j - i;
+            return 1;
+        }
+        i = j;
+    }
+    return 0;
+}
+
+// 把 runs[from, from+count) 交给后台线程合并（线程创建失败就地合并）
+static void lsmStartCompaction(LsmStore* lsm, int from, int count) {
+    if (lsm->compacting || count < 2) return;
+    lsm->compactCount = count;
+    lsm->compactIds = (int*)malloc(count * sizeof(int));
+    for (int i = 0; i < count; i++) lsm->compactIds[i] = lsm->runs[from + i]->id;
+    lsm->compactDropTombstones = (from + count == lsm->runCount);
+    lsm->compactTarget = lsm->nextRunId++;
+    lsm->compacting = 1;
+    lsm->done = 0;
+    lsm->thread = CreateThread(NULL, 0, lsmCompactThread, lsm, 0, NULL);
+    if (!lsm->thread) lsmCompactThread(lsm);
+}
+
+/* lsmFinishCompaction - 合并完成就装上：被合并的那几段换成合并结果，写清单，再删旧段文件
+ * @wait: 1 = 没完成就等；0 = 没完成直接返回
+ */
+static void lsmFinishCompaction(LsmStore* lsm, int wait) {
+    if (!lsm->compacting) return;
+    if (!wait && InterlockedCompareExchange(&lsm->done, 0, 0) == 0) return;
+    if (lsm->thread) {
+        WaitForSingleObject(lsm->thread, INFINITE);
+        CloseHandle(lsm->thread);
+        lsm->thread = NULL;
+    }
+    lsm->compacting = 0;
+    LsmRun* merged = lsm->compactOk ? lsmOpenRun(lsm, lsm->compactTarget) : NULL;
+    char path[300];
+    if (merged) {
+        int from = 0;  // 合并期间新刷出的段加在前面，被合并的段整体后移
+        while (lsm->runs[from]->id != lsm->compactIds[0]) from++;
+        int n = lsm->compactCount, after = lsm->runCount - from - n;
+        LsmRun** old = (LsmRun**)malloc(n * sizeof(LsmRun*));
+        memcpy(old, lsm->runs + from, n * sizeof(LsmRun*));
+        lsm->runs[from] = merged;
+        memmove(lsm->runs + from + 1, lsm->runs + from + n, after * sizeof(LsmRun*));
+        lsm->runCount -= n - 1;
+        if (lsmWriteManifest(lsm)) {
+            for (int i = 0; i < lsm->compactCount; i++) {
+                lsmRunName(path, sizeof(path), lsm->base, old[i]->id);
+                lsmCloseRun(lsm, old[i]);
+                remove(path);
+            }
+            lsm->compactions++;
+            lsm->compactMs = lsm->compactRunMs;
+        } else {
+            // 清单没写成：还用旧的段
+            memmove(lsm->runs + from + n, lsm->runs + from + 1, after * sizeof(LsmRun*));
+            memcpy(lsm->runs + from, old, n * sizeof(LsmRun*));
+            lsm->runCount += n - 1;
+            lsmCloseRun(lsm, merged);
+            merged = NULL;
+        }
+        free(old);
+    }
+    if (!merged) {
+        lsmRunName(path, sizeof(path), lsm->base, lsm->compactTarget);
+        remove(path);
+    }
+    free(lsm->compactIds);
+    lsm->compactIds = NULL;
+}
+
+/* lsmFlush - 内存表顺序写成一个新段，放在最前面；写好清单后清空WAL
+ * 有一层攒够了段就启动后台合并
+ */
+static int lsmFlush(LsmStore* lsm) {
+    if (lsm->memCount == 0) return 1;
+    lsmFinishCompaction(lsm, 0);
+    int id = lsm->nextRunId++;
+    char path[300];
+    lsmRunName(path, sizeof(path), lsm->base, id);
+    LsmRunWriter w;
+    if (!lsmWriterOpen(&w, lsm, path, lsm->memCount)) return 0;
+    for (int i = 0; i < lsm->memCount; i++) lsmWriterAdd(&w, &lsm->mem[i]->key, lsm->mem[i]->cells);
+    LsmRun* run = lsmWriterClose(&w, path) ? lsmOpenRun(lsm, id) : NULL;
+    if (!run) return 0;
+    
+    lsm->runs = (LsmRun**)realloc(lsm->runs, (lsm->runCount + 1) * sizeof(LsmRun*));
+    memmove(lsm->runs + 1, lsm->runs, lsm->runCount * sizeof(LsmRun*));
+    lsm->runs[0] = run;
+    lsm->runCount++;
+    if (!lsmWriteManifest(lsm)) {
+        memmove(lsm->runs, lsm->runs + 1, --lsm->runCount * sizeof(LsmRun*));
+        lsmCloseRun(lsm, run);
+        remove(path);
+        return 0;
+    }
+    // 内存表已经在段里了，WAL从头开始
+    char walPath[300];
+    snprintf(walPath, sizeof(walPath), "%s.wal", lsm->base);
+    if (lsm->wal) fclose(lsm->wal);
+    lsm->wal = fopen(walPath, "wb");
+    lsmMemClear(lsm);
+    lsm->flushes++;
+    int from, count;
+    if (!lsm->compacting && lsmPickCompaction(lsm, &from, &count)) lsmStartCompaction(lsm, from, count);
+    return 1;
+}
+
+/*-------- 对外接口 --------*/
+
+static LsmStore* lsmCreateStore(const char* base, const Column* columns, int numColumns, int keyColumn) {
+    LsmStore* lsm = (LsmStore*)calloc(1, sizeof(LsmStore));
+    snprintf(lsm->base, sizeof(lsm->base), "%s", base);
+    lsm->numColumns = numColumns;
+    lsm->columns = (Column*)malloc(numColumns * sizeof(Column));
+    for (int c = 0; c < numColumns; c++) {
+        lsm->columns[c].name = _strdup(columns[c].name);
+        lsm->columns[c].type = columns[c].type;
+    }
+    lsm->keyColumn = keyColumn;
+    return lsm;
+}
+
+static void lsmFreeStore(LsmStore* lsm) {
+    if (!lsm) return;
+    lsmFinishCompaction(lsm, 1);
+    if (lsm->wal) fclose(lsm->wal);
+    for (int i = 0; i < lsm->runCount; i++) lsmCloseRun(lsm, lsm->runs[i]);
+    free(lsm->runs);
+    lsmMemClear(lsm);
+    free(lsm->mem);
+    free(lsm->buf.data);
+    for (int c = 0; c < lsm->numColumns; c++) free(lsm->columns[c].name);
+    free(lsm->columns);
+    free(lsm);
+}
+
+// 关闭表的LSM存储（内存表留在WAL里，下次打开时重放）
+static void closeLsm(Table* table) {
+    lsmFreeStore(table->lsm);
+    table->lsm = NULL;
+}
+
+// 主键改成别的列（或取消）时关闭LSM存储
+static void lsmCheckKeyColumn(Table* table, int colIndex) {
+    if (table->lsm && table->lsm->keyColumn != colIndex) closeLsm(table);
+}
+
+// 删除以base为前缀的LSM文件（按旧清单找段文件）
+static void lsmRemoveFiles(const char* base) {
+    char path[300];
+    snprintf(path, sizeof(path), "%s.lsm", base);
+    FILE* file = fopen(path, "rb");
+    char magic[4];
+    int head[5];
+    if (file && fread(magic, 1, 4, file) == 4 && memcmp(magic, LSM_MAGIC, 4) == 0 && fread(head, sizeof(head), 1, file) == 1) {
+        int ok = 1;
+        for (int c = 0; ok && c < head[1]; c++) {
+            int type, nameLen;
+            ok = fread(&type, 4, 1, file) == 1 && fread(&nameLen, 4, 1, file) == 1 && fseek(file, nameLen, SEEK_CUR) == 0;
+        }
+        int id;
+        for (int i = 0; ok && i < head[4] && fread(&id, 4, 1, file) == 1; i++) {
+            char runPath[300];
+            lsmRunName(runPath, sizeof(runPath), base, id);
+            remove(runPath);
+        }
+    }
+    if (file) fclose(file);
+    remove(path);
+    snprintf(path, sizeof(path), "%s.wal", base);
+    remove(path);
+}
+
+typedef struct {
+    const Cell* key;
+    const Cell* cells;
+} LsmSortRow;
+
+static int cmpLsmSortInt(const void* a, const void* b) {
+    int x = ((const LsmSortRow*)a)->key->data.int_val, y = ((const LsmSortRow*)b)->key->data.int_val;
+    return (x > y) - (x < y);
+}
+
+static int cmpLsmSortStr(const void* a, const void* b) {
+    return strcmp(cellStr(((const LsmSortRow*)a)->key), cellStr(((const LsmSortRow*)b)->key));
+}
+
+/* attachLsm - 把表（须有主键）存为一个新的LSM存储，之后的增删改都写入它
+ * 现有内容按主键排序后写成第一个段；base下原有的LSM文件会被删除
+ * 返回值：成功返回1
+ */
+int attachLsm(Table* table, const char* base) {
+    if (!table || table->primaryKey < 0) return 0;
+    closeLsm(table);
+    lsmRemoveFiles(base);
+    LsmStore* lsm = lsmCreateStore(base, table->columns, table->numColumns, table->primaryKey);
+    
+    int n = table->rowCount;
+    LsmSortRow* rows = (LsmSortRow*)queryAlloc((n > 0 ? n : 1) * sizeof(LsmSortRow));
+    int i = 0;
+    for (RecordNode* cur = table->head; cur; cur = cur->next, i++) {
+        rows[i].key = &cur->cells[table->primaryKey];
+        rows[i].cells = cur->cells;
+    }
+    qsort(rows, n, sizeof(LsmSortRow), lsmKeyType(lsm) == 1 ? cmpLsmSortInt : cmpLsmSortStr);
+    int ok = 1;
+    if (n > 0) {
+        int id = lsm->nextRunId++;
+        char path[300];
+        lsmRunName(path, sizeof(path), base, id);
+        LsmRunWriter w;
+        ok = lsmWriterOpen(&w, lsm, path, n);
+        for (i = 0; ok && i < n; i++) lsmWriterAdd(&w, rows[i].key, rows[i].cells);
+        LsmRun* run = (ok && lsmWriterClose(&w, path)) ? lsmOpenRun(lsm, id) : NULL;
+        ok = run != NULL;
+        if (run) {
+            lsm->runs = (LsmRun**)malloc(sizeof(LsmRun*));
+            lsm->runs[0] = run;
+            lsm->runCount = 1;
+        }
+    }
+    char walPath[300];
+    snprintf(walPath, sizeof(walPath), "%s.wal", base);
+    if (ok) ok = lsmWriteManifest(lsm) && (lsm->wal = fopen(walPath, "wb")) != NULL;
+    if (!ok) {
+        lsmFreeStore(lsm);
+        lsmRemoveFiles(base);
+        return 0;
+    }
+    table->lsm = lsm;
+    return 1;
+}
+
+/* openLsmTable - 从LSM存储打开表：读清单、打开各段、重放WAL，再把所有段和内存表归并成表
+ * 返回值：新表（行按主键排列，已设好主键并挂上LSM存储），失败返回NULL
+ */
+Table* openLsmTable(const char* base) {
+    char path[300];
+    snprintf(path, sizeof(path), "%s.lsm", base);
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    char magic[4];
+    int head[5];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, LSM_MAGIC, 4) != 0 || fread(head, sizeof(head), 1, file) != 1
+        || head[0] != LSM_FORMAT || head[1] <= 0 || head[1] > 1024 || head[2] < 0 || head[2] >= head[1] || head[4] < 0) {
+        fclose(file);
+        return NULL;
+    }
+    int numColumns = head[1];
+    Column* columns = (Column*)calloc(numColumns, sizeof(Column));
+    int ok = 1;
+    for (int c = 0; ok && c < numColumns; c++) {
+        int nameLen = 0;
+        ok = fread(&columns[c].type, 4, 1, file) == 1 && fread(&nameLen, 4, 1, file) == 1 && nameLen >= 0 && nameLen < 4096;
+        if (!ok) break;
+        columns[c].name = (char*)calloc(nameLen + 1, 1);
+        ok = fread(columns[c].name, 1, nameLen, file) == (size_t)nameLen;
+    }
+    LsmStore* lsm = ok ? lsmCreateStore(base, columns, numColumns, head[2]) : NULL;
+    for (int c = 0; c < numColumns; c++) free(columns[c].name);
+    free(columns);
+    if (lsm) {
+        lsm->nextRunId = head[3];
+        lsm->runs = (LsmRun**)calloc(head[4] > 0 ? head[4] : 1, sizeof(LsmRun*));
+        int id;
+        for (int i = 0; ok && i < head[4]; i++) {
+            ok = fread(&id, 4, 1, file) == 1 && (lsm->runs[i] = lsmOpenRun(lsm, id)) != NULL;
+            if (ok) lsm->runCount++;
+        }
+    }
+    fclose(file);
+    if (!ok) {
+        lsmFreeStore(lsm);
+        return NULL;
+    }
+    
+    snprintf(path, sizeof(path), "%s.wal", base);
+    FILE* wal = fopen(path, "rb");
+    int torn = 0;
+    if (wal) {
+        torn = !lsmWalReplay(lsm, wal);
+        fclose(wal);
+    }
+    // 尾部残缺时新记录不能接在后面（下次重放到残缺处就停了）：
+    // 把重放出来的内存表刷成段，WAL从头开始
+    if (torn && !lsmFlush(lsm)) {
+        lsmFreeStore(lsm);
+        return NULL;
+    }
+    if (!lsm->wal) lsm->wal = fopen(path, torn ? "wb" : "ab");
+    
+    Table* table = createTable(lsm->numColumns, lsm->columns);
+    int total = lsm->memCount;
+    for (int i = 0; i < lsm->runCount; i++) total += lsm->runs[i]->count;
+    bloomReserve(table, total);
+    int n = lsm->runCount + 1;
+    LsmCursor* cs = (LsmCursor*)calloc(n, sizeof(LsmCursor));
+    cs[0].isMem = 1;
+    lsmCursorNext(lsm, &cs[0]);
+    for (int i = 0; i < lsm->runCount; i++) lsmCursorOpenRun(lsm, &cs[i + 1], lsm->runs[i]->file, lsm->runs[i], 0);
+    int winner;
+    while ((winner = lsmMergePick(lsm, cs, n)) >= 0) {
+        if (cs[winner].cur.cells) addRecord(table, cs[winner].cur.cells);
+        lsmMergeAdvance(lsm, cs, n, winner);
+    }
+    for (int i = 0; i < n; i++) lsmCursorClose(lsm, &cs[i]);
+    free(cs);
+    setPrimaryKey(table, lsm->keyColumn);
+    table->lsm = lsm;
+    return table;
+}
+
+// 增删改后调用：把记录的新内容写进WAL和内存表
+static void lsmNotePut(Table* table, RecordNode* node) {
+    LsmStore* lsm = table->lsm;
+    if (!lsm) return;
+    const Cell* key = &node->cells[lsm->keyColumn];
+    lsmWalAppend(lsm, key, node->cells);
+    lsmMemPut(lsm, key, node->cells);
+    if (lsm->memCount >= LSM_MEMTABLE_ROWS) lsmFlush(lsm);
+}
+
+// 删除记录（或改掉它的主键）之前调用：写一条墓碑
+static void lsmNoteDelete(Table* table, RecordNode* node) {
+    LsmStore* lsm = table->lsm;
+    if (!lsm) return;
+    const Cell* key = &node->cells[lsm->keyColumn];
+    lsmWalAppend(lsm, key, NULL);
+    lsmMemPut(lsm, key, NULL);
+    if (lsm->memCount >= LSM_MEMTABLE_ROWS) lsmFlush(lsm);
+}
+
+/* lsmGet - 直接从LSM存储（内存表 + 磁盘上的段）按主键读一条记录
+ * 返回值：整行副本（用 lsmFreeCells 释放），不存在或已删除返回NULL
+ */
+Cell* lsmGet(LsmStore* lsm, const Cell* key) {
+    lsm->lookups++;
+    int pos = lsmMemLowerBound(lsm, key);
+    if (pos < lsm->memCount && lsmCompare(lsm, &lsm->mem[pos]->key, key) == 0) {
+        if (!lsm->mem[pos]->cells) return NULL;
+        Cell* cells = (Cell*)malloc(lsm->numColumns * sizeof(Cell));
+        deepCopyCells(cells, lsm->mem[pos]->cells, lsm->columns, lsm->numColumns);
+        return cells;
+    }
+    for (int i = 0; i < lsm->runCount; i++) {
+        LsmEntry e;
+        if (!lsmRunGet(lsm, lsm->runs[i], key, &e)) continue;
+        Cell* cells = e.cells;  // 墓碑为NULL：更旧的段里即使有也已经删了
+        e.cells = NULL;
+        lsmFreeEntry(lsm, &e);
+        return cells;
+    }
+    return NULL;
+}
+
+void lsmFreeCells(LsmStore* lsm, Cell* cells) {
+    if (!cells) return;
+    freeCells(cells, lsm->columns, lsm->numColumns);
+    free(cells);
+}
+
+/* lsmRange - 从LSM存储读出主键在 [low, high] 内的记录（按主键升序）
+ * 
+ * 返回值：整行副本的数组（用 lsmFreeRows 释放），*count 为条数
+ * 算法：内存表二分定位，每个段按栅栏指针定位到起始块，多路归并，新版本覆盖旧版本、跳过墓碑
+ */
+Cell** lsmRange(LsmStore* lsm, const Cell* low, const Cell* high, int* count) {
+    int n = lsm->runCount + 1, cap = 16;
+    Cell** rows = (Cell**)malloc(cap * sizeof(Cell*));
+    *count = 0;
+    LsmCursor* cs = (LsmCursor*)calloc(n, sizeof(LsmCursor));
+    cs[0].isMem = 1;
+    cs[0].memPos = lsmMemLowerBound(lsm, low);
+    cs[0].valid = 0;
+    lsmCursorNext(lsm, &cs[0]);
+    for (int i = 0; i < lsm->runCount; i++) {
+        LsmRun* run = lsm->runs[i];
+        int lo = 0, hi = run->fenceCount;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (lsmCompare(lsm, &run->fenceKeys[mid], low) <= 0) lo = mid + 1;
+            else hi = mid;
+        }
+        lsmCursorOpenRun(lsm, &cs[i + 1], run->file, run, lo > 0 ? lo - 1 : 0);
+        if (run->fenceCount > 0) lsm->blocksRead++;
+    }
+    int winner;
+    while ((winner = lsmMergePick(lsm, cs, n)) >= 0) {
+        const LsmEntry* e = &cs[winner].cur;
+        if (lsmCompare(lsm, &e->key, high) > 0) break;
+        if (e->cells && lsmCompare(lsm, &e->key, low) >= 0) {
+            if (*count == cap) {
+                cap *= 2;
+                rows = (Cell**)realloc(rows, cap * sizeof(Cell*));
+            }
+            rows[*count] = (Cell*)malloc(lsm->numColumns * sizeof(Cell));
+            deepCopyCells(rows[*count], e->cells, lsm->columns, lsm->numColumns);
+            (*count)++;
+        }
+        lsmMergeAdvance(lsm, cs, n, winner);
+    }
+    for (int i = 0; i < n; i++) lsmCursorClose(lsm, &cs[i]);
+    free(cs);
+    return rows;
+}
+
+void lsmFreeRows(LsmStore* lsm, Cell** rows, int count) {
+    for (int i = 0; i < count; i++) lsmFreeCells(lsm, rows[i]);
+    free(rows);
+}
+
+/* lsmStep - 主循环在请求之间调用：装上已完成的后台合并，有一层攒够了段就启动下一次 */
+void lsmStep(Table* table) {
+    LsmStore* lsm = table ? table->lsm : NULL;
+    if (!lsm) return;
+    lsmFinishCompaction(lsm, 0);
+    int from, count;
+    if (!lsm->compacting && lsmPickCompaction(lsm, &from, &count)) lsmStartCompaction(lsm, from, count);
+}
+
+// 立即刷内存表并把所有段合并成一个（等待完成）
+void lsmCompactNow(Table* table) {
+    LsmStore* lsm = table ? table->lsm : NULL;
+    if (!lsm) return;
+    lsmFlush(lsm);
+    lsmFinishCompaction(lsm, 1);
+    lsmStartCompaction(lsm, 0, lsm->runCount);
+    lsmFinishCompaction(lsm, 1);
+}
+
+void printLsmStats(Table* table) {
+    LsmStore* lsm = table->lsm;
+    if (!lsm) {
+        printf("LSM storage is off.\n");
+        return;
+    }
+    printf("LSM storage: %s (key %s)\n", lsm->base, lsm->columns[lsm->keyColumn].name);
+    printf("  Memtable: %d/%d entries, WAL records written/replayed: %lld\n", lsm->memCount, LSM_MEMTABLE_ROWS, lsm->walRecords);
+    printf("  Runs (newest first):");
+    for (int i = 0; i < lsm->runCount; i++) printf(" #%d(%d)", lsm->runs[i]->id, lsm->runs[i]->count);
+    printf("\n  Flushes: %d, compactions: %d", lsm->flushes, lsm->compactions);
+    if (lsm->compactions > 0) printf(" (last %.2f ms)", lsm->compactMs);
+    if (lsm->compacting) printf(", compacting in background");
+    printf("\n  Lookups: %d, runs skipped by bloom filter: %d, blocks read: %d\n", lsm->lookups, lsm->bloomSkips, lsm->blocksRead);
+}
+
+/*==================== 共享内存表段 ====================*/
+
+/*
+ * 把表的行数据和各列有序索引放进一块具名共享内存（Windows文件映射），其他进程
+ * 只读映射后直接查询，不用各自 loadTableFromJson 再建一份：N个进程共用一份物理内存。
+ *
+ * 各进程映射到的地址不同，所以段内不存指针，一律存相对段首的偏移：
+ *   [SharedSegmentHeader][SharedColumn × 列数][单元格：行数×列数个uint32，行优先]
+ *   [各列索引：行号按该列值升序，每列行数个uint32][字符串池]
+ * 整数列的单元格直接存值，字符串列存字符串在段内的偏移。
+ *
+ * 两级映射：
+ *   - 目录 "<名字>"：魔数、顺序锁计数seq、当前数据段代号generation
+ *   - 数据段 "<名字>.<代号>"：上面的布局。每次发布都建下一代段，在进程内写好（含各列排序）后
+ *     才在目录里切换代号，读者发现代号变了就重新映射（旧段在最后一个进程取消映射后由系统回收）。
+ *     段发布后不再改动，重建大表再慢也不挡读者。
+ *
+ * 顺序锁：写者切换代号前把seq加成奇数，切完再加回偶数（中间只有一次写）；读者开始前记下seq
+ * （须为偶数），读完再比较一次，变了就丢掉这次结果重读。读者碰上奇数就让出CPU等一会儿，
+ * 等久了改为睡眠。读者不加锁也不写共享内存，所以只读映射即可。
+ * 共享内存别的进程也能写，所以段头、偏移、行号都先对照段大小检查再使用。
+ */
+#define SHARED_DIR_MAGIC "TSHD"
+#define SHARED_SEG_MAGIC "TSHS"
+#define SHARED_FORMAT 1
+#define SHARED_NAME_PREFIX "Local\\thinking2_"
+#define SHARED_MIN_CAPACITY (64 * 1024)  // 数据段最小字节数
+#define SHARED_MAX_RETRIES 1000          // 一次查询最多重读几次（每次重读都是写者刚换了代）
+#define SHARED_WAIT_MS 5000              // 读者等seq变回偶数最多等多久（写者卡在切换中途时放弃）
+
+typedef struct {
+    char magic[4];
+    int format;
+    volatile LONG seq;          // 顺序锁计数：奇数表示写者正在改
+    volatile LONG generation;   // 当前数据段代号
+} SharedDirectory;
+
+typedef struct {
+    char magic[4];
+    int format;
+    unsigned int capacity;      // 段大小（建段时写定，之后不变）
+    unsigned int used;          // 已用字节数
+    int numColumns;
+    int rowCount;
+    unsigned int version;       // 发布时表的version
+    unsigned int columnsOffset; // SharedColumn数组
+    unsigned int cellsOffset;   // 单元格数组
+    unsigned int indexOffset;   // 各列有序行号数组
+} SharedSegmentHeader;
+
+typedef struct {
+    unsigned int nameOffset;    // 列名在段内的偏移
+    int type;                   // 1=int, 2=string
+} SharedColumn;
+
+/*SharedSegment - 发布表的进程（写者）持有的共享段 */
+typedef struct SharedSegment {
+    char name[96];
+    HANDLE dirHandle;
+    SharedDirectory* dir;
+    HANDLE segHandle;
+    unsigned char* seg;
+    unsigned int capacity;
+    unsigned int version;       // 已发布内容对应的表version
+    int publishes;              // 发布次数（每次建一代新段）
+    double publishMs;           // 最近一次发布耗时
+} SharedSegment;
+
+/*SharedView - 只读映射共享表的进程（读者）持有的视图 */
+typedef struct SharedView {
+    char name[96];
+    HANDLE dirHandle;
+    const SharedDirectory* dir;
+    HANDLE segHandle;
+    const unsigned char* seg;
+    unsigned int capacity;
+    LONG generation;            // 当前映射的数据段代号（-1表示还没映射）
+    int retries;                // 和写者冲突而重读的次数
+    int remaps;                 // 因换代重新映射的次数
+} SharedView;
+
+static void sharedMappingName(char* out, size_t size, const char* name, LONG generation) {
+    if (generation < 0) snprintf(out, size, SHARED_NAME_PREFIX "%s", name);
+    else snprintf(out, size, SHARED_NAME_PREFIX "%s.%ld", name, (long)generation);
+}
+
+// 新建一块可写的具名映射；同名映射已存在（别的进程在用）时失败
+static void* sharedCreateMapping(const char* mappingName, unsigned int size, HANDLE* handle) {
+    HANDLE h = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, mappingName);
+    if (!h) return NULL;
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(h);
+        return NULL;
+    }
+    void* p = MapViewOfFile(h, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!p) {
+        CloseHandle(h);
+        return NULL;
+    }
+    *handle = h;
+    return p;
+}
+
+// 只读打开一块已有的具名映射（size为0表示整块）
+static const void* sharedOpenMapping(const char* mappingName, size_t size, HANDLE* handle) {
+    HANDLE h = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName);
+    if (!h) return NULL;
+    const void* p = MapViewOfFile(h, FILE_MAP_READ, 0, 0, size);
+    if (!p) {
+        CloseHandle(h);
+        return NULL;
+    }
+    *handle = h;
+    return p;
+}
+
+static void sharedCloseMapping(const void* p, HANDLE h) {
+    if (p) UnmapViewOfFile(p);
+    if (h) CloseHandle(h);
+}
+
+// 表发布进共享段需要的字节数；超出32位偏移能表示的范围返回0
+static unsigned int sharedSegmentSize(Table* table) {
+    unsigned long long size = sizeof(SharedSegmentHeader) + table->numColumns * sizeof(SharedColumn);
+    size += (unsigned long long)table->rowCount * table->numColumns * sizeof(unsigned int) * 2; // 单元格 + 索引
+    for (int c = 0; c < table->numColumns; c++) size += strlen(table->columns[c].name) + 1;
+    for (RecordNode* cur = table->head; cur; cur = cur->next) {
+        for (int c = 0; c < table->numColumns; c++) {
+            if (table->columns[c].type != 1) size += strlen(cellStr(&cur->cells[c])) + 1;
+        }
+    }
+    return size > UINT_MAX / 2 ? 0 : (unsigned int)size;
+}
+
+typedef struct {
+    int value;
+    unsigned int row;
+} SharedIntKey;
+
+typedef struct {
+    const char* value;
+    unsigned int row;
+} SharedStrKey;
+
+static int cmpSharedIntKey(const void* a, const void* b) {
+    const SharedIntKey* x = (const SharedIntKey*)a;
+    const SharedIntKey* y = (const SharedIntKey*)b;
+    if (x->value != y->value) return (x->value > y->value) - (x->value < y->value);
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+static int cmpSharedStrKey(const void* a, const void* b) {
+    const SharedStrKey* x = (const SharedStrKey*)a;
+    const SharedStrKey* y = (const SharedStrKey*)b;
+    int r = strcmp(x->value, y->value);
+    if (r) return r;
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+// 把表按段布局写进seg（调用者保证放得下）；每列的有序行号相同值按行号排
+static void sharedWriteSegment(Table* table, unsigned char* seg, unsigned int capacity) {
+    int nc = table->numColumns, n = table->rowCount;
+    SharedSegmentHeader* h = (SharedSegmentHeader*)seg;
+    memcpy(h->magic, SHARED_SEG_MAGIC, 4);
+    h->format = SHARED_FORMAT;
+    h->capacity = capacity;
+    h->numColumns = nc;
+    h->rowCount = n;
+    h->version = table->version;
+    h->columnsOffset = sizeof(SharedSegmentHeader);
+    h->cellsOffset = h->columnsOffset + nc * sizeof(SharedColumn);
+    h->indexOffset = h->cellsOffset + (unsigned int)n * nc * sizeof(unsigned int);
+    unsigned int pool = h->indexOffset + (unsigned int)n * nc * sizeof(unsigned int);
+    
+    SharedColumn* cols = (SharedColumn*)(seg + h->columnsOffset);
+    for (int c = 0; c < nc; c++) {
+        size_t len = strlen(table->columns[c].name) + 1;
+        cols[c].nameOffset = pool;
+        cols[c].type = table->columns[c].type;
+        memcpy(seg + pool, table->columns[c].name, len);
+        pool += (unsigned int)len;
+    }
+    
+    unsigned int* cells = (unsigned int*)(seg + h->cellsOffset);
+    unsigned int row = 0;
+    for (RecordNode* cur = table->head; cur; cur = cur->next, row++) {
+        for (int c = 0; c < nc; c++) {
+            if (table->columns[c].type == 1) {
+                cells[(size_t)row * nc + c] = (unsigned int)cur->cells[c].data.int_val;
+            } else {
+                const char* str = cellStr(&cur->cells[c]);
+                size_t len = strlen(str) + 1;
+                cells[(size_t)row * nc + c] = pool;
+                memcpy(seg + pool, str, len);
+                pool += (unsigned int)len;
+            }
+        }
+    }
+    h->used = pool;
+    
+    // 各列的有序行号：在进程内排好序再整列写入
+    unsigned int* index = (unsigned int*)(seg + h->indexOffset);
+    size_t keySize = sizeof(SharedIntKey) > sizeof(SharedStrKey) ? sizeof(SharedIntKey) : sizeof(SharedStrKey);
+    void* keys = queryAlloc((n > 0 ? n : 1) * keySize);
+    for (int c = 0; c < nc; c++) {
+        unsigned int* order = index + (size_t)c * n;
+        if (table->columns[c].type == 1) {
+            SharedIntKey* k = (SharedIntKey*)keys;
+            for (int r = 0; r < n; r++) {
+                k[r].value = (int)cells[(size_t)r * nc + c];
+                k[r].row = (unsigned int)r;
+            }
+            qsort(k, n, sizeof(SharedIntKey), cmpSharedIntKey);
+            for (int r = 0; r < n; r++) order[r] = k[r].row;
+        } else {
+            SharedStrKey* k = (SharedStrKey*)keys;
+            for (int r = 0; r < n; r++) {
+                k[r].value = (const char*)seg + cells[(size_t)r * nc + c];
+                k[r].row = (unsigned int)r;
+            }
+            qsort(k, n, sizeof(SharedStrKey), cmpSharedStrKey);
+            for (int r = 0; r < n; r++) order[r] = k[r].row;
+        }
+    }
+}
+
+/* sharedPublish - 把表的当前内容发布到共享段
+ * 总是新建下一代段并写好，再在顺序锁保护下切换目录里的代号（读者只在切换那一下要等）
+ * 返回值：成功返回1
+ */
+static int sharedPublish(Table* table) {
+    SharedSegment* sh = table->shared;
+    HighResTimer timer;
+    timerStart(&timer);
+    unsigned int size = sharedSegmentSize(table);
+    if (!size) return 0;
+    unsigned int capacity = size < SHARED_MIN_CAPACITY ? SHARED_MIN_CAPACITY : size;
+    LONG generation = sh->dir->generation + 1;
+    char mappingName[160];
+    sharedMappingName(mappingName, sizeof(mappingName), sh->name, generation);
+    HANDLE handle;
+    unsigned char* seg = (unsigned char*)sharedCreateMapping(mappingName, capacity, &handle);
+    if (!seg) return 0;
+    sharedWriteSegment(table, seg, capacity);  // 新段还没人映射，不用加锁
+    InterlockedIncrement(&sh->dir->seq);       // 奇数：读者等待或重读
+    InterlockedExchange(&sh->dir->generation, generation);
+    InterlockedIncrement(&sh->dir->seq);
+    sharedCloseMapping(sh->seg, sh->segHandle);  // 仍映射着旧段的读者不受影响
+    sh->seg = seg;
+    sh->segHandle = handle;
+    sh->capacity = capacity;
+    sh->version = table->version;
+    sh->publishes++;
+    sh->publishMs = timerEndMs(&timer);
+    return 1;
+}
+
+/* stopSharing - 停止发布共享表
+ * 已映射的读者还能读到最后一次发布的内容，直到它们断开
+ */
+static void stopSharing(Table* table) {
+    SharedSegment* sh = table ? table->shared : NULL;
+    if (!sh) return;
+    sharedCloseMapping(sh->seg, sh->segHandle);
+    sharedCloseMapping(sh->dir, sh->dirHandle);
+    free(sh);
+    table->shared = NULL;
+}
+
+/* shareTable - 以name发布表：建立目录和第一代数据段，之后表有修改时由sharedStep重新发布
+ * 返回值：成功返回1；名字已被别的进程占用或内存不足返回0
+ */
+int shareTable(Table* table, const char* name) {
+    if (!table || !name[0] || strlen(name) >= sizeof(((SharedSegment*)0)->name)) return 0;
+    stopSharing(table);
+    char mappingName[160];
+    sharedMappingName(mappingName, sizeof(mappingName), name, -1);
+    HANDLE dirHandle;
+    SharedDirectory* dir = (SharedDirectory*)sharedCreateMapping(mappingName, sizeof(SharedDirectory), &dirHandle);
+    if (!dir) return 0;
+    memcpy(dir->magic, SHARED_DIR_MAGIC, 4);
+    dir->format = SHARED_FORMAT;
+    dir->seq = 0;
+    dir->generation = 0;
+    
+    SharedSegment* sh = (SharedSegment*)calloc(1, sizeof(SharedSegment));
+    strcpy(sh->name, name);
+    sh->dir = dir;
+    sh->dirHandle = dirHandle;
+    table->shared = sh;
+    if (!sharedPublish(table)) {
+        stopSharing(table);
+        return 0;
+    }
+    return 1;
+}
+
+/* sharedStep - 主循环在请求之间调用：表改过就重新发布 */
+void sharedStep(Table* table) {
+    SharedSegment* sh = table ? table->shared : NULL;
+    if (sh && sh->version != table->version) sharedPublish(table);
+}
+
+void printSharedStats(Table* table) {
+    SharedSegment* sh = table->shared;
+    if (!sh) {
+        printf("Table is not shared.\n");
+        return;
+    }
+    const SharedSegmentHeader* h = (const SharedSegmentHeader*)sh->seg;
+    printf("Shared as \"%s\": generation %ld, %u/%u bytes used\n", sh->name, (long)sh->dir->generation, h->used, sh->capacity);
+    printf("  Publishes: %d (last %.2f ms)\n", sh->publishes, sh->publishMs);
+}
+
+/* attachSharedTable - 只读映射别的进程发布的共享表
+ * 只映射目录，数据段在第一次读时按目录里的代号映射，不复制任何数据
+ * 返回值：视图，没有这个名字的共享表返回NULL
+ */
+SharedView* attachSharedTable(const char* name) {
+    if (!name[0] || strlen(name) >= sizeof(((SharedView*)0)->name)) return NULL;
+    char mappingName[160];
+    sharedMappingName(mappingName, sizeof(mappingName), name, -1);
+    HANDLE dirHandle;
+    const SharedDirectory* dir = (const SharedDirectory*)sharedOpenMapping(mappingName, sizeof(SharedDirectory), &dirHandle);
+    if (!dir) return NULL;
+    if (memcmp(dir->magic, SHARED_DIR_MAGIC, 4) != 0 || dir->format != SHARED_FORMAT) {
+        sharedCloseMapping(dir, dirHandle);
+        return NULL;
+    }
+    SharedView* v = (SharedView*)calloc(1, sizeof(SharedView));
+    strcpy(v->name, name);
+    v->dir = dir;
+    v->dirHandle = dirHandle;
+    v->generation = -1;
+    return v;
+}
+
+void detachSharedTable(SharedView* v) {
+    if (!v) return;
+    sharedCloseMapping(v->seg, v->segHandle);
+    sharedCloseMapping(v->dir, v->dirHandle);
+    free(v);
+}
+
+// 映射第generation代数据段（换掉当前映射）
+static int sharedRemap(SharedView* v, LONG generation) {
+    char mappingName[160];
+    sharedMappingName(mappingName, sizeof(mappingName), v->name, generation);
+    HANDLE handle;
+    const unsigned char* seg = (const unsigned char*)sharedOpenMapping(mappingName, 0, &handle);
+    if (!seg) return 0;
+    const SharedSegmentHeader* h = (const SharedSegmentHeader*)seg;
+    if (memcmp(h->magic, SHARED_SEG_MAGIC, 4) != 0 || h->format != SHARED_FORMAT) {
+        sharedCloseMapping(seg, handle);
+        return 0;
+    }
+    sharedCloseMapping(v->seg, v->segHandle);
+    v->seg = seg;
+    v->segHandle = handle;
+    v->capacity = h->capacity;  // 建段时写定，不受之后原地重写影响
+    if (v->generation >= 0) v->remaps++;
+    v->generation = generation;
+    return 1;
+}
+
+// 开始一次读：等到seq为偶数，数据段换代了就重新映射；返回记下的seq，等了SHARED_WAIT_MS还不行返回-1
+// （共享内存是只读映射，不能用Interlocked读，用普通读加内存屏障）
+static LONG sharedReadBegin(SharedView* v) {
+    HighResTimer timer;
+    timerStart(&timer);
+    for (int i = 0; ; i++) {
+        LONG seq = v->dir->seq;
+        MemoryBarrier();
+        if (!(seq & 1)) {
+            LONG generation = v->dir->generation;
+            if (generation == v->generation || sharedRemap(v, generation)) {
+                MemoryBarrier();
+                if (v->dir->seq == seq) return seq;
+            }
+        }
+        if (timerEndMs(&timer) > SHARED_WAIT_MS) return -1;
+        Sleep(i < 64 ? 0 : 1);  // 先只让出时间片，等久了改为睡眠，不空转占CPU
+    }
+}
+
+// 结束一次读：期间写者没动过返回1，否则记一次重读返回0
+static int sharedReadEnd(SharedView* v, LONG seq) {
+    MemoryBarrier();
+    if (v->dir->seq == seq) return 1;
+    v->retries++;
+    return 0;
+}
+
+// 取段头并检查各数组都在段内（写者可能正改到一半）
+static int sharedHeader(const SharedView* v, SharedSegmentHeader* h) {
+    memcpy(h, v->seg, sizeof(SharedSegmentHeader));
+    if (h->numColumns <= 0 || h->rowCount < 0) return 0;
+    unsigned long long array = (unsigned long long)h->rowCount * h->numColumns * sizeof(unsigned int);
+    return (unsigned long long)h->columnsOffset + h->numColumns * sizeof(SharedColumn) <= v->capacity
+        && h->cellsOffset + array <= v->capacity
+        && h->indexOffset + array <= v->capacity;
+}
+
+// 段内偏移处的字符串；偏移越界或到段尾都没有'\0'时返回NULL
+static const char* sharedStr(const SharedView* v, unsigned int offset) {
+    if (offset >= v->capacity) return NULL;
+    const char* s = (const char*)v->seg + offset;
+    return memchr(s, '\0', v->capacity - offset) ? s : NULL;
+}
+
+/* sharedFindColumn - 按列名找共享表的列
+ * 返回值：列下标（*type为列类型），没有该列或一直读不到一致的内容返回-1
+ */
+int sharedFindColumn(SharedView* v, const char* name, int* type) {
+    for (int attempt = 0; attempt < SHARED_MAX_RETRIES; attempt++) {
+        LONG seq = sharedReadBegin(v);
+        if (seq < 0) return -1;
+        SharedSegmentHeader h;
+        int found = -1;
+        if (sharedHeader(v, &h)) {
+            const SharedColumn* cols = (const SharedColumn*)(v->seg + h.columnsOffset);
+            for (int c = 0; c < h.numColumns; c++) {
+                const char* colName = sharedStr(v, cols[c].nameOffset);
+                if (colName && strcmp(colName, name) == 0) {
+                    found = c;
+                    *type = cols[c].type;
+                    break;
+                }
+            }
+        }
+        if (sharedReadEnd(v, seq)) return found;
+    }
+    return -1;
+}
+
+/* sharedFindRange - 整数列范围查询 low <= 值 <= high，行号（从1开始）按值升序返回
+ * 在该列的有序行号上二分找起点，再顺序取到超过high为止
+ * 返回值：结果集；列不是整数列或一直读不到一致的内容返回NULL
+ */
+SearchResult* sharedFindRange(SharedView* v, int col, int low, int high) {
+    for (int attempt = 0; attempt < SHARED_MAX_RETRIES; attempt++) {
+        LONG seq = sharedReadBegin(v);
+        if (seq < 0) return NULL;
+        SharedSegmentHeader h;
+        SearchResult* sr = NULL;
+        if (sharedHeader(v, &h) && col >= 0 && col < h.numColumns
+            && ((const SharedColumn*)(v->seg + h.columnsOffset))[col].type == 1) {
+            int nc = h.numColumns, n = h.rowCount;
+            const unsigned int* cells = (const unsigned int*)(v->seg + h.cellsOffset);
+            const unsigned int* order = (const unsigned int*)(v->seg + h.indexOffset) + (size_t)col * n;
+            int lo = 0, hi = n;
+            while (lo < hi) {
+                int mid = lo + (hi - lo) / 2;
+                unsigned int row = order[mid];
+                if (row >= (unsigned int)n) break;  // 写了一半，等sharedReadEnd判重读
+                if ((int)cells[(size_t)row * nc + col] < low) lo = mid + 1;
+                else hi = mid;
+            }
+            sr = createSearchResult(16);
+            for (int i = lo; i < n; i++) {
+                unsigned int row = order[i];
+                if (row >= (unsigned int)n || (int)cells[(size_t)row * nc + col] > high) break;
+                addToResult(sr, (int)row + 1);
+            }
+        }
+        if (sharedReadEnd(v, seq)) return sr;
+        freeSearchResult(sr);
+    }
+    return NULL;
+}
+
+/* sharedFindStrEqual - 字符串列等值查询，行号（从1开始）升序返回
+ * 返回值：结果集；列不是字符串列或一直读不到一致的内容返回NULL
+ */
+SearchResult* sharedFindStrEqual(SharedView* v, int col, const char* value) {
+    for (int attempt = 0; attempt < SHARED_MAX_RETRIES; attempt++) {
+        LONG seq = sharedReadBegin(v);
+        if (seq < 0) return NULL;
+        SharedSegmentHeader h;
+        SearchResult* sr = NULL;
+        if (sharedHeader(v, &h) && col >= 0 && col < h.numColumns
+            && ((const SharedColumn*)(v->seg + h.columnsOffset))[col].type != 1) {
+            int nc = h.numColumns, n = h.rowCount;
+            const unsigned int* cells = (const unsigned int*)(v->seg + h.cellsOffset);
+            const unsigned int* order = (const unsigned int*)(v->seg + h.indexOffset) + (size_t)col * n;
+            int lo = 0, hi = n;
+            while (lo < hi) {
+                int mid = lo + (hi - lo) / 2;
+                unsigned int row = order[mid];
+                const char* s = row < (unsigned int)n ? sharedStr(v, cells[(size_t)row * nc + col]) : NULL;
+                if (!s) break;
+                if (strcmp(s, value) < 0) lo = mid + 1;
+                else hi = mid;
+            }
+            sr = createSearchResult(16);
+            for (int i = lo; i < n; i++) {
+                unsigned int row = order[i];
+                const char* s = row < (unsigned int)n ? sharedStr(v, cells[(size_t)row * nc + col]) : NULL;
+                if (!s || strcmp(s, value) != 0) break;
+                addToResult(sr, (int)row + 1);
+            }
+        }
+        if (sharedReadEnd(v, seq)) return sr;
+        freeSearchResult(sr);
+    }
+    return NULL;
+}
+
+/* sharedFormatRow - 把共享表第rowNum行（从1开始）格式化成 "列=值, ..." 写入buf
+ * 返回值：成功返回1；行号越界或一直读不到一致的内容返回0
+ */
+int sharedFormatRow(SharedView* v, int rowNum, char* buf, size_t size) {
+    for (int attempt = 0; attempt < SHARED_MAX_RETRIES; attempt++) {
+        LONG seq = sharedReadBegin(v);
+        if (seq < 0) return 0;
+        SharedSegmentHeader h;
+        int ok = sharedHeader(v, &h) && rowNum >= 1 && rowNum <= h.rowCount;
+        size_t len = 0;
+        buf[0] = '\0';
+        if (ok) {
+            const SharedColumn* cols = (const SharedColumn*)(v->seg + h.columnsOffset);
+            const unsigned int* cells = (const unsigned int*)(v->seg + h.cellsOffset) + (size_t)(rowNum - 1) * h.numColumns;
+            for (int c = 0; c < h.numColumns && len < size; c++) {
+                const char* name = sharedStr(v, cols[c].nameOffset);
+                const char* str = cols[c].type == 1 ? "" : sharedStr(v, cells[c]);
+                if (!name || !str) { ok = 0; break; }
+                int w = cols[c].type == 1
+                    ? snprintf(buf + len, size - len, "%s%s=%d", c ? ", " : "", name, (int)cells[c])
+                    : snprintf(buf + len, size - len, "%s%s=%s", c ? ", " : "", name, str);
+                if (w < 0) break;
+                len += (size_t)w;
+            }
+        }
+        if (sharedReadEnd(v, seq)) return ok;
+    }
+    return 0;
+}
+
+void printSharedViewStats(SharedView* v) {
+    LONG seq = sharedReadBegin(v);
+    SharedSegmentHeader h;
+    int ok = seq >= 0 && sharedHeader(v, &h);
+    if (ok && sharedReadEnd(v, seq)) {
+        printf("Attached to \"%s\" (read-only): %d rows, %d columns, generation %ld, %u bytes mapped\n",
+               v->name, h.rowCount, h.numColumns, (long)v->generation, v->capacity);
+    } else {
+        printf("Attached to \"%s\" (read-only): publisher is busy\n", v->name);
+    }
+    printf("  Read retries: %d, remaps: %d\n", v->retries, v->remaps);
+}
+
+/*==================== 映射表文件 ====================*/
+
+/*
+ * 表的行按定长槽存放在内存映射文件 <base>.tbl 里。增删改直接改映射中对应的槽，
+ * "保存"只是把上次保存后改过的页刷回磁盘（FlushViewOfFile），不再整文件重新生成；
+ * 重新打开就是映射文件，沿槽链表把行取进内存中的表。
+ *
+ * 文件布局：
+ *   [文件头区 MAP_HEADER_SIZE字节：MapFileHeader + MapFileColumn × 列数]
+ *   [槽 × capacity]，槽 = next(下一行的槽号) + used + 各列（整数4字节，字符串定宽并以'\0'补齐）
+ * 槽号从1开始，0表示没有。行顺序由槽之间的next链表示（和内存中的链表一一对应），
+ * 删掉的槽用next串成空闲链表，插入时优先复用。
+ *
+ * 崩溃一致性（撤销日志 <base>.tbj）：
+ *   上次保存后第一次改某个槽或文件头之前，先把它的原内容追加到日志并刷盘，再改映射内存。
+ *   保存 = 刷脏页 + FlushFileBuffers，然后清空日志。打开时日志里还有记录，说明上次保存后
+ *   文件又被改过（脏页可能已被系统写回一部分）：把原内容写回，文件就回到上次保存时的样子。
+ *   上次保存时还没用到的槽（高水位之后）不用记日志，撤销后没有链接指向它们。
+ *
+ * 字符串超过列宽、聚簇整表重排（节点全换了）时标记为过期：之后的改动不再写进文件，
+ * 下次保存时整文件重写。保存之前关闭或崩溃，照样按日志回到上次保存的状态。
+ */
+#define MAP_MAGIC "TMAP"
+#define MAP_JOURNAL_MAGIC "TMJL"
+#define MAP_FORMAT 1
+#define MAP_HEADER_SIZE 4096     // 文件头区大小，槽从这里开始
+#define MAP_NAME_MAX 52          // 列名最大字节数（含'\0'）
+#define MAP_MIN_STR_WIDTH 32     // 字符串列最小宽度
+#define MAP_MIN_SLOTS 1024       // 新文件最少的槽数
+#define MAP_SLOT_USED 4          // 槽内used字段的偏移（next在偏移0）
+#define MAP_SLOT_CELLS 8         // 槽内第一列的偏移
+
+typedef struct {
+    char magic[4];
+    int format;
+    unsigned int stamp;         // 文件代号：整文件重写时换新，日志只对代号相同的文件有效
+    int numColumns;
+    unsigned int slotSize;      // 每个槽的字节数
+    unsigned int capacity;      // 文件里的槽数
+    unsigned int used;          // 用到过的槽数（高水位）
+    unsigned int head;          // 第一行的槽号
+    unsigned int tail;          // 最后一行的槽号
+    unsigned int freeHead;      // 空闲槽链表头
+    int rowCount;
+} MapFileHeader;
+
+typedef struct {
+    int type;                   // 1=int, 2=string
+    unsigned int offset;        // 在槽内的偏移
+    unsigned int width;         // 字节数（整数列为4，字符串列含'\0'）
+    char name[MAP_NAME_MAX];
+} MapFileColumn;
+
+#define MAP_MAX_COLUMNS ((MAP_HEADER_SIZE - (int)sizeof(MapFileHeader)) / (int)sizeof(MapFileColumn))
+
+typedef struct {
+    RecordNode* node;
+    unsigned int slot;
+} MapNodeSlot;
+
+typedef struct MapFile {
+    char base[256];
+    HANDLE file;                // <base>.tbl
+    HANDLE mapping;
+    unsigned char* view;
+    HANDLE journal;             // <base>.tbj
+    unsigned int savedUsed;     // 上次保存时的高水位：这之前的槽改动前要记日志
+    int headerLogged;           // 上次保存后文件头已记过日志
+    int headerDirty;
+    unsigned char* logged;      // 每槽1位：上次保存后已记过日志
+    unsigned char* dirty;       // 每槽1位：上次保存后改过
+    MapNodeSlot* slots;         // 节点 -> 槽号 的哈希表（线性探测）
+    unsigned int slotMask;
+    int slotUsed;
+    int stale;                  // 1 = 保存时要整文件重写（之后的改动不再写进文件）
+    int journalPending;         // 日志有写入但还没刷盘
+    int journalRecords;         // 本次保存周期记的日志条数
+    int recovered;              // 打开时按日志写回的记录数
+    int saves;
+    int rewrites;
+    int lastRanges;             // 最近一次保存刷了几段
+    unsigned long long lastBytes;
+    double saveMs;
+} MapFile;
+
+static MapFileHeader* mapHeader(MapFile* m) { return (MapFileHeader*)m->view; }
+static MapFileColumn* mapColumns(MapFile* m) { return (MapFileColumn*)(m->view + sizeof(MapFileHeader)); }
+
+static unsigned char* mapSlot(MapFile* m, unsigned int slot) {
+    return m->view + MAP_HEADER_SIZE + (size_t)(slot - 1) * mapHeader(m)->slotSize;
+}
+
+static unsigned int* mapNext(MapFile* m, unsigned int slot) { return (unsigned int*)mapSlot(m, slot); }
+
+static void mapPath(char* out, size_t size, const char* base, const char* ext) {
+    snprintf(out, size, "%s%s", base, ext);
+}
+
+// 节点对应的槽号，没有返回0
+static unsigned int mapFindSlot(MapFile* m, const RecordNode* node) {
+    unsigned int pos = storeHashNode(node) & m->slotMask;
+    while (m->slots[pos].node) {
+        if (m->slots[pos].node == node) return m->slots[pos].slot;
+        pos = (pos + 1) & m->slotMask;
+    }
+    return 0;
+}
+
+static void mapPutSlot(MapFile* m, RecordNode* node, unsigned int slot) {
+    if ((unsigned int)(m->slotUsed + 1) * 2 > m->slotMask + 1) {
+        MapNodeSlot* old = m->slots;
+        unsigned int oldCount = m->slotMask + 1;
+        m->slotMask = oldCount * 2 - 1;
+        m->slots = (MapNodeSlot*)calloc(oldCount * 2, sizeof(MapNodeSlot));
+        m->slotUsed = 0;
+        for (unsigned int i = 0; i < oldCount; i++) {
+            if (old[i].node) mapPutSlot(m, old[i].node, old[i].slot);
+        }
+        free(old);
+    }
+    unsigned int pos = storeHashNode(node) & m->slotMask;
+    while (m->slots[pos].node && m->slots[pos].node != node) pos = (pos + 1) & m->slotMask;
+    if (!m->slots[pos].node) m->slotUsed++;
+    m->slots[pos].node = node;
+    m->slots[pos].slot = slot;
+}
+
+static void mapEraseSlot(MapFile* m, const RecordNode* node) {
+    unsigned int hole = storeHashNode(node) & m->slotMask;
+    while (m->slots[hole].node && m->slots[hole].node != node) hole = (hole + 1) & m->slotMask;
+    if (!m->slots[hole].node) return;
+    m->slots[hole].node = NULL;
+    m->slotUsed--;
+    // 与主键哈希表相同的删除方式：后面同一探测链上的元素挪进空洞
+    unsigned int cur = (hole + 1) & m->slotMask;
+    while (m->slots[cur].node) {
+        unsigned int home = storeHashNode(m->slots[cur].node) & m->slotMask;
+        if (((cur - home) & m->slotMask) >= ((cur - hole) & m->slotMask)) {
+            m->slots[hole] = m->slots[cur];
+            m->slots[cur].node = NULL;
+            hole = cur;
+        }
+        cur = (cur + 1) & m->slotMask;
+    }
+}
+
+/* mapJournal - 把文件中 [offset, offset+length) 的原内容追加到撤销日志（由mapJournalSync统一刷盘）
+ * 记录格式：[offset][length][校验和][原内容]，打开时校验和不对的记录（写了一半）被忽略
+ * 返回值：成功返回1
+ */
+static int mapJournal(MapFile* m, unsigned int offset, unsigned int length) {
+    unsigned int head[2] = { offset, length };
+    unsigned long long sum = checksumText((const char*)m->view + offset, length);
+    DWORD written;
+    int ok = WriteFile(m->journal, head, sizeof(head), &written, NULL)
+          && WriteFile(m->journal, &sum, sizeof(sum), &written, NULL)
+          && WriteFile(m->journal, m->view + offset, length, &written, NULL);
+    if (ok) m->journalRecords++;
+    m->journalPending = 1;
+    return ok;
+}
+
+/* mapJournalSync - 改映射内存之前调用：把刚记的日志刷盘
+ * 一次操作先把要改的槽和文件头都记进日志，再刷一次盘，然后才动手改
+ * 返回值：日志都已落盘返回1；记日志或刷盘失败过（已标记过期）返回0，调用者不能再改映射内存
+ */
+static int mapJournalSync(MapFile* m) {
+    if (m->journalPending) {
+        if (!FlushFileBuffers(m->journal)) m->stale = 1;
+        m->journalPending = 0;
+    }
+    return !m->stale;
+}
+
+// 准备修改文件头：本保存周期第一次改时先记日志（日志写不进去就标记过期，由mapJournalSync告诉调用者）
+static void mapTouchHeader(MapFile* m) {
+    if (!m->headerLogged) {
+        if (!mapJournal(m, 0, sizeof(MapFileHeader))) m->stale = 1;
+        m->headerLogged = 1;
+    }
+    m->headerDirty = 1;
+}
+
+// 准备修改一个槽
+static void mapTouchSlot(MapFile* m, unsigned int slot) {
+    unsigned int bit = slot - 1;
+    unsigned char mask = (unsigned char)(1u << (bit & 7));
+    if (slot <= m->savedUsed && !(m->logged[bit >> 3] & mask)) {
+        unsigned int size = mapHeader(m)->slotSize;
+        if (!mapJournal(m, MAP_HEADER_SIZE + bit * size, size)) m->stale = 1;
+        m->logged[bit >> 3] |= mask;
+    }
+    m->dirty[bit >> 3] |= mask;
+}
+
+// 把一行写进槽；字符串超过列宽时返回0（调用者标记整文件重写）
+static int mapWriteCells(MapFile* m, unsigned int slot, const Cell* cells) {
+    MapFileHeader* h = mapHeader(m);
+    MapFileColumn* cols = mapColumns(m);
+    unsigned char* p = mapSlot(m, slot);
+    *(unsigned int*)(p + MAP_SLOT_USED) = 1;
+    for (int c = 0; c < h->numColumns; c++) {
+        unsigned char* dst = p + cols[c].offset;
+        if (cols[c].type == 1) {
+            memcpy(dst, &cells[c].data.int_val, sizeof(int));
+        } else {
+            const char* str = cellStr(&cells[c]);
+            size_t len = strlen(str);
+            if (len >= cols[c].width) return 0;
+            memcpy(dst, str, len);
+            memset(dst + len, 0, cols[c].width - len);
+        }
+    }
+    return 1;
+}
+
+// 从槽里读出一行（字符串新分配）；槽没在用或字符串没有结尾返回0
+static int mapReadCells(MapFile* m, unsigned int slot, Cell* cells) {
+    MapFileHeader* h = mapHeader(m);
+    MapFileColumn* cols = mapColumns(m);
+    const unsigned char* p = mapSlot(m, slot);
+    if (*(const unsigned int*)(p + MAP_SLOT_USED) != 1) return 0;
+    for (int c = 0; c < h->numColumns; c++) {
+        const unsigned char* src = p + cols[c].offset;
+        if (cols[c].type == 1) {
+            memcpy(&cells[c].data.int_val, src, sizeof(int));
+        } else if (src[cols[c].width - 1] != '\0') {
+            for (int k = 0; k < c; k++) {
+                if (cols[k].type != 1) cellFreeStr(&cells[k]);
+            }
+            return 0;
+        } else {
+            cellSetStr(&cells[c], (const char*)src);
+        }
+    }
+    return 1;
+}
+
+// 扩大文件（槽数翻倍）并重新映射
+static int mapGrow(MapFile* m) {
+    unsigned int oldCapacity = mapHeader(m)->capacity, capacity = oldCapacity * 2;
+    unsigned long long size = MAP_HEADER_SIZE + (unsigned long long)capacity * mapHeader(m)->slotSize;
+    if (size > 0xFFFFFFFFull) return 0;
+    HANDLE mapping = CreateFileMappingA(m->file, NULL, PAGE_READWRITE, 0, (DWORD)size, NULL);  // 映射比文件大时文件随之变大
+    unsigned char* view = mapping ? (unsigned char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) : NULL;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        return 0;
+    }
+    UnmapViewOfFile(m->view);  // 旧视图里的脏页还在系统缓存中，新视图看得到
+    CloseHandle(m->mapping);
+    m->view = view;
+    m->mapping = mapping;
+    unsigned int oldBytes = (oldCapacity + 7) / 8 + 1, newBytes = (capacity + 7) / 8 + 1;
+    m->logged = (unsigned char*)realloc(m->logged, newBytes);
+    m->dirty = (unsigned char*)realloc(m->dirty, newBytes);
+    memset(m->logged + oldBytes, 0, newBytes - oldBytes);
+    memset(m->dirty + oldBytes, 0, newBytes - oldBytes);
+    mapTouchHeader(m);
+    if (!mapJournalSync(m)) return 0;
+    mapHeader(m)->capacity = capacity;
+    return 1;
+}
+
+// 分配一个槽：先用空闲链表，再用高水位之后的，都没有就扩文件；失败返回0
+// 返回前日志已刷盘（调用者之前记的日志一起刷）
+static unsigned int mapAllocSlot(MapFile* m) {
+    MapFileHeader* h = mapHeader(m);
+    unsigned int slot;
+    if (h->freeHead) {
+        slot = h->freeHead;
+        mapTouchHeader(m);
+        mapTouchSlot(m, slot);
+        if (!mapJournalSync(m)) return 0;
+        h->freeHead = *mapNext(m, slot);
+    } else {
+        if (h->used == h->capacity && !mapGrow(m)) return 0;
+        h = mapHeader(m);
+        mapTouchHeader(m);
+        if (!mapJournalSync(m)) return 0;
+        slot = ++h->used;
+        mapTouchSlot(m, slot);  // 高水位之后的槽，不用记日志
+    }
+    return slot;
+}
+
+/* mapNoteLink - 节点接到prev之后（prev为NULL表示接在表头）后调用：分配槽写入，接进槽链表 */
+static void mapNoteLink(Table* table, RecordNode* prev, RecordNode* node) {
+    MapFile* m = table->map;
+    if (!m || m->stale) return;
+    unsigned int prevSlot = prev ? mapFindSlot(m, prev) : 0;
+    if (prevSlot) mapTouchSlot(m, prevSlot);  // 和分配槽要记的日志一起刷盘
+    unsigned int slot = (prev && !prevSlot) ? 0 : mapAllocSlot(m);
+    if (!slot || !mapWriteCells(m, slot, node->cells)) {
+        m->stale = 1;
+        return;
+    }
+    MapFileHeader* h = mapHeader(m);
+    unsigned int* link = prevSlot ? mapNext(m, prevSlot) : &h->head;
+    *mapNext(m, slot) = *link;
+    *link = slot;
+    if (!*mapNext(m, slot)) h->tail = slot;
+    h->rowCount++;
+    mapPutSlot(m, node, slot);
+}
+
+/* mapNoteUnlink - 节点从prev之后摘下后调用（释放节点之前）：槽移出链表，放回空闲链表 */
+static void mapNoteUnlink(Table* table, RecordNode* prev, RecordNode* node) {
+    MapFile* m = table->map;
+    if (!m || m->stale) return;
+    unsigned int slot = mapFindSlot(m, node);
+    unsigned int prevSlot = prev ? mapFindSlot(m, prev) : 0;
+    if (!slot || (prev && !prevSlot)) {
+        m->stale = 1;
+        return;
+    }
+    MapFileHeader* h = mapHeader(m);
+    mapTouchHeader(m);
+    if (prevSlot) mapTouchSlot(m, prevSlot);
+    mapTouchSlot(m, slot);
+    if (!mapJournalSync(m)) return;
+    unsigned int next = *mapNext(m, slot);
+    if (prevSlot) *mapNext(m, prevSlot) = next;
+    else h->head = next;
+    if (h->tail == slot) h->tail = prevSlot;
+    *mapNext(m, slot) = h->freeHead;
+    *(unsigned int*)(mapSlot(m, slot) + MAP_SLOT_USED) = 0;
+    h->freeHead = slot;
+    h->rowCount--;
+    mapEraseSlot(m, node);
+}
+
+/* mapNoteUpdate - 节点内容改变后调用：原地改写它的槽 */
+static void mapNoteUpdate(Table* table, RecordNode* node) {
+    MapFile* m = table->map;
+    if (!m || m->stale) return;
+    unsigned int slot = mapFindSlot(m, node);
+    if (slot) mapTouchSlot(m, slot);
+    if (!slot || !mapJournalSync(m) || !mapWriteCells(m, slot, node->cells)) m->stale = 1;
+}
+
+/* mapRelink - 链表在from之后（NULL表示从表头起）被重新排序后调用（节点不变）
+ * 按内存中的顺序改写槽的next，只有真正变了的链接才记日志、算脏页
+ * 两遍：第一遍给要改的槽记日志，刷一次盘，第二遍再改
+ */
+static void mapRelink(Table* table, RecordNode* from) {
+    MapFile* m = table->map;
+    if (!m || m->stale) return;
+    MapFileHeader* h = mapHeader(m);
+    unsigned int first = from ? mapFindSlot(m, from) : 0;
+    if (from && !first) {
+        m->stale = 1;
+        return;
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        unsigned int prevSlot = first;
+        for (RecordNode* cur = from ? from->next : table->head; ; cur = cur->next) {
+            unsigned int slot = cur ? mapFindSlot(m, cur) : 0;
+            if (cur && !slot) {
+                m->stale = 1;
+                return;
+            }
+            unsigned int* link = prevSlot ? mapNext(m, prevSlot) : &h->head;
+            if (*link != slot) {
+                if (pass == 1) *link = slot;
+                else if (prevSlot) mapTouchSlot(m, prevSlot);
+                else mapTouchHeader(m);
+            }
+            if (!cur) break;
+            prevSlot = slot;
+        }
+        if (h->tail != prevSlot) {
+            if (pass == 1) h->tail = prevSlot;
+            else mapTouchHeader(m);
+        }
+        if (pass == 0 && !mapJournalSync(m)) return;
+    }
+}
+
+// 行顺序整体变了、节点也换了（聚簇整表）：保存时整文件重写
+static void mapInvalidate(Table* table) {
+    if (table->map) table->map->stale = 1;
+}
+
+/* mapLayout - 按表的当前内容定文件布局：字符串列宽 = 最长值+1 向上取16的倍数（至少MAP_MIN_STR_WIDTH）
+ * 返回值：槽大小；列太多或列名太长返回0
+ */
+static unsigned int mapLayout(Table* table, MapFileColumn* cols) {
+    int nc = table->numColumns;
+    if (nc > MAP_MAX_COLUMNS) return 0;
+    size_t* maxLen = (size_t*)queryAlloc(nc * sizeof(size_t));
+    memset(maxLen, 0, nc * sizeof(size_t));
+    for (RecordNode* cur = table->head; cur; cur = cur->next) {
+        for (int c = 0; c < nc; c++) {
+            if (table->columns[c].type == 1) continue;
+            size_t len = strlen(cellStr(&cur->cells[c]));
+            if (len > maxLen[c]) maxLen[c] = len;
+        }
+    }
+    unsigned long long offset = MAP_SLOT_CELLS;
+    for (int c = 0; c < nc; c++) {
+        if (strlen(table->columns[c].name) >= MAP_NAME_MAX) return 0;
+        memset(&cols[c], 0, sizeof(MapFileColumn));
+        strcpy(cols[c].name, table->columns[c].name);
+        cols[c].type = table->columns[c].type;
+        cols[c].offset = (unsigned int)offset;
+        if (cols[c].type == 1) {
+            cols[c].width = sizeof(int);
+        } else {
+            size_t width = (maxLen[c] + 1 + 15) & ~(size_t)15;
+            cols[c].width = (unsigned int)(width < MAP_MIN_STR_WIDTH ? MAP_MIN_STR_WIDTH : width);
+        }
+        offset += cols[c].width;
+    }
+    return offset > 0xFFFFFFull ? 0 : (unsigned int)offset;
+}
+
+/* mapWriteFile - 把表整个写成新的映射表文件path（写完刷盘）
+ * 返回值：成功返回1
+ */
+static int mapWriteFile(Table* table, const char* path, unsigned int stamp) {
+    MapFileColumn* cols = (MapFileColumn*)queryAlloc(table->numColumns * sizeof(MapFileColumn));
+    unsigned int slotSize = mapLayout(table, cols);
+    if (!slotSize) return 0;
+    unsigned int n = (unsigned int)table->rowCount;
+    unsigned int capacity = n + n / 2 < MAP_MIN_SLOTS ? MAP_MIN_SLOTS : n + n / 2;
+    unsigned long long size = MAP_HEADER_SIZE + (unsigned long long)capacity * slotSize;
+    if (size > 0xFFFFFFFFull) return 0;
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return 0;
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, (DWORD)size, NULL);
+    unsigned char* view = mapping ? (unsigned char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) : NULL;
+    int ok = view != NULL;
+    if (ok) {
+        MapFileHeader* h = (MapFileHeader*)view;
+        memset(view, 0, MAP_HEADER_SIZE);
+        memcpy(h->magic, MAP_MAGIC, 4);
+        h->format = MAP_FORMAT;
+        h->stamp = stamp;
+        h->numColumns = table->numColumns;
+        h->slotSize = slotSize;
+        h->capacity = capacity;
+        h->used = n;
+        h->head = n > 0 ? 1 : 0;
+        h->tail = n;
+        h->rowCount = (int)n;
+        memcpy(view + sizeof(MapFileHeader), cols, table->numColumns * sizeof(MapFileColumn));
+        MapFile tmp;
+        memset(&tmp, 0, sizeof(tmp));
+        tmp.view = view;
+        unsigned int slot = 1;
+        for (RecordNode* cur = table->head; cur; cur = cur->next, slot++) {
+            mapWriteCells(&tmp, slot, cur->cells);  // 列宽按现有内容定，一定放得下
+            *mapNext(&tmp, slot) = cur->next ? slot + 1 : 0;
+        }
+        ok = FlushViewOfFile(view, 0) && FlushFileBuffers(file);
+    }
+    if (view) UnmapViewOfFile(view);
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+    return ok;
+}
+
+// 检查文件头和列定义是否自洽，槽区都在文件内
+static int mapCheckHeader(MapFile* m, DWORD fileSize) {
+    MapFileHeader* h = mapHeader(m);
+    if (memcmp(h->magic, MAP_MAGIC, 4) != 0 || h->format != MAP_FORMAT || h->numColumns <= 0 || h->numColumns > MAP_MAX_COLUMNS) return 0;
+    MapFileColumn* cols = mapColumns(m);
+    unsigned long long offset = MAP_SLOT_CELLS;
+    for (int c = 0; c < h->numColumns; c++) {
+        if (cols[c].offset != offset || memchr(cols[c].name, '\0', MAP_NAME_MAX) == NULL) return 0;
+        if (cols[c].type == 1 ? cols[c].width != sizeof(int) : (cols[c].type != 2 || cols[c].width == 0)) return 0;
+        offset += cols[c].width;
+    }
+    return h->slotSize == offset && h->used <= h->capacity
+        && MAP_HEADER_SIZE + (unsigned long long)h->capacity * h->slotSize <= fileSize
+        && h->head <= h->used && h->tail <= h->used && h->freeHead <= h->used
+        && h->rowCount >= 0 && (unsigned int)h->rowCount <= h->used;
+}
+
+// 清空撤销日志（只留日志头）并刷盘
+static int mapResetJournal(MapFile* m) {
+    struct { char magic[4]; unsigned int stamp; } head;
+    memcpy(head.magic, MAP_JOURNAL_MAGIC, 4);
+    head.stamp = mapHeader(m)->stamp;
+    DWORD written;
+    return SetFilePointer(m->journal, 0, NULL, FILE_BEGIN) != INVALID_SET_FILE_POINTER && SetEndOfFile(m->journal)
+        && WriteFile(m->journal, &head, sizeof(head), &written, NULL) && FlushFileBuffers(m->journal);
+}
+
+/* mapRecover - 打开时调用：把撤销日志里的原内容写回文件并刷盘
+ * 日志头的代号和文件不同（日志属于被整体替换掉的旧文件）时不用
+ * 返回值：写回的记录数
+ */
+static int mapRecover(MapFile* m, DWORD fileSize) {
+    DWORD size = GetFileSize(m->journal, NULL);
+    if (size == INVALID_FILE_SIZE || size <= 8) return 0;
+    unsigned char* buf = (unsigned char*)malloc(size);
+    DWORD got = 0;
+    int applied = 0;
+    if (buf && SetFilePointer(m->journal, 0, NULL, FILE_BEGIN) != INVALID_SET_FILE_POINTER
+        && ReadFile(m->journal, buf, size, &got, NULL) && got == size
+        && memcmp(buf, MAP_JOURNAL_MAGIC, 4) == 0 && memcmp(buf + 4, &mapHeader(m)->stamp, 4) == 0) {
+        size_t pos = 8;
+        while (pos + 16 <= size) {
+            unsigned int offset, length;
+            unsigned long long sum;
+            memcpy(&offset, buf + pos, 4);
+            memcpy(&length, buf + pos + 4, 4);
+            memcpy(&sum, buf + pos + 8, 8);
+            if (length > size - pos - 16 || (unsigned long long)offset + length > fileSize
+                || checksumText((const char*)buf + pos + 16, length) != sum) break;  // 写了一半的记录：对应的修改还没发生
+            memcpy(m->view + offset, buf + pos + 16, length);
+            applied++;
+            pos += 16 + length;
+        }
+        if (applied && !(FlushViewOfFile(m->view, 0) && FlushFileBuffers(m->file))) applied = -1;
+    }
+    free(buf);
+    return applied;
+}
+
+static void mapClose(MapFile* m) {
+    if (!m) return;
+    if (m->view) UnmapViewOfFile(m->view);
+    if (m->mapping) CloseHandle(m->mapping);
+    if (m->file) CloseHandle(m->file);
+    if (m->journal) CloseHandle(m->journal);
+    free(m->logged);
+    free(m->dirty);
+    free(m->slots);
+    free(m);
+}
+
+// 打开映射表文件：映射、按日志撤销上次保存后的改动、检查文件头、清空日志
+static MapFile* mapOpen(const char* base) {
+    if (strlen(base) >= sizeof(((MapFile*)0)->base)) return NULL;
+    MapFile* m = (MapFile*)calloc(1, sizeof(MapFile));
+    strcpy(m->base, base);
+    char path[300];
+    mapPath(path, sizeof(path), base, ".tbl");
+    m->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m->file == INVALID_HANDLE_VALUE) m->file = NULL;
+    mapPath(path, sizeof(path), base, ".tbj");
+    m->journal = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m->journal == INVALID_HANDLE_VALUE) m->journal = NULL;
+    DWORD fileSize = m->file ? GetFileSize(m->file, NULL) : INVALID_FILE_SIZE;
+    int ok = m->journal && fileSize != INVALID_FILE_SIZE && fileSize >= MAP_HEADER_SIZE;
+    if (ok) {
+        m->mapping = CreateFileMappingA(m->file, NULL, PAGE_READWRITE, 0, 0, NULL);
+        m->view = m->mapping ? (unsigned char*)MapViewOfFile(m->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) : NULL;
+        ok = m->view != NULL;
+    }
+    if (ok) {
+        m->recovered = mapRecover(m, fileSize);
+        ok = m->recovered >= 0 && mapCheckHeader(m, fileSize) && mapResetJournal(m);
+    }
+    if (!ok) {
+        mapClose(m);
+        return NULL;
+    }
+    MapFileHeader* h = mapHeader(m);
+    m->logged = (unsigned char*)calloc((h->capacity + 7) / 8 + 1, 1);
+    m->dirty = (unsigned char*)calloc((h->capacity + 7) / 8 + 1, 1);
+    m->savedUsed = h->used;
+    m->slotMask = 15;
+    while (m->slotMask + 1 < (unsigned int)h->rowCount * 2) m->slotMask = m->slotMask * 2 + 1;
+    m->slots = (MapNodeSlot*)calloc(m->slotMask + 1, sizeof(MapNodeSlot));
+    return m;
+}
+
+// 内存链表和槽链表逐行对应，建 节点 -> 槽号 的哈希表；对不上返回0
+static int mapBuildSlots(MapFile* m, Table* table) {
+    MapFileHeader* h = mapHeader(m);
+    unsigned int slot = h->head;
+    for (RecordNode* cur = table->head; cur; cur = cur->next) {
+        if (!slot || slot > h->used) return 0;
+        mapPutSlot(m, cur, slot);
+        slot = *mapNext(m, slot);
+    }
+    return slot == 0 && h->rowCount == table->rowCount;
+}
+
+// 关闭表的映射表文件（上次保存后的改动在下次打开时按日志撤销）
+static void closeMappedFile(Table* table) {
+    mapClose(table->map);
+    table->map = NULL;
+}
+
+/* attachMappedFile - 把表写成映射表文件 <base>.tbl，之后的增删改直接改映射中的槽
+ * 返回值：成功返回1
+ */
+int attachMappedFile(Table* table, const char* base) {
+    if (!table || strlen(base) >= sizeof(((MapFile*)0)->base)) return 0;
+    closeMappedFile(table);
+    char path[300];
+    mapPath(path, sizeof(path), base, ".tbj");
+    DeleteFileA(path);  // 旧日志不属于新文件
+    mapPath(path, sizeof(path), base, ".tbl");
+    if (!mapWriteFile(table, path, (unsigned int)time(NULL))) return 0;
+    MapFile* m = mapOpen(base);
+    if (!m || !mapBuildSlots(m, table)) {
+        mapClose(m);
+        return 0;
+    }
+    table->map = m;
+    return 1;
+}
+
+/* mapRewrite - 整文件重写：写临时文件后替换原文件，相当于保存一次
+ * 返回值：成功返回1；临时文件写不成时原映射不动（仍待重写），返回0；
+ *         替换或重新打开失败时表与映射表文件断开，返回0
+ */
+static int mapRewrite(Table* table) {
+    MapFile* m = table->map;
+    char base[256], path[300], tmp[300];
+    strcpy(base, m->base);
+    mapPath(path, sizeof(path), base, ".tbl");
+    mapPath(tmp, sizeof(tmp), base, ".tbl.tmp");
+    int saves = m->saves, rewrites = m->rewrites + 1;
+    if (!mapWriteFile(table, tmp, mapHeader(m)->stamp + 1)) {
+        remove(tmp);
+        return 0;
+    }
+    closeMappedFile(table);  // 映射着的文件不能被替换
+    int ok = MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING);
+    MapFile* fresh = ok ? mapOpen(base) : NULL;
+    if (!fresh || !mapBuildSlots(fresh, table)) {
+        mapClose(fresh);
+        remove(tmp);
+        return 0;
+    }
+    fresh->saves = saves;
+    fresh->rewrites = rewrites;
+    table->map = fresh;
+    return 1;
+}
+
+/* flushMappedFile - 保存：把上次保存后改过的槽和文件头刷回磁盘，再清空撤销日志
+ * 连续的脏槽合成一段调用一次FlushViewOfFile；需要整文件重写时直接重写
+ * 返回值：成功返回1
+ */
+int flushMappedFile(Table* table) {
+    MapFile* m = table ? table->map : NULL;
+    if (!m) return 0;
+    HighResTimer timer;
+    timerStart(&timer);
+    if (m->stale) {
+        if (!mapRewrite(table)) return 0;
+        m = table->map;
+        m->saves++;
+        m->lastRanges = 1;
+        m->lastBytes = MAP_HEADER_SIZE + (unsigned long long)mapHeader(m)->capacity * mapHeader(m)->slotSize;
+        m->saveMs = timerEndMs(&timer);
+        return 1;
+    }
+    MapFileHeader* h = mapHeader(m);
+    int ok = 1, ranges = 0;
+    unsigned long long bytes = 0;
+    if (m->headerDirty) {
+        ok = FlushViewOfFile(m->view, MAP_HEADER_SIZE);
+        ranges++;
+        bytes += MAP_HEADER_SIZE;
+    }
+    unsigned int n = h->capacity;
+    for (unsigned int i = 0; i < n; ) {
+        if (!(m->dirty[i >> 3] & (1u << (i & 7)))) {
+            i = (i & 7) == 0 && !m->dirty[i >> 3] ? i + 8 : i + 1;  // 整字节没有脏槽就一次跳过
+            continue;
+        }
+        unsigned int start = i;
+        while (i < n && (m->dirty[i >> 3] & (1u << (i & 7)))) i++;
+        size_t len = (size_t)(i - start) * h->slotSize;
+        ok = FlushViewOfFile(mapSlot(m, start + 1), len) && ok;
+        ranges++;
+        bytes += len;
+    }
+    ok = ok && FlushFileBuffers(m->file) && mapResetJournal(m);
+    if (ok) {
+        memset(m->logged, 0, (n + 7) / 8);
+        memset(m->dirty, 0, (n + 7) / 8);
+        m->headerLogged = 0;
+        m->headerDirty = 0;
+        m->savedUsed = h->used;
+        m->journalRecords = 0;
+        m->saves++;
+        m->lastRanges = ranges;
+        m->lastBytes = bytes;
+        m->saveMs = timerEndMs(&timer);
+    }
+    return ok;
+}
+
+/* openMappedTable - 映射已有的映射表文件，沿槽链表把行取进新表
+ * 上次保存后没保存的改动先按撤销日志撤掉
+ * 返回值：新表；文件不存在或损坏返回NULL
+ */
+Table* openMappedTable(const char* base) {
+    MapFile* m = mapOpen(base);
+    if (!m) return NULL;
+    MapFileHeader* h = mapHeader(m);
+    MapFileColumn* cols = mapColumns(m);
+    int nc = h->numColumns;
+    Column* columns = (Column*)calloc(nc, sizeof(Column));
+    for (int c = 0; c < nc; c++) {
+        columns[c].name = cols[c].name;  // createTable 会拷贝列名
+        columns[c].type = cols[c].type;
+    }
+    Table* table = createTable(nc, columns);
+    free(columns);
+    
+    Cell* cells = (Cell*)queryAlloc(nc * sizeof(Cell));
+    unsigned int slot = h->head;
+    int ok = 1;
+    for (int i = 0; ok && i < h->rowCount; i++) {
+        ok = slot && slot <= h->used && mapReadCells(m, slot, cells);
+        if (!ok) break;
+        addRecord(table, cells);
+        freeCells(cells, table->columns, nc);
+        slot = *mapNext(m, slot);
+    }
+    if (!ok || slot != 0 || !mapBuildSlots(m, table)) {
+        mapClose(m);
+        freeTable(table);
+        return NULL;
+    }
+    table->map = m;
+    return table;
+}
+
+void printMappedFileStats(Table* table) {
+    MapFile* m = table->map;
+    if (!m) {
+        printf("Mapped table file is off.\n");
+        return;
+    }
+    MapFileHeader* h = mapHeader(m);
+    printf("Mapped table file: %s.tbl (%u/%u slots of %u bytes, %d rows)\n", m->base, h->used, h->capacity, h->slotSize, h->rowCount);
+    int dirty = 0;
+    for (unsigned int i = 0; i < (h->capacity + 7) / 8; i++) {
+        for (unsigned char b = m->dirty[i]; b; b &= (unsigned char)(b - 1)) dirty++;
+    }
+    printf("  Unsaved: %d dirty slot(s)%s, %d journal record(s)%s\n", dirty, m->headerDirty ? " + header" : "",
+           m->journalRecords, m->stale ? ", full rewrite on next save" : "");
+    printf("  Saves: %d (full rewrites: %d)", m->saves, m->rewrites);
+    if (m->saves > 0) printf(", last %.2f ms, %d range(s), %llu bytes", m->saveMs, m->lastRanges, m->lastBytes);
+    printf("\n");
+    if (m->recovered > 0) printf("  Rolled back %d unsaved change(s) when opening.\n", m->recovered);
+}
+
+/*==================== 纪元回收 ====================*/
+
+/*
+ * 无锁结构里摘下的节点不能马上释放：别的线程可能正走到它。
+ *   每个线程操作前在自己的槽里登记当前全局纪元，操作完撤销。摘下的节点记下当时的纪元放进退休栈；
+ *   所有正在操作的线程都已登记到当前纪元时，全局纪元才能加1。
+ *   全局纪元比节点退休时大2以上，说明退休时在操作的线程都已经结束，节点可以释放。
+ * 并发哈希索引和并发跳表共用。
+ */
+#define EPOCH_MAX_THREADS 64                  // 同时访问的线程数上限
+#define EPOCH_RECLAIM_EVERY 64                // 每退休这么多节点尝试回收一次
+
+// 可回收的节点以它开头
+typedef struct EpochItem {
+    struct EpochItem* next;        // 退休栈
+    LONG epoch;                    // 退休时的全局纪元
+} EpochItem;
+
+typedef struct {
+    volatile LONG active;          // 1 = 线程正在操作
+    volatile LONG epoch;           // 操作开始时登记的全局纪元
+    volatile LONG used;            // 槽已分给某个线程
+    unsigned int rng;              // 线程自己的随机数状态（跳表取层数用）
+    char pad[48];                  // 各线程的槽不共享缓存行
+} EpochThread;
+
+typedef struct {
+    EpochThread threads[EPOCH_MAX_THREADS];
+    volatile LONG epoch;           // 全局纪元
+    EpochItem* volatile retired;   // 退休节点栈
+    volatile LONG retiredCount;
+    volatile LONG freed;           // 已回收的节点数
+    void (*destroy)(EpochItem*);   // 释放一个节点
+} EpochDomain;
+
+/* epochRegister - 给调用线程分一个线程槽（之后的每次操作都带上它）
+ * 返回值：槽号，满了返回-1
+ */
+static int epochRegister(EpochDomain* d) {
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+        if (InterlockedCompareExchange(&d->threads[i].used, 1, 0) == 0) {
+            d->threads[i].rng = 2654435761u * (unsigned int)(i + 1);
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void epochUnregister(EpochDomain* d, int slot) {
+    InterlockedExchange(&d->threads[slot].used, 0);
+}
+
+static void epochEnter(EpochDomain* d, int slot) {
+    EpochThread* t = &d->threads[slot];
+    InterlockedExchange(&t->active, 1);           // 先置活跃：回收线程看到旧纪元只会少推进一次，不会多
+    InterlockedExchange(&t->epoch, d->epoch);     // 全屏障：之后读共享结构不会排到登记之前
+}
+
+static void epochExit(EpochDomain* d, int slot) {
+    InterlockedExchange(&d->threads[slot].active, 0);
+}
+
+static void epochPush(EpochDomain* d, EpochItem* item) {
+    EpochItem* top;
+    do {
+        top = d->retired;
+        item->next = top;
+    } while (InterlockedCompareExchangePointer((PVOID volatile*)&d->retired, item, top) != top);
+}
+
+// 尝试推进全局纪元，再释放退休已满两个纪元的节点
+static void epochReclaim(EpochDomain* d) {
+    LONG epoch = d->epoch;
+    int advance = 1;
+    for (int i = 0; i < EPOCH_MAX_THREADS && advance; i++) {
+        if (d->threads[i].active && d->threads[i].epoch != epoch) advance = 0;
+    }
+    if (advance) InterlockedCompareExchange(&d->epoch, epoch + 1, epoch);
+    epoch = d->epoch;
+    EpochItem* list = (EpochItem*)InterlockedExchangePointer((PVOID volatile*)&d->retired, NULL);
+    while (list) {
+        EpochItem* item = list;
+        list = item->next;
+        if (epoch - item->epoch >= 2) {
+            d->destroy(item);
+            InterlockedIncrement(&d->freed);
+        } else {
+            epochPush(d, item);
+        }
+    }
+}
+
+// 已摘下的节点放进退休栈，攒够一批就尝试回收（调用线程须在 epochEnter/epochExit 之间）
+static void epochRetire(EpochDomain* d, EpochItem* item) {
+    item->epoch = d->epoch;
+    epochPush(d, item);
+    if (InterlockedIncrement(&d->retiredCount) % EPOCH_RECLAIM_EVERY == 0) epochReclaim(d);
+}
+
+// 释放退休栈里剩下的节点（没有线程在访问时）
+static void epochFreeRetired(EpochDomain* d) {
+    EpochItem* item = d->retired;
+    while (item) {
+        EpochItem* next = item->next;
+        d->destroy(item);
+        item = next;
+    }
+    d->retired = NULL;
+}
+
+/*==================== 并发哈希索引 ====================*/
+
+/*
+ * 某一列上的 键 -> 行 哈希索引，多个线程可以同时查找、插入、删除：
+ *   - 查找不加锁、不写共享数据（除了自己线程槽里的纪元），读线程越多吞吐越高
+ *   - 插入、删除只用CAS，不加锁
+ *
+ * 结构：分裂有序链表（split-ordered list）
+ *   所有元素在一条按"位反转哈希"排序的无锁链表上；桶只是指向链表中哨兵节点的指针。
+ *   桶数翻倍时不搬动任何元素：新桶的哨兵在第一次用到时从父桶（去掉最高位）插进链表。
+ *   同一哈希值的元素相邻，再按行地址排序，所以同一个键可以对应多行。
+ *   桶指针按段（每段1024个）分配，段在第一次用到时用CAS装上，目录本身不用扩。
+ *
+ * 删除（Harris-Michael）：先用CAS在被删节点的next上打删除标记（最低位），再把它从链表中摘掉；
+ * 任何线程走到打了标记的节点都会顺手帮忙摘。摘下的节点交给纪元回收。
+ *
+ * 行用 RecordNode* 表示（和主键索引相同）。表的增删改仍在主线程进行，
+ * 由与其他索引相同的挂钩同步到这里；并发访问用于多线程点查（见 chashBenchmark）。
+ */
+#define CH_SEGMENT_BITS 10                    // 每段 2^10 个桶
+#define CH_MAX_SEGMENTS (1 << 14)             // 最多 2^24 个桶
+#define CH_LOAD_FACTOR 2                      // 平均每桶超过2个元素时桶数翻倍
+
+typedef struct ChNode {
+    EpochItem retire;
+    struct ChNode* volatile next;  // 最低位为1：本节点已被逻辑删除
+    unsigned int sortKey;          // 位反转的哈希：普通节点最低位为1，哨兵节点为0
+    int intKey;
+    char* strKey;                  // 字符串键的副本（整数列为NULL）
+    RecordNode* row;               // 哨兵为NULL
+} ChNode;
+
+typedef ChNode* volatile ChBucket;
+
+typedef struct ConcurrentHash {
+    int column;
+    int isInt;
+    ChBucket* volatile* segments;  // CH_MAX_SEGMENTS 个段指针
+    volatile LONG size;            // 桶数（2的幂）
+    volatile LONG count;           // 元素数
+    EpochDomain reclaim;
+} ConcurrentHash;
+
+static int chMarked(const ChNode* p) { return ((size_t)p & 1) != 0; }
+static ChNode* chMark(ChNode* p) { return (ChNode*)((size_t)p | 1); }
+static ChNode* chUnmark(ChNode* p) { return (ChNode*)((size_t)p & ~(size_t)1); }
+
+// 读共享指针：volatile读在VC下带acquire语义，x86/x64上就是普通读，不会在读线程之间争缓存行
+static ChNode* chLoad(ChNode* volatile* p) { return *p; }
+
+static int chCas(ChNode* volatile* p, ChNode* expected, ChNode* desired) {
+    return InterlockedCompareExchangePointer((PVOID volatile*)p, desired, expected) == expected;
+}
+
+static unsigned int chReverse(unsigned int x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+static unsigned int chHash(const ConcurrentHash* h, const Cell* key) {
+    if (h->isInt) {
+        unsigned int x = (unsigned int)key->data.int_val;  // 与主键索引相同的打散
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+    return (unsigned int)bloomHash(cellStr(key));
+}
+
+static int chKeyEqual(const ConcurrentHash* h, const ChNode* node, const Cell* key) {
+    return h->isInt ? node->intKey == key->data.int_val : strcmp(node->strKey, cellStr(key)) == 0;
+}
+
+// 节点排在 (sortKey, row) 之前。同一哈希值的按行地址从大到小排：
+// 建索引时行节点大多按地址递增分配，新元素插在同一个键的最前面，不用走完重复值的整串
+static int chBefore(const ChNode* node, unsigned int sortKey, const RecordNode* row) {
+    return node->sortKey < sortKey || (node->sortKey == sortKey && (size_t)node->row > (size_t)row);
+}
+
+/* chashRegister - 给调用线程分一个线程槽（之后的每次操作都带上它）
+ * 返回值：槽号，满了返回-1
+ */
+int chashRegister(ConcurrentHash* h) {
+    return epochRegister(&h->reclaim);
+}
+
+void chashUnregister(ConcurrentHash* h, int slot) {
+    epochUnregister(&h->reclaim, slot);
+}
+
+static void chFreeNode(ChNode* node) {
+    free(node->strKey);
+    free(node);
+}
+
+static void chDestroy(EpochItem* item) {
+    chFreeNode((ChNode*)item);
+}
+
+/* chFind - 从哨兵start往后找第一个不排在 (sortKey, row) 之前的节点，路上摘掉打了删除标记的节点
+ * 返回值：该节点正好是 (sortKey, row) 返回1；*prevOut 为指向它的链接，*curOut 为它（可能为NULL）
+ */
+static int chFind(ConcurrentHash* h, ChNode* start, unsigned int sortKey, const RecordNode* row,
+                  ChNode* volatile** prevOut, ChNode** curOut) {
+    for (;;) {
+        ChNode* volatile* prev = &start->next;
+        ChNode* cur = chLoad(prev);  // 哨兵不会被删，它的next不带标记
+        int restart = 0;
+        while (cur) {
+            ChNode* next = chLoad(&cur->next);
+            if (chMarked(next)) {
+                if (!chCas(prev, cur, chUnmark(next))) { restart = 1; break; }
+                epochRetire(&h->reclaim, &cur->retire);
+                cur = chUnmark(next);
+                continue;
+            }
+            if (chLoad(prev) != cur) { restart = 1; break; }  // 前驱被删或被改
+            if (!chBefore(cur, sortKey, row)) break;
+            prev = &cur->next;
+            cur = next;
+        }
+        if (restart) continue;
+        *prevOut = prev;
+        *curOut = cur;
+        return cur && cur->sortKey == sortKey && cur->row == row;
+    }
+}
+
+// 桶指针的地址；段还没分配时 create=1 就分配（CAS装上），否则返回NULL
+static ChBucket* chBucketSlot(ConcurrentHash* h, unsigned int bucket, int create) {
+    unsigned int seg = bucket >> CH_SEGMENT_BITS;
+    ChBucket* s = h->segments[seg];
+    if (!s) {
+        if (!create) return NULL;
+        ChBucket* fresh = (ChBucket*)calloc((size_t)1 << CH_SEGMENT_BITS, sizeof(ChBucket));
+        s = (ChBucket*)InterlockedCompareExchangePointer((PVOID volatile*)&h->segments[seg], (PVOID)fresh, NULL);
+        if (s) free((void*)fresh);
+        else s = fresh;
+    }
+    return &s[bucket & ((1u << CH_SEGMENT_BITS) - 1)];
+}
+
+static unsigned int chParent(unsigned int bucket) {
+    unsigned int bit = 0x80000000u;
+    while (!(bucket & bit)) bit >>= 1;
+    return bucket & ~bit;
+}
+
+// 桶的哨兵，还没有就从父桶的哨兵开始插进链表（写操作用）
+static ChNode* chSentinel(ConcurrentHash* h, unsigned int bucket) {
+    ChBucket* b = chBucketSlot(h, bucket, 1);
+    ChNode* s = chLoad(b);
+    if (s) return s;
+    ChNode* parent = chSentinel(h, chParent(bucket));
+    ChNode* node = (ChNode*)calloc(1, sizeof(ChNode));
+    node->sortKey = chReverse(bucket);
+    for (;;) {
+        ChNode* volatile* prev;
+        ChNode* cur;
+        if (chFind(h, parent, node->sortKey, NULL, &prev, &cur)) {  // 别的线程已经插进去了
+            free(node);
+            node = cur;
+            break;
+        }
+        node->next = cur;
+        if (chCas(prev, cur, node)) break;
+    }
+    chCas(b, NULL, node);
+    return chLoad(b);
+}
+
+// 桶的哨兵，还没有就用最近的已有祖先桶的（读操作用，不分配任何东西）
+static ChNode* chExistingSentinel(ConcurrentHash* h, unsigned int bucket) {
+    for (;;) {
+        ChBucket* b = chBucketSlot(h, bucket, 0);
+        ChNode* s = b ? chLoad(b) : NULL;
+        if (s) return s;
+        bucket = chParent(bucket);  // 0号桶一定存在
+    }
+}
+
+/* chashLookup - 查键对应的行（不加锁）
+ * 参数：@rows/@max: 最多写入max个行
+ * 返回值：匹配的行数（可能大于max）
+ */
+int chashLookup(ConcurrentHash* h, int slot, const Cell* key, RecordNode** rows, int max) {
+    unsigned int hash = chHash(h, key);
+    unsigned int sortKey = chReverse(hash) | 1;
+    int found = 0;
+    epochEnter(&h->reclaim, slot);
+    ChNode* start = chExistingSentinel(h, hash & (unsigned int)(h->size - 1));
+    for (ChNode* cur = chUnmark(chLoad(&start->next)); cur && cur->sortKey <= sortKey; cur = chUnmark(chLoad(&cur->next))) {
+        if (cur->sortKey == sortKey && !chMarked(chLoad(&cur->next)) && chKeyEqual(h, cur, key)) {
+            if (found < max) rows[found] = cur->row;
+            found++;
+        }
+    }
+    epochExit(&h->reclaim, slot);
+    return found;
+}
+
+/* chashInsert - 加入 (key, row)
+ * 返回值：加入返回1，已存在返回0
+ */
+int chashInsert(ConcurrentHash* h, int slot, const Cell* key, RecordNode* row) {
+    unsigned int hash = chHash(h, key);
+    ChNode* node = (ChNode*)calloc(1, sizeof(ChNode));
+    node->sortKey = chReverse(hash) | 1;
+    node->row = row;
+    if (h->isInt) node->intKey = key->data.int_val;
+    else node->strKey = _strdup(cellStr(key));
+    
+    epochEnter(&h->reclaim, slot);
+    LONG size = h->size;
+    ChNode* start = chSentinel(h, hash & (unsigned int)(size - 1));
+    int added = 0;
+    for (;;) {
+        ChNode* volatile* prev;
+        ChNode* cur;
+        if (chFind(h, start, node->sortKey, row, &prev, &cur)) break;
+        node->next = cur;
+        if (chCas(prev, cur, node)) {
+            added = 1;
+            break;
+        }
+    }
+    epochExit(&h->reclaim, slot);
+    if (!added) {
+        chFreeNode(node);
+        return 0;
+    }
+    LONG count = InterlockedIncrement(&h->count);
+    if (count > size * CH_LOAD_FACTOR && size < ((LONG)CH_MAX_SEGMENTS << CH_SEGMENT_BITS)) {
+        InterlockedCompareExchange(&h->size, size * 2, size);  // 别的线程已经翻倍就算了
+    }
+    return 1;
+}
+
+/* chashRemove - 删除 (key, row)
+ * 返回值：删除返回1，不存在返回0
+ */
+int chashRemove(ConcurrentHash* h, int slot, const Cell* key, RecordNode* row) {
+    unsigned int hash = chHash(h, key);
+    unsigned int sortKey = chReverse(hash) | 1;
+    int removed = 0;
+    epochEnter(&h->reclaim, slot);
+    ChNode* start = chSentinel(h, hash & (unsigned int)(h->size - 1));
+    for (;;) {
+        ChNode* volatile* prev;
+        ChNode* cur;
+        if (!chFind(h, start, sortKey, row, &prev, &cur)) break;
+        ChNode* next = chLoad(&cur->next);
+        if (chMarked(next)) continue;                       // 别的线程在删，重找一遍
+        if (!chCas(&cur->next, next, chMark(next))) continue;  // next变了，重来
+        removed = 1;
+        if (chCas(prev, cur, next)) epochRetire(&h->reclaim, &cur->retire);
+        else chFind(h, start, sortKey, row, &prev, &cur);  // 摘不下来就让查找顺手摘
+        break;
+    }
+    epochExit(&h->reclaim, slot);
+    if (removed) InterlockedDecrement(&h->count);
+    return removed;
+}
+
+/* freeConcurrentHash - 释放索引（调用时不能有其他线程在访问） */
+void freeConcurrentHash(ConcurrentHash* h) {
+    if (!h) return;
+    ChNode* cur = h->segments[0][0];  // 0号桶的哨兵是整条链表的头
+    while (cur) {
+        ChNode* next = chUnmark(cur->next);
+        chFreeNode(cur);
+        cur = next;
+    }
+    epochFreeRetired(&h->reclaim);
+    for (int i = 0; i < CH_MAX_SEGMENTS; i++) free((void*)h->segments[i]);
+    free((void*)h->segments);
+    free(h);
+}
+
+static void dropConcurrentHash(Table* table) {
+    freeConcurrentHash(table->chash);
+    table->chash = NULL;
+}
+
+/* buildConcurrentHash - 在表的第colIndex列上建并发哈希索引（主线程占0号线程槽）
+ * 时间复杂度：O(n)
+ */
+ConcurrentHash* buildConcurrentHash(Table* table, int colIndex) {
+    if (!table || colIndex < 0 || colIndex >= table->numColumns) return NULL;
+    dropConcurrentHash(table);
+    ConcurrentHash* h = (ConcurrentHash*)calloc(1, sizeof(ConcurrentHash));
+    h->column = colIndex;
+    h->isInt = table->columns[colIndex].type == 1;
+    h->segments = (ChBucket* volatile*)calloc(CH_MAX_SEGMENTS, sizeof(ChBucket*));
+    h->reclaim.destroy = chDestroy;
+    h->size = 1 << CH_SEGMENT_BITS;
+    while (h->size < table->rowCount / CH_LOAD_FACTOR && h->size < ((LONG)CH_MAX_SEGMENTS << CH_SEGMENT_BITS)) h->size *= 2;
+    *chBucketSlot(h, 0, 1) = (ChNode*)calloc(1, sizeof(ChNode));  // 0号桶的哨兵
+    chashRegister(h);  // 0号槽：主线程
+    for (RecordNode* cur = table->head; cur; cur = cur->next) chashInsert(h, 0, &cur->cells[colIndex], cur);
+    table->chash = h;
+    return h;
+}
+
+// 节点地址全变了（聚簇搬节点）：按原来的列重建
+static void rebuildConcurrentHash(Table* table) {
+    if (table->chash) buildConcurrentHash(table, table->chash->column);
+}
+
+// 表的增删改挂钩（主线程，0号槽）
+static void chashNoteInsert(Table* table, RecordNode* node) {
+    ConcurrentHash* h = table->chash;
+    if (h) chashInsert(h, 0, &node->cells[h->column], node);
+}
+
+static void chashNoteRemove(Table* table, RecordNode* node) {
+    ConcurrentHash* h = table->chash;
+    if (h) chashRemove(h, 0, &node->cells[h->column], node);
+}
+
+typedef struct {
+    ConcurrentHash* h;
+    const Cell* keys;          // 要查的键
+    RecordNode** rows;         // 写线程：keys[i] 对应的行
+    int keyCount;
+    int ops;                   // 读线程：查找次数
+    unsigned int seed;
+    volatile LONG* stop;       // 写线程：读线程都结束后置1
+    long long hits;
+    int writes;
+} ChBenchArg;
+
+static DWORD WINAPI chBenchReader(LPVOID param) {
+    ChBenchArg* a = (ChBenchArg*)param;
+    int slot = chashRegister(a->h);
+    unsigned int x = a->seed;
+    RecordNode* rows[4];
+    long long hits = 0;  // 计在局部变量里，最后写一次：各线程的参数挨在一起，每次都写会互相抢缓存行
+    for (int i = 0; i < a->ops; i++) {
+        x = x * 1103515245u + 12345u;
+        hits += chashLookup(a->h, slot, &a->keys[(x >> 8) % (unsigned int)a->keyCount], rows, 4) > 0;
+    }
+    a->hits = hits;
+    chashUnregister(a->h, slot);
+    return 0;
+}
+
+// 写线程：反复删掉一个 (键, 行) 再加回去，直到读线程结束（结束时索引内容不变）
+static DWORD WINAPI chBenchWriter(LPVOID param) {
+    ChBenchArg* a = (ChBenchArg*)param;
+    int slot = chashRegister(a->h);
+    unsigned int x = a->seed;
+    int writes = 0;
+    while (!InterlockedCompareExchange(a->stop, 0, 0)) {
+        x = x * 1103515245u + 12345u;
+        int i = (int)((x >> 8) % (unsigned int)a->keyCount);
+        if (chashRemove(a->h, slot, &a->keys[i], a->rows[i])) chashInsert(a->h, slot, &a->keys[i], a->rows[i]);
+        writes++;
+    }
+    a->writes = writes;
+    chashUnregister(a->h, slot);
+    return 0;
+}
+
+/* chashBenchmark - 1、2、4、8个读线程各做opsPerThread次随机点查，同时有一个写线程不停删了再加
+ * 打印各线程数下的吞吐（查找次数/秒）
+ */
+void chashBenchmark(Table* table, int opsPerThread) {
+    ConcurrentHash* h = table->chash;
+    if (!h || table->rowCount == 0) return;
+    int keyCount = table->rowCount < 65536 ? table->rowCount : 65536;
+    Cell* keys = (Cell*)malloc(keyCount * sizeof(Cell));
+    RecordNode** rows = (RecordNode**)malloc(keyCount * sizeof(RecordNode*));
+    int step = table->rowCount / keyCount, i = 0, r = 0;
+    for (RecordNode* cur = table->head; cur && i < keyCount; cur = cur->next, r++) {
+        if (r % step) continue;
+        keys[i] = cur->cells[h->column];  // 只读，直接共用表里的字符串
+        rows[i++] = cur;
+    }
+    keyCount = i;
+    double base = 0;
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        ChBenchArg args[9];
+        HANDLE handles[9];
+        volatile LONG stop = 0;
+        HighResTimer timer;
+        timerStart(&timer);
+        for (int t = 0; t <= threads; t++) {
+            args[t].h = h;
+            args[t].keys = keys;
+            args[t].rows = rows;
+            args[t].keyCount = keyCount;
+            args[t].ops = opsPerThread;
+            args[t].seed = 2654435761u * (unsigned int)(t + 1);
+            args[t].stop = &stop;
+            args[t].hits = 0;
+            args[t].writes = 0;
+            handles[t] = CreateThread(NULL, 0, t < threads ? chBenchReader : chBenchWriter, &args[t], 0, NULL);
+        }
+        long long hits = 0;
+        for (int t = 0; t < threads; t++) {
+            WaitForSingleObject(handles[t], INFINITE);
+            CloseHandle(handles[t]);
+            hits += args[t].hits;
+        }
+        double ms = timerEndMs(&timer);
+        InterlockedExchange(&stop, 1);
+        WaitForSingleObject(handles[threads], INFINITE);
+        CloseHandle(handles[threads]);
+        double rate = (double)threads * opsPerThread / (ms > 0 ? ms : 1e-3) * 1000.0;
+        if (threads == 1) base = rate;
+        printf("  %d reader(s) + 1 writer: %.0f lookups/s (x%.2f), hit %.1f%%, %d concurrent writes\n",
+               threads, rate, rate / base, 100.0 * hits / ((double)threads * opsPerThread), args[threads].writes);
+    }
+    free(keys);
+    free(rows);
+}
+
+void printConcurrentHashStats(Table* table) {
+    ConcurrentHash* h = table->chash;
+    if (!h) {
+        printf("Concurrent hash index is off.\n");
+        return;
+    }
+    printf("Concurrent hash index on %s: %ld entries, %ld buckets, epoch %ld, nodes reclaimed: %ld\n",
+           table->columns[h->column].name, (long)h->count, (long)h->size, (long)h->reclaim.epoch, (long)h->reclaim.freed);
+}
+
+/*==================== 并发跳表索引 ====================*/
+
+/*
+ * 某一列上的有序索引，多个线程可以同时插入、删除和按序遍历，都不加锁。
+ *   AVL树插入要旋转，一次改好几个节点，很难让别的线程同时读写。
+ *   跳表每层都是一条有序链表，插入只是在每层各CAS一次指针，彼此不牵连。
+ *
+ * 结构：无锁跳表（Fraser / Herlihy-Shavit）
+ *   元素按 (键, 行地址) 排序，同一个键可以有多行。层数随机（每升一层概率1/4，最高16层）。
+ *   插入：先CAS接进第0层（接上就算插入成功），再从下往上逐层接。
+ *   删除：从最高层往下在每层的next上打删除标记，第0层打上标记的线程算删除成功；
+ *         之后查找路上遇到带标记的节点就顺手摘掉。
+ *   回收：删除时节点的上层可能还没接完。"插入线程接完上层"和"第0层被打上删除标记"各算一件，
+ *         两件都做完时，做完后一件的线程再查找一次（保证每层都已摘掉），然后交给纪元回收。
+ *
+ * 查询（GE / LE / BETWEEN、最小/最大、前N/后N）只读不写，返回行节点；
+ * 行号在并发插入下随时会变，所以不转成行号。
+ *
+ * 只有索引本身支持并发写：表的行链表不是线程安全的，addRecord 等仍只在主线程调用，
+ * 经 skipNoteInsert / skipNoteRemove 同步进索引。skipBenchmark 的写线程直接对索引
+ * skipRemove / skipInsert 已有的 (键, 行)，不经过 addRecord。
+ */
+#define SL_MAX_LEVEL 16
+
+typedef struct SlNode {
+    EpochItem retire;
+    int intKey;
+    char* strKey;                  // 字符串键的副本（整数列为NULL）
+    RecordNode* row;               // 头节点为NULL
+    volatile LONG pending;         // 还没做完的事：接上层、删除；减到0的线程负责回收
+    int height;
+    struct SlNode* volatile next[];  // height 个，最低位为1：本节点在这一层已被删除
+} SlNode;
+
+typedef struct SkipList {
+    int column;
+    int isInt;
+    SlNode* head;                  // SL_MAX_LEVEL 层高的头节点
+    volatile LONG count;           // 元素数
+    EpochDomain reclaim;
+} SkipList;
+
+// 查找用的键：(key, row)。row 为 NULL 表示排在这个键所有行之前，SL_ROW_LAST 表示之后
+#define SL_ROW_LAST ((RecordNode*)~(size_t)0)
+
+typedef struct {
+    int intKey;
+    const char* strKey;
+    const RecordNode* row;
+} SlKey;
+
+static int slMarked(const SlNode* p) { return ((size_t)p & 1) != 0; }
+static SlNode* slMark(SlNode* p) { return (SlNode*)((size_t)p | 1); }
+static SlNode* slUnmark(SlNode* p) { return (SlNode*)((size_t)p & ~(size_t)1); }
+
+static int slCas(SlNode* volatile* p, SlNode* expected, SlNode* desired) {
+    return InterlockedCompareExchangePointer((PVOID volatile*)p, desired, expected) == expected;
+}
+
+static SlKey slKeyOf(const SkipList* sl, const Cell* key, const RecordNode* row) {
+    SlKey k;
+    k.intKey = sl->isInt ? key->data.int_val : 0;
+    k.strKey = sl->isInt ? NULL : cellStr(key);
+    k.row = row;
+    return k;
+}
+
+static SlKey slNodeKey(const SlNode* node) {
+    SlKey k;
+    k.intKey = node->intKey;
+    k.strKey = node->strKey;
+    k.row = node->row;
+    return k;
+}
+
+// 节点与键比较：<0 节点在前
+static int slCompare(const SkipList* sl, const SlNode* node, const SlKey* k) {
+    int c = sl->isInt ? (node->intKey > k->intKey) - (node->intKey < k->intKey) : strcmp(node->strKey, k->strKey);
+    if (c) return c;
+    return ((size_t)node->row > (size_t)k->row) - ((size_t)node->row < (size_t)k->row);
+}
+
+/* slFind - 找出每层最后一个排在k之前的节点（preds）和它的后继（succs），路上摘掉带删除标记的节点
+ * 返回值：第0层的后继正好是k返回1
+ */
+static int slFind(SkipList* sl, const SlKey* k, SlNode** preds, SlNode** succs) {
+    for (;;) {
+        SlNode* pred = sl->head;
+        int restart = 0;
+        for (int level = SL_MAX_LEVEL - 1; level >= 0 && !restart; level--) {
+            SlNode* cur = slUnmark(pred->next[level]);
+            while (cur) {
+                SlNode* next = cur->next[level];
+                if (slMarked(next)) {
+                    // pred 自己被删了（它的next带标记）CAS会失败，从头再来
+                    if (!slCas(&pred->next[level], cur, slUnmark(next))) { restart = 1; break; }
+                    cur = slUnmark(next);
+                    continue;
+                }
+                if (slCompare(sl, cur, k) >= 0) break;
+                pred = cur;
+                cur = next;
+            }
+            preds[level] = pred;
+            succs[level] = cur;
+        }
+        if (!restart) return succs[0] && slCompare(sl, succs[0], k) == 0;
+    }
+}
+
+// 做完节点的一件事；两件都做完了就把它从各层摘掉并交给纪元回收
+static void slRelease(SkipList* sl, SlNode* node) {
+    if (InterlockedDecrement(&node->pending) != 0) return;
+    SlNode* preds[SL_MAX_LEVEL];
+    SlNode* succs[SL_MAX_LEVEL];
+    SlKey k = slNodeKey(node);
+    slFind(sl, &k, preds, succs);
+    epochRetire(&sl->reclaim, &node->retire);
+}
+
+static void slFreeNode(SlNode* node) {
+    free(node->strKey);
+    free(node);
+}
+
+static void slDestroy(EpochItem* item) {
+    slFreeNode((SlNode*)item);
+}
+
+static int slRandomHeight(SkipList* sl, int slot) {
+    unsigned int x = sl->reclaim.threads[slot].rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sl->reclaim.threads[slot].rng = x;
+    int height = 1;
+    while (height < SL_MAX_LEVEL && (x & 3) == 0) {
+        height++;
+        x >>= 2;
+    }
+    return height;
+}
+
+int skipRegister(SkipList* sl) {
+    return epochRegister(&sl->reclaim);
+}
+
+void skipUnregister(SkipList* sl, int slot) {
+    epochUnregister(&sl->reclaim, slot);
+}
+
+/* skipInsert - 加入 (key, row)
+ * 返回值：加入返回1，已存在返回0
+ */
+int skipInsert(SkipList* sl, int slot, const Cell* key, RecordNode* row) {
+    int height = slRandomHeight(sl, slot);
+    SlNode* node = (SlNode*)calloc(1, sizeof(SlNode) + height * sizeof(SlNode*));
+    node->height = height;
+    node->row = row;
+    node->pending = 2;
+    if (sl->isInt) node->intKey = key->data.int_val;
+    else node->strKey = _strdup(cellStr(key));
+    SlKey k = slNodeKey(node);
+    SlNode* preds[SL_MAX_LEVEL];
+    SlNode* succs[SL_MAX_LEVEL];
+    
+    epochEnter(&sl->reclaim, slot);
+    for (;;) {
+        if (slFind(sl, &k, preds, succs)) {
+            epochExit(&sl->reclaim, slot);
+            slFreeNode(node);
+            return 0;
+        }
+        for (int level = 0; level < height; level++) node->next[level] = succs[level];
+        if (slCas(&preds[0]->next[0], succs[0], node)) break;
+    }
+    InterlockedIncrement(&sl->count);
+    
+    // 逐层往上接；节点在接的过程中被删了就不再接
+    for (int level = 1; level < height; level++) {
+        int linked = 0;
+        while (!linked) {
+            SlNode* mine = node->next[level];
+            if (slMarked(mine)) break;
+            if (mine != succs[level] && !slCas(&node->next[level], mine, succs[level])) continue;
+            if (slCas(&preds[level]->next[level], succs[level], node)) linked = 1;
+            else if (!slFind(sl, &k, preds, succs)) break;
+        }
+        if (!linked) break;
+    }
+    slRelease(sl, node);
+    epochExit(&sl->reclaim, slot);
+    return 1;
+}
+
+/* skipRemove - 删除 (key, row)
+ * 返回值：删除返回1，不存在返回0
+ */
+int skipRemove(SkipList* sl, int slot, const Cell* key, RecordNode* row) {
+    SlKey k = slKeyOf(sl, key, row);
+    SlNode* preds[SL_MAX_LEVEL];
+    SlNode* succs[SL_MAX_LEVEL];
+    int removed = 0;
+    epochEnter(&sl->reclaim, slot);
+    if (slFind(sl, &k, preds, succs)) {
+        SlNode* node = succs[0];
+        for (int level = node->height - 1; level >= 1; level--) {
+            SlNode* next = node->next[level];
+            while (!slMarked(next) && !slCas(&node->next[level], next, slMark(next))) next = node->next[level];
+        }
+        for (;;) {
+            SlNode* next = node->next[0];
+            if (slMarked(next)) break;  // 别的线程删掉了
+            if (slCas(&node->next[0], next, slMark(next))) {
+                removed = 1;
+                break;
+            }
+        }
+        if (removed) {
+            InterlockedDecrement(&sl->count);
+            slRelease(sl, node);
+        }
+    }
+    epochExit(&sl->reclaim, slot);
+    return removed;
+}
+
+// 第一个不排在k之前、没被删除的节点（只读）
+static SlNode* slSeek(SkipList* sl, const SlKey* k) {
+    SlNode* pred = sl->head;
+    for (int level = SL_MAX_LEVEL - 1; level >= 0; level--) {
+        SlNode* cur = slUnmark(pred->next[level]);
+        while (cur && slCompare(sl, cur, k) < 0) {
+            pred = cur;
+            cur = slUnmark(cur->next[level]);
+        }
+    }
+    SlNode* cur = slUnmark(pred->next[0]);
+    while (cur && slMarked(cur->next[0])) cur = slUnmark(cur->next[0]);
+    return cur;
+}
+
+// 最后一个排在k之前、没被删除的节点（k为NULL表示表尾；只读）
+static SlNode* slLastBefore(SkipList* sl, const SlKey* k) {
+    SlKey bound;
+    int bounded = k != NULL;
+    if (k) bound = *k;
+    for (;;) {
+        SlNode* pred = sl->head;
+        for (int level = SL_MAX_LEVEL - 1; level >= 0; level--) {
+            SlNode* cur = slUnmark(pred->next[level]);
+            while (cur && (!bounded || slCompare(sl, cur, &bound) < 0)) {
+                pred = cur;
+                cur = slUnmark(cur->next[level]);
+            }
+        }
+        // pred 是第0层最后一个排在前面的，被删了的话就从它往前再找一次
+        if (pred == sl->head || !slMarked(pred->next[0])) return pred == sl->head ? NULL : pred;
+        bound = slNodeKey(pred);
+        bounded = 1;
+    }
+}
+
+/* skipRange - 按键从小到大取 low <= 键 <= high 的行（GE：high为NULL；LE：low为NULL；BETWEEN：都给）
+ * 参数：@rows/@max: 最多取max行，到max就停
+ * 返回值：取到的行数
+ * 时间复杂度：O(log n + k)
+ */
+int skipRange(SkipList* sl, int slot, const Cell* low, const Cell* high, RecordNode** rows, int max) {
+    SlKey lowKey, highKey;
+    if (low) lowKey = slKeyOf(sl, low, NULL);
+    if (high) highKey = slKeyOf(sl, high, SL_ROW_LAST);
+    int found = 0;
+    epochEnter(&sl->reclaim, slot);
+    SlNode* cur = low ? slSeek(sl, &lowKey) : slUnmark(sl->head->next[0]);
+    while (cur && found < max) {
+        if (high && slCompare(sl, cur, &highKey) > 0) break;
+        SlNode* next = cur->next[0];
+        if (!slMarked(next)) rows[found++] = cur->row;
+        cur = slUnmark(next);
+    }
+    epochExit(&sl->reclaim, slot);
+    return found;
+}
+
+/* skipTopN - 键最大的n行，从大到小
+ * 时间复杂度：O(n log N)，每次从上往下找前一个
+ */
+int skipTopN(SkipList* sl, int slot, RecordNode** rows, int n) {
+    int found = 0;
+    epochEnter(&sl->reclaim, slot);
+    SlNode* cur = slLastBefore(sl, NULL);
+    while (cur && found < n) {
+        rows[found++] = cur->row;
+        SlKey k = slNodeKey(cur);
+        cur = slLastBefore(sl, &k);
+    }
+    epochExit(&sl->reclaim, slot);
+    return found;
+}
+
+// 最小键的行，空索引返回NULL
+RecordNode* skipMin(SkipList* sl, int slot) {
+    RecordNode* row = NULL;
+    skipRange(sl, slot, NULL, NULL, &row, 1);
+    return row;
+}
+
+// 最大键的行，空索引返回NULL
+RecordNode* skipMax(SkipList* sl, int slot) {
+    RecordNode* row = NULL;
+    skipTopN(sl, slot, &row, 1);
+    return row;
+}
+
+/* freeSkipList - 释放索引（调用时不能有其他线程在访问） */
+void freeSkipList(SkipList* sl) {
+    if (!sl) return;
+    SlNode* cur = sl->head;
+    while (cur) {
+        SlNode* next = slUnmark(cur->next[0]);
+        slFreeNode(cur);
+        cur = next;
+    }
+    epochFreeRetired(&sl->reclaim);
+    free(sl);
+}
+
+static void dropSkipList(Table* table) {
+    freeSkipList(table->skip);
+    table->skip = NULL;
+}
+
+/* buildSkipList - 在表的第colIndex列上建并发跳表（主线程占0号线程槽）
+ * 时间复杂度：O(n log n)
+ */
+SkipList* buildSkipList(Table* table, int colIndex) {
+    if (!table || colIndex < 0 || colIndex >= table->numColumns) return NULL;
+    dropSkipList(table);
+    SkipList* sl = (SkipList*)calloc(1, sizeof(SkipList));
+    sl->column = colIndex;
+    sl->isInt = table->columns[colIndex].type == 1;
+    sl->head = (SlNode*)calloc(1, sizeof(SlNode) + SL_MAX_LEVEL * sizeof(SlNode*));
+    sl->head->height = SL_MAX_LEVEL;
+    sl->reclaim.destroy = slDestroy;
+    skipRegister(sl);  // 0号槽：主线程
+    for (RecordNode* cur = table->head; cur; cur = cur->next) skipInsert(sl, 0, &cur->cells[colIndex], cur);
+    table->skip = sl;
+    return sl;
+}
+
+// 节点地址全变了（聚簇搬节点）：按原来的列重建
+static void rebuildSkipList(Table* table) {
+    if (table->skip) buildSkipList(table, table->skip->column);
+}
+
+// 表的增删改挂钩（主线程，0号槽）
+static void skipNoteInsert(Table* table, RecordNode* node) {
+    SkipList* sl = table->skip;
+    if (sl) skipInsert(sl, 0, &node->cells[sl->column], node);
+}
+
+static void skipNoteRemove(Table* table, RecordNode* node) {
+    SkipList* sl = table->skip;
+    if (sl) skipRemove(sl, 0, &node->cells[sl->column], node);
+}
+
+typedef struct {
+    SkipList* sl;
+    const Cell* keys;          // 取样的键
+    RecordNode** rows;         // keys[i] 对应的行
+    int keyCount;
+    int from, to;              // 写线程：负责 keys[from..to)，各写线程互不重叠
+    int ops;                   // 读线程：范围查询次数
+    int scan;                  // 每次范围查询取多少行
+    unsigned int seed;
+    volatile LONG* stop;       // 写线程：读线程都结束后置1
+    long long scanned;
+    int writes;
+} SlBenchArg;
+
+static DWORD WINAPI slBenchReader(LPVOID param) {
+    SlBenchArg* a = (SlBenchArg*)param;
+    int slot = skipRegister(a->sl);
+    RecordNode** out = (RecordNode**)malloc(a->scan * sizeof(RecordNode*));
+    unsigned int x = a->seed;
+    long long scanned = 0;  // 计在局部变量里，最后写一次，免得和相邻线程的参数抢缓存行
+    for (int i = 0; i < a->ops; i++) {
+        x = x * 1103515245u + 12345u;
+        scanned += skipRange(a->sl, slot, &a->keys[(x >> 8) % (unsigned int)a->keyCount], NULL, out, a->scan);
+    }
+    a->scanned = scanned;
+    free(out);
+    skipUnregister(a->sl, slot);
+    return 0;
+}
+
+// 写线程：反复删掉一个 (键, 行) 再插回去，直到读线程结束（结束时索引内容不变）
+static DWORD WINAPI slBenchWriter(LPVOID param) {
+    SlBenchArg* a = (SlBenchArg*)param;
+    int slot = skipRegister(a->sl);
+    unsigned int x = a->seed;
+    int writes = 0;
+    while (!InterlockedCompareExchange(a->stop, 0, 0)) {
+        x = x * 1103515245u + 12345u;
+        int i = a->from + (int)((x >> 8) % (unsigned int)(a->to - a->from));
+        if (skipRemove(a->sl, slot, &a->keys[i], a->rows[i])) skipInsert(a->sl, slot, &a->keys[i], a->rows[i]);
+        writes += 2;
+    }
+    a->writes = writes;
+    skipUnregister(a->sl, slot);
+    return 0;
+}
+
+/* skipBenchmark - 1、2、4个读线程各做opsPerThread次范围查询（从随机键起按序取scan行），
+ * 分别在没有写线程和有writers个写线程不停删了再插时测一遍，打印吞吐
+ * 写线程直接改索引，不经过addRecord（表的行链表不能多线程改）
+ */
+void skipBenchmark(Table* table, int opsPerThread, int scan, int writers) {
+    SkipList* sl = table->skip;
+    if (!sl || table->rowCount == 0) return;
+    if (writers > 8) writers = 8;
+    int keyCount = table->rowCount < 65536 ? table->rowCount : 65536;
+    Cell* keys = (Cell*)malloc(keyCount * sizeof(Cell));
+    RecordNode** rows = (RecordNode**)malloc(keyCount * sizeof(RecordNode*));
+    int step = table->rowCount / keyCount, i = 0, r = 0;
+    for (RecordNode* cur = table->head; cur && i < keyCount; cur = cur->next, r++) {
+        if (r % step) continue;
+        keys[i] = cur->cells[sl->column];  // 只读，直接共用表里的字符串
+        rows[i++] = cur;
+    }
+    keyCount = i;
+    if (writers > keyCount) writers = keyCount;
+    for (int w = 0; w <= writers; w += writers > 0 ? writers : 1) {
+        for (int threads = 1; threads <= 4; threads *= 2) {
+            SlBenchArg args[12];
+            HANDLE handles[12];
+            volatile LONG stop = 0;
+            HighResTimer timer;
+            timerStart(&timer);
+            for (int t = 0; t < threads + w; t++) {
+                args[t].sl = sl;
+                args[t].keys = keys;
+                args[t].rows = rows;
+                args[t].keyCount = keyCount;
+                args[t].from = (t - threads) * keyCount / (w > 0 ? w : 1);
+                args[t].to = (t - threads + 1) * keyCount / (w > 0 ? w : 1);
+                args[t].ops = opsPerThread;
+                args[t].scan = scan;
+                args[t].seed = 2654435761u * (unsigned int)(t + 1);
+                args[t].stop = &stop;
+                args[t].scanned = 0;
+                args[t].writes = 0;
+                handles[t] = CreateThread(NULL, 0, t < threads ? slBenchReader : slBenchWriter, &args[t], 0, NULL);
+            }
+            long long scanned = 0;
+            for (int t = 0; t < threads; t++) {
+                WaitForSingleObject(handles[t], INFINITE);
+                CloseHandle(handles[t]);
+                scanned += args[t].scanned;
+            }
+            double ms = timerEndMs(&timer);
+            InterlockedExchange(&stop, 1);
+            long long writes = 0;
+            for (int t = threads; t < threads + w; t++) {
+                WaitForSingleObject(handles[t], INFINITE);
+                CloseHandle(handles[t]);
+                writes += args[t].writes;
+            }
+            if (ms <= 0) ms = 1e-3;
+            printf("  %d reader(s) + %d writer(s): %.0f range queries/s (%.1f rows each), %.0f writes/s\n",
+                   threads, w, threads * opsPerThread / ms * 1000.0, (double)scanned / ((double)threads * opsPerThread),
+                   writes / ms * 1000.0);
+        }
+    }
+    free(keys);
+    free(rows);
+}
+
+void printSkipListStats(Table* table) {
+    SkipList* sl = table->skip;
+    if (!sl) {
+        printf("Concurrent skip list is off.\n");
+        return;
+    }
+    printf("Concurrent skip list on %s: %ld entries, epoch %ld, nodes reclaimed: %ld\n",
+           table->columns[sl->column].name, (long)sl->count, (long)sl->reclaim.epoch, (long)sl->reclaim.freed);
+}
+
+/*==================== 共享扫描 ====================*/
+
+/*
+ * 很多查询同时做全表过滤时，各自从头到尾走一遍链表，互相抢内存带宽。
+ * 共享扫描只让一个扫描线程绕着表一圈一圈地走：
+ *   - 每次取一批行（SCAN_BATCH 个节点，几十KB，落在L2里），挂着的每个查询都在这一批上算自己的条件
+ *   - 新查询随时挂上，从扫描线程当前所在的批开始，跟着走满一圈（全表的批数）就摘下
+ *   - 挂上时已经走过的那段在下一圈开头补上，所以结果的行号先是挂上处到表尾、再是表头到挂上处，
+ *     摘下时转一下，和线性查找一样按行号从小到大
+ * 表头和批边界是固定的（第1行、第SCAN_BATCH+1行……），每个查询正好看到每一行一次。
+ *
+ * 共享扫描开着的时候主线程不能改表（和其他多线程读一样）。
+ */
+#define SCAN_BATCH 512
+
+typedef struct ScanQuery {
+    int column;
+    int isInt;
+    int low, high;                 // 整数列：low <= 值 <= high
+    const char* value;             // 字符串列：等于value
+    SearchResult* result;          // 查询线程分配，扫描线程填写
+    int startRow;                  // 挂上时所在批的第一行
+    int remaining;                 // 还要看的批数
+    HANDLE finished;               // 扫描线程转完一圈后置位，查询线程在上面等
+    struct ScanQuery* next;        // 等待挂上的栈
+} ScanQuery;
+
+typedef struct SharedScan {
+    Table* table;
+    HANDLE thread;
+    HANDLE wake;                   // 有新查询或要结束时置位（扫描线程空闲时在上面等）
+    ScanQuery* volatile pending;   // 新提交、还没挂上的查询
+    volatile LONG stop;
+    volatile LONG batchesRun;      // 扫描线程走过的批数
+    volatile LONG queriesRun;      // 完成的查询数
+} SharedScan;
+
+// 结果按挂上处转回行号顺序：[startRow之后的 | 绕回来的] -> [绕回来的 | startRow之后的]（三次反转）
+static void scanReverse(unsigned int* a, int n) {
+    for (int i = 0, j = n - 1; i < j; i++, j--) {
+        unsigned int t = a[i];
+        a[i] = a[j];
+        a[j] = t;
+    }
+}
+
+static void scanFinish(ScanQuery* q) {
+    SearchResult* sr = q->result;
+    int split = 0;
+    while (split < sr->count && sr->rowNums[split] >= (unsigned int)q->startRow) split++;
+    if (split > 0 && split < sr->count) {
+        scanReverse(sr->rowNums, split);
+        scanReverse(sr->rowNums + split, sr->count - split);
+        scanReverse(sr->rowNums, sr->count);
+    }
+    SetEvent(q->finished);  // 之后不能再碰q：它在查询线程的栈上
+}
+
+// 一批行里某一列的值抽成连续数组：挂着的查询都在它上面算，每批每列只从节点里读一次
+typedef struct {
+    int loaded;                    // 本批已抽取
+    int ints[SCAN_BATCH];
+    const char* strs[SCAN_BATCH];
+} ScanColumn;
+
+static void scanLoadColumn(const Table* table, ScanColumn* c, int col, RecordNode** batch, int n) {
+    if (table->columns[col].type == 1) {
+        for (int i = 0; i < n; i++) c->ints[i] = batch[i]->cells[col].data.int_val;
+    } else {
+        for (int i = 0; i < n; i++) c->strs[i] = cellStr(&batch[i]->cells[col]);
+    }
+    c->loaded = 1;
+}
+
+// 一个查询在一批行上算条件
+static void scanEvaluate(const ScanQuery* q, const ScanColumn* c, int n, int firstRow) {
+    SearchResult* sr = q->result;
+    if (q->isInt) {
+        if (q->high < q->low) return;
+        unsigned int low = (unsigned int)q->low, span = (unsigned int)q->high - low;
+        for (int i = 0; i < n; i++) {
+            if ((unsigned int)c->ints[i] - low <= span) addToResult(sr, firstRow + i);  // 一次比较判断 low <= v <= high
+        }
+    } else {
+        for (int i = 0; i < n; i++) {
+            if (strcmp(c->strs[i], q->value) == 0) addToResult(sr, firstRow + i);
+        }
+    }
+}
+
+static DWORD WINAPI sharedScanThread(LPVOID param) {
+    SharedScan* s = (SharedScan*)param;
+    Table* table = s->table;
+    int batches = (table->rowCount + SCAN_BATCH - 1) / SCAN_BATCH;  // 一圈的批数
+    RecordNode* batch[SCAN_BATCH];
+    ScanColumn* columns = (ScanColumn*)calloc(table->numColumns, sizeof(ScanColumn));
+    ScanQuery** active = NULL;
+    int activeCount = 0, activeCapacity = 0;
+    RecordNode* cursor = table->head;
+    int cursorRow = 1;
+    
+    for (;;) {
+        // 在批边界上挂上新查询
+        ScanQuery* q = (ScanQuery*)InterlockedExchangePointer((PVOID volatile*)&s->pending, NULL);
+        while (q) {
+            ScanQuery* next = q->next;
+            q->startRow = cursorRow;
+            q->remaining = batches;
+            if (batches == 0) {
+                scanFinish(q);
+            } else {
+                if (activeCount == activeCapacity) {
+                    activeCapacity = activeCapacity ? activeCapacity * 2 : 16;
+                    active = (ScanQuery**)realloc(active, activeCapacity * sizeof(ScanQuery*));
+                }
+                active[activeCount++] = q;
+            }
+            q = next;
+        }
+        if (activeCount == 0) {
+            if (InterlockedCompareExchange(&s->stop, 0, 0) && !s->pending) break;
+            WaitForSingleObject(s->wake, INFINITE);  // 取空之后才提交的查询会让它立刻返回
+            continue;
+        }
+        
+        int n = 0;
+        for (; cursor && n < SCAN_BATCH; cursor = cursor->next) batch[n++] = cursor;
+        for (int c = 0; c < table->numColumns; c++) columns[c].loaded = 0;
+        for (int i = 0; i < activeCount; i++) {
+            ScanColumn* c = &columns[active[i]->column];
+            if (!c->loaded) scanLoadColumn(table, c, active[i]->column, batch, n);
+            scanEvaluate(active[i], c, n, cursorRow);
+        }
+        for (int i = 0; i < activeCount; ) {
+            if (--active[i]->remaining == 0) {
+                ScanQuery* finished = active[i];
+                active[i] = active[--activeCount];
+                scanFinish(finished);
+                InterlockedIncrement(&s->queriesRun);
+            } else {
+                i++;
+            }
+        }
+        InterlockedIncrement(&s->batchesRun);
+        cursorRow += n;
+        if (!cursor) {  // 走到表尾，绕回表头
+            cursor = table->head;
+            cursorRow = 1;
+        }
+    }
+    free(active);
+    free(columns);
+    return 0;
+}
+
+/* startSharedScan - 开始共享扫描：起一个扫描线程，之后多个线程可以通过它做全表过滤
+ * 返回值：失败返回NULL
+ */
+SharedScan* startSharedScan(Table* table) {
+    if (!table) return NULL;
+    SharedScan* s = (SharedScan*)calloc(1, sizeof(SharedScan));
+    s->table = table;
+    s->wake = CreateEventA(NULL, FALSE, FALSE, NULL);
+    s->thread = s->wake ? CreateThread(NULL, 0, sharedScanThread, s, 0, NULL) : NULL;
+    if (!s->thread) {
+        if (s->wake) CloseHandle(s->wake);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+/* stopSharedScan - 结束共享扫描：已经提交的查询都做完后扫描线程才退出 */
+void stopSharedScan(SharedScan* s) {
+    if (!s) return;
+    InterlockedExchange(&s->stop, 1);
+    SetEvent(s->wake);
+    WaitForSingleObject(s->thread, INFINITE);
+    CloseHandle(s->thread);
+    CloseHandle(s->wake);
+    free(s);
+}
+
+// 提交查询并等它转完一圈
+static SearchResult* sharedScanRun(SharedScan* s, ScanQuery* q) {
+    q->result = createSearchResult(0);  // 在查询线程的结果池里取，用完由查询线程放回
+    q->finished = CreateEventA(NULL, FALSE, FALSE, NULL);
+    ScanQuery* top;
+    do {
+        top = s->pending;
+        q->next = top;
+    } while (InterlockedCompareExchangePointer((PVOID volatile*)&s->pending, q, top) != top);
+    SetEvent(s->wake);
+    WaitForSingleObject(q->finished, INFINITE);
+    CloseHandle(q->finished);
+    return q->result;
+}
+
+/* sharedScanRange - 通过共享扫描查整数列 low <= 值 <= high 的行（结果与 linearFindBetween 相同）
+ * 可以在多个线程里同时调用
+ */
+SearchResult* sharedScanRange(SharedScan* s, int colIndex, int low, int high) {
+    if (s->table->columns[colIndex].type != 1) return createSearchResult(0);
+    ScanQuery q;
+    memset(&q, 0, sizeof(q));
+    q.column = colIndex;
+    q.isInt = 1;
+    q.low = low;
+    q.high = high;
+    return sharedScanRun(s, &q);
+}
+
+/* sharedScanStrEqual - 通过共享扫描查字符串列等于value的行（结果与 linearFindStrEqual 相同） */
+SearchResult* sharedScanStrEqual(SharedScan* s, int colIndex, const char* value) {
+    if (s->table->columns[colIndex].type != 2 || !bloomMayContain(s->table, colIndex, value)) {
+        return createSearchResult(0);  // 布隆过滤器判定一定不存在，不用挂上
+    }
+    ScanQuery q;
+    memset(&q, 0, sizeof(q));
+    q.column = colIndex;
+    q.value = value;
+    return sharedScanRun(s, &q);
+}
+
+typedef struct {
+    Table* table;
+    SharedScan* scan;          // NULL：各自线性扫描
+    int column;
+    const Cell* keys;          // 每个查询的条件：整数列查 [v, v+10]，字符串列查等值
+    int queries;
+    long long matched;
+} ScanBenchArg;
+
+static DWORD WINAPI scanBenchClient(LPVOID param) {
+    ScanBenchArg* a = (ScanBenchArg*)param;
+    int isInt = a->table->columns[a->column].type == 1;
+    for (int i = 0; i < a->queries; i++) {
+        const Cell* k = &a->keys[i];
+        SearchResult* sr;
+        if (a->scan) {
+            sr = isInt ? sharedScanRange(a->scan, a->column, k->data.int_val, k->data.int_val + 10)
+                       : sharedScanStrEqual(a->scan, a->column, cellStr(k));
+        } else {
+            sr = isInt ? linearFindBetween(a->table, a->column, k->data.int_val, k->data.int_val + 10)
+                       : linearFindStrEqual(a->table, a->column, cellStr(k));
+        }
+        a->matched += sr->count;
+        freeSearchResult(sr);
+    }
+    freeResultPool();
+    return 0;
+}
+
+// 跑一轮：threads 个查询线程各做 queries 个查询，返回毫秒数
+static double scanBenchRound(Table* table, SharedScan* scan, int column, const Cell* keys,
+                             int threads, int queries, long long* matched) {
+    ScanBenchArg args[64];
+    HANDLE handles[64];
+    HighResTimer timer;
+    timerStart(&timer);
+    for (int t = 0; t < threads; t++) {
+        args[t].table = table;
+        args[t].scan = scan;
+        args[t].column = column;
+        args[t].keys = keys + (size_t)t * queries;
+        args[t].queries = queries;
+        args[t].matched = 0;
+        handles[t] = CreateThread(NULL, 0, scanBenchClient, &args[t], 0, NULL);
+    }
+    *matched = 0;
+    for (int t = 0; t < threads; t++) {
+        WaitForSingleObject(handles[t], INFINITE);
+        CloseHandle(handles[t]);
+        *matched += args[t].matched;
+    }
+    return timerEndMs(&timer);
+}
+
+/* sharedScanBenchmark - 1、2、4……maxThreads 个线程同时做全表过滤：
+ * 先各自线性扫描，再都走共享扫描，打印总吞吐（查询数/秒）
+ */
+void sharedScanBenchmark(Table* table, int column, int maxThreads, int queries) {
+    if (!table || table->rowCount == 0 || column < 0 || column >= table->numColumns) return;
+    if (maxThreads > 64) maxThreads = 64;
+    int n = table->rowCount;
+    RecordNode** nodes = (RecordNode**)malloc(n * sizeof(RecordNode*));
+    int i = 0;
+    for (RecordNode* cur = table->head; cur; cur = cur->next) nodes[i++] = cur;
+    size_t total = (size_t)maxThreads * queries;
+    Cell* keys = (Cell*)malloc(total * sizeof(Cell));
+    unsigned int x = 12345u;
+    for (size_t k = 0; k < total; k++) {
+        x = x * 1103515245u + 12345u;
+        keys[k] = nodes[(x >> 8) % (unsigned int)n]->cells[column];  // 只读，直接共用表里的字符串
+    }
+    free(nodes);
+    
+    SharedScan* scan = startSharedScan(table);
+    if (!scan) {
+        free(keys);
+        return;
+    }
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        long long linearMatched, sharedMatched;
+        double linearMs = scanBenchRound(table, NULL, column, keys, threads, queries, &linearMatched);
+        double sharedMs = scanBenchRound(table, scan, column, keys, threads, queries, &sharedMatched);
+        double count = (double)threads * queries;
+        printf("  %2d thread(s): independent %.1f queries/s, shared %.1f queries/s (x%.2f)%s\n",
+               threads, count / (linearMs > 0 ? linearMs : 1e-3) * 1000.0, count / (sharedMs > 0 ? sharedMs : 1e-3) * 1000.0,
+               linearMs / (sharedMs > 0 ? sharedMs : 1e-3), linearMatched == sharedMatched ? "" : "  [result mismatch]");
+    }
+    printf("  Shared scanner: %ld batches of %d rows for %ld queries\n", (long)scan->batchesRun, SCAN_BATCH, (long)scan->queriesRun);
+    stopSharedScan(scan);
+    free(keys);
+}
+
+/*==================== 批量查询 ====================*/
+
+/*
+ * 批处理经常对同一张表跑几十个互不相关的条件（等值、>=、<=、区间、包含），
+ * 一个条件一趟全表扫描。batchEvaluate 把一批条件一次交进来，只走一趟链表：
+ *   - 条件按列分组，每行每个涉及的列只读一次
+ *   - 同一列上的整数等值常量排好序，每行二分查一次（常量再多也是 O(log k)），相同常量挨在一起
+ *   - 整数区间（>=、<=、BETWEEN）按下界排序，值小于下界的区间不用看
+ *   - 字符串等值常量同样排序后二分；先用布隆过滤器去掉一定不存在的常量
+ *   - 包含（子串）只能逐个 strstr
+ * 每个条件一个结果集，按行号从小到大，与对应的 linearFind* 结果相同。
+ */
+#define BATCH_EQUAL 1              // 整数列 = low；字符串列 = value
+#define BATCH_GE 2                 // >= low
+#define BATCH_LE 3                 // <= high
+#define BATCH_BETWEEN 4            // low <= 值 <= high
+#define BATCH_CONTAINS 5           // 字符串列包含 value
+#define BATCH_MENU_MAX 64          // 菜单里一批最多输入的条件数
+
+typedef struct {
+    int op;                        // BATCH_*
+    int column;
+    int low, high;
+    const char* value;
+} BatchPredicate;
+
+typedef struct {
+    int low, high;                 // 等值常量 low == high
+    int pred;                      // 条件下标
+} BatchRange;
+
+typedef struct {
+    const char* value;
+    int pred;
+} BatchString;
+
+// 一列上的全部条件
+typedef struct {
+    int column;
+    BatchRange* equals;            // 按值排序
+    int equalCount;
+    BatchRange* ranges;            // 按下界排序
+    int rangeCount;
+    BatchString* strEquals;        // 按strcmp排序
+    int strEqualCount;
+    int* contains;                 // 条件下标
+    int containsCount;
+} BatchColumn;
+
+static int cmpBatchRange(const void* a, const void* b) {
+    const BatchRange* x = (const BatchRange*)a;
+    const BatchRange* y = (const BatchRange*)b;
+    if (x->low != y->low) return x->low < y->low ? -1 : 1;
+    return x->pred - y->pred;
+}
+
+static int cmpBatchString(const void* a, const void* b) {
+    const BatchString* x = (const BatchString*)a;
+    const BatchString* y = (const BatchString*)b;
+    int c = strcmp(x->value, y->value);
+    return c ? c : x->pred - y->pred;
+}
+
+// 整数等值：第一个值 >= v 的常量，相同的往后都加上
+static void batchProbeEquals(const BatchColumn* bc, int v, int rowNum, SearchResult** results) {
+    int lo = 0, hi = bc->equalCount;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (bc->equals[mid].low < v) lo = mid + 1;
+        else hi = mid;
+    }
+    for (; lo < bc->equalCount && bc->equals[lo].low == v; lo++) addToResult(results[bc->equals[lo].pred], rowNum);
+}
+
+static void batchProbeStrEquals(const BatchColumn* bc, const char* s, int rowNum, SearchResult** results) {
+    int lo = 0, hi = bc->strEqualCount;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strcmp(bc->strEquals[mid].value, s) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    for (; lo < bc->strEqualCount && strcmp(bc->strEquals[lo].value, s) == 0; lo++) {
+        addToResult(results[bc->strEquals[lo].pred], rowNum);
+    }
+}
+
+// 条件能否参与扫描：列号有效、类型相符；字符串等值常量布隆过滤器判定一定不存在的直接是空结果
+static int batchUsable(Table* table, const BatchPredicate* p) {
+    if (!table || p->column < 0 || p->column >= table->numColumns) return 0;
+    if (table->columns[p->column].type == 1) return p->op >= BATCH_EQUAL && p->op <= BATCH_BETWEEN;
+    if (!p->value) return 0;
+    if (p->op == BATCH_CONTAINS) return 1;
+    return p->op == BATCH_EQUAL && bloomMayContain(table, p->column, p->value);
+}
+
+/* batchEvaluate - 一趟扫描求出一批条件各自的结果
+ * 
+ * 参数：
+ *   @preds/@count: 条件
+ *   @results: 输出，results[i] 为第i个条件的结果集（调用者逐个 freeSearchResult）
+ * 
+ * 列号越界或类型不符的条件得到空结果（与 linearFind* 一致）。
+ * 时间复杂度：O(n * (每行涉及的列数 * log k + 区间数 + 包含条件数))，k为同列等值常量数
+ */
+void batchEvaluate(Table* table, const BatchPredicate* preds, int count, SearchResult** results) {
+    int n = table ? table->rowCount : 0;
+    int* columnSlot = (int*)queryAlloc((table && table->numColumns > 0 ? table->numColumns : 1) * sizeof(int));
+    BatchColumn* groups = (BatchColumn*)queryAlloc((count > 0 ? count : 1) * sizeof(BatchColumn));
+    char* usable = (char*)queryAlloc(count > 0 ? count : 1);
+    int groupCount = 0;
+    if (table) {
+        for (int c = 0; c < table->numColumns; c++) columnSlot[c] = -1;
+    }
+    
+    // 第一遍：分配结果集，数出每列各类条件的个数
+    for (int i = 0; i < count; i++) {
+        const BatchPredicate* p = &preds[i];
+        usable[i] = (char)batchUsable(table, p);
+        // 与 linearFind* 相同的预估
+        int expected = p->op == BATCH_EQUAL ? n / 64 : p->op == BATCH_BETWEEN ? n / 4 : p->op == BATCH_CONTAINS ? n / 8 : n / 2;
+        results[i] = createSearchResult(usable[i] ? expected : 0);
+        if (!usable[i]) continue;
+        if (columnSlot[p->column] < 0) {
+            BatchColumn* bc = &groups[groupCount];
+            memset(bc, 0, sizeof(*bc));
+            bc->column = p->column;
+            columnSlot[p->column] = groupCount++;
+        }
+        BatchColumn* bc = &groups[columnSlot[p->column]];
+        if (p->op == BATCH_EQUAL) {
+            if (table->columns[p->column].type == 1) bc->equalCount++;
+            else bc->strEqualCount++;
+        } else if (p->op == BATCH_CONTAINS) {
+            bc->containsCount++;
+        } else {
+            bc->rangeCount++;
+        }
+    }
+    
+    // 第二遍：填进各列的数组并排序
+    for (int g = 0; g < groupCount; g++) {
+        BatchColumn* bc = &groups[g];
+        bc->equals = (BatchRange*)queryAlloc((bc->equalCount + 1) * sizeof(BatchRange));
+        bc->ranges = (BatchRange*)queryAlloc((bc->rangeCount + 1) * sizeof(BatchRange));
+        bc->strEquals = (BatchString*)queryAlloc((bc->strEqualCount + 1) * sizeof(BatchString));
+        bc->contains = (int*)queryAlloc((bc->containsCount + 1) * sizeof(int));
+        bc->equalCount = bc->rangeCount = bc->strEqualCount = bc->containsCount = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        const BatchPredicate* p = &preds[i];
+        if (!usable[i]) continue;
+        BatchColumn* bc = &groups[columnSlot[p->column]];
+        int isInt = table->columns[p->column].type == 1;
+        if (p->op == BATCH_EQUAL && isInt) {
+            BatchRange r = { p->low, p->low, i };
+            bc->equals[bc->equalCount++] = r;
+        } else if (p->op == BATCH_EQUAL) {
+            BatchString s = { p->value, i };
+            bc->strEquals[bc->strEqualCount++] = s;
+        } else if (p->op == BATCH_CONTAINS) {
+            bc->contains[bc->containsCount++] = i;
+        } else {
+            BatchRange r = { p->op == BATCH_LE ? INT_MIN : p->low, p->op == BATCH_GE ? INT_MAX : p->high, i };
+            if (r.low <= r.high) bc->ranges[bc->rangeCount++] = r;  // 空区间没有结果，不用参与扫描
+        }
+    }
+    for (int g = 0; g < groupCount; g++) {
+        BatchColumn* bc = &groups[g];
+        qsort(bc->equals, bc->equalCount, sizeof(BatchRange), cmpBatchRange);
+        qsort(bc->ranges, bc->rangeCount, sizeof(BatchRange), cmpBatchRange);
+        qsort(bc->strEquals, bc->strEqualCount, sizeof(BatchString), cmpBatchString);
+    }
+    if (groupCount == 0) return;
+    
+    // 一趟扫描
+    int rowNum = 1;
+    for (RecordNode* cur = table->head; cur; cur = cur->next, rowNum++) {
+        for (int g = 0; g < groupCount; g++) {
+            const BatchColumn* bc = &groups[g];
+            const Cell* cell = &cur->cells[bc->column];
+            if (table->columns[bc->column].type == 1) {
+                int v = cell->data.int_val;
+                if (bc->equalCount && v >= bc->equals[0].low && v <= bc->equals[bc->equalCount - 1].low) {
+                    batchProbeEquals(bc, v, rowNum, results);
+                }
+                for (int r = 0; r < bc->rangeCount && bc->ranges[r].low <= v; r++) {
+                    if (v <= bc->ranges[r].high) addToResult(results[bc->ranges[r].pred], rowNum);
+                }
+            } else {
+                const char* s = cellStr(cell);
+                if (bc->strEqualCount) batchProbeStrEquals(bc, s, rowNum, results);
+                for (int k = 0; k < bc->containsCount; k++) {
+                    if (strstr(s, preds[bc->contains[k]].value)) addToResult(results[bc->contains[k]], rowNum);
+                }
+            }
+        }
+    }
+}
+
+// 单个条件用对应的 linearFind* 单独扫一遍（对照用）
+SearchResult* linearFindPredicate(Table* table, const BatchPredicate* p) {
+    if (!table || p->column < 0 || p->column >= table->numColumns) return createSearchResult(0);
+    int isInt = table->columns[p->column].type == 1;
+    switch (p->op) {
+    case BATCH_EQUAL:
+        if (isInt) return linearFindEqual(table, p->column, p->low);
+        return p->value ? linearFindStrEqual(table, p->column, p->value) : createSearchResult(0);
+    case BATCH_GE: return linearFindGE(table, p->column, p->low);
+    case BATCH_LE: return linearFindLE(table, p->column, p->high);
+    case BATCH_BETWEEN: return linearFindBetween(table, p->column, p->low, p->high);
+    case BATCH_CONTAINS: return p->value ? linearFindContains(table, p->column, p->value) : createSearchResult(0);
+    }
+    return createSearchResult(0);
+}
+
+/* parseBatchPredicate - 解析一行条件："列 = 值"、"列 >= 值"、"列 <= 值"、"列 between 低 高"、"列 contains 子串"
+ * 参数：@valueBuf: 字符串值存放处（p->value 指向它）
+ * 返回值：成功返回1
+ */
+int parseBatchPredicate(Table* table, const char* line, BatchPredicate* p, char* valueBuf, size_t valueSize) {
+    char colName[64], op[16];
+    int used = 0;
+    if (sscanf(line, "%63s %15s %n", colName, op, &used) < 2) return 0;
+    const char* rest = line + used;
+    memset(p, 0, sizeof(*p));
+    char* end = NULL;
+    long idx = strtol(colName, &end, 10);
+    p->column = (end != colName && *end == '\0') ? (idx >= 0 && idx < table->numColumns ? (int)idx : -1) : findColumnIndex(table, colName);
+    if (p->column < 0) return 0;
+    int isInt = table->columns[p->column].type == 1;
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) p->op = BATCH_EQUAL;
+    else if (strcmp(op, ">=") == 0) p->op = BATCH_GE;
+    else if (strcmp(op, "<=") == 0) p->op = BATCH_LE;
+    else if (strcmp(op, "between") == 0 || strcmp(op, "BETWEEN") == 0) p->op = BATCH_BETWEEN;
+    else if (strcmp(op, "contains") == 0 || strcmp(op, "CONTAINS") == 0) p->op = BATCH_CONTAINS;
+    else return 0;
+    if (isInt) {
+        if (p->op == BATCH_CONTAINS) return 0;
+        if (p->op == BATCH_BETWEEN) return sscanf(rest, "%d %d", &p->low, &p->high) == 2;
+        if (sscanf(rest, "%d", &p->low) != 1) return 0;
+        p->high = p->low;
+        return 1;
+    }
+    if (p->op != BATCH_EQUAL && p->op != BATCH_CONTAINS) return 0;
+    snprintf(valueBuf, valueSize, "%s", rest);
+    p->value = valueBuf;
+    return 1;
+}
+
+/*==================== 工具函数 ====================*/
+
+// 控制台输入转 UTF-8（用于处理 Windows 控制台输入）
+// Windows PowerShell/cmd 实际上使用系统代码页 (通常是 GBK/936)，即使设置了 65001
+static void consoleInputToUtf8(char* dest, const char* src, int destSize) {
+    // 检查是否有非 ASCII 字符
+    int hasNonAscii = 0;
+    const unsigned char* p = (const unsigned char*)src;
+    while (*p) {
+        if (*p >= 0x80) {
+            hasNonAscii = 1;
+            break;
+        }
+        p++;
+    }
+    
+    // 如果是纯 ASCII，直接复制
+    if (!hasNonAscii) {
+        strncpy(dest, src, destSize - 1);
+        dest[destSize - 1] = '\0';
+        return;
+    }
+    
+    // 对于非 ASCII 输入，强制使用系统代码页 (CP_ACP，通常是 GBK/936) 进行转换
+    // 因为 Windows 传统控制台不真正支持 UTF-8 输入
+    
+    // 步骤1: 系统代码页 (GBK) -> Unicode (wchar_t)
+    int wlen = MultiByteToWideChar(CP_ACP, 0, src, -1, NULL, 0);
+    if (wlen <= 0) {
+        strncpy(dest, src, destSize - 1);
+        dest[destSize - 1] = '\0';
+        return;
+    }
+    
+    wchar_t* wbuf = (wchar_t*)malloc(wlen * sizeof(wchar_t));
+    if (!wbuf) {
+        strncpy(dest, src, destSize - 1);
+        dest[destSize - 1] = '\0';
+        return;
+    }
+    
+    MultiByteToWideChar(CP_ACP, 0, src, -1, wbuf, wlen);
+    
+    // 步骤2: Unicode -> UTF-8
+    int utf8len = WideCharToMultiByte(CP_UTF8, 0, wbuf, -1, NULL, 0, NULL, NULL);
+    if (utf8len <= 0 || utf8len > destSize) {
+        free(wbuf);
+        strncpy(dest, src, destSize - 1);
+        dest[destSize - 1] = '\0';
+        return;
+    }
+    
+    WideCharToMultiByte(CP_UTF8, 0, wbuf, -1, dest, destSize, NULL, NULL);
+    free(wbuf);
+}
+
+static void readLine(char* buf, int size) {
+    fflush(stdout);
+    char tempBuf[512];
+    if (fgets(tempBuf, sizeof(tempBuf), stdin)) {
+        size_t len = strlen(tempBuf);
+        if (len > 0 && tempBuf[len - 1] == '\n') tempBuf[len - 1] = '\0';
+        len = strlen(tempBuf);
+        if (len > 0 && tempBuf[len - 1] == '\r') tempBuf[len - 1] = '\0';
+        
+        // 将可能的 GBK 输入转换为 UTF-8
+        consoleInputToUtf8(buf, tempBuf, size);
+    } else if (size > 0) {
+        buf[0] = '\0';
+    }
+}
+
+// 读取列号或列名，返回列下标，无效返回-1（列名走哈希表，宽表也不用逐列比较）
+static int readColumnIndex(Table* table) {
+    char buf[128];
+    readLine(buf, sizeof(buf));
+    char* end = NULL;
+    long idx = strtol(buf, &end, 10);
+    if (end != buf && *end == '\0') {
+        return (idx >= 0 && idx < table->numColumns) ? (int)idx : -1;
+    }
+    return findColumnIndex(table, buf);
+}
+
+// 逐列输入一条记录（字符串列用 cellSetStr，调用者用 freeCells 释放）
+static void readRecordCells(Table* table, Cell* cells) {
+    int ch;
+    for (int i = 0; i < table->numColumns; i++) {
+        if (table->columns[i].type == 1) {
+            printf("Enter [%s] (int): ", table->columns[i].name);
+            fflush(stdout);
+            scanf("%d", &cells[i].data.int_val);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+        } else {
+            char buf[128];
+            printf("Enter [%s] (string): ", table->columns[i].name);
+            fflush(stdout);
+            readLine(buf, sizeof(buf));
+            cellSetStr(&cells[i], buf);
+        }
+    }
+}
+
+// 读入一个单元格的值（按列类型），label 为提示前缀
+static void readCellValue(Table* table, int col, const char* label, Cell* cell) {
+    int ch;
+    if (table->columns[col].type == 1) {
+        printf("%s[%s] (int): ", label, table->columns[col].name);
+        fflush(stdout);
+        cell->data.int_val = 0;
+        scanf("%d", &cell->data.int_val);
+        while ((ch = getchar()) != '\n' && ch != EOF) {}
+    } else {
+        char buf[128];
+        printf("%s[%s] (string): ", label, table->columns[col].name);
+        fflush(stdout);
+        readLine(buf, sizeof(buf));
+        cellSetStr(cell, buf);
     }
 }
 
@@ -1596,8 +8853,7 @@ static void printTable(Table* table) {
             if (table->columns[i].type == 1) {
                 printf(" | %-14d", cur->cells[i].data.int_val);
             } else {
-                const char* s = cur->cells[i].data.str_val;
-                printf(" | %-14s", s ? s : "(null)");
+                printf(" | %-14s", cellStr(&cur->cells[i]));
             }
         }
         printf(" |\n");
@@ -1619,7 +8875,7 @@ static void printRecord(Table* table, RecordNode* node) {
         if (table->columns[i].type == 1) {
             printf("%d", node->cells[i].data.int_val);
         } else {
-            printf("%s", node->cells[i].data.str_val);
+            printf("%s", cellStr(&node->cells[i]));
         }
         if (i < table->numColumns - 1) printf(", ");
     }
@@ -1633,9 +8889,12 @@ static void printSearchResults(Table* table, SearchResult* sr) {
         return;
     }
     printf("Found %d record(s):\n", sr->count);
-    for (int i = 0; i < sr->count && i < 50; i++) { // 最多显示50条
-        printf("  [%d] (Row %d) ", i + 1, sr->rowNums[i]);
-        printRecord(table, sr->records[i]);
+    RecordNode* shown[50];
+    int showCount = sr->count < 50 ? sr->count : 50; // 最多显示50条
+    resolveResultRows(table, sr, showCount, shown);
+    for (int i = 0; i < showCount; i++) {
+        printf("  [%d] (Row %u) ", i + 1, sr->rowNums[i]);
+        printRecord(table, shown[i]);
     }
     if (sr->count > 50) {
         printf("  ... and %d more.\n", sr->count - 50);
@@ -1658,15 +8917,13 @@ static SearchResult* interactiveSearch(Table* table) {
         printf("  [%d] %s (%s)\n", i, table->columns[i].name,
                table->columns[i].type == 1 ? "int" : "string");
     }
-    printf("Column index: ");
+    printf("Column index or name: ");
     fflush(stdout);
-    int colIdx;
-    if (scanf("%d", &colIdx) != 1 || colIdx < 0 || colIdx >= table->numColumns) {
-        while ((ch = getchar()) != '\n' && ch != EOF) {}
+    int colIdx = readColumnIndex(table);
+    if (colIdx < 0) {
         printf("Invalid column.\n");
         return NULL;
     }
-    while ((ch = getchar()) != '\n' && ch != EOF) {}
     
     // 选择条件
     printf("Search condition:\n");
@@ -1678,6 +8935,7 @@ static SearchResult* interactiveSearch(Table* table) {
         printf("  5. Less or equal (<=)\n");
         printf("  7. Find TOP N (largest)\n");
         printf("  8. Find BOTTOM N (smallest)\n");
+        printf("  9. Between [low, high]\n");
     } else {
         printf("  3. Equal to value (=)\n");
         printf("  6. Contains substring\n");
@@ -1698,16 +8956,16 @@ static SearchResult* interactiveSearch(Table* table) {
         int rowNum = 0;
         RecordNode* rec = linearFindMax(table, colIdx, &rowNum);
         if (rec) {
-            sr = createSearchResult();
-            addToResultWithRowNum(sr, rec, rowNum);
+            sr = createSearchResult(1);
+            addToResult(sr, rowNum);
         }
     } else if (cond == 2 && table->columns[colIdx].type == 1) {
         // 最小值
         int rowNum = 0;
         RecordNode* rec = linearFindMin(table, colIdx, &rowNum);
         if (rec) {
-            sr = createSearchResult();
-            addToResultWithRowNum(sr, rec, rowNum);
+            sr = createSearchResult(1);
+            addToResult(sr, rowNum);
         }
     } else if (cond == 3 && table->columns[colIdx].type == 1) {
         // 整数等于
@@ -1767,6 +9025,14 @@ static SearchResult* interactiveSearch(Table* table) {
         if (n > 0) {
             sr = linearFindBottomN(table, colIdx, n);
         }
+    } else if (cond == 9 && table->columns[colIdx].type == 1) {
+        // 区间查找（裂解）
+        printf("Enter low and high: ");
+        fflush(stdout);
+        int low, high;
+        if (scanf("%d %d", &low, &high) != 2) low = 1, high = 0;
+        while ((ch = getchar()) != '\n' && ch != EOF) {}
+        sr = crackFindRange(table, colIdx, low, high);
     } else {
         printf("Invalid condition.\n");
         return NULL;
@@ -1782,6 +9048,7 @@ int main() {
     SetConsoleCP(65001);
     
     Table* table = NULL;
+    SharedView* sharedView = NULL;  // 只读映射的别的进程的共享表
     int running = 1;
     int autoDisplay = 1;
 
@@ -1795,6 +9062,19 @@ int main() {
         printf("6. Save to JSON\n");
         printf("7. Load from JSON\n");
         printf("8. Settings (Auto Display)\n");
+        printf("9. Index Stats\n");
+        printf("10. Primary Key (Get/Delete/Upsert/Merge by key)\n");
+        printf("11. Insert Record at Row\n");
+        printf("12. Cluster Table\n");
+        printf("13. Multi-Column Search (k-d tree)\n");
+        printf("14. Column Store (delta + main)\n");
+        printf("15. LSM Storage\n");
+        printf("16. Shared Memory (publish / attach read-only)\n");
+        printf("17. Mapped Table File\n");
+        printf("18. Concurrent Hash Index\n");
+        printf("19. Concurrent Skip List (ordered)\n");
+        printf("20. Shared Scan (concurrent full-table filters)\n");
+        printf("21. Batch Query (many predicates, one pass)\n");
         printf("0. Exit\n");
         printf("Choose: ");
         fflush(stdout);
@@ -1847,30 +9127,15 @@ int main() {
         case 2: { // Add Record
             if (!table) { printf("Create table first.\n"); break; }
             
-            Cell* cells = (Cell*)malloc(table->numColumns * sizeof(Cell));
-            for (int i = 0; i < table->numColumns; i++) {
-                cells[i].type = table->columns[i].type;
-                if (table->columns[i].type == 1) {
-                    printf("Enter [%s] (int): ", table->columns[i].name);
-                    fflush(stdout);
-                    scanf("%d", &cells[i].data.int_val);
-                    while ((ch = getchar()) != '\n' && ch != EOF) {}
-                } else {
-                    char buf[128];
-                    printf("Enter [%s] (string): ", table->columns[i].name);
-                    fflush(stdout);
-                    readLine(buf, sizeof(buf));
-                    cells[i].data.str_val = _strdup(buf);
-                }
-            }
+            Cell* cells = (Cell*)queryAlloc(table->numColumns * sizeof(Cell));
+            readRecordCells(table, cells);
             
             if (addRecord(table, cells)) {
                 printf("Record added. Total rows: %d\n", table->rowCount);
             } else {
                 printf("Failed to add record.\n");
             }
-            freeCells(cells, table->numColumns);
-            free(cells);
+            freeCells(cells, table->columns, table->numColumns);
             break;
         }
         
@@ -1886,14 +9151,13 @@ int main() {
                 printf("  [%d] %s (%s)\n", i, table->columns[i].name,
                        table->columns[i].type == 1 ? "int" : "string");
             }
-            printf("Column index: ");
-            int colIdx;
-            if (scanf("%d", &colIdx) != 1 || colIdx < 0 || colIdx >= table->numColumns) {
-                while ((ch = getchar()) != '\n' && ch != EOF) {}
+            printf("Column index or name: ");
+            fflush(stdout);
+            int colIdx = readColumnIndex(table);
+            if (colIdx < 0) {
                 printf("Invalid column.\n");
                 break;
             }
-            while ((ch = getchar()) != '\n' && ch != EOF) {}
             
             // 选择条件
             printf("Search condition:\n");
@@ -1905,7 +9169,9 @@ int main() {
                 printf("  5. Less or equal (<=)\n");
                 printf("  7. Find TOP N (largest)\n");
                 printf("  8. Find BOTTOM N (smallest)\n");
+                printf("  9. Between [low, high]\n");
             } else {
+                printf("  3. Equal to value (=)\n");
                 printf("  6. Contains substring\n");
             }
             printf("Condition: ");
@@ -1935,7 +9201,6 @@ int main() {
                 timerStart(&timer);
                 AVLNode* r2 = avlFindMax(avlRoot);
                 avlSearchTime = timerEndMicro(&timer);
-                freeAVL(avlRoot);
                 
                 printf("\n--- Results ---\n");
                 printf("Linear search: %.2f us (%.4f ms) - Row %d\n", linearTime, linearTime/1000.0, rowNum1);
@@ -1959,7 +9224,6 @@ int main() {
                 timerStart(&timer);
                 AVLNode* r2 = avlFindMin(avlRoot);
                 avlSearchTime = timerEndMicro(&timer);
-                freeAVL(avlRoot);
                 
                 printf("\n--- Results ---\n");
                 printf("Linear search: %.2f us (%.4f ms) - Row %d\n", linearTime, linearTime/1000.0, rowNum1);
@@ -1996,8 +9260,17 @@ int main() {
                 printf("AVL total:     %.2f us (%.4f ms)\n", avlBuildTime + avlSearchTime, (avlBuildTime + avlSearchTime)/1000.0);
                 if (r2) printRecord(table, r2->record);
                 
+                // 裂解：同一列查得越多越快
+                timerStart(&timer);
+                SearchResult* sr3 = crackFindEqual(table, colIdx, val);
+                double crackTime = timerEndMicro(&timer);
+                printf("Cracking:      %.2f us (%.4f ms), found %d\n", crackTime, crackTime/1000.0, sr3->count);
+                reportIndexSearch(table, colIdx, val, val, NULL);
+                reportClusterSearch(table, colIdx, val, val, NULL);
+                reportStoreSearch(table, colIdx, val, val, NULL);
+                
                 freeSearchResult(sr1);
-                freeAVL(avlRoot);
+                freeSearchResult(sr3);
                 
             } else if (cond == 4 && table->columns[colIdx].type == 1) {
                 // 大于等于
@@ -2018,16 +9291,24 @@ int main() {
                 SearchResult* sr2 = avlFindGE(avlRoot, val);
                 avlSearchTime = timerEndMicro(&timer);
                 
+                timerStart(&timer);
+                SearchResult* sr3 = crackFindGE(table, colIdx, val);
+                double crackTime = timerEndMicro(&timer);
+                
                 printf("\n--- Results ---\n");
                 printf("Linear search: %.2f us (%.4f ms), found %d\n", linearTime, linearTime/1000.0, sr1->count);
                 printSearchResults(table, sr1);
                 printf("AVL build:     %.2f us (%.4f ms)\n", avlBuildTime, avlBuildTime/1000.0);
                 printf("AVL search:    %.2f us (%.4f ms), found %d\n", avlSearchTime, avlSearchTime/1000.0, sr2->count);
                 printf("AVL total:     %.2f us (%.4f ms)\n", avlBuildTime + avlSearchTime, (avlBuildTime + avlSearchTime)/1000.0);
+                printf("Cracking:      %.2f us (%.4f ms), found %d\n", crackTime, crackTime/1000.0, sr3->count);
+                reportIndexSearch(table, colIdx, val, INT_MAX, NULL);
+                reportClusterSearch(table, colIdx, val, INT_MAX, NULL);
+                reportStoreSearch(table, colIdx, val, INT_MAX, NULL);
                 
                 freeSearchResult(sr1);
                 freeSearchResult(sr2);
-                freeAVL(avlRoot);
+                freeSearchResult(sr3);
                 
             } else if (cond == 5 && table->columns[colIdx].type == 1) {
                 // 小于等于
@@ -2048,16 +9329,45 @@ int main() {
                 SearchResult* sr2 = avlFindLE(avlRoot, val);
                 avlSearchTime = timerEndMicro(&timer);
                 
+                timerStart(&timer);
+                SearchResult* sr3 = crackFindLE(table, colIdx, val);
+                double crackTime = timerEndMicro(&timer);
+                
                 printf("\n--- Results ---\n");
                 printf("Linear search: %.2f us (%.4f ms), found %d\n", linearTime, linearTime/1000.0, sr1->count);
                 printSearchResults(table, sr1);
                 printf("AVL build:     %.2f us (%.4f ms)\n", avlBuildTime, avlBuildTime/1000.0);
                 printf("AVL search:    %.2f us (%.4f ms), found %d\n", avlSearchTime, avlSearchTime/1000.0, sr2->count);
                 printf("AVL total:     %.2f us (%.4f ms)\n", avlBuildTime + avlSearchTime, (avlBuildTime + avlSearchTime)/1000.0);
+                printf("Cracking:      %.2f us (%.4f ms), found %d\n", crackTime, crackTime/1000.0, sr3->count);
+                reportIndexSearch(table, colIdx, INT_MIN, val, NULL);
+                reportClusterSearch(table, colIdx, INT_MIN, val, NULL);
+                reportStoreSearch(table, colIdx, INT_MIN, val, NULL);
                 
                 freeSearchResult(sr1);
                 freeSearchResult(sr2);
-                freeAVL(avlRoot);
+                freeSearchResult(sr3);
+                
+            } else if (cond == 3 && table->columns[colIdx].type == 2) {
+                // 字符串等于（先查布隆过滤器）
+                char buf[128];
+                printf("Enter value: ");
+                readLine(buf, sizeof(buf));
+                
+                int mayExist = bloomMayContain(table, colIdx, buf);
+                timerStart(&timer);
+                SearchResult* sr1 = linearFindStrEqual(table, colIdx, buf);
+                linearTime = timerEndMicro(&timer);
+                
+                printf("\n--- Results ---\n");
+                printf("Bloom filter:  %s\n", mayExist ? "may exist, scanned" : "definitely absent, scan skipped");
+                printf("Linear search: %.2f us (%.4f ms), found %d\n", linearTime, linearTime/1000.0, sr1->count);
+                printSearchResults(table, sr1);
+                reportIndexSearch(table, colIdx, 0, 0, buf);
+                reportClusterSearch(table, colIdx, 0, 0, buf);
+                reportStoreSearch(table, colIdx, 0, 0, buf);
+                
+                freeSearchResult(sr1);
                 
             } else if (cond == 6 && table->columns[colIdx].type == 2) {
                 // 包含字符串
@@ -2105,7 +9415,6 @@ int main() {
                 
                 freeSearchResult(sr1);
                 freeSearchResult(sr2);
-                freeAVL(avlRoot);
                 
             } else if (cond == 8 && table->columns[colIdx].type == 1) {
                 // 最小前n项
@@ -2136,7 +9445,32 @@ int main() {
                 
                 freeSearchResult(sr1);
                 freeSearchResult(sr2);
-                freeAVL(avlRoot);
+                
+            } else if (cond == 9 && table->columns[colIdx].type == 1) {
+                // 区间查找：线性 vs 裂解
+                printf("Enter low and high: ");
+                int low, high;
+                if (scanf("%d %d", &low, &high) != 2) low = 1, high = 0;
+                while ((ch = getchar()) != '\n' && ch != EOF) {}
+                
+                timerStart(&timer);
+                SearchResult* sr1 = linearFindBetween(table, colIdx, low, high);
+                linearTime = timerEndMicro(&timer);
+                
+                timerStart(&timer);
+                SearchResult* sr2 = crackFindRange(table, colIdx, low, high);
+                double crackTime = timerEndMicro(&timer);
+                
+                printf("\n--- Results ---\n");
+                printf("Linear search: %.2f us (%.4f ms), found %d\n", linearTime, linearTime/1000.0, sr1->count);
+                printSearchResults(table, sr1);
+                printf("Cracking:      %.2f us (%.4f ms), found %d\n", crackTime, crackTime/1000.0, sr2->count);
+                reportIndexSearch(table, colIdx, low, high, NULL);
+                reportClusterSearch(table, colIdx, low, high, NULL);
+                reportStoreSearch(table, colIdx, low, high, NULL);
+                
+                freeSearchResult(sr1);
+                freeSearchResult(sr2);
                 
             } else {
                 printf("Invalid condition for this column type.\n");
@@ -2193,7 +9527,7 @@ int main() {
                 } else if (delChoice == 0) {
                     // 删除所有找到的记录（从后往前删，避免行号变化）
                     // 先收集所有行号并排序（降序）
-                    int* rowsToDelete = (int*)malloc(sr->count * sizeof(int));
+                    int* rowsToDelete = (int*)queryAlloc(sr->count * sizeof(int));
                     for (int i = 0; i < sr->count; i++) {
                         rowsToDelete[i] = sr->rowNums[i];
                     }
@@ -2213,7 +9547,6 @@ int main() {
                             deleted++;
                         }
                     }
-                    free(rowsToDelete);
                     printf("Deleted %d record(s). Remaining rows: %d\n", deleted, table->rowCount);
                 } else if (delChoice >= 1 && delChoice <= sr->count) {
                     int rowNum = sr->rowNums[delChoice - 1];
@@ -2321,9 +9654,8 @@ int main() {
             }
             
             printf("\nEnter new values:\n");
-            Cell* cells = (Cell*)malloc(table->numColumns * sizeof(Cell));
+            Cell* cells = (Cell*)queryAlloc(table->numColumns * sizeof(Cell));
             for (int i = 0; i < table->numColumns; i++) {
-                cells[i].type = table->columns[i].type;
                 if (table->columns[i].type == 1) {
                     printf("  [%s] (int): ", table->columns[i].name);
                     fflush(stdout);
@@ -2334,7 +9666,7 @@ int main() {
                     printf("  [%s] (string): ", table->columns[i].name);
                     fflush(stdout);
                     readLine(buf, sizeof(buf));
-                    cells[i].data.str_val = _strdup(buf);
+                    cellSetStr(&cells[i], buf);
                 }
             }
             
@@ -2343,8 +9675,7 @@ int main() {
             } else {
                 printf("Update failed.\n");
             }
-            freeCells(cells, table->numColumns);
-            free(cells);
+            freeCells(cells, table->columns, table->numColumns);
             break;
         }
         
@@ -2371,8 +9702,10 @@ int main() {
             table = newTable;
             printf("Loaded. Rows: %d, Columns: %d\n", table->rowCount, table->numColumns);
             for (int i = 0; i < table->numColumns; i++) {
-                printf("  [%d] %s (%s)\n", i, table->columns[i].name,
-                       table->columns[i].type == 1 ? "int" : "string");
+                printf("  [%d] %s (%s)%s\n", i, table->columns[i].name,
+                       table->columns[i].type == 1 ? "int" : "string",
+                       table->builds && table->builds[i] ? ", index building in background" :
+                       table->indexes && table->indexes[i] ? ", index restored" : "");
             }
             break;
         }
@@ -2389,6 +9722,695 @@ int main() {
             break;
         }
         
+        case 9: { // Index Stats
+            if (!table) { printf("No table.\n"); break; }
+            printIndexStats(table);
+            break;
+        }
+        
+        case 10: { // Primary Key
+            if (!table) { printf("Create table first.\n"); break; }
+            printf("Primary key: %s\n", table->primaryKey >= 0 ? table->columns[table->primaryKey].name : "(none)");
+            if (table->pk && table->pk->directSize) {
+                printf("  Direct array: keys %lld..%lld, %d record(s); hash: %d record(s)\n",
+                       table->pk->directBase, table->pk->directBase + table->pk->directSize - 1,
+                       table->pk->directCount, table->pk->count);
+            }
+            printf("1. Set primary key column\n");
+            printf("2. Get by key\n");
+            printf("3. Delete by key\n");
+            printf("4. Upsert record\n");
+            printf("5. Merge from JSON file\n");
+            printf("Choose: ");
+            int op = 0;
+            scanf("%d", &op);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            
+            if (op == 1) {
+                printf("Column index or name (-1 = none): ");
+                int colIdx = readColumnIndex(table);
+                if (setPrimaryKey(table, colIdx)) {
+                    printf("Primary key set to %s.\n", colIdx >= 0 ? table->columns[colIdx].name : "(none)");
+                } else {
+                    printf("Duplicate values in this column, primary key not set.\n");
+                }
+                break;
+            }
+            if (table->primaryKey < 0) { printf("Set a primary key first.\n"); break; }
+            
+            if (op == 2 || op == 3) {
+                // 只需要主键那一格
+                Cell* key = (Cell*)queryAlloc(table->numColumns * sizeof(Cell));
+                int pkCol = table->primaryKey;
+                if (table->columns[pkCol].type == 1) {
+                    printf("Enter [%s] (int): ", table->columns[pkCol].name);
+                    scanf("%d", &key[pkCol].data.int_val);
+                    while ((ch = getchar()) != '\n' && ch != EOF) {}
+                } else {
+                    char buf[128];
+                    printf("Enter [%s] (string): ", table->columns[pkCol].name);
+                    readLine(buf, sizeof(buf));
+                    cellSetStr(&key[pkCol], buf);
+                }
+                HighResTimer timer;
+                timerStart(&timer);
+                if (op == 2) {
+                    RecordNode* node = findRecordByKey(table, &key[pkCol]);
+                    double t = timerEndMicro(&timer);
+                    if (node) printRecord(table, node);
+                    else printf("[Info] No record with this key.\n");
+                    printf("Key lookup: %.2f us\n", t);
+                } else {
+                    int ok = deleteRecordByKey(table, &key[pkCol]);
+                    double t = timerEndMicro(&timer);
+                    printf(ok ? "Record deleted. (%.2f us)\n" : "No record with this key. (%.2f us)\n", t);
+                }
+                if (table->columns[pkCol].type != 1) cellFreeStr(&key[pkCol]);
+                
+            } else if (op == 4) {
+                Cell* cells = (Cell*)queryAlloc(table->numColumns * sizeof(Cell));
+                readRecordCells(table, cells);
+                int result = upsertRecord(table, cells);
+                printf(result == 1 ? "Record inserted. Total rows: %d\n" :
+                       result == 2 ? "Record updated. Total rows: %d\n" : "Upsert failed. Total rows: %d\n", table->rowCount);
+                freeCells(cells, table->columns, table->numColumns);
+                
+            } else if (op == 5) {
+                char fname[128];
+                printf("Filename: ");
+                readLine(fname, sizeof(fname));
+                int inserted, updated;
+                HighResTimer timer;
+                timerStart(&timer);
+                if (mergeTableFromJson(table, fname, &inserted, &updated)) {
+                    printf("Merged: %d inserted, %d updated (%.2f ms). Total rows: %d\n",
+                           inserted, updated, timerEndMs(&timer), table->rowCount);
+                } else {
+                    printf("Merge failed.\n");
+                }
+            } else {
+                printf("Invalid option.\n");
+            }
+            break;
+        }
+        
+        case 11: { // Insert at row
+            if (!table) { printf("Create table first.\n"); break; }
+            printf("Insert at row (1-%d): ", table->rowCount + 1);
+            int rowNum;
+            if (scanf("%d", &rowNum) != 1 || rowNum < 1 || rowNum > table->rowCount + 1) {
+                while ((ch = getchar()) != '\n' && ch != EOF) {}
+                printf("Invalid row number.\n");
+                break;
+            }
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            
+            Cell* cells = (Cell*)queryAlloc(table->numColumns * sizeof(Cell));
+            readRecordCells(table, cells);
+            if (insertRecordAt(table, rowNum, cells)) {
+                printf("Record inserted at row %d. Total rows: %d\n", rowNum, table->rowCount);
+            } else {
+                printf("Insert failed.\n");
+            }
+            freeCells(cells, table->columns, table->numColumns);
+            break;
+        }
+        
+        case 12: { // Cluster
+            if (!table) { printf("Create table first.\n"); break; }
+            if (table->clusterColumn >= 0) {
+                printf("Clustered by %s: %d of %d rows in order, auto %s\n", table->columns[table->clusterColumn].name,
+                       table->clusteredRows, table->rowCount, table->autoCluster ? "ON" : "OFF");
+            } else {
+                printf("Not clustered.\n");
+            }
+            printf("1. CLUSTER by column now\n");
+            printf("2. CLUSTER and keep clustered automatically\n");
+            printf("3. Stop clustering\n");
+            printf("Choose: ");
+            int op = 0;
+            scanf("%d", &op);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            
+            if (op == 1 || op == 2) {
+                printf("Column index or name: ");
+                int colIdx = readColumnIndex(table);
+                if (colIdx < 0) { printf("Invalid column.\n"); break; }
+                HighResTimer timer;
+                timerStart(&timer);
+                clusterTable(table, colIdx);
+                table->autoCluster = (op == 2);
+                printf("Clustered by %s in %.2f ms.\n", table->columns[colIdx].name, timerEndMs(&timer));
+            } else if (op == 3) {
+                unclusterTable(table);
+                printf("Clustering stopped.\n");
+            } else {
+                printf("Invalid option.\n");
+            }
+            break;
+        }
+        
+        case 13: { // Multi-column search
+            if (!table || table->rowCount == 0) { printf("Table is empty or not created.\n"); break; }
+            printf("Number of int columns (2-%d): ", KD_MAX_DIMS);
+            int dims = 0;
+            scanf("%d", &dims);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            if (dims < 2 || dims > KD_MAX_DIMS) { printf("Invalid.\n"); break; }
+            int cols[KD_MAX_DIMS];
+            int ok = 1;
+            for (int d = 0; d < dims && ok; d++) {
+                printf("Column %d index or name: ", d + 1);
+                cols[d] = readColumnIndex(table);
+                ok = cols[d] >= 0 && table->columns[cols[d]].type == 1;
+            }
+            if (!ok) { printf("Only int columns can be used.\n"); break; }
+            
+            printf("1. Range (all columns within [low, high])\n");
+            printf("2. Nearest records\n");
+            printf("Choose: ");
+            int op = 0;
+            scanf("%d", &op);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            
+            HighResTimer timer;
+            int built = 0, visited = 0;
+            timerStart(&timer);
+            getKdIndex(table, cols, dims, &built);
+            double buildTime = timerEndMicro(&timer);
+            if (op == 1) {
+                int low[KD_MAX_DIMS], high[KD_MAX_DIMS];
+                for (int d = 0; d < dims; d++) {
+                    printf("[%s] low and high: ", table->columns[cols[d]].name);
+                    if (scanf("%d %d", &low[d], &high[d]) != 2) low[d] = 1, high[d] = 0;
+                    while ((ch = getchar()) != '\n' && ch != EOF) {}
+                }
+                timerStart(&timer);
+                SearchResult* sr1 = linearFindMultiRange(table, cols, dims, low, high);
+                double linearTime = timerEndMicro(&timer);
+                timerStart(&timer);
+                SearchResult* sr2 = kdFindRange(table, cols, dims, low, high, &visited);
+                double kdTime = timerEndMicro(&timer);
+                
+                printf("\n--- Results ---\n");
+                printf("Linear search: %.2f us (%.4f ms), found %d\n", linearTime, linearTime/1000.0, sr1->count);
+                printSearchResults(table, sr1);
+                if (built) printf("k-d build:     %.2f us (%.4f ms)\n", buildTime, buildTime/1000.0);
+                printf("k-d search:    %.2f us (%.4f ms), found %d, visited %d of %d rows\n",
+                       kdTime, kdTime/1000.0, sr2->count, visited, table->rowCount);
+                freeSearchResult(sr1);
+                freeSearchResult(sr2);
+            } else if (op == 2) {
+                int target[KD_MAX_DIMS];
+                for (int d = 0; d < dims; d++) {
+                    printf("[%s] value: ", table->columns[cols[d]].name);
+                    scanf("%d", &target[d]);
+                    while ((ch = getchar()) != '\n' && ch != EOF) {}
+                }
+                printf("How many (k): ");
+                int k = 0;
+                scanf("%d", &k);
+                while ((ch = getchar()) != '\n' && ch != EOF) {}
+                
+                timerStart(&timer);
+                SearchResult* sr = kdFindNearest(table, cols, dims, target, k, &visited);
+                double kdTime = timerEndMicro(&timer);
+                printf("\n--- Nearest (closest first) ---\n");
+                printSearchResults(table, sr);
+                if (built) printf("k-d build:     %.2f us (%.4f ms)\n", buildTime, buildTime/1000.0);
+                printf("k-d nearest:   %.2f us (%.4f ms), visited %d of %d rows\n",
+                       kdTime, kdTime/1000.0, visited, table->rowCount);
+                freeSearchResult(sr);
+            } else {
+                printf("Invalid option.\n");
+            }
+            break;
+        }
+        
+        case 14: { // Column store
+            if (!table) { printf("Create table first.\n"); break; }
+            printColumnStoreStats(table);
+            printf("1. Enable column store\n");
+            printf("2. Merge delta into main now\n");
+            printf("3. Disable column store\n");
+            printf("Choose: ");
+            int op = 0;
+            scanf("%d", &op);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            
+            HighResTimer timer;
+            timerStart(&timer);
+            if (op == 1) {
+                if (table->store) { printf("Column store is already on.\n"); break; }
+                enableColumnStore(table);
+                printf("Column store built in %.2f ms.\n", timerEndMs(&timer));
+                printColumnStoreStats(table);
+            } else if (op == 2) {
+                if (!table->store) { printf("Column store is off.\n"); break; }
+                storeMergeNow(table);
+                printf("Merged in %.2f ms.\n", timerEndMs(&timer));
+                printColumnStoreStats(table);
+            } else if (op == 3) {
+                freeColumnStore(table);
+                printf("Column store disabled.\n");
+            } else {
+                printf("Invalid option.\n");
+            }
+            break;
+        }
+        
+        case 15: { // LSM storage
+            if (table) printLsmStats(table);
+            printf("1. Store table in LSM files (needs primary key)\n");
+            printf("2. Open table from LSM files\n");
+            printf("3. Get by key from disk\n");
+            printf("4. Key range from disk\n");
+            printf("5. Flush memtable and compact now\n");
+            printf("6. Detach LSM storage\n");
+            printf("Choose: ");
+            int op = 0;
+            scanf("%d", &op);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            
+            HighResTimer timer;
+            if (op == 1 || op == 2) {
+                char base[128];
+                printf("File name (without extension): ");
+                readLine(base, sizeof(base));
+                timerStart(&timer);
+                if (op == 1) {
+                    if (!table || table->primaryKey < 0) { printf("Set a primary key first (menu 10).\n"); break; }
+                    if (attachLsm(table, base)) printf("Stored %d rows in %.2f ms; changes are now logged to %s.wal\n",
+                                                       table->rowCount, timerEndMs(&timer), base);
+                    else printf("Could not write LSM files.\n");
+                } else {
+                    Table* newTable = openLsmTable(base);
+                    if (!newTable) { printf("Open failed.\n"); break; }
+                    if (table) freeTable(table);
+                    table = newTable;
+                    printf("Opened in %.2f ms. Rows: %d (ordered by %s)\n", timerEndMs(&timer), table->rowCount,
+                           table->columns[table->primaryKey].name);
+                }
+                break;
+            }
+            if (!table || !table->lsm) { printf("LSM storage is off.\n"); break; }
+            LsmStore* lsm = table->lsm;
+            int keyCol = lsm->keyColumn;
+            RecordNode* shown = (RecordNode*)queryAlloc(sizeof(RecordNode) + table->numColumns * sizeof(Cell));
+            
+            if (op == 3) {
+                Cell key;
+                readCellValue(table, keyCol, "Key ", &key);
+                timerStart(&timer);
+                Cell* cells = lsmGet(lsm, &key);
+                double t = timerEndMicro(&timer);
+                if (cells) {
+                    memcpy(shown->cells, cells, table->numColumns * sizeof(Cell));
+                    printRecord(table, shown);
+                } else {
+                    printf("[Info] No record with this key.\n");
+                }
+                printf("LSM lookup: %.2f us\n", t);
+                lsmFreeCells(lsm, cells);
+                if (table->columns[keyCol].type != 1) cellFreeStr(&key);
+            } else if (op == 4) {
+                Cell low, high;
+                readCellValue(table, keyCol, "From ", &low);
+                readCellValue(table, keyCol, "To ", &high);
+                int count = 0;
+                timerStart(&timer);
+                Cell** rows = lsmRange(lsm, &low, &high, &count);
+                double t = timerEndMicro(&timer);
+                for (int i = 0; i < count && i < 20; i++) {
+                    memcpy(shown->cells, rows[i], table->numColumns * sizeof(Cell));
+                    printRecord(table, shown);
+                }
+                if (count > 20) printf("... %d more\n", count - 20);
+                printf("LSM range: %d record(s) in %.2f us (%.4f ms)\n", count, t, t/1000.0);
+                lsmFreeRows(lsm, rows, count);
+                if (table->columns[keyCol].type != 1) {
+                    cellFreeStr(&low);
+                    cellFreeStr(&high);
+                }
+            } else if (op == 5) {
+                timerStart(&timer);
+                lsmCompactNow(table);
+                printf("Done in %.2f ms.\n", timerEndMs(&timer));
+                printLsmStats(table);
+            } else if (op == 6) {
+                closeLsm(table);
+                printf("LSM storage detached (files kept).\n");
+            } else {
+                printf("Invalid option.\n");
+            }
+            break;
+        }
+        
+        case 16: { // shared memory
+            if (table) printSharedStats(table);
+            if (sharedView) printSharedViewStats(sharedView);
+            printf("1. Publish current table\n");
+            printf("2. Stop publishing\n");
+            printf("3. Attach to a shared table (read-only)\n");
+            printf("4. Query attached table\n");
+            printf("5. Detach\n");
+            printf("Choose: ");
+            int op = 0;
+            scanf("%d", &op);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            
+            HighResTimer timer;
+            if (op == 1 || op == 3) {
+                char name[96];
+                printf("Shared name: ");
+                readLine(name, sizeof(name));
+                timerStart(&timer);
+                if (op == 1) {
+                    if (!table) { printf("Create or load a table first.\n"); break; }
+                    if (shareTable(table, name)) printf("Published %d rows in %.2f ms; changes are republished between requests.\n",
+                                                        table->rowCount, timerEndMs(&timer));
+                    else printf("Could not publish (name in use or out of memory).\n");
+                } else {
+                    SharedView* v = attachSharedTable(name);
+                    if (!v) { printf("No shared table named \"%s\".\n", name); break; }
+                    detachSharedTable(sharedView);
+                    sharedView = v;
+                    printf("Attached in %.2f ms.\n", timerEndMs(&timer));
+                    printSharedViewStats(sharedView);
+                }
+            } else if (op == 2) {
+                stopSharing(table);
+                printf("Stopped publishing.\n");
+            } else if (op == 4) {
+                if (!sharedView) { printf("Attach to a shared table first.\n"); break; }
+                char colName[64];
+                printf("Column name: ");
+                readLine(colName, sizeof(colName));
+                int type = 0;
+                int col = sharedFindColumn(sharedView, colName, &type);
+                if (col < 0) { printf("Column not found.\n"); break; }
+                SearchResult* sr;
+                if (type == 1) {
+                    int low = 0, high = 0;
+                    printf("From: ");
+                    scanf("%d", &low);
+                    printf("To: ");
+                    scanf("%d", &high);
+                    while ((ch = getchar()) != '\n' && ch != EOF) {}
+                    timerStart(&timer);
+                    sr = sharedFindRange(sharedView, col, low, high);
+                } else {
+                    char value[128];
+                    printf("Value: ");
+                    readLine(value, sizeof(value));
+                    timerStart(&timer);
+                    sr = sharedFindStrEqual(sharedView, col, value);
+                }
+                double t = timerEndMicro(&timer);
+                if (!sr) { printf("Publisher kept changing the table; try again.\n"); break; }
+                char line[512];
+                for (int i = 0; i < sr->count && i < 20; i++) {
+                    if (sharedFormatRow(sharedView, (int)sr->rowNums[i], line, sizeof(line)))
+                        printf("  (Row %u) Record: %s\n", sr->rowNums[i], line);
+                }
+                if (sr->count > 20) printf("  ... and %d more.\n", sr->count - 20);
+                printf("Shared memory query: %d record(s) in %.2f us (%.4f ms)\n", sr->count, t, t/1000.0);
+                freeSearchResult(sr);
+            } else if (op == 5) {
+                detachSharedTable(sharedView);
+                sharedView = NULL;
+                printf("Detached.\n");
+            } else {
+                printf("Invalid option.\n");
+            }
+            break;
+        }
+        
+        case 17: { // mapped table file
+            if (table) printMappedFileStats(table);
+            printf("1. Store table in a mapped file\n");
+            printf("2. Open mapped file\n");
+            printf("3. Save (flush changed pages)\n");
+            printf("4. Close mapped file (unsaved changes are rolled back on next open)\n");
+            printf("Choose: ");
+            int op = 0;
+            scanf("%d", &op);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            
+            HighResTimer timer;
+            if (op == 1 || op == 2) {
+                char base[128];
+                printf("File name (without extension): ");
+                readLine(base, sizeof(base));
+                timerStart(&timer);
+                if (op == 1) {
+                    if (!table) { printf("Create or load a table first.\n"); break; }
+                    if (attachMappedFile(table, base)) printf("Stored %d rows in %s.tbl in %.2f ms; changes now go to the mapped file.\n",
+                                                               table->rowCount, base, timerEndMs(&timer));
+                    else printf("Could not write the mapped file.\n");
+                } else {
+                    Table* newTable = openMappedTable(base);
+                    if (!newTable) { printf("Open failed.\n"); break; }
+                    if (table) freeTable(table);
+                    table = newTable;
+                    printf("Opened in %.2f ms. Rows: %d\n", timerEndMs(&timer), table->rowCount);
+                    printMappedFileStats(table);
+                }
+            } else if (op == 3) {
+                if (!table || !table->map) { printf("Mapped table file is off.\n"); break; }
+                if (flushMappedFile(table)) printMappedFileStats(table);
+                else if (!table->map) printf("Save failed; the table is no longer backed by the mapped file.\n");
+                else printf("Save failed.\n");
+            } else if (op == 4) {
+                if (table) closeMappedFile(table);
+                printf("Mapped file closed.\n");
+            } else {
+                printf("Invalid option.\n");
+            }
+            break;
+        }
+        
+        case 18: { // concurrent hash index
+            if (!table) { printf("Create table first.\n"); break; }
+            printConcurrentHashStats(table);
+            printf("1. Build on a column\n");
+            printf("2. Look up a key\n");
+            printf("3. Multi-threaded lookup benchmark\n");
+            printf("4. Drop index\n");
+            printf("Choose: ");
+            int op = 0;
+            scanf("%d", &op);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            
+            HighResTimer timer;
+            if (op == 1) {
+                printf("Column index or name: ");
+                int colIdx = readColumnIndex(table);
+                if (colIdx < 0) { printf("Column not found.\n"); break; }
+                timerStart(&timer);
+                buildConcurrentHash(table, colIdx);
+                printf("Built in %.2f ms.\n", timerEndMs(&timer));
+                printConcurrentHashStats(table);
+            } else if (op == 2) {
+                ConcurrentHash* h = table->chash;
+                if (!h) { printf("Build the index first.\n"); break; }
+                Cell key;
+                memset(&key, 0, sizeof(key));
+                if (h->isInt) {
+                    printf("Enter [%s] (int): ", table->columns[h->column].name);
+                    scanf("%d", &key.data.int_val);
+                    while ((ch = getchar()) != '\n' && ch != EOF) {}
+                } else {
+                    char buf[128];
+                    printf("Enter [%s] (string): ", table->columns[h->column].name);
+                    readLine(buf, sizeof(buf));
+                    cellSetStr(&key, buf);
+                }
+                RecordNode* rows[20];
+                timerStart(&timer);
+                int n = chashLookup(h, 0, &key, rows, 20);
+                double t = timerEndMicro(&timer);
+                for (int i = 0; i < n && i < 20; i++) printRecord(table, rows[i]);
+                if (n > 20) printf("  ... and %d more.\n", n - 20);
+                printf("Concurrent hash lookup: %d record(s) in %.2f us\n", n, t);
+                if (!h->isInt) cellFreeStr(&key);
+            } else if (op == 3) {
+                if (!table->chash) { printf("Build the index first.\n"); break; }
+                printf("Lookups per reader thread: ");
+                int ops = 0;
+                scanf("%d", &ops);
+                while ((ch = getchar()) != '\n' && ch != EOF) {}
+                if (ops <= 0) ops = 1000000;
+                chashBenchmark(table, ops);
+                printConcurrentHashStats(table);
+            } else if (op == 4) {
+                dropConcurrentHash(table);
+                printf("Index dropped.\n");
+            } else {
+                printf("Invalid option.\n");
+            }
+            break;
+        }
+        
+        case 19: { // concurrent skip list
+            if (!table) { printf("Create table first.\n"); break; }
+            printSkipListStats(table);
+            printf("1. Build on a column\n");
+            printf("2. Range query (>= / <= / BETWEEN)\n");
+            printf("3. Min / Max\n");
+            printf("4. Top N / Bottom N\n");
+            printf("5. Multi-threaded range benchmark\n");
+            printf("6. Drop index\n");
+            printf("Choose: ");
+            int op = 0;
+            scanf("%d", &op);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            
+            SkipList* sl = table->skip;
+            HighResTimer timer;
+            if (op == 1) {
+                printf("Column index or name: ");
+                int colIdx = readColumnIndex(table);
+                if (colIdx < 0) { printf("Column not found.\n"); break; }
+                timerStart(&timer);
+                buildSkipList(table, colIdx);
+                printf("Built in %.2f ms.\n", timerEndMs(&timer));
+                printSkipListStats(table);
+                break;
+            }
+            if (op == 6) {
+                dropSkipList(table);
+                printf("Index dropped.\n");
+                break;
+            }
+            if (!sl) { printf("Build the index first.\n"); break; }
+            RecordNode** rows = (RecordNode**)queryAlloc((table->rowCount + 1) * sizeof(RecordNode*));
+            int n = 0;
+            if (op == 2) {
+                printf("1. >=  2. <=  3. BETWEEN\nChoose: ");
+                int kind = 0;
+                scanf("%d", &kind);
+                while ((ch = getchar()) != '\n' && ch != EOF) {}
+                if (kind < 1 || kind > 3) { printf("Invalid option.\n"); break; }
+                Cell bounds[2];
+                memset(bounds, 0, sizeof(bounds));
+                const char* labels[2] = { kind == 3 ? "Low" : "Value", kind == 3 ? "High" : "Value" };
+                for (int b = 0; b < 2; b++) {
+                    if ((b == 0 && kind == 2) || (b == 1 && kind == 1)) continue;
+                    if (sl->isInt) {
+                        printf("%s [%s] (int): ", labels[b], table->columns[sl->column].name);
+                        scanf("%d", &bounds[b].data.int_val);
+                        while ((ch = getchar()) != '\n' && ch != EOF) {}
+                    } else {
+                        char buf[128];
+                        printf("%s [%s] (string): ", labels[b], table->columns[sl->column].name);
+                        readLine(buf, sizeof(buf));
+                        cellSetStr(&bounds[b], buf);
+                    }
+                }
+                timerStart(&timer);
+                n = skipRange(sl, 0, kind != 2 ? &bounds[0] : NULL, kind != 1 ? &bounds[1] : NULL, rows, table->rowCount + 1);
+                if (!sl->isInt) {
+                    cellFreeStr(&bounds[0]);
+                    cellFreeStr(&bounds[1]);
+                }
+            } else if (op == 3) {
+                timerStart(&timer);
+                rows[0] = skipMin(sl, 0);
+                rows[1] = skipMax(sl, 0);
+                n = rows[0] ? 2 : 0;
+            } else if (op == 4) {
+                printf("N (negative = bottom N): ");
+                int want = 0;
+                scanf("%d", &want);
+                while ((ch = getchar()) != '\n' && ch != EOF) {}
+                if (want > table->rowCount) want = table->rowCount;
+                if (want < -table->rowCount) want = -table->rowCount;
+                timerStart(&timer);
+                n = want >= 0 ? skipTopN(sl, 0, rows, want) : skipRange(sl, 0, NULL, NULL, rows, -want);
+            } else if (op == 5) {
+                int ops = 0, scan = 0, writers = 0;
+                printf("Range queries per reader thread: ");
+                scanf("%d", &ops);
+                printf("Rows per range query: ");
+                scanf("%d", &scan);
+                printf("Concurrent index writer threads (remove/re-insert existing rows): ");
+                scanf("%d", &writers);
+                while ((ch = getchar()) != '\n' && ch != EOF) {}
+                if (ops <= 0) ops = 100000;
+                if (scan <= 0) scan = 100;
+                if (writers < 0) writers = 0;
+                skipBenchmark(table, ops, scan, writers);
+                printSkipListStats(table);
+                break;
+            } else {
+                printf("Invalid option.\n");
+                break;
+            }
+            double t = timerEndMicro(&timer);
+            for (int i = 0; i < n && i < 20; i++) printRecord(table, rows[i]);
+            if (n > 20) printf("  ... and %d more.\n", n - 20);
+            printf("Skip list query: %d record(s) in %.2f us (%.4f ms)\n", n, t, t/1000.0);
+            break;
+        }
+        
+        case 20: { // shared scan
+            if (!table || table->rowCount == 0) { printf("Table is empty.\n"); break; }
+            printf("Concurrent full-table filters: each thread runs its own queries,\n");
+            printf("first scanning independently, then attached to one shared circular scan.\n");
+            printf("Column index or name: ");
+            int colIdx = readColumnIndex(table);
+            if (colIdx < 0) { printf("Column not found.\n"); break; }
+            int threads = 0, queries = 0;
+            printf("Max concurrent threads (1-64): ");
+            scanf("%d", &threads);
+            printf("Queries per thread: ");
+            scanf("%d", &queries);
+            while ((ch = getchar()) != '\n' && ch != EOF) {}
+            if (threads < 1) threads = 8;
+            if (queries < 1) queries = 20;
+            sharedScanBenchmark(table, colIdx, threads, queries);
+            break;
+        }
+        
+        case 21: { // batch query
+            if (!table || table->rowCount == 0) { printf("Table is empty.\n"); break; }
+            printf("One predicate per line, empty line to run:\n");
+            printf("  <column> = <value> | >= <value> | <= <value> | between <low> <high> | contains <text>\n");
+            BatchPredicate preds[BATCH_MENU_MAX];
+            char lines[BATCH_MENU_MAX][128];
+            char values[BATCH_MENU_MAX][128];
+            int count = 0;
+            while (count < BATCH_MENU_MAX) {
+                printf("#%d: ", count + 1);
+                readLine(lines[count], sizeof(lines[count]));
+                if (lines[count][0] == '\0') break;
+                if (parseBatchPredicate(table, lines[count], &preds[count], values[count], sizeof(values[count]))) count++;
+                else printf("  Not understood (unknown column, operator, or wrong value type).\n");
+            }
+            if (count == 0) break;
+            
+            SearchResult* batched[BATCH_MENU_MAX];
+            SearchResult* separate[BATCH_MENU_MAX];
+            HighResTimer timer;
+            timerStart(&timer);
+            batchEvaluate(table, preds, count, batched);
+            double batchMs = timerEndMs(&timer);
+            timerStart(&timer);
+            for (int i = 0; i < count; i++) separate[i] = linearFindPredicate(table, &preds[i]);
+            double separateMs = timerEndMs(&timer);
+            for (int i = 0; i < count; i++) {
+                int same = batched[i]->count == separate[i]->count &&
+                           memcmp(batched[i]->rowNums, separate[i]->rowNums, batched[i]->count * sizeof(unsigned int)) == 0;
+                printf("  #%d %s: %d record(s)%s\n", i + 1, lines[i], batched[i]->count, same ? "" : "  [differs from separate scan]");
+                freeSearchResult(batched[i]);
+                freeSearchResult(separate[i]);
+            }
+            printf("One pass: %.2f ms; %d separate scans: %.2f ms (x%.2f)\n",
+                   batchMs, count, separateMs, separateMs / (batchMs > 0 ? batchMs : 1e-3));
+            break;
+        }
+        
         case 0:
             running = 0;
             break;
@@ -2403,9 +10425,16 @@ int main() {
             }
             waitEnter();
         }
+        reclusterStep(table);// 自动聚簇：请求之间把一批新行归位
+        storeStep(table);// 列存：装上已完成的合并，增量区够大就开始下一次后台合并
+        lsmStep(table);// LSM：装上已完成的段合并
+        sharedStep(table);// 共享内存：表改过就重新发布
+        queryArenaReset();// 本次请求的临时内存一次性回收
     }
 
     if (table) freeTable(table);
+    detachSharedTable(sharedView);
+    queryArenaRelease();
     printf("Goodbye!\n");
     return 0;
 }